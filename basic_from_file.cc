@@ -223,8 +223,8 @@ int main(int argc, const char *argv[]) {
   // Flush vmaf context.
   vmaf_read_pictures(vmaf, NULL, NULL, 0);
   printf("Releasing VMAF resources.\n");
-  vmaf_model_destroy(model[0]);
-  vmaf_model_collection_destroy(model_collection[0]);
+  vmaf_model_release(model[0]);
+  vmaf_model_collection_release(model_collection[0]);
   vmaf_close(vmaf);
   printf("releasing all AV the resources\n");
   avformat_close_input(&ref_pFormatContext);
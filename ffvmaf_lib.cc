@@ -7,41 +7,33 @@ extern "C" {
 #include "libswscale/swscale.h"
 }
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-// Returns 0 if no frames have been decoded, 1 if a frame has been decoded, and a negative value on error.
-static int decode_packet(AVPacket *pPacket, AVCodecContext *pCodecContext,
-                         AVFrame *pFrame) {
-  int response = avcodec_send_packet(pCodecContext, pPacket);
+// Maximum number of decoded frames buffered per input between its decode thread and the scoring loop.
+static const size_t kFrameQueueCapacity = 8;
 
-  if (response < 0) {
-    printf("Error while sending a packet to the decoder: ");
-    printf("\n");
-    return response;
-  }
+// Maximum number of picture pairs a threaded VmafContext queues for feature extraction at a time. Bounds the decoded
+// frames it keeps alive when scoring runs behind decoding.
+static const unsigned kMaxInflightFrames = 8;
 
-  int num_frames = 0;
-  while (response >= 0) {
-    // We know that there is exactly one frame per packet. After reading this frame, however, we still need to make another
-    // call to receive_frame() to flush the decoder. To retain the decoded frame, we don't pass it in the flush call
-    // and instead pass a nullptr.
-    auto frame_arg = num_frames == 0 ? pFrame : nullptr;
-    response = avcodec_receive_frame(pCodecContext, frame_arg);
-    if (response == AVERROR(EAGAIN) || response == AVERROR_EOF) {
-      break;
-    } else if (response < 0) {
-      return response;
-    }
-    num_frames++;
-  }
-  return num_frames;
-}
+// Number of most recently read picture pairs kept by the per-frame loop. Its scores lag the pictures read by two
+// frames, since motion needs the frame after the one it scores.
+static const unsigned kNumRecentPictures = 3;
 
 int InitializeVmaf(VmafContext *vmaf,
                    VmafModel **model,
                    VmafModelCollection **model_collection,
                    uint64_t *model_collection_count, const char *model_buffer, uint64_t model_buffer_size,
-                   bool use_phone_model) {
+                   bool use_phone_model,
+                   const char *reference_cache_path) {
 
   enum VmafModelFlags flags = VMAF_MODEL_FLAGS_DEFAULT;
   if (use_phone_model) {
@@ -52,18 +44,33 @@ int InitializeVmaf(VmafContext *vmaf,
       .flags = flags,
   };
 
-  if (vmaf_model_load_from_buffer(model, &model_config, model_buffer, model_buffer_size) != 0) {
+  // Models from the registry are shared with every other context and read-only, so a model the reference cache is
+  // enabled on is loaded on its own.
+  const bool shared = reference_cache_path == nullptr;
+  const int model_err = shared ? vmaf_model_acquire_from_buffer(model, &model_config, model_buffer, model_buffer_size)
+                               : vmaf_model_load_from_buffer(model, &model_config, model_buffer, model_buffer_size);
+  if (model_err != 0) {
     printf("Reading json model from buffer failed. Attempting to read it as a model collection.\n");
 
-    if (vmaf_model_collection_load_from_buffer(model,
-                                               model_collection,
-                                               &model_config,
-                                               model_buffer,
-                                               model_buffer_size) != 0) {
+    const int collection_err =
+        shared ? vmaf_model_collection_acquire_from_buffer(model, model_collection, &model_config, model_buffer,
+                                                           model_buffer_size)
+               : vmaf_model_collection_load_from_buffer(model, model_collection, &model_config, model_buffer,
+                                                        model_buffer_size);
+    if (collection_err != 0) {
       fprintf(stderr, "Reading json model collection from buffer failed. Unable to read model.\n");
       return -1;
     }
 
+    if (reference_cache_path != nullptr) {
+      VmafFeatureDictionary *opts_dict = nullptr;
+      if (vmaf_feature_dictionary_set(&opts_dict, "reference_cache", reference_cache_path) != 0 ||
+          vmaf_model_collection_feature_overload(model[0], model_collection, "motion", opts_dict) != 0) {
+        fprintf(stderr, "Problem enabling the reference cache for the model collection.\n");
+        return -1;
+      }
+    }
+
     if (vmaf_use_features_from_model_collection(vmaf, model_collection[0]) != 0) {
       fprintf(stderr, "Problem registering feature extractors from model collection.\n");
       return -1;
@@ -73,6 +80,16 @@ int InitializeVmaf(VmafContext *vmaf,
     *model_collection_count = *model_collection_count + 1;
   }
 
+  // Motion is the only extractor whose reference-side work is cached.
+  if (reference_cache_path != nullptr) {
+    VmafFeatureDictionary *opts_dict = nullptr;
+    if (vmaf_feature_dictionary_set(&opts_dict, "reference_cache", reference_cache_path) != 0 ||
+        vmaf_model_feature_overload(model[0], "motion", opts_dict) != 0) {
+      fprintf(stderr, "Problem enabling the reference cache for the model.\n");
+      return -1;
+    }
+  }
+
   // Register the feature extractors required by the model.
   if (vmaf_use_features_from_model(vmaf, model[0]) != 0) {
     fprintf(stderr, "Problem registering feature extractors for the model.\n");
@@ -83,205 +100,542 @@ int InitializeVmaf(VmafContext *vmaf,
   return 0;
 }
 
-bool GetNextFrame(AVFormatContext *pFormatContext,
-                  AVCodecContext *pCodecContext,
-                  AVPacket *pPacket,
-                  AVFrame *pFrame,
-                  int8_t video_stream_index) {
-  while (av_read_frame(pFormatContext, pPacket) >= 0) {
-    if (pPacket->stream_index == video_stream_index) {
-      // decode_packet returns the number of frames decoded, or a negative value on error.
-      int response = decode_packet(pPacket, pCodecContext, pFrame);
-      if (response == 0) {
-        // No error but no frame decoded.
-        continue;
-      }
-      return (response == 1);
+// Bounded, thread-safe queue of decoded frames, as the VmafPictures they are scored as, handed from a decode thread to
+// the scoring loop. Each picture may come with the decoded frame it was converted from. The queue owns the pictures and
+// frames it holds and releases any that are left over when it is destroyed.
+class FrameQueue {
+ public:
+  explicit FrameQueue(size_t capacity) : capacity_(capacity) {}
+
+  ~FrameQueue() {
+    for (Entry &entry : entries_) {
+      vmaf_picture_unref(&entry.picture);
+      av_frame_free(&entry.frame);
     }
-    av_packet_unref(pPacket);
   }
-  return false;
+
+  // Blocks while the queue is full. Returns false, without taking ownership of the picture and frame, if the consumer
+  // cancelled. The frame may be null.
+  bool Push(const VmafPicture &picture, AVFrame *frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return cancelled_ || entries_.size() < capacity_; });
+    if (cancelled_) {
+      return false;
+    }
+    entries_.push_back({picture, frame});
+    not_empty_.notify_one();
+    return true;
+  }
+
+  // Blocks until a picture is available and hands it over with its frame. Returns false once the producer has finished
+  // and the queue is drained.
+  bool Pop(VmafPicture *picture, AVFrame **frame) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return finished_ || !entries_.empty(); });
+    if (entries_.empty()) {
+      return false;
+    }
+    *picture = entries_.front().picture;
+    *frame = entries_.front().frame;
+    entries_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  // Called by the producer after its last picture has been pushed.
+  void Finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    finished_ = true;
+    not_empty_.notify_all();
+  }
+
+  // Called by the consumer to unblock the producer and make it stop decoding.
+  void Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    cancelled_ = true;
+    not_full_.notify_all();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  struct Entry {
+    VmafPicture picture;
+    AVFrame *frame;
+  };
+  std::deque<Entry> entries_;
+  const size_t capacity_;
+  bool finished_ = false;
+  bool cancelled_ = false;
+};
+
+// A pixel format that frames are scored in, with the gray format of its luma plane and the VmafPicture layout it
+// corresponds to.
+struct ScoringFormat {
+  AVPixelFormat format;
+  AVPixelFormat luma_format;
+  VmafPixelFormat pix_fmt;
+  unsigned bpc;
+};
+
+// The formats libvmaf scores natively. Frames are passed in these formats at their own bit depth, so the high bit depth
+// feature paths do the work. Frames in any other format are converted to the first.
+static const ScoringFormat kScoringFormats[] = {
+    {AV_PIX_FMT_YUV420P, AV_PIX_FMT_GRAY8, VMAF_PIX_FMT_YUV420P, 8},
+    {AV_PIX_FMT_YUV422P, AV_PIX_FMT_GRAY8, VMAF_PIX_FMT_YUV422P, 8},
+    {AV_PIX_FMT_YUV444P, AV_PIX_FMT_GRAY8, VMAF_PIX_FMT_YUV444P, 8},
+    {AV_PIX_FMT_YUV420P10, AV_PIX_FMT_GRAY10, VMAF_PIX_FMT_YUV420P, 10},
+    {AV_PIX_FMT_YUV422P10, AV_PIX_FMT_GRAY10, VMAF_PIX_FMT_YUV422P, 10},
+    {AV_PIX_FMT_YUV444P10, AV_PIX_FMT_GRAY10, VMAF_PIX_FMT_YUV444P, 10},
+    {AV_PIX_FMT_YUV420P12, AV_PIX_FMT_GRAY12, VMAF_PIX_FMT_YUV420P, 12},
+    {AV_PIX_FMT_YUV422P12, AV_PIX_FMT_GRAY12, VMAF_PIX_FMT_YUV422P, 12},
+    {AV_PIX_FMT_YUV444P12, AV_PIX_FMT_GRAY12, VMAF_PIX_FMT_YUV444P, 12},
+};
+
+// Returns the scoring format for a pixel format, or nullptr if libvmaf does not score it natively.
+static const ScoringFormat *FindScoringFormat(int format) {
+  for (const ScoringFormat &scoring_format : kScoringFormats) {
+    if (scoring_format.format == format) {
+      return &scoring_format;
+    }
+  }
+  return nullptr;
 }
 
-int AllocateAndOpenCodecContexts(AVCodecContext *&pCodecContext_reference,
-                                 AVCodecContext *&pCodecContext_test,
-                                 const AVCodecParameters *pCodecParameters_reference,
-                                 const AVCodecParameters *pCodecParameters_test,
-                                 const AVCodec *pCodec_reference,
-                                 const AVCodec *pCodec_test) {
-  pCodecContext_reference = avcodec_alloc_context3(pCodec_reference);
-  pCodecContext_test = avcodec_alloc_context3(pCodec_test);
-  if (!pCodecContext_reference || !pCodecContext_test) {
+// Demuxing, decoding and scaling state for one input video.
+struct InputVideo {
+  AVFormatContext *format_context = nullptr;
+  AVCodecContext *codec_context = nullptr;
+  const AVCodecParameters *codec_parameters = nullptr;
+  int video_stream_index = -1;
+  // Reads the video through caller-supplied callbacks when it is not opened from a file. Freed after format_context.
+  AVIOContext *io_context = nullptr;
+  // Resolution at which the video is scored and the swscale flags used to get there.
+  int scoring_width = 0;
+  int scoring_height = 0;
+  int scaler_flags = SWS_BICUBIC;
+  // Pixel format the video is scored in.
+  const ScoringFormat *scoring_format = &kScoringFormats[0];
+  // Set when no registered feature extractor reads chroma. Only the luma plane is then scaled and scored.
+  bool luma_only = false;
+  // Set when the scoring loop needs the decoded frames as well as the pictures they are scored as.
+  bool keep_decoded_frames = false;
+  // Context whose picture pool scaled frames are written into.
+  VmafContext *vmaf = nullptr;
+  // Scales decoded frames to the scoring resolution. Created on the first frame that needs it.
+  SwsContext *sws_context = nullptr;
+  // Decoded frames before this index, which a seek to the preceding keyframe hands back, are dropped.
+  unsigned first_frame_index = 0;
+  // Set by the decode thread when a frame decoded after a seek has no timestamp, so that it can't be told apart from
+  // the frames to drop. Read once the input's queue is finished.
+  bool frame_without_timestamp = false;
+
+  ~InputVideo() {
+    sws_freeContext(sws_context);
+    if (codec_context != nullptr)
+      avcodec_free_context(&codec_context);
+    if (format_context != nullptr)
+      avformat_close_input(&format_context);
+    if (io_context != nullptr) {
+      av_freep(&io_context->buffer);
+      avio_context_free(&io_context);
+    }
+  }
+};
+
+bool IsUHDResolution(int width, int height) {
+  return height >= 2160;
+}
+
+static int AllocateAndOpenCodecContext(InputVideo *input, const AVCodec *pCodec) {
+  input->codec_context = avcodec_alloc_context3(pCodec);
+  if (!input->codec_context) {
     fprintf(stderr, "failed to allocated memory for AVCodecContext\n");
-    return -1.0;
+    return -1;
   }
 
-  if (avcodec_parameters_to_context(pCodecContext_reference, pCodecParameters_reference) < 0
-      || avcodec_parameters_to_context(pCodecContext_test, pCodecParameters_test) < 0) {
+  if (avcodec_parameters_to_context(input->codec_context, input->codec_parameters) < 0) {
     fprintf(stderr, "failed to copy codec params to codec context\n");
-    return -1.0;
+    return -1;
   }
 
-  if (avcodec_open2(pCodecContext_reference, pCodec_reference, NULL) < 0
-      || avcodec_open2(pCodecContext_test, pCodec_test, NULL) < 0) {
+  if (avcodec_open2(input->codec_context, pCodec, NULL) < 0) {
     fprintf(stderr, "failed to open codec through avcodec_open2\n");
-    return -1.0;
+    return -1;
   }
   return 0;
 }
 
-static int ScaleFrame(SwsContext *sws_context, AVFrame *dst, AVFrame *src) {
-  sws_scale(sws_context,
-            (const uint8_t *const *) src->data,
-            src->linesize,
-            0,
-            src->height,
-            dst->data,
-            dst->linesize);
-  return 0;
+// Finds the first video stream of an opened input and prepares its decoder. The name is used in error messages.
+static VmafComputeStatus OpenVideoStream(const char *name, InputVideo *input) {
+  if (avformat_find_stream_info(input->format_context, NULL) < 0) {
+    printf("ERROR could not get the stream info\n");
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+
+  const AVCodec *pCodec = NULL;
+  for (int i = 0; i < input->format_context->nb_streams; i++) {
+    const AVCodecParameters *pLocalCodecParameters = input->format_context->streams[i]->codecpar;
+    const AVCodec *pLocalCodec = avcodec_find_decoder(pLocalCodecParameters->codec_id);
+
+    if (pLocalCodec == NULL) {
+      printf("ERROR unsupported codec!\n");
+      // In this example if the codec is not found we just skip it
+      continue;
+    }
+
+    // when the stream is a video we store its index, codec parameters and codec
+    if (pLocalCodecParameters->codec_type == AVMEDIA_TYPE_VIDEO) {
+      input->video_stream_index = i;
+      input->codec_parameters = pLocalCodecParameters;
+      pCodec = pLocalCodec;
+      break;
+    }
+  }
+
+  if (input->video_stream_index == -1) {
+    fprintf(stderr, "%s does not contain a video stream!\n", name);
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+
+  if (AllocateAndOpenCodecContext(input, pCodec) != 0) {
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+  return VmafComputeStatus::SUCCESS;
 }
 
-static int ScaleFrameToHD(SwsContext *sws_context, AVFrame *&dst, AVFrame *&src) {
-  if (sws_context != NULL) {
-    ScaleFrame(sws_context, dst, src);
-  } else {
-    dst = src;
+// Opens the file, finds its first video stream and prepares its decoder.
+static VmafComputeStatus OpenInputVideo(const std::string &file, InputVideo *input) {
+  input->format_context = avformat_alloc_context();
+  if (!input->format_context) {
+    fprintf(stderr, "ERROR could not allocate memory for format context\n");
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
   }
-  return 0;
+
+  // avformat_open_input frees the context on failure.
+  if (avformat_open_input(&input->format_context, file.c_str(), NULL, NULL) != 0) {
+    fprintf(stderr, "ERROR could not open file %s.\n", file.c_str());
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+  return OpenVideoStream(file.c_str(), input);
 }
 
-static int AllocateHDFrame(const AVCodecParameters *pCodec_parameters,
-                           SwsContext *&sws_context,
-                           AVFrame *&scaled_pFrame) {
-  sws_context = sws_getContext(pCodec_parameters->width,
-                               pCodec_parameters->height,
-                               AV_PIX_FMT_YUV420P,
-                               1920,
-                               1080,
-                               AV_PIX_FMT_YUV420P,
-                               SWS_BICUBIC,
-                               NULL,
-                               NULL,
-                               NULL);
-
-  scaled_pFrame = av_frame_alloc();
-  if (!scaled_pFrame) {
-    fprintf(stderr, "Failed to allocate new frame.");
-    return -1.0;
-  }
-  scaled_pFrame->height = 1080;
-  scaled_pFrame->width = 1920;
-  scaled_pFrame->format = AV_PIX_FMT_YUV420P;
-  if (av_frame_get_buffer(scaled_pFrame, 32)) {
-    fprintf(stderr, "Failed to allocate data buffers for new frame.\n");
-    av_frame_free(&scaled_pFrame);
-    return -1.0;
+// Opens the video read through the source's callbacks, finds its first video stream and prepares its decoder. The
+// name is used in error messages.
+static VmafComputeStatus OpenInputVideo(const InputSource &source, const char *name, InputVideo *input) {
+  if (source.read == nullptr || source.buffer_size <= 0) {
+    fprintf(stderr, "ERROR invalid input source for %s.\n", name);
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+
+  input->format_context = avformat_alloc_context();
+  if (!input->format_context) {
+    fprintf(stderr, "ERROR could not allocate memory for format context\n");
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+
+  // The buffer is owned by the AVIOContext from here on, which may replace it with one of another size.
+  unsigned char *buffer = static_cast<unsigned char *>(av_malloc(source.buffer_size));
+  if (buffer != nullptr) {
+    input->io_context = avio_alloc_context(buffer, source.buffer_size, 0, source.opaque, source.read, NULL,
+                                           source.seek);
+  }
+  if (input->io_context == nullptr) {
+    av_free(buffer);
+    fprintf(stderr, "ERROR could not allocate memory for the I/O context of %s\n", name);
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
   }
+  input->format_context->pb = input->io_context;
+
+  // avformat_open_input frees the context on failure, but never a caller-supplied I/O context.
+  if (avformat_open_input(&input->format_context, NULL, NULL, NULL) != 0) {
+    fprintf(stderr, "ERROR could not open %s.\n", name);
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+  return OpenVideoStream(name, input);
+}
+
+// Scales the planes of a VmafPicture into a frame.
+static int ScalePicture(SwsContext *sws_context, AVFrame *dst, const VmafPicture &src) {
+  const uint8_t *data[3] = {static_cast<const uint8_t *>(src.data[0]), static_cast<const uint8_t *>(src.data[1]),
+                            static_cast<const uint8_t *>(src.data[2])};
+  const int stride[3] = {(int) src.stride[0], (int) src.stride[1], (int) src.stride[2]};
+  sws_scale(sws_context, data, stride, 0, src.h[0], dst->data, dst->linesize);
   return 0;
 }
 
-static int AllocateFramesAndPackets(AVFrame *&pFrame_reference,
-                                    AVFrame *&pFrame_test,
-                                    AVPacket *&pPacket_reference,
-                                    AVPacket *&pPacket_test) {
-  pFrame_reference = av_frame_alloc();
-  pFrame_test = av_frame_alloc();
-  if (!pFrame_reference || !pFrame_test) {
-    fprintf(stderr, "failed to allocate memory for AVFrame\n");
-    return -1;
-  }
+static void ReleaseWrappedFrame(void *cookie) {
+  AVFrame *frame = static_cast<AVFrame *>(cookie);
+  av_frame_free(&frame);
+}
 
-  pPacket_reference = av_packet_alloc();
-  pPacket_test = av_packet_alloc();
-  if (!pPacket_reference || !pPacket_test) {
-    fprintf(stderr, "failed to allocate memory for AVPacket\n");
-    return -1;
+// Wraps the planes of an AVFrame (FFMPEG's frame abstraction) in a VmafPicture (VMAF's frame abstraction) without
+// copying them. A YUV400P picture wraps the luma plane only. On success the picture owns the frame, which libvmaf
+// frees once the last reference to the picture is dropped.
+static int WrapPictureData(AVFrame *src, VmafPicture *dst, VmafPixelFormat pix_fmt, unsigned bpc) {
+  void *data[3] = {src->data[0], src->data[1], src->data[2]};
+  const ptrdiff_t stride[3] = {src->linesize[0], src->linesize[1], src->linesize[2]};
+  int err = vmaf_picture_wrap(dst, pix_fmt, bpc, src->width, src->height, data, stride, ReleaseWrappedFrame, src);
+  if (err) {
+    fprintf(stderr, "Error wrapping vmaf picture: %d.\n", err);
+    return err;
   }
+
   return 0;
 }
 
-// Copies picture data from AVFrame (FFMPEG's frame abstraction) to VmafPicture (VMAF's frame abstraction).
-static int CopyPictureData(AVFrame *src, VmafPicture *dst, unsigned bpc) {
-  int err = vmaf_picture_alloc(dst, VMAF_PIX_FMT_YUV420P, bpc,
-                               src->width, src->height);
+static void ReleaseWrappedPicture(void *cookie) {
+  VmafPicture *picture = static_cast<VmafPicture *>(cookie);
+  vmaf_picture_unref(picture);
+  delete picture;
+}
+
+// Wraps the luma plane of a picture in a YUV400P picture, which takes over the reference to the picture.
+static int WrapLumaPlane(VmafPicture *src, VmafPicture *dst) {
+  VmafPicture *cookie = new VmafPicture(*src);
+  void *data[3] = {src->data[0], nullptr, nullptr};
+  const ptrdiff_t stride[3] = {src->stride[0], 0, 0};
+  int err = vmaf_picture_wrap(dst, VMAF_PIX_FMT_YUV400P, src->bpc, src->w[0], src->h[0], data, stride,
+                              ReleaseWrappedPicture, cookie);
   if (err) {
-    fprintf(stderr, "Error allocating vmaf picture: %d.\n", err);
-    return AVERROR(ENOMEM);
+    fprintf(stderr, "Error wrapping vmaf picture: %d.\n", err);
+    delete cookie;
+    return err;
   }
+  return 0;
+}
 
-  for (unsigned i = 0; i < 3; i++) {
-    uint8_t *src_data = (uint8_t *) src->data[i];
-    uint8_t *dst_data = (uint8_t *) dst->data[i];
-    for (unsigned j = 0; j < dst->h[i]; j++) {
-      memcpy(dst_data, src_data, sizeof(*dst_data) * dst->w[i]);
-      src_data += src->linesize[i];
-      dst_data += dst->stride[i];
-    }
+// Returns true if only the luma plane of the frame needs to be converted to the input's scoring format, because the
+// input is luma-only and the frame's luma plane already has the scoring bit depth.
+static bool NeedsLumaPlaneOnly(const InputVideo *input, const AVFrame *frame) {
+  const ScoringFormat *frame_format = FindScoringFormat(frame->format);
+  return input->luma_only && frame_format != nullptr && frame_format->bpc == input->scoring_format->bpc;
+}
+
+// Scales a frame straight into a picture from the input's context pool, at libvmaf's alignment and stride, so that
+// no intermediate frame is allocated. When only its luma plane is needed, only that plane is scaled. Gray to gray
+// scaling uses the same luma filter as YUV to YUV and, unlike a YUV to gray conversion, leaves the range alone. The
+// other frames of a luma-only input are converted in full and their luma plane is wrapped.
+static int ScaleFrameToPicture(InputVideo *input, const AVFrame *frame, VmafPicture *picture) {
+  const ScoringFormat &scoring_format = *input->scoring_format;
+  const bool luma_plane_only = NeedsLumaPlaneOnly(input, frame);
+  const AVPixelFormat src_format = luma_plane_only ? scoring_format.luma_format : (AVPixelFormat) frame->format;
+  const AVPixelFormat dst_format = luma_plane_only ? scoring_format.luma_format : scoring_format.format;
+  input->sws_context = sws_getCachedContext(input->sws_context,
+                                            frame->width,
+                                            frame->height,
+                                            src_format,
+                                            input->scoring_width,
+                                            input->scoring_height,
+                                            dst_format,
+                                            input->scaler_flags,
+                                            NULL,
+                                            NULL,
+                                            NULL);
+  if (input->sws_context == nullptr) {
+    fprintf(stderr, "Failed to create the scaling context.\n");
+    return AVERROR(EINVAL);
   }
 
+  VmafPicture scaled;
+  int err = vmaf_fetch_picture(input->vmaf, &scaled, luma_plane_only ? VMAF_PIX_FMT_YUV400P : scoring_format.pix_fmt,
+                               scoring_format.bpc, input->scoring_width, input->scoring_height);
+  if (err) {
+    fprintf(stderr, "Error fetching vmaf picture: %d.\n", err);
+    return err;
+  }
+  uint8_t *data[3] = {static_cast<uint8_t *>(scaled.data[0]), static_cast<uint8_t *>(scaled.data[1]),
+                      static_cast<uint8_t *>(scaled.data[2])};
+  const int stride[3] = {(int) scaled.stride[0], (int) scaled.stride[1], (int) scaled.stride[2]};
+  sws_scale(input->sws_context, (const uint8_t *const *) frame->data, frame->linesize, 0, frame->height, data,
+            stride);
+
+  if (input->luma_only && !luma_plane_only) {
+    err = WrapLumaPlane(&scaled, picture);
+    if (err) {
+      vmaf_picture_unref(&scaled);
+    }
+    return err;
+  }
+  *picture = scaled;
   return 0;
 }
 
-static int CopyFrameToBuffer(AVFrame *frame, uint8_t *buffer) {
-  for (unsigned i = 0; i < 3; i++) {
-    uint8_t *frame_data = (uint8_t *) frame->data[i];
-    for (unsigned j = 0; j < frame->height; j++) {
-      memcpy(buffer, frame_data, sizeof(*buffer) * frame->linesize[i]);
-      frame_data += frame->linesize[i];
-      buffer += frame->linesize[i];
+// Turns a decoded frame into the VmafPicture it is scored as and releases the frame. A frame in the scoring format at
+// the scoring resolution, or one whose luma plane is all a luma-only input needs, is wrapped as it is. Any other frame
+// is scaled. Returns 0 on success or a negative value on error.
+static int ConvertFrameToPicture(InputVideo *input, AVFrame *frame, VmafPicture *picture) {
+  const ScoringFormat &scoring_format = *input->scoring_format;
+  if (frame->width == input->scoring_width && frame->height == input->scoring_height &&
+      (frame->format == scoring_format.format || NeedsLumaPlaneOnly(input, frame))) {
+    const VmafPixelFormat pix_fmt = input->luma_only ? VMAF_PIX_FMT_YUV400P : scoring_format.pix_fmt;
+    const int err = WrapPictureData(frame, picture, pix_fmt, scoring_format.bpc);
+    if (err) {
+      av_frame_free(&frame);
     }
+    return err;
   }
-  return 0;
+  const int err = ScaleFrameToPicture(input, frame, picture);
+  av_frame_free(&frame);
+  return err;
 }
 
-bool IsHDResolution(const AVCodecParameters *codec_parameters) {
-  return codec_parameters->height == 1080 && codec_parameters->width == 1920;
+// Returns the index of a decoded frame in its stream, computed from its timestamp, or -1 if it has none.
+static int64_t GetFrameIndex(const InputVideo *input, const AVFrame *frame) {
+  if (frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+    return -1;
+  }
+  const AVStream *stream = input->format_context->streams[input->video_stream_index];
+  const int64_t start_time = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+  return av_rescale_q(frame->best_effort_timestamp - start_time, stream->time_base, av_inv_q(stream->r_frame_rate));
 }
 
-void FreeResources(AVFormatContext *pFormatContext_reference,
-                   AVFormatContext *pFormatContext_test,
-                   SwsContext *reference_sws_context,
-                   SwsContext *test_sws_context,
-                   AVFrame *pFrame_reference,
-                   AVFrame *pFrame_test,
-                   AVPacket *pPacket_reference,
-                   AVPacket *pPacket_test,
-                   AVFrame *scaled_pFrame_reference,
-                   AVFrame *scaled_pFrame_test,
-                   AVCodecContext *pCodecContext_reference = NULL,
-                   AVCodecContext *pCodecContext_test = NULL) {
-  if (pFormatContext_reference != NULL)
-    avformat_close_input(&pFormatContext_reference);
+// Whether frame indices and timestamps convert into each other at r_frame_rate: the frame rate is known and the
+// average frame rate matches it exactly. Streams that may have a variable frame rate fail the check.
+static bool HasConstantFrameRate(const InputVideo &input) {
+  const AVStream *stream = input.format_context->streams[input.video_stream_index];
+  return stream->r_frame_rate.num > 0 && stream->r_frame_rate.den > 0 &&
+         av_cmp_q(stream->r_frame_rate, stream->avg_frame_rate) == 0;
+}
 
-  if (pFormatContext_test != NULL)
-    avformat_close_input(&pFormatContext_test);
+// Seeks to the keyframe at or before frame_index so that decoding resumes at frame_index. The stream must have a
+// constant frame rate. Must be called before the input's decode thread starts. Returns 0 on success or a negative value
+// on error.
+static int SeekToFrame(InputVideo *input, unsigned frame_index) {
+  if (frame_index == 0) {
+    return 0;
+  }
+  const AVStream *stream = input->format_context->streams[input->video_stream_index];
+  const int64_t start_time = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+  const int64_t timestamp = start_time + av_rescale_q(frame_index, av_inv_q(stream->r_frame_rate), stream->time_base);
+  const int response = av_seek_frame(input->format_context, input->video_stream_index, timestamp,
+                                     AVSEEK_FLAG_BACKWARD);
+  if (response < 0) {
+    fprintf(stderr, "Error seeking to frame %u: %d\n", frame_index, response);
+    return response;
+  }
+  avcodec_flush_buffers(input->codec_context);
+  input->first_frame_index = frame_index;
+  return 0;
+}
 
-  sws_freeContext(reference_sws_context);
-  sws_freeContext(test_sws_context);
+// Sends a packet, or nullptr to flush, to the decoder and pushes every frame it hands back, as the picture it is scored
+// as, to the queue. Returns 0
+// when the decoder needs more input, AVERROR_EOF once it is fully flushed, AVERROR_EXIT if the consumer cancelled,
+// or another negative value on error.
+static int DecodePacket(InputVideo *input, const AVPacket *pPacket, FrameQueue *queue) {
+  int response = avcodec_send_packet(input->codec_context, pPacket);
+  if (response < 0) {
+    printf("Error while sending a packet to the decoder: %d\n", response);
+    return response;
+  }
 
-  if (pFrame_reference != NULL)
-    av_frame_free(&pFrame_reference);
+  for (;;) {
+    AVFrame *pFrame = av_frame_alloc();
+    if (!pFrame) {
+      return AVERROR(ENOMEM);
+    }
+    response = avcodec_receive_frame(input->codec_context, pFrame);
+    if (response < 0) {
+      av_frame_free(&pFrame);
+      return response == AVERROR(EAGAIN) ? 0 : response;
+    }
+    const int64_t frame_index = GetFrameIndex(input, pFrame);
+    if (frame_index < 0 && input->first_frame_index > 0) {
+      // The frame may be one of those before the seek target. Scoring it could put the inputs out of step.
+      fprintf(stderr, "Frame decoded after seeking to frame %u has no timestamp.\n", input->first_frame_index);
+      input->frame_without_timestamp = true;
+      av_frame_free(&pFrame);
+      return AVERROR_INVALIDDATA;
+    }
+    if (frame_index >= 0 && frame_index < input->first_frame_index) {
+      av_frame_free(&pFrame);
+      continue;
+    }
+    AVFrame *decoded_frame = nullptr;
+    if (input->keep_decoded_frames && (decoded_frame = av_frame_clone(pFrame)) == nullptr) {
+      av_frame_free(&pFrame);
+      return AVERROR(ENOMEM);
+    }
+    VmafPicture picture;
+    response = ConvertFrameToPicture(input, pFrame, &picture);
+    if (response < 0) {
+      av_frame_free(&decoded_frame);
+      return response;
+    }
+    if (!queue->Push(picture, decoded_frame)) {
+      vmaf_picture_unref(&picture);
+      av_frame_free(&decoded_frame);
+      return AVERROR_EXIT;
+    }
+  }
+}
+
+// Body of a decode thread: demuxes and decodes the whole video stream into the queue, then marks it finished.
+static void DecodeFrames(InputVideo *input, FrameQueue *queue) {
+  AVPacket *pPacket = av_packet_alloc();
+  int response = pPacket != nullptr ? 0 : AVERROR(ENOMEM);
+
+  while (response >= 0 && av_read_frame(input->format_context, pPacket) >= 0) {
+    if (pPacket->stream_index == input->video_stream_index) {
+      response = DecodePacket(input, pPacket, queue);
+    }
+    av_packet_unref(pPacket);
+  }
 
-  if (pFrame_test != NULL)
-    av_frame_free(&pFrame_test);
+  // Drain the frames still buffered inside the decoder.
+  if (response >= 0) {
+    response = DecodePacket(input, nullptr, queue);
+  }
+  if (response < 0 && response != AVERROR_EOF && response != AVERROR_EXIT) {
+    fprintf(stderr, "Error while decoding: %d\n", response);
+  }
 
-  if (pPacket_reference != NULL)
-    av_packet_free(&pPacket_reference);
+  av_packet_free(&pPacket);
+  queue->Finish();
+}
 
-  if (pPacket_test != NULL)
-    av_packet_free(&pPacket_test);
+// Runs DecodeFrames for one input on its own thread. Destroying the stage cancels decoding and joins the thread.
+class DecodeStage {
+ public:
+  explicit DecodeStage(InputVideo *input) : queue_(kFrameQueueCapacity), thread_(DecodeFrames, input, &queue_) {}
 
-  if (scaled_pFrame_reference != NULL)
-    av_frame_free(&scaled_pFrame_reference);
+  ~DecodeStage() {
+    queue_.Cancel();
+    thread_.join();
+  }
 
-  if (scaled_pFrame_test != NULL)
-    av_frame_free(&scaled_pFrame_test);
+  // Hands the caller the next decoded frame as a picture, and the frame itself if frame is not null and the input
+  // keeps its decoded frames. Returns false at the end of the stream.
+  bool NextPicture(VmafPicture *picture, AVFrame **frame = nullptr) {
+    AVFrame *decoded_frame;
+    if (!queue_.Pop(picture, &decoded_frame)) {
+      return false;
+    }
+    if (frame != nullptr) {
+      *frame = decoded_frame;
+    } else {
+      av_frame_free(&decoded_frame);
+    }
+    return true;
+  }
 
-  if (pCodecContext_reference != NULL)
-    avcodec_free_context(&pCodecContext_reference);
+ private:
+  FrameQueue queue_;
+  std::thread thread_;
+};
 
-  if (pCodecContext_test != NULL)
-    avcodec_free_context(&pCodecContext_test);
+static int CopyFrameToBuffer(AVFrame *frame, uint8_t *buffer) {
+  for (unsigned i = 0; i < 3; i++) {
+    uint8_t *frame_data = (uint8_t *) frame->data[i];
+    for (unsigned j = 0; j < frame->height; j++) {
+      memcpy(buffer, frame_data, sizeof(*buffer) * frame->linesize[i]);
+      frame_data += frame->linesize[i];
+      buffer += frame->linesize[i];
+    }
+  }
+  return 0;
 }
 
 unsigned GetNumCommonFrames(const AVFormatContext *pFormatContext_reference,
@@ -345,253 +699,322 @@ class OutputBuffer {
   float *buffer_;
 };
 
-VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
-                              const std::string &test_file,
-                              SwsContext *display_frame_sws_context,
-                              AVFrame *max_score_ref_frame,
-                              AVFrame *max_score_test_frame,
-                              AVFrame *min_score_ref_frame,
-                              AVFrame *min_score_test_frame,
-                              VmafContext *vmaf,
-                              VmafModel *model,
-                              uintptr_t max_score_ref_frame_buffer,
-                              uintptr_t max_score_test_frame_buffer,
-                              uintptr_t min_score_ref_frame_buffer,
-                              uintptr_t min_score_test_frame_buffer,
-                              uintptr_t output_buffer) {
-
-  // Allocate AVFormatContexts and initialize them below.
-  AVFormatContext *pFormatContext_reference = avformat_alloc_context();
-  AVFormatContext *pFormatContext_test = avformat_alloc_context();
-  if (!pFormatContext_reference || !pFormatContext_test) {
-    fprintf(stderr, "ERROR could not allocate memory for format contexts\n");
-    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+// Picks the resolution both videos are scored at from their native resolutions.
+static void ResolveScoringResolution(const AVCodecParameters *reference,
+                                     const AVCodecParameters *test,
+                                     const ScoringOptions &options,
+                                     int *width,
+                                     int *height) {
+  switch (options.resolution) {
+    case ScoringResolution::NATIVE:
+      if (reference->width == test->width && reference->height == test->height) {
+        *width = reference->width;
+        *height = reference->height;
+        return;
+      }
+      break;
+    case ScoringResolution::SCALE_TEST_TO_REFERENCE:
+      *width = reference->width;
+      *height = reference->height;
+      return;
+    case ScoringResolution::FIXED:
+      break;
   }
+  *width = options.target_width;
+  *height = options.target_height;
+}
 
-  if (avformat_open_input(&pFormatContext_reference, reference_file.c_str(), NULL, NULL) != 0
-      || avformat_open_input(&pFormatContext_test, test_file.c_str(), NULL, NULL) != 0) {
-    fprintf(stderr, "ERROR could not open file.\n");
-    return VmafComputeStatus::INPUT_VIDEO_ERROR;
-  }
+// Picks the format both videos are scored in. Videos decoded to the same natively scored format keep it, and with it
+// their bit depth and chroma subsampling. Any other pair is converted to 8-bit YUV420P, since libvmaf scores both
+// pictures of a pair in one format.
+static const ScoringFormat *ResolveScoringFormat(const AVCodecParameters *reference, const AVCodecParameters *test) {
+  const ScoringFormat *format = FindScoringFormat(reference->format);
+  return format != nullptr && reference->format == test->format ? format : &kScoringFormats[0];
+}
 
-  if (avformat_find_stream_info(pFormatContext_reference, NULL) < 0
-      || avformat_find_stream_info(pFormatContext_test, NULL) < 0) {
-    printf("ERROR could not get the stream info\n");
-    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+// Sets both opened videos up to be scaled to the resolution and format they are scored in under the given options.
+static void PrepareInputVideos(const ScoringOptions &options, InputVideo *reference, InputVideo *test) {
+  int scoring_width, scoring_height;
+  ResolveScoringResolution(reference->codec_parameters, test->codec_parameters, options, &scoring_width,
+                           &scoring_height);
+  const ScoringFormat *scoring_format = ResolveScoringFormat(reference->codec_parameters, test->codec_parameters);
+  for (InputVideo *input : {reference, test}) {
+    input->scoring_width = scoring_width;
+    input->scoring_height = scoring_height;
+    input->scaler_flags = options.scaler_flags;
+    input->scoring_format = scoring_format;
   }
+}
 
-  // Declare the various local variables. Those allocated on heap must be free before this function returns.
-  int8_t video_stream_index_reference = -1;
-  int8_t video_stream_index_test = -1;
-  SwsContext *reference_sws_context = NULL;
-  SwsContext *test_sws_context = NULL;
-  AVFrame *pFrame_reference = NULL;
-  AVFrame *pFrame_test = NULL;
-  AVFrame *scaled_pFrame_reference = NULL;
-  AVFrame *scaled_pFrame_test = NULL;
-  AVPacket *pPacket_reference = NULL;
-  AVPacket *pPacket_test = NULL;
-  AVCodecContext *pCodecContext_reference = NULL;
-  AVCodecContext *pCodecContext_test = NULL;
-  AVCodec *pCodec_reference = NULL;
-  AVCodecParameters *pCodecParameters_reference = NULL;
-  AVCodec *pCodec_test = NULL;
-  AVCodecParameters *pCodecParameters_test = NULL;
-  OutputBuffer output(output_buffer);
+// Opens both videos and sets them up to be scaled to the resolution and format they are scored in under the given
+// options.
+static VmafComputeStatus OpenInputVideos(const std::string &reference_file,
+                                         const std::string &test_file,
+                                         const ScoringOptions &options,
+                                         InputVideo *reference,
+                                         InputVideo *test) {
+  VmafComputeStatus status = OpenInputVideo(reference_file, reference);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  status = OpenInputVideo(test_file, test);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  PrepareInputVideos(options, reference, test);
+  return VmafComputeStatus::SUCCESS;
+}
 
-  // Find the video stream for the reference video, and allocate an HD resolution frame and a
-  // scaling context if necessary.
-  for (int i = 0; i < pFormatContext_reference->nb_streams; i++) {
-    AVCodecParameters *pLocalCodecParameters = NULL;
-    pLocalCodecParameters = pFormatContext_reference->streams[i]->codecpar;
-    AVCodec *pLocalCodec = NULL;
-    pLocalCodec = (AVCodec *) avcodec_find_decoder(pLocalCodecParameters->codec_id);
+// Reads a pair of pictures into the context at the given index. The caller keeps its references to them.
+static VmafComputeStatus ReadPictures(VmafContext *vmaf, const VmafPicture &reference_picture,
+                                      const VmafPicture &test_picture, unsigned index) {
+  VmafPicture reference_vmaf_picture, test_vmaf_picture;
+  vmaf_picture_ref(&reference_vmaf_picture, const_cast<VmafPicture *>(&reference_picture));
+  vmaf_picture_ref(&test_vmaf_picture, const_cast<VmafPicture *>(&test_picture));
+
+  if (vmaf_read_pictures(vmaf, &reference_vmaf_picture, &test_vmaf_picture, index) != 0) {
+    fprintf(stderr, "Error reading vmaf pictures.\n");
+    // Both are no-ops for pictures the context already released.
+    vmaf_picture_unref(&reference_vmaf_picture);
+    vmaf_picture_unref(&test_vmaf_picture);
+    return VmafComputeStatus::VMAF_ERROR_READING_FRAMES;
+  }
+  return VmafComputeStatus::SUCCESS;
+}
 
-    if (pLocalCodec == NULL) {
-      printf("ERROR unsupported codec!\n");
-      // In this example if the codec is not found we just skip it
-      continue;
+// A reference and test frame, as decoded, kept alive past their scoring, e.g. to be turned into thumbnails once the
+// video is done. The pictures they were scored as may have been luma-only. Holds a reference to each frame while set.
+class RetainedPictures {
+ public:
+  RetainedPictures() = default;
+  RetainedPictures(const RetainedPictures &) = delete;
+  RetainedPictures &operator=(const RetainedPictures &) = delete;
+  ~RetainedPictures() { Reset(); }
+
+  // Returns false if a reference could not be taken, which leaves the pair empty.
+  bool Retain(const AVFrame *reference, const AVFrame *test) {
+    Reset();
+    reference_ = av_frame_clone(reference);
+    test_ = av_frame_clone(test);
+    if (reference_ == nullptr || test_ == nullptr) {
+      Reset();
+      return false;
     }
+    return true;
+  }
 
-    // when the stream is a video we store its index, codec parameters and codec
-    if (pLocalCodecParameters->codec_type == AVMEDIA_TYPE_VIDEO) {
-      if (!IsHDResolution(pLocalCodecParameters)) {
-        if (AllocateHDFrame(pLocalCodecParameters, reference_sws_context, scaled_pFrame_reference) != 0) {
-          return VmafComputeStatus::INITIALIZATION_ERROR;
-        }
-      }
-      video_stream_index_reference = i;
-      pCodec_reference = pLocalCodec;
-      pCodecParameters_reference = pLocalCodecParameters;
-      break;
+  bool Retain(const RetainedPictures &other) {
+    if (&other == this) {
+      return true;
+    }
+    if (other.empty()) {
+      Reset();
+      return true;
     }
+    return Retain(other.reference_, other.test_);
   }
 
-  // Find the video stream for the test video, and allocate an HD resolution frame and a scaling context if
-  // necessary.
-  for (int i = 0; i < pFormatContext_test->nb_streams; i++) {
-    AVCodecParameters *pLocalCodecParameters = NULL;
-    pLocalCodecParameters = pFormatContext_test->streams[i]->codecpar;
-    AVCodec *pLocalCodec = NULL;
-    pLocalCodec = (AVCodec *) avcodec_find_decoder(pLocalCodecParameters->codec_id);
+  // Freeing a frame that was never retained is a no-op.
+  void Reset() {
+    av_frame_free(&reference_);
+    av_frame_free(&test_);
+  }
 
-    if (pLocalCodec == NULL) {
-      printf("ERROR unsupported codec!\n");
-      // In this example if the codec is not found we just skip it
-      continue;
-    }
+  bool empty() const { return reference_ == nullptr; }
+  const AVFrame *reference() const { return reference_; }
+  const AVFrame *test() const { return test_; }
 
-    // when the stream is a video we store its index, codec parameters and codec
-    if (pLocalCodecParameters->codec_type == AVMEDIA_TYPE_VIDEO) {
-      if (!IsHDResolution(pLocalCodecParameters)) {
-        if (AllocateHDFrame(pLocalCodecParameters, test_sws_context, scaled_pFrame_test) != 0) {
-          return VmafComputeStatus::INITIALIZATION_ERROR;
-        }
-      }
-      video_stream_index_test = i;
-      pCodec_test = pLocalCodec;
-      pCodecParameters_test = pLocalCodecParameters;
-    }
-  }
-
-  if (AllocateFramesAndPackets(pFrame_reference, pFrame_test, pPacket_reference, pPacket_test) != 0) {
-    FreeResources(pFormatContext_reference,
-                  pFormatContext_test,
-                  reference_sws_context,
-                  test_sws_context,
-                  pFrame_reference,
-                  pFrame_test,
-                  pPacket_reference,
-                  pPacket_test,
-                  scaled_pFrame_reference,
-                  scaled_pFrame_test);
-    return VmafComputeStatus::INITIALIZATION_ERROR;
+ private:
+  AVFrame *reference_ = nullptr;
+  AVFrame *test_ = nullptr;
+};
+
+// Points an input at the context whose picture pool its scaled frames are written into. The input is made luma-only
+// when none of the context's feature extractors reads chroma. Must be called before the input's decode thread starts.
+static void AttachInputToContext(InputVideo *input, VmafContext *vmaf) {
+  input->vmaf = vmaf;
+  input->luma_only = vmaf_needs_chroma(vmaf) == 0;
+}
+
+// Converts a frame as ConvertFrameToPicture does under the settings of input, which has no decode thread, without
+// taking over the frame.
+static int ConvertFrameReference(InputVideo *input, const AVFrame *frame, VmafPicture *picture) {
+  AVFrame *clone = av_frame_clone(frame);
+  if (clone == nullptr) {
+    return AVERROR(ENOMEM);
   }
+  return ConvertFrameToPicture(input, clone, picture);
+}
 
-  // Return if a video stream was not found for one or both videos. Free the initialized resources before returning.
-  if (video_stream_index_reference == -1 || video_stream_index_test == -1) {
-    fprintf(stderr, "One of the files does not contain a video stream!\n");
-    FreeResources(pFormatContext_reference,
-                  pFormatContext_test,
-                  reference_sws_context,
-                  test_sws_context,
-                  pFrame_reference,
-                  pFrame_test,
-                  pPacket_reference,
-                  pPacket_test,
-                  scaled_pFrame_reference,
-                  scaled_pFrame_test);
-    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+// Converts a retained frame of an input to the picture it was scored as, with its chroma even if the input is
+// luma-only, and scales that to a display frame copied into the frontend's buffer.
+static int WriteThumbnail(SwsContext *sws_context, const InputVideo &input, const AVFrame *frame, AVFrame *display_frame,
+                          uintptr_t buffer) {
+  InputVideo converter;
+  converter.scoring_width = input.scoring_width;
+  converter.scoring_height = input.scoring_height;
+  converter.scaler_flags = input.scaler_flags;
+  converter.scoring_format = input.scoring_format;
+  converter.vmaf = input.vmaf;
+  VmafPicture picture;
+  const int err = ConvertFrameReference(&converter, frame, &picture);
+  if (err) {
+    return err;
   }
+  ScalePicture(sws_context, display_frame, picture);
+  CopyFrameToBuffer(display_frame, reinterpret_cast<uint8_t *>(buffer));
+  vmaf_picture_unref(&picture);
+  return 0;
+}
 
-  // Prepare the codec contexts for decoding the videos. Return and free resources if there is an error.
-  if (AllocateAndOpenCodecContexts(pCodecContext_reference,
-                                   pCodecContext_test,
-                                   pCodecParameters_reference,
-                                   pCodecParameters_test,
-                                   pCodec_reference,
-                                   pCodec_test) != 0) {
-    FreeResources(pFormatContext_reference,
-                  pFormatContext_test,
-                  reference_sws_context,
-                  test_sws_context,
-                  pFrame_reference,
-                  pFrame_test,
-                  pPacket_reference,
-                  pPacket_test,
-                  scaled_pFrame_reference,
-                  scaled_pFrame_test,
-                  pCodecContext_reference,
-                  pCodecContext_test);
-    return VmafComputeStatus::INITIALIZATION_ERROR;
+// Writes the thumbnails of a retained pair into the frontend's buffers.
+static void WriteThumbnails(SwsContext *sws_context, const InputVideo &reference, const InputVideo &test,
+                            const RetainedPictures &pictures, AVFrame *reference_frame, AVFrame *test_frame,
+                            uintptr_t reference_buffer, uintptr_t test_buffer) {
+  if (WriteThumbnail(sws_context, reference, pictures.reference(), reference_frame, reference_buffer) != 0 ||
+      WriteThumbnail(sws_context, test, pictures.test(), test_frame, test_buffer) != 0) {
+    fprintf(stderr, "Error converting a frame for its thumbnail.\n");
   }
+}
 
-  const unsigned num_common_frames = GetNumCommonFrames(pFormatContext_reference,
-                                                        pFormatContext_test,
-                                                        video_stream_index_reference,
-                                                        video_stream_index_test);
+int ConvertFrameForScoring(const AVFrame *frame,
+                           int scoring_width,
+                           int scoring_height,
+                           const ScoringOptions &options,
+                           VmafContext *vmaf,
+                           VmafPicture *picture) {
+  InputVideo input;
+  input.scoring_width = scoring_width;
+  input.scoring_height = scoring_height;
+  input.scaler_flags = options.scaler_flags;
+  const ScoringFormat *scoring_format = FindScoringFormat(frame->format);
+  input.scoring_format = scoring_format != nullptr ? scoring_format : &kScoringFormats[0];
+  AttachInputToContext(&input, vmaf);
+  return ConvertFrameReference(&input, frame, picture);
+}
+
+// Sets last_pooled_frame to the last of the frames, from 0, whose scores are pooled out of the num_frames_read frames
+// read. The last frame read is left out, as ComputeVmafForEachFrame has always pooled, so that every entry point reports
+// the same pooled score for the same comparison. Returns false if no frame is pooled.
+static bool GetLastPooledFrame(unsigned num_frames_read, unsigned *last_pooled_frame) {
+  if (num_frames_read < 2) {
+    return false;
+  }
+  *last_pooled_frame = num_frames_read - 2;
+  return true;
+}
+
+// Scores the opened videos frame by frame into output_buffer and captures the frames of the lowest and highest scores.
+static VmafComputeStatus ScoreEachFrame(InputVideo *reference,
+                                        InputVideo *test,
+                                        SwsContext *display_frame_sws_context,
+                                        AVFrame *max_score_ref_frame,
+                                        AVFrame *max_score_test_frame,
+                                        AVFrame *min_score_ref_frame,
+                                        AVFrame *min_score_test_frame,
+                                        VmafContext *vmaf,
+                                        VmafModel *model,
+                                        uintptr_t max_score_ref_frame_buffer,
+                                        uintptr_t max_score_test_frame_buffer,
+                                        uintptr_t min_score_ref_frame_buffer,
+                                        uintptr_t min_score_test_frame_buffer,
+                                        uintptr_t output_buffer) {
+  const int scoring_width = reference->scoring_width;
+  const int scoring_height = reference->scoring_height;
+
+  // The display context scales 8-bit YUV420P HD frames. Frames scored at any other resolution or in any other format
+  // need their own context.
+  const AVPixelFormat scoring_format = reference->scoring_format->format;
+  std::unique_ptr<SwsContext, decltype(&sws_freeContext)> display_sws_context(nullptr, sws_freeContext);
+  if (scoring_width != 1920 || scoring_height != 1080 || scoring_format != AV_PIX_FMT_YUV420P) {
+    display_sws_context.reset(sws_getContext(scoring_width,
+                                             scoring_height,
+                                             scoring_format,
+                                             max_score_ref_frame->width,
+                                             max_score_ref_frame->height,
+                                             (AVPixelFormat) max_score_ref_frame->format,
+                                             SWS_BICUBIC,
+                                             NULL,
+                                             NULL,
+                                             NULL));
+    if (display_sws_context == nullptr) {
+      return VmafComputeStatus::INITIALIZATION_ERROR;
+    }
+    display_frame_sws_context = display_sws_context.get();
+  }
+
+  OutputBuffer output(output_buffer);
+  const unsigned num_common_frames = GetNumCommonFrames(reference->format_context,
+                                                        test->format_context,
+                                                        reference->video_stream_index,
+                                                        test->video_stream_index);
   const unsigned num_frames_to_process = num_common_frames;
   output.SetNumFramesToProcess(num_frames_to_process);
 
   // For computing the processing rate in FPS and finding the min and max vmaf scores.
   float fps = 0;
-  const time_t t0 = clock();
+  const auto t0 = std::chrono::steady_clock::now();
   double max_vmaf_score = 0.0;
   double min_vmaf_score = 100.0;
 
+  // The thumbnails below are converted again, with their chroma, from the decoded frames.
+  AttachInputToContext(reference, vmaf);
+  AttachInputToContext(test, vmaf);
+  reference->keep_decoded_frames = true;
+  test->keep_decoded_frames = true;
+
+  // The decoded frames scored below, and those with the highest and lowest score so far.
+  RetainedPictures recent_pictures[kNumRecentPictures];
+  RetainedPictures max_score_pictures, min_score_pictures;
+
   unsigned frame_index;
-  for (frame_index = 0; frame_index < num_frames_to_process; frame_index++) {
-
-    if (output.IsTerminationBitSet()) {
-      printf("Cancelling compute...\n");
-      output.ClearTerminationBit();
-      FreeResources(pFormatContext_reference,
-                    pFormatContext_test,
-                    reference_sws_context,
-                    test_sws_context,
-                    pFrame_reference,
-                    pFrame_test,
-                    pPacket_reference,
-                    pPacket_test,
-                    scaled_pFrame_reference,
-                    scaled_pFrame_test,
-                    pCodecContext_reference,
-                    pCodecContext_test);
-      return VmafComputeStatus::CANCELLED;
-    }
-
-    bool reference_frame_decoded =
-        GetNextFrame(pFormatContext_reference, pCodecContext_reference, pPacket_reference, pFrame_reference,
-                     video_stream_index_reference);
-
-    bool test_frame_decoded = GetNextFrame(pFormatContext_test, pCodecContext_test, pPacket_test, pFrame_test,
-                                           video_stream_index_test);
-
-    if (reference_frame_decoded && test_frame_decoded) {
-
-      // Scale the frames to HD if they are not already that resolution.
-      ScaleFrameToHD(reference_sws_context, scaled_pFrame_reference, pFrame_reference);
-      ScaleFrameToHD(test_sws_context, scaled_pFrame_test, pFrame_test);
-
-      // Copy the frames into VmafPictures and read them into VmafContext.
-      VmafPicture reference_vmaf_picture, test_vmaf_picture;
-      int ret1 = CopyPictureData(scaled_pFrame_reference, &reference_vmaf_picture, 8);
-      int ret2 = CopyPictureData(scaled_pFrame_test, &test_vmaf_picture, 8);
-      if (ret1 || ret2) {
-        FreeResources(pFormatContext_reference,
-                      pFormatContext_test,
-                      reference_sws_context,
-                      test_sws_context,
-                      pFrame_reference,
-                      pFrame_test,
-                      pPacket_reference,
-                      pPacket_test,
-                      scaled_pFrame_reference,
-                      scaled_pFrame_test,
-                      pCodecContext_reference,
-                      pCodecContext_test);
-        if (ret2)
-          vmaf_picture_unref(&reference_vmaf_picture);
-        if (ret1)
-          vmaf_picture_unref(&test_vmaf_picture);
+  {
+    // Demux and decode each video on its own thread so that decoding overlaps with feature extraction below. The
+    // stages are stopped and joined when this scope exits.
+    DecodeStage reference_stage(reference);
+    DecodeStage test_stage(test);
+
+    for (frame_index = 0; frame_index < num_frames_to_process; frame_index++) {
+
+      if (output.IsTerminationBitSet()) {
+        printf("Cancelling compute...\n");
+        output.ClearTerminationBit();
+        return VmafComputeStatus::CANCELLED;
+      }
+
+      // Unreferencing a picture, or freeing a frame, that was never handed out is a no-op.
+      VmafPicture reference_picture = {}, test_picture = {};
+      AVFrame *reference_frame = nullptr, *test_frame = nullptr;
+      const bool reference_decoded = reference_stage.NextPicture(&reference_picture, &reference_frame);
+      const bool test_decoded = test_stage.NextPicture(&test_picture, &test_frame);
+      // The decoded frames are kept until their scores are known, in case they become thumbnails.
+      const bool retained = reference_decoded && test_decoded &&
+                            recent_pictures[frame_index % kNumRecentPictures].Retain(reference_frame, test_frame);
+      av_frame_free(&reference_frame);
+      av_frame_free(&test_frame);
+
+      if (!reference_decoded || !test_decoded) {
+        if (!reference_decoded && !test_decoded) {
+          printf("Decoding the next frame failed for both test and ref where frame index is %d.\n", frame_index);
+        } else {
+          printf("Decoding the next frame failed for one stream where frame index is %d.\n", frame_index);
+        }
+        vmaf_picture_unref(&reference_picture);
+        vmaf_picture_unref(&test_picture);
+        break;
+      }
+      if (!retained) {
+        vmaf_picture_unref(&reference_picture);
+        vmaf_picture_unref(&test_picture);
         return VmafComputeStatus::VMAF_ERROR_COPYING_FRAMES;
       }
 
-      if (vmaf_read_pictures(vmaf, &reference_vmaf_picture, &test_vmaf_picture, frame_index) != 0) {
-        fprintf(stderr, "Error reading vmaf pictures.\n");
-        FreeResources(pFormatContext_reference,
-                      pFormatContext_test,
-                      reference_sws_context,
-                      test_sws_context,
-                      pFrame_reference,
-                      pFrame_test,
-                      pPacket_reference,
-                      pPacket_test,
-                      scaled_pFrame_reference,
-                      scaled_pFrame_test,
-                      pCodecContext_reference,
-                      pCodecContext_test);
-        return VmafComputeStatus::VMAF_ERROR_READING_FRAMES;
+      // Read the pictures into VmafContext.
+      const VmafComputeStatus status = ReadPictures(vmaf, reference_picture, test_picture, frame_index);
+      if (status != VmafComputeStatus::SUCCESS) {
+        vmaf_picture_unref(&reference_picture);
+        vmaf_picture_unref(&test_picture);
+        return status;
       }
 
       // Compute the vmaf score at index - 2.
@@ -601,18 +1024,8 @@ VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
         int err = vmaf_score_at_index(vmaf, model, &vmaf_score, frame_index_for_vmaf);
         if (err != 0) {
           fprintf(stderr, "Error computing vmaf score at index\n");
-          FreeResources(pFormatContext_reference,
-                        pFormatContext_test,
-                        reference_sws_context,
-                        test_sws_context,
-                        pFrame_reference,
-                        pFrame_test,
-                        pPacket_reference,
-                        pPacket_test,
-                        scaled_pFrame_reference,
-                        scaled_pFrame_test,
-                        pCodecContext_reference,
-                        pCodecContext_test);
+          vmaf_picture_unref(&reference_picture);
+          vmaf_picture_unref(&test_picture);
           return VmafComputeStatus::VMAF_ERROR_COMPUTING_AT_INDEX;
         }
         output.SetVmafScore(frame_index_for_vmaf, vmaf_score);
@@ -620,99 +1033,594 @@ VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
 
       // Compute and store FPS.
       if (frame_index != 0 && frame_index % 5 == 0) {
-        fps = (frame_index + 1) /
-            (((float) clock() - t0) / CLOCKS_PER_SEC);
+        // Wall-clock time: CPU time would add up the time of the decode threads too.
+        const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - t0;
+        fps = (frame_index + 1) / elapsed.count();
         output.SetFPS(fps);
       }
 
-      // If the frame's vmaf score is max seen so far, copy the frame into buffer for display.
+      // Only remember which pictures scored the extremes; they are turned into thumbnails once the loop is done.
       if (vmaf_score > max_vmaf_score) {
-        ScaleFrame(display_frame_sws_context, max_score_ref_frame, scaled_pFrame_reference);
-        uint8_t *buffer_ptr = reinterpret_cast<uint8_t *>(max_score_ref_frame_buffer);
-        CopyFrameToBuffer(max_score_ref_frame, buffer_ptr);
-
-        ScaleFrame(display_frame_sws_context, max_score_test_frame, scaled_pFrame_test);
-        buffer_ptr = reinterpret_cast<uint8_t *>(max_score_test_frame_buffer);
-        CopyFrameToBuffer(max_score_test_frame, buffer_ptr);
-
+        max_score_pictures.Retain(recent_pictures[(frame_index - 2) % kNumRecentPictures]);
         max_vmaf_score = vmaf_score;
       }
 
-      // If the frame's vmaf score is the min seen so far, copy the frame into buffer for display.
       if (vmaf_score >= 0.0 && vmaf_score < min_vmaf_score) {
-        ScaleFrame(display_frame_sws_context, min_score_ref_frame, scaled_pFrame_reference);
-        uint8_t *buffer_ptr = reinterpret_cast<uint8_t *>(min_score_ref_frame_buffer);
-        CopyFrameToBuffer(min_score_ref_frame, buffer_ptr);
-
-        ScaleFrame(display_frame_sws_context, min_score_test_frame, scaled_pFrame_test);
-        buffer_ptr = reinterpret_cast<uint8_t *>(min_score_test_frame_buffer);
-        CopyFrameToBuffer(min_score_test_frame, buffer_ptr);
-
+        min_score_pictures.Retain(recent_pictures[(frame_index - 2) % kNumRecentPictures]);
         min_vmaf_score = vmaf_score;
       }
 
+      vmaf_picture_unref(&reference_picture);
+      vmaf_picture_unref(&test_picture);
+
       const unsigned num_frames_processed = frame_index + 1;
       output.SetNumFramesProcessed(num_frames_processed);
-
-    } else if (!reference_frame_decoded && !test_frame_decoded) {
-      printf("Decoding the next frame failed for both test and ref where frame index is %d.\n", frame_index);
-      break;
-    } else {
-      printf("Decoding the next frame failed for one stream where frame index is %d.\n", frame_index);
-      break;
     }
   }
 
+  // Copy the frames with the highest and lowest score into the buffers for display.
+  if (!max_score_pictures.empty()) {
+    WriteThumbnails(display_frame_sws_context, *reference, *test, max_score_pictures, max_score_ref_frame,
+                    max_score_test_frame, max_score_ref_frame_buffer, max_score_test_frame_buffer);
+  }
+  if (!min_score_pictures.empty()) {
+    WriteThumbnails(display_frame_sws_context, *reference, *test, min_score_pictures, min_score_ref_frame,
+                    min_score_test_frame, min_score_ref_frame_buffer, min_score_test_frame_buffer);
+  }
+
   output.SetMaxVmafScore(max_vmaf_score);
   output.SetMinVmafScore(min_vmaf_score);
 
   // Flush the VMAF context.
   if (vmaf_read_pictures(vmaf, NULL, NULL, 0) != 0) {
-    FreeResources(pFormatContext_reference,
-                  pFormatContext_test,
-                  reference_sws_context,
-                  test_sws_context,
-                  pFrame_reference,
-                  pFrame_test,
-                  pPacket_reference,
-                  pPacket_test,
-                  scaled_pFrame_reference,
-                  scaled_pFrame_test,
-                  pCodecContext_reference,
-                  pCodecContext_test);
     return VmafComputeStatus::VMAF_ERROR_FLUSHING_CONTEXT;
   }
 
   // Compute the pooled vmaf score.
   double pooled_vmaf_score = 0;
-  if (vmaf_score_pooled(vmaf, model, VMAF_POOL_METHOD_MEAN, &pooled_vmaf_score, 0, frame_index - 2) != 0) {
-    FreeResources(pFormatContext_reference,
-                  pFormatContext_test,
-                  reference_sws_context,
-                  test_sws_context,
-                  pFrame_reference,
-                  pFrame_test,
-                  pPacket_reference,
-                  pPacket_test,
-                  scaled_pFrame_reference,
-                  scaled_pFrame_test,
-                  pCodecContext_reference,
-                  pCodecContext_test);
+  unsigned last_pooled_frame;
+  if (GetLastPooledFrame(frame_index, &last_pooled_frame) &&
+      vmaf_score_pooled(vmaf, model, VMAF_POOL_METHOD_MEAN, &pooled_vmaf_score, 0, last_pooled_frame) != 0) {
+    return VmafComputeStatus::VMAF_ERROR_COMPUTING_POOLED;
+  }
+
+  output.SetPooledVmafScore(pooled_vmaf_score);
+  return VmafComputeStatus::SUCCESS;
+}
+
+VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
+                              const std::string &test_file,
+                              SwsContext *display_frame_sws_context,
+                              AVFrame *max_score_ref_frame,
+                              AVFrame *max_score_test_frame,
+                              AVFrame *min_score_ref_frame,
+                              AVFrame *min_score_test_frame,
+                              VmafContext *vmaf,
+                              VmafModel *model,
+                              uintptr_t max_score_ref_frame_buffer,
+                              uintptr_t max_score_test_frame_buffer,
+                              uintptr_t min_score_ref_frame_buffer,
+                              uintptr_t min_score_test_frame_buffer,
+                              uintptr_t output_buffer,
+                              const ScoringOptions &options) {
+  const auto loaded_model = [model](int, int) { return model; };
+  return ComputeVmafForEachFrame(reference_file, test_file, display_frame_sws_context, max_score_ref_frame,
+                                 max_score_test_frame, min_score_ref_frame, min_score_test_frame, vmaf, loaded_model,
+                                 max_score_ref_frame_buffer, max_score_test_frame_buffer, min_score_ref_frame_buffer,
+                                 min_score_test_frame_buffer, output_buffer, options);
+}
+
+VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
+                                          const std::string &test_file,
+                                          SwsContext *display_frame_sws_context,
+                                          AVFrame *max_score_ref_frame,
+                                          AVFrame *max_score_test_frame,
+                                          AVFrame *min_score_ref_frame,
+                                          AVFrame *min_score_test_frame,
+                                          VmafContext *vmaf,
+                                          const ModelLoader &load_model,
+                                          uintptr_t max_score_ref_frame_buffer,
+                                          uintptr_t max_score_test_frame_buffer,
+                                          uintptr_t min_score_ref_frame_buffer,
+                                          uintptr_t min_score_test_frame_buffer,
+                                          uintptr_t output_buffer,
+                                          const ScoringOptions &options) {
+  // Open both videos. Their resources are released by InputVideo's destructor when this function returns.
+  InputVideo reference, test;
+  VmafComputeStatus status = OpenInputVideos(reference_file, test_file, options, &reference, &test);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  VmafModel *model = load_model(reference.scoring_width, reference.scoring_height);
+  if (model == nullptr) {
+    fprintf(stderr, "Failed to load the model.\n");
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+  return ScoreEachFrame(&reference, &test, display_frame_sws_context, max_score_ref_frame, max_score_test_frame,
+                        min_score_ref_frame, min_score_test_frame, vmaf, model, max_score_ref_frame_buffer,
+                        max_score_test_frame_buffer, min_score_ref_frame_buffer, min_score_test_frame_buffer,
+                        output_buffer);
+}
+
+VmafComputeStatus ComputeVmafForEachFrame(const InputSource &reference_source,
+                                          const InputSource &test_source,
+                                          SwsContext *display_frame_sws_context,
+                                          AVFrame *max_score_ref_frame,
+                                          AVFrame *max_score_test_frame,
+                                          AVFrame *min_score_ref_frame,
+                                          AVFrame *min_score_test_frame,
+                                          VmafContext *vmaf,
+                                          VmafModel *model,
+                                          uintptr_t max_score_ref_frame_buffer,
+                                          uintptr_t max_score_test_frame_buffer,
+                                          uintptr_t min_score_ref_frame_buffer,
+                                          uintptr_t min_score_test_frame_buffer,
+                                          uintptr_t output_buffer,
+                                          const ScoringOptions &options) {
+  // Open both videos. Their resources are released by InputVideo's destructor when this function returns.
+  InputVideo reference, test;
+  VmafComputeStatus status = OpenInputVideo(reference_source, "reference input", &reference);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  status = OpenInputVideo(test_source, "test input", &test);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  PrepareInputVideos(options, &reference, &test);
+  return ScoreEachFrame(&reference, &test, display_frame_sws_context, max_score_ref_frame, max_score_test_frame,
+                        min_score_ref_frame, min_score_test_frame, vmaf, model, max_score_ref_frame_buffer,
+                        max_score_test_frame_buffer, min_score_ref_frame_buffer, min_score_test_frame_buffer,
+                        output_buffer);
+}
+
+// A VmafContext and the model it scores with. Both are released on destruction.
+struct ScoringContext {
+  VmafContext *vmaf = nullptr;
+  VmafModel *model[1] = {nullptr};
+  VmafModelCollection *model_collection[1] = {nullptr};
+  uint64_t model_collection_count = 0;
+
+  ~ScoringContext() {
+    if (model[0] != nullptr)
+      vmaf_model_release(model[0]);
+    if (model_collection_count != 0)
+      vmaf_model_collection_release(model_collection[0]);
+    if (vmaf != nullptr)
+      vmaf_close(vmaf);
+  }
+};
+
+// Opens the context and loads the model into it. If parent is not null, the context runs on its thread pool.
+static VmafComputeStatus InitializeScoringContext(ScoringContext *context,
+                                                  const char *model_buffer,
+                                                  uint64_t model_buffer_size,
+                                                  bool use_phone_model,
+                                                  unsigned n_threads,
+                                                  VmafContext *parent = nullptr) {
+  VmafConfiguration cfg = {
+      .log_level = VMAF_LOG_LEVEL_INFO,
+      .n_threads = n_threads,
+      .max_inflight_frames = kMaxInflightFrames,
+  };
+  int err = parent != nullptr ? vmaf_init_shared(&context->vmaf, cfg, parent) : vmaf_init(&context->vmaf, cfg);
+  if (err) {
+    fprintf(stderr, "Failed to initialize VMAF context. error code: %d\n", err);
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+  if (InitializeVmaf(context->vmaf, context->model, context->model_collection, &context->model_collection_count,
+                     model_buffer, model_buffer_size, use_phone_model) != 0) {
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+  return VmafComputeStatus::SUCCESS;
+}
+
+// Name the per-frame scores of the segments are gathered under to be pooled.
+static const char kMergedScoreName[] = "vmaf";
+
+// State shared by the threads scoring the segments of one comparison.
+struct SegmentedComputation {
+  std::string reference_file;
+  std::string test_file;
+  const char *model_buffer;
+  uint64_t model_buffer_size;
+  bool use_phone_model;
+  unsigned n_threads_per_context;
+  ScoringOptions options;
+  // Per-frame scores of the whole comparison. Each segment writes its own range.
+  std::vector<double> scores;
+
+  // Guards the members below and the output buffer.
+  std::mutex mutex;
+  OutputBuffer *output;
+  unsigned num_frames_processed = 0;
+  bool cancelled = false;
+
+  // Returns true once the caller has asked for the computation to be cancelled.
+  bool IsCancelled() {
+    std::lock_guard<std::mutex> lock(mutex);
+    cancelled = cancelled || output->IsTerminationBitSet();
+    return cancelled;
+  }
+
+  void FrameProcessed() {
+    std::lock_guard<std::mutex> lock(mutex);
+    output->SetNumFramesProcessed(++num_frames_processed);
+  }
+};
+
+// A range of frames scored in its own VmafContext.
+struct Segment {
+  unsigned begin = 0;
+  // One past the last frame. Reduced to the frames actually scored if a stream ends early.
+  unsigned end = 0;
+  VmafComputeStatus status = VmafComputeStatus::SUCCESS;
+};
+
+static VmafComputeStatus ScoreSegment(SegmentedComputation *computation, Segment *segment) {
+  InputVideo reference, test;
+  VmafComputeStatus status = OpenInputVideos(computation->reference_file, computation->test_file,
+                                             computation->options, &reference, &test);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+
+  // The motion features of a frame compare it with the frames before and after it. Read one frame on either side of
+  // the segment, when there is one, so that its scores match those of an unsegmented run, and discard their scores.
+  const unsigned prime_index = segment->begin > 0 ? segment->begin - 1 : 0;
+  const unsigned read_end = segment->end < computation->scores.size() ? segment->end + 1 : segment->end;
+  if (SeekToFrame(&reference, prime_index) < 0 || SeekToFrame(&test, prime_index) < 0) {
+    return VmafComputeStatus::INPUT_VIDEO_ERROR;
+  }
+
+  ScoringContext context;
+  status = InitializeScoringContext(&context, computation->model_buffer, computation->model_buffer_size,
+                                    computation->use_phone_model, computation->n_threads_per_context);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  AttachInputToContext(&reference, context.vmaf);
+  AttachInputToContext(&test, context.vmaf);
+
+  unsigned frame_index;
+  {
+    DecodeStage reference_stage(&reference);
+    DecodeStage test_stage(&test);
+
+    for (frame_index = prime_index; frame_index < read_end; frame_index++) {
+      if (computation->IsCancelled()) {
+        return VmafComputeStatus::CANCELLED;
+      }
+
+      // Unreferencing a picture that was never handed out is a no-op.
+      VmafPicture reference_picture = {}, test_picture = {};
+      const bool reference_decoded = reference_stage.NextPicture(&reference_picture);
+      const bool test_decoded = test_stage.NextPicture(&test_picture);
+      if (!reference_decoded || !test_decoded) {
+        printf("Decoding the next frame failed where frame index is %d.\n", frame_index);
+        vmaf_picture_unref(&reference_picture);
+        vmaf_picture_unref(&test_picture);
+        // Only a stream whose queue is finished may be inspected.
+        if ((!reference_decoded && reference.frame_without_timestamp) ||
+            (!test_decoded && test.frame_without_timestamp)) {
+          return VmafComputeStatus::INPUT_VIDEO_ERROR;
+        }
+        break;
+      }
+
+      status = ReadPictures(context.vmaf, reference_picture, test_picture, frame_index - prime_index);
+      vmaf_picture_unref(&reference_picture);
+      vmaf_picture_unref(&test_picture);
+      if (status != VmafComputeStatus::SUCCESS) {
+        return status;
+      }
+
+      if (frame_index >= segment->begin && frame_index < segment->end) {
+        computation->FrameProcessed();
+      }
+    }
+  }
+
+  if (vmaf_read_pictures(context.vmaf, NULL, NULL, 0) != 0) {
+    return VmafComputeStatus::VMAF_ERROR_FLUSHING_CONTEXT;
+  }
+
+  segment->end = std::max(std::min(frame_index, segment->end), segment->begin);
+  for (unsigned i = segment->begin; i < segment->end; i++) {
+    if (vmaf_score_at_index(context.vmaf, context.model[0], &computation->scores[i], i - prime_index) != 0) {
+      fprintf(stderr, "Error computing vmaf score at index\n");
+      return VmafComputeStatus::VMAF_ERROR_COMPUTING_AT_INDEX;
+    }
+  }
+  return VmafComputeStatus::SUCCESS;
+}
+
+VmafComputeStatus ComputeVmafInSegments(const std::string &reference_file,
+                                        const std::string &test_file,
+                                        const char *model_buffer,
+                                        uint64_t model_buffer_size,
+                                        bool use_phone_model,
+                                        unsigned num_segments,
+                                        unsigned n_threads_per_context,
+                                        uintptr_t output_buffer,
+                                        const ScoringOptions &options) {
+  unsigned num_frames;
+  {
+    InputVideo reference, test;
+    VmafComputeStatus status = OpenInputVideos(reference_file, test_file, options, &reference, &test);
+    if (status != VmafComputeStatus::SUCCESS) {
+      return status;
+    }
+    num_frames = GetNumCommonFrames(reference.format_context,
+                                    test.format_context,
+                                    reference.video_stream_index,
+                                    test.video_stream_index);
+    // Segments are seeked to by frame index, which only maps onto timestamps at a constant frame rate.
+    if (num_segments > 1 && (!HasConstantFrameRate(reference) || !HasConstantFrameRate(test))) {
+      printf("The inputs may have a variable frame rate. Scoring them in a single segment.\n");
+      num_segments = 1;
+    }
+  }
+
+  OutputBuffer output(output_buffer);
+  output.SetNumFramesToProcess(num_frames);
+
+  SegmentedComputation computation;
+  computation.reference_file = reference_file;
+  computation.test_file = test_file;
+  computation.model_buffer = model_buffer;
+  computation.model_buffer_size = model_buffer_size;
+  computation.use_phone_model = use_phone_model;
+  computation.n_threads_per_context = n_threads_per_context;
+  computation.options = options;
+  computation.scores.resize(num_frames);
+  computation.output = &output;
+
+  num_segments = std::max(1u, std::min(num_segments, num_frames));
+  std::vector<Segment> segments(num_segments);
+  for (unsigned i = 0; i < num_segments; i++) {
+    segments[i].begin = (uint64_t) num_frames * i / num_segments;
+    segments[i].end = (uint64_t) num_frames * (i + 1) / num_segments;
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  std::vector<std::thread> threads;
+  for (Segment &segment : segments) {
+    threads.emplace_back([&computation, &segment] { segment.status = ScoreSegment(&computation, &segment); });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+
+  if (computation.cancelled) {
+    printf("Cancelling compute...\n");
+    output.ClearTerminationBit();
+    return VmafComputeStatus::CANCELLED;
+  }
+  for (const Segment &segment : segments) {
+    if (segment.status != VmafComputeStatus::SUCCESS) {
+      return segment.status;
+    }
+  }
+
+  // Merge the segments. The scored frames end where the first segment that was cut short ends.
+  unsigned num_frames_scored = 0;
+  for (const Segment &segment : segments) {
+    if (segment.begin != num_frames_scored) {
+      break;
+    }
+    num_frames_scored = segment.end;
+  }
+
+  // vmaf_score_pooled() predicts the frames of a context and pools the predictions with vmaf_feature_score_pooled().
+  // The segments have already predicted theirs, so they are gathered into a context of their own and pooled by that
+  // same step, over the frames the other entry points pool.
+  ScoringContext merged;
+  const VmafConfiguration merged_cfg = {
+      .log_level = VMAF_LOG_LEVEL_INFO,
+  };
+  if (vmaf_init(&merged.vmaf, merged_cfg) != 0) {
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+
+  double max_vmaf_score = 0.0;
+  double min_vmaf_score = 100.0;
+  for (unsigned i = 0; i < num_frames_scored; i++) {
+    const double vmaf_score = computation.scores[i];
+    output.SetVmafScore(i, vmaf_score);
+    max_vmaf_score = std::max(max_vmaf_score, vmaf_score);
+    min_vmaf_score = std::min(min_vmaf_score, vmaf_score);
+    if (vmaf_import_feature_score(merged.vmaf, kMergedScoreName, vmaf_score, i) != 0) {
+      return VmafComputeStatus::VMAF_ERROR_COMPUTING_POOLED;
+    }
+  }
+
+  double pooled_vmaf_score = 0.0;
+  unsigned last_pooled_frame;
+  if (GetLastPooledFrame(num_frames_scored, &last_pooled_frame) &&
+      vmaf_feature_score_pooled(merged.vmaf, kMergedScoreName, VMAF_POOL_METHOD_MEAN, &pooled_vmaf_score, 0,
+                                last_pooled_frame) != 0) {
     return VmafComputeStatus::VMAF_ERROR_COMPUTING_POOLED;
   }
 
+  const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - t0;
+  if (elapsed.count() > 0) {
+    output.SetFPS(num_frames_scored / elapsed.count());
+  }
+  output.SetNumFramesProcessed(num_frames_scored);
+  output.SetMaxVmafScore(max_vmaf_score);
+  output.SetMinVmafScore(min_vmaf_score);
   output.SetPooledVmafScore(pooled_vmaf_score);
-  FreeResources(pFormatContext_reference,
-                pFormatContext_test,
-                reference_sws_context,
-                test_sws_context,
-                pFrame_reference,
-                pFrame_test,
-                pPacket_reference,
-                pPacket_test,
-                scaled_pFrame_reference,
-                scaled_pFrame_test,
-                pCodecContext_reference,
-                pCodecContext_test);
   return VmafComputeStatus::SUCCESS;
-}
\ No newline at end of file
+}
+
+VmafComputeStatus ComputeVmafForEachTestVideo(const std::string &reference_file,
+                                              const std::vector<std::string> &test_files,
+                                              const char *model_buffer,
+                                              uint64_t model_buffer_size,
+                                              bool use_phone_model,
+                                              unsigned n_threads,
+                                              const std::vector<uintptr_t> &output_buffers,
+                                              const ScoringOptions &options) {
+  const size_t num_tests = test_files.size();
+  if (num_tests == 0 || output_buffers.size() != num_tests) {
+    return VmafComputeStatus::INITIALIZATION_ERROR;
+  }
+
+  // Open the reference once and every test video. The reference is scaled once for all of them, so they are scored at
+  // a common resolution: the one the policy picks for every pair, or the fixed target if the pairs disagree. They are
+  // scored in a common format the same way, falling back to 8-bit YUV420P.
+  InputVideo reference;
+  std::vector<InputVideo> tests(num_tests);
+  VmafComputeStatus status = OpenInputVideo(reference_file, &reference);
+  if (status != VmafComputeStatus::SUCCESS) {
+    return status;
+  }
+  int scoring_width = 0, scoring_height = 0;
+  const ScoringFormat *scoring_format = nullptr;
+  unsigned num_frames = 0;
+  for (size_t k = 0; k < num_tests; k++) {
+    status = OpenInputVideo(test_files[k], &tests[k]);
+    if (status != VmafComputeStatus::SUCCESS) {
+      return status;
+    }
+    int width, height;
+    ResolveScoringResolution(reference.codec_parameters, tests[k].codec_parameters, options, &width, &height);
+    if (k > 0 && (width != scoring_width || height != scoring_height)) {
+      width = options.target_width;
+      height = options.target_height;
+    }
+    scoring_width = width;
+    scoring_height = height;
+
+    const ScoringFormat *format = ResolveScoringFormat(reference.codec_parameters, tests[k].codec_parameters);
+    scoring_format = k > 0 && format != scoring_format ? &kScoringFormats[0] : format;
+
+    const unsigned num_common_frames = GetNumCommonFrames(reference.format_context,
+                                                          tests[k].format_context,
+                                                          reference.video_stream_index,
+                                                          tests[k].video_stream_index);
+    num_frames = k > 0 ? std::min(num_frames, num_common_frames) : num_common_frames;
+  }
+  reference.scoring_width = scoring_width;
+  reference.scoring_height = scoring_height;
+  reference.scaler_flags = options.scaler_flags;
+  reference.scoring_format = scoring_format;
+  for (InputVideo &test : tests) {
+    test.scoring_width = scoring_width;
+    test.scoring_height = scoring_height;
+    test.scaler_flags = options.scaler_flags;
+    test.scoring_format = scoring_format;
+  }
+
+  // One context per test video. All of them run on the thread pool of the first.
+  std::vector<ScoringContext> contexts(num_tests);
+  for (size_t k = 0; k < num_tests; k++) {
+    VmafContext *parent = k > 0 && n_threads > 0 ? contexts[0].vmaf : nullptr;
+    status = InitializeScoringContext(&contexts[k], model_buffer, model_buffer_size, use_phone_model, n_threads,
+                                      parent);
+    if (status != VmafComputeStatus::SUCCESS) {
+      return status;
+    }
+  }
+
+  // Every context loads the same model, so they agree on whether chroma is needed. The reference is shared by all of
+  // them, so every input writes into the pool of the first.
+  AttachInputToContext(&reference, contexts[0].vmaf);
+  for (InputVideo &test : tests) {
+    AttachInputToContext(&test, contexts[0].vmaf);
+  }
+
+  std::vector<OutputBuffer> outputs;
+  for (uintptr_t output_buffer : output_buffers) {
+    outputs.emplace_back(output_buffer);
+    outputs.back().SetNumFramesToProcess(num_frames);
+  }
+
+  const auto t0 = std::chrono::steady_clock::now();
+  unsigned frame_index;
+  {
+    // Each video is decoded on its own thread. The stages are stopped and joined when this scope exits.
+    DecodeStage reference_stage(&reference);
+    std::vector<std::unique_ptr<DecodeStage>> test_stages;
+    for (InputVideo &test : tests) {
+      test_stages.emplace_back(new DecodeStage(&test));
+    }
+    std::vector<VmafPicture> test_pictures(num_tests);
+
+    for (frame_index = 0; frame_index < num_frames; frame_index++) {
+      for (OutputBuffer &output : outputs) {
+        if (output.IsTerminationBitSet()) {
+          printf("Cancelling compute...\n");
+          output.ClearTerminationBit();
+          return VmafComputeStatus::CANCELLED;
+        }
+      }
+
+      // Unreferencing a picture that was never handed out is a no-op.
+      VmafPicture reference_picture = {};
+      bool decoded = reference_stage.NextPicture(&reference_picture);
+      for (size_t k = 0; k < num_tests; k++) {
+        test_pictures[k] = {};
+        decoded = test_stages[k]->NextPicture(&test_pictures[k]) && decoded;
+      }
+
+      // Every context takes its own reference to the same decoded reference picture.
+      for (size_t k = 0; k < num_tests && decoded && status == VmafComputeStatus::SUCCESS; k++) {
+        status = ReadPictures(contexts[k].vmaf, reference_picture, test_pictures[k], frame_index);
+      }
+
+      vmaf_picture_unref(&reference_picture);
+      for (VmafPicture &test_picture : test_pictures) {
+        vmaf_picture_unref(&test_picture);
+      }
+      if (status != VmafComputeStatus::SUCCESS) {
+        return status;
+      }
+      if (!decoded) {
+        printf("Decoding the next frame failed where frame index is %d.\n", frame_index);
+        break;
+      }
+
+      for (OutputBuffer &output : outputs) {
+        output.SetNumFramesProcessed(frame_index + 1);
+      }
+    }
+  }
+
+  const std::chrono::duration<float> elapsed = std::chrono::steady_clock::now() - t0;
+  for (size_t k = 0; k < num_tests; k++) {
+    if (vmaf_read_pictures(contexts[k].vmaf, NULL, NULL, 0) != 0) {
+      return VmafComputeStatus::VMAF_ERROR_FLUSHING_CONTEXT;
+    }
+
+    double max_vmaf_score = 0.0;
+    double min_vmaf_score = 100.0;
+    for (unsigned i = 0; i < frame_index; i++) {
+      double vmaf_score;
+      if (vmaf_score_at_index(contexts[k].vmaf, contexts[k].model[0], &vmaf_score, i) != 0) {
+        fprintf(stderr, "Error computing vmaf score at index\n");
+        return VmafComputeStatus::VMAF_ERROR_COMPUTING_AT_INDEX;
+      }
+      outputs[k].SetVmafScore(i, vmaf_score);
+      max_vmaf_score = std::max(max_vmaf_score, vmaf_score);
+      min_vmaf_score = std::min(min_vmaf_score, vmaf_score);
+    }
+
+    double pooled_vmaf_score = 0;
+    unsigned last_pooled_frame;
+    if (GetLastPooledFrame(frame_index, &last_pooled_frame) &&
+        vmaf_score_pooled(contexts[k].vmaf, contexts[k].model[0], VMAF_POOL_METHOD_MEAN, &pooled_vmaf_score, 0,
+                          last_pooled_frame) != 0) {
+      return VmafComputeStatus::VMAF_ERROR_COMPUTING_POOLED;
+    }
+
+    if (elapsed.count() > 0) {
+      outputs[k].SetFPS(frame_index / elapsed.count());
+    }
+    outputs[k].SetMaxVmafScore(max_vmaf_score);
+    outputs[k].SetMinVmafScore(min_vmaf_score);
+    outputs[k].SetPooledVmafScore(pooled_vmaf_score);
+  }
+  return VmafComputeStatus::SUCCESS;
+}
@@ -1,7 +1,9 @@
 #ifndef FFVMAF_LIB_H
 #define FFVMAF_LIB_H
 
+#include <functional>
 #include <string>
+#include <vector>
 extern "C" {
 #include "libvmaf/src/libvmaf.h"
 #include "libavformat/avformat.h"
@@ -20,13 +22,72 @@ enum class VmafComputeStatus {
   VMAF_ERROR_COMPUTING_POOLED,  // 7
 };
 
+// Resolution policy for scoring a test video against its reference.
+enum class ScoringResolution {
+  // Score at the native resolution when both videos share it, otherwise at the fixed target.
+  NATIVE,
+  // Scale the test video to the reference's resolution.
+  SCALE_TEST_TO_REFERENCE,
+  // Scale both videos to the fixed target.
+  FIXED,
+};
+
+struct ScoringOptions {
+  ScoringResolution resolution = ScoringResolution::FIXED;
+  int target_width = 1920;
+  int target_height = 1080;
+  // swscale algorithm used to resize frames, e.g. SWS_BICUBIC or SWS_LANCZOS.
+  int scaler_flags = SWS_BICUBIC;
+};
+
+// Caller-supplied byte source for an input video, e.g. memory, a pipe or ranged reads from an object store. The video
+// is demuxed through an AVIOContext built on the callbacks instead of being opened by path, so nothing is staged to
+// disk. The callbacks follow AVIOContext's conventions and are called from the thread decoding the video.
+struct InputSource {
+  // Reads up to buf_size bytes into buf and returns the number read, or AVERROR_EOF at the end of the input.
+  int (*read)(void *opaque, uint8_t *buf, int buf_size) = nullptr;
+  // Seeks like fseek() and returns the new position, or returns the size of the input for AVSEEK_SIZE. Optional, but
+  // containers with their index at the end, such as most MP4 files, cannot be read without it.
+  int64_t (*seek)(void *opaque, int64_t offset, int whence) = nullptr;
+  // Passed to both callbacks.
+  void *opaque = nullptr;
+  // Size of the buffer the AVIOContext reads through, i.e. of the reads requested from the callback.
+  int buffer_size = 64 * 1024;
+};
+
+// Returns true if scores at this resolution should come from the 4K model (vmaf_4k_v0.6.1).
+bool IsUHDResolution(int width, int height);
+
+// Loads the model to score with into the context, given the resolution the videos will be scored at, and returns it.
+// Returns null on failure.
+using ModelLoader = std::function<VmafModel *(int scoring_width, int scoring_height)>;
+
+// Loads the model from the buffer and registers its feature extractors. If reference_cache_path is not null, the
+// reference-side motion work is read from, or written to, a file at that path with a key of the options appended,
+// so that later runs against the same reference can skip it. Otherwise the model comes from the process-wide
+// registry and is shared with other contexts which loaded the same buffer; it is destroyed with its last release
+// unless pinned with vmaf_model_pin(). Either way, release it with vmaf_model_release() and
+// vmaf_model_collection_release().
 int InitializeVmaf(VmafContext *vmaf,
                    VmafModel **model,
                    VmafModelCollection **model_collection,
                    uint64_t *model_collection_count,
                    const char *model_buffer,
                    uint64_t model_buffer_size,
-                   bool use_phone_model);
+                   bool use_phone_model,
+                   const char *reference_cache_path = nullptr);
+
+// Converts a decoded frame into the VmafPicture it is scored as against a frame of the same format, at the scoring
+// resolution. A frame in a format libvmaf scores natively keeps its bit depth and chroma subsampling, and is wrapped
+// without a copy when it needs no scaling. Any other frame is converted to 8-bit YUV420P. Only the luma plane is kept
+// when no feature extractor registered on vmaf reads chroma. The picture takes its own reference to the frame. Returns
+// 0 on success or a negative value on error.
+int ConvertFrameForScoring(const AVFrame *frame,
+                           int scoring_width,
+                           int scoring_height,
+                           const ScoringOptions &options,
+                           VmafContext *vmaf,
+                           VmafPicture *picture);
 
 VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
                               const std::string &test_file,
@@ -40,6 +101,70 @@ VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
                               uintptr_t max_score_ref_frame_buffer,
                               uintptr_t max_score_test_frame_buffer,
                               uintptr_t min_score_ref_frame_buffer,
-                              uintptr_t min_score_test_frame_buffer, uintptr_t output_buffer);
+                              uintptr_t min_score_test_frame_buffer, uintptr_t output_buffer,
+                              const ScoringOptions &options = ScoringOptions());
+
+// As above, with the model loaded by load_model once the videos are open, so that it can depend on the resolution they
+// are scored at without opening them twice.
+VmafComputeStatus ComputeVmafForEachFrame(const std::string &reference_file,
+                                          const std::string &test_file,
+                                          SwsContext *display_frame_sws_context,
+                                          AVFrame *max_score_ref_frame,
+                                          AVFrame *max_score_test_frame,
+                                          AVFrame *min_score_ref_frame,
+                                          AVFrame *min_score_test_frame,
+                                          VmafContext *vmaf,
+                                          const ModelLoader &load_model,
+                                          uintptr_t max_score_ref_frame_buffer,
+                                          uintptr_t max_score_test_frame_buffer,
+                                          uintptr_t min_score_ref_frame_buffer,
+                                          uintptr_t min_score_test_frame_buffer,
+                                          uintptr_t output_buffer,
+                                          const ScoringOptions &options = ScoringOptions());
+
+// As the first, with both videos read through caller-supplied sources instead of opened by path.
+VmafComputeStatus ComputeVmafForEachFrame(const InputSource &reference_source,
+                                          const InputSource &test_source,
+                                          SwsContext *display_frame_sws_context,
+                                          AVFrame *max_score_ref_frame,
+                                          AVFrame *max_score_test_frame,
+                                          AVFrame *min_score_ref_frame,
+                                          AVFrame *min_score_test_frame,
+                                          VmafContext *vmaf,
+                                          VmafModel *model,
+                                          uintptr_t max_score_ref_frame_buffer,
+                                          uintptr_t max_score_test_frame_buffer,
+                                          uintptr_t min_score_ref_frame_buffer,
+                                          uintptr_t min_score_test_frame_buffer,
+                                          uintptr_t output_buffer,
+                                          const ScoringOptions &options = ScoringOptions());
+
+// Scores the comparison as num_segments consecutive segments, each seeked to, decoded and scored in its own VmafContext
+// on its own thread, and merges the per-frame scores into output_buffer with the layout ComputeVmafForEachFrame uses.
+// Every segment loads the model from model_buffer into a context with n_threads_per_context threads. Frames of the
+// lowest and highest scores are not captured. Inputs that may have a variable frame rate are scored in one segment, and
+// a frame decoded after a seek without a timestamp fails the computation rather than be scored out of place.
+VmafComputeStatus ComputeVmafInSegments(const std::string &reference_file,
+                                        const std::string &test_file,
+                                        const char *model_buffer,
+                                        uint64_t model_buffer_size,
+                                        bool use_phone_model,
+                                        unsigned num_segments,
+                                        unsigned n_threads_per_context,
+                                        uintptr_t output_buffer,
+                                        const ScoringOptions &options = ScoringOptions());
+
+// Scores every test video against the same reference in one pass. The reference is demuxed, decoded and scaled once
+// and each of its frames is read into one VmafContext per test video. With n_threads > 0 the contexts share a single
+// thread pool of that size. Results for test_files[k] are written to output_buffers[k] with the layout
+// ComputeVmafForEachFrame uses. Frames of the lowest and highest scores are not captured.
+VmafComputeStatus ComputeVmafForEachTestVideo(const std::string &reference_file,
+                                              const std::vector<std::string> &test_files,
+                                              const char *model_buffer,
+                                              uint64_t model_buffer_size,
+                                              bool use_phone_model,
+                                              unsigned n_threads,
+                                              const std::vector<uintptr_t> &output_buffers,
+                                              const ScoringOptions &options = ScoringOptions());
 
 #endif // FFVMAF_LIB_H
\ No newline at end of file
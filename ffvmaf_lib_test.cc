@@ -2,8 +2,135 @@
 
 #include "gmock/gmock.h"
 
+extern "C" {
+#include "libavutil/pixdesc.h"
+}
+
+#include <algorithm>
 #include <cstring>
-#include "libvmaf/runfiles_util.h"
+#include <fstream>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include "libvmaf/src/runfiles_util.h"
+
+namespace {
+
+// InputSource callbacks reading a FILE.
+int ReadFileSource(void* opaque, uint8_t* buf, int buf_size) {
+  const size_t n = fread(buf, 1, buf_size, static_cast<FILE*>(opaque));
+  return n > 0 ? static_cast<int>(n) : AVERROR_EOF;
+}
+
+int64_t SeekFileSource(void* opaque, int64_t offset, int whence) {
+  FILE* file = static_cast<FILE*>(opaque);
+  if (whence == AVSEEK_SIZE) {
+    const long position = ftell(file);
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, position, SEEK_SET);
+    return size;
+  }
+  if (fseek(file, offset, whence & ~AVSEEK_FORCE) != 0) return -1;
+  return ftell(file);
+}
+
+// The model every test scores with.
+std::string ReadModel() {
+  std::ifstream model_file(tools::GetModelRunfilesPathForTest() +
+                           "vmaf_v0.6.1neg.json");
+  std::stringstream model_json;
+  model_json << model_file.rdbuf();
+  return model_json.str();
+}
+
+std::string VideoPath(const std::string& name) {
+  return tools::GetModelRunfilesPathForTest() + name;
+}
+
+// Scores the test video against the reference frame by frame and returns the
+// output buffer. The videos are opened by path, or read through file-backed
+// InputSources with the given buffer size when buffer_size is not 0. Opened by
+// path, the resolution they were scored at is stored in scoring_size if it is
+// not null. With read_chroma, an extractor reading chroma is registered so the
+// pictures are scored in YUV420P rather than luma-only. The four thumbnail
+// buffers are stored in thumbnails if it is not null.
+std::vector<float> ScoreEachFrame(
+    const std::string& reference_path, const std::string& test_path,
+    const ScoringOptions& options, int buffer_size = 0,
+    std::pair<int, int>* scoring_size = nullptr, bool read_chroma = false,
+    std::vector<std::vector<uint8_t>>* thumbnails = nullptr) {
+  VmafConfiguration config = {
+      .log_level = VMAF_LOG_LEVEL_NONE,
+  };
+  VmafContext* vmaf;
+  EXPECT_EQ(vmaf_init(&vmaf, config), 0);
+  if (read_chroma) EXPECT_EQ(vmaf_use_feature(vmaf, "psnr", nullptr), 0);
+  VmafModel* model[1] = {nullptr};
+  VmafModelCollection* model_collection[1] = {nullptr};
+  uint64_t model_collection_count = 0;
+  const std::string model_buffer = ReadModel();
+  EXPECT_EQ(InitializeVmaf(vmaf, model, model_collection,
+                           &model_collection_count, model_buffer.data(),
+                           model_buffer.size(), false),
+            0);
+
+  // Frames and buffers the lowest and highest scoring frames are captured
+  // into.
+  SwsContext* display_sws_context =
+      sws_getContext(1920, 1080, AV_PIX_FMT_YUV420P, 480, 360,
+                     AV_PIX_FMT_RGB0, SWS_BICUBIC, NULL, NULL, NULL);
+  AVFrame* frames[4];
+  std::vector<uint8_t> buffers[4];
+  for (int k = 0; k < 4; k++) {
+    frames[k] = av_frame_alloc();
+    frames[k]->width = 480;
+    frames[k]->height = 360;
+    frames[k]->format = AV_PIX_FMT_RGB0;
+    av_frame_get_buffer(frames[k], 0);
+    buffers[k].resize(480 * 360 * 4);
+  }
+
+  std::vector<float> output(100000);
+  VmafComputeStatus status;
+  if (buffer_size == 0) {
+    const ModelLoader load_model = [&](int width, int height) {
+      if (scoring_size != nullptr) *scoring_size = {width, height};
+      return model[0];
+    };
+    status = ComputeVmafForEachFrame(
+        reference_path, test_path, display_sws_context, frames[0], frames[1],
+        frames[2], frames[3], vmaf, load_model, (uintptr_t)buffers[0].data(),
+        (uintptr_t)buffers[1].data(), (uintptr_t)buffers[2].data(),
+        (uintptr_t)buffers[3].data(), (uintptr_t)output.data(), options);
+  } else {
+    FILE* files[2] = {fopen(reference_path.c_str(), "rb"),
+                      fopen(test_path.c_str(), "rb")};
+    InputSource sources[2];
+    for (int k = 0; k < 2; k++) {
+      sources[k].read = ReadFileSource;
+      sources[k].seek = SeekFileSource;
+      sources[k].opaque = files[k];
+      sources[k].buffer_size = buffer_size;
+    }
+    status = ComputeVmafForEachFrame(
+        sources[0], sources[1], display_sws_context, frames[0], frames[1],
+        frames[2], frames[3], vmaf, model[0], (uintptr_t)buffers[0].data(),
+        (uintptr_t)buffers[1].data(), (uintptr_t)buffers[2].data(),
+        (uintptr_t)buffers[3].data(), (uintptr_t)output.data(), options);
+    for (FILE* file : files) fclose(file);
+  }
+  EXPECT_EQ(status, VmafComputeStatus::SUCCESS);
+  if (thumbnails != nullptr) thumbnails->assign(buffers, buffers + 4);
+
+  for (AVFrame*& frame : frames) av_frame_free(&frame);
+  sws_freeContext(display_sws_context);
+  vmaf_model_release(model[0]);
+  vmaf_close(vmaf);
+  return output;
+}
+
+}  // namespace
 
 class Ffvmaflib : public testing::Test {
  protected:
@@ -42,4 +169,356 @@ class Ffvmaflib : public testing::Test {
 
 TEST_F(Ffvmaflib, Basic) {
   fprintf(stderr, "Ready to initialize vmaf\n");
-}
\ No newline at end of file
+}
+
+TEST_F(Ffvmaflib, InputSourceMatchesFile) {
+  const std::string video_path = VideoPath("720p.mp4");
+  ScoringOptions options;
+  options.resolution = ScoringResolution::NATIVE;
+  const std::vector<float> from_file =
+      ScoreEachFrame(video_path, video_path, options);
+  ASSERT_GT(from_file[1], 0);
+
+  for (int buffer_size : {4096, 1 << 20}) {
+    const std::vector<float> from_source =
+        ScoreEachFrame(video_path, video_path, options, buffer_size);
+    // Both runs agree on everything but the processing rate.
+    const unsigned num_frames = from_file[0];
+    EXPECT_EQ(from_source[0], from_file[0]);
+    EXPECT_EQ(from_source[1], from_file[1]);
+    for (unsigned i = 4; i < 7 + num_frames; i++) {
+      EXPECT_EQ(from_source[i], from_file[i]) << "at index " << i;
+    }
+  }
+}
+
+TEST_F(Ffvmaflib, InputSourceWithoutReadCallbackFails) {
+  InputSource reference, test;
+  std::vector<float> output(16);
+  EXPECT_EQ(ComputeVmafForEachFrame(reference, test, nullptr, nullptr,
+                                    nullptr, nullptr, nullptr, vmaf_, nullptr,
+                                    0, 0, 0, 0, (uintptr_t)output.data()),
+            VmafComputeStatus::INPUT_VIDEO_ERROR);
+}
+
+TEST_F(Ffvmaflib, EachTestVideoMatchesASeparateRun) {
+  const std::string video_path = VideoPath("720p.mp4");
+  ScoringOptions options;
+  options.resolution = ScoringResolution::NATIVE;
+  const std::vector<float> separate =
+      ScoreEachFrame(video_path, video_path, options);
+  const unsigned num_frames = separate[0];
+  ASSERT_GT(num_frames, 2u);
+
+  const std::string model_buffer = ReadModel();
+  for (unsigned n_threads : {0u, 2u}) {
+    std::vector<std::vector<float>> outputs(2,
+                                            std::vector<float>(num_frames + 7));
+    const std::vector<uintptr_t> output_buffers = {
+        (uintptr_t)outputs[0].data(), (uintptr_t)outputs[1].data()};
+    ASSERT_EQ(ComputeVmafForEachTestVideo(
+                  video_path, {video_path, video_path}, model_buffer.data(),
+                  model_buffer.size(), false, n_threads, output_buffers,
+                  options),
+              VmafComputeStatus::SUCCESS);
+    for (const std::vector<float>& output : outputs) {
+      EXPECT_EQ(output[0], num_frames);
+      EXPECT_EQ(output[1], num_frames);
+      // The separate run leaves out the scores of the last two frames, which
+      // it only has once the stream ends.
+      for (unsigned i = 0; i + 2 < num_frames; i++) {
+        EXPECT_EQ(output[4 + i], separate[4 + i])
+            << "frame " << i << ", " << n_threads << " threads";
+      }
+      EXPECT_EQ(output[4 + num_frames], separate[4 + num_frames])
+          << "pooled, " << n_threads << " threads";
+    }
+  }
+}
+
+TEST_F(Ffvmaflib, LumaOnlyScoresMatchYuv420pScores) {
+  const std::string video_path = VideoPath("720p.mp4");
+  for (ScoringResolution resolution :
+       {ScoringResolution::NATIVE, ScoringResolution::FIXED}) {
+    ScoringOptions options;
+    options.resolution = resolution;
+    std::vector<std::vector<uint8_t>> luma_thumbnails, yuv_thumbnails;
+    const std::vector<float> luma_only = ScoreEachFrame(
+        video_path, video_path, options, 0, nullptr, false, &luma_thumbnails);
+    const std::vector<float> yuv = ScoreEachFrame(
+        video_path, video_path, options, 0, nullptr, true, &yuv_thumbnails);
+    const unsigned num_frames = yuv[0];
+    ASSERT_GT(num_frames, 2u);
+    EXPECT_EQ(luma_only[0], yuv[0]);
+    EXPECT_EQ(luma_only[1], yuv[1]);
+    // The frame scores and the pooled, highest and lowest scores, but not the
+    // processing rate.
+    for (unsigned i = 4; i < 7 + num_frames; i++) {
+      EXPECT_EQ(luma_only[i], yuv[i]) << "at index " << i;
+    }
+    // The thumbnails are still converted with their chroma.
+    for (int k = 0; k < 4; k++) {
+      EXPECT_TRUE(luma_thumbnails[k] == yuv_thumbnails[k]) << "thumbnail " << k;
+    }
+  }
+}
+
+TEST_F(Ffvmaflib, SegmentsMatchASingleSegment) {
+  const std::string video_path = VideoPath("720p.mp4");
+  ScoringOptions options;
+  options.resolution = ScoringResolution::NATIVE;
+  const std::vector<float> separate =
+      ScoreEachFrame(video_path, video_path, options);
+  const unsigned num_frames = separate[0];
+  ASSERT_GT(num_frames, 8u);
+
+  const std::string model_buffer = ReadModel();
+  std::vector<float> single(num_frames + 7);
+  ASSERT_EQ(ComputeVmafInSegments(video_path, video_path, model_buffer.data(),
+                                  model_buffer.size(), false, 1, 0,
+                                  (uintptr_t)single.data(), options),
+            VmafComputeStatus::SUCCESS);
+  ASSERT_EQ(single[1], num_frames);
+  // Pooled over the same frames as a run which isn't segmented.
+  EXPECT_EQ(single[4 + num_frames], separate[4 + num_frames]);
+
+  // Every segment after the first starts on a frame whose motion is scored
+  // against the last frame of the segment before.
+  for (unsigned num_segments : {2u, 3u, 7u}) {
+    std::vector<float> segmented(num_frames + 7);
+    ASSERT_EQ(ComputeVmafInSegments(
+                  video_path, video_path, model_buffer.data(),
+                  model_buffer.size(), false, num_segments, 0,
+                  (uintptr_t)segmented.data(), options),
+              VmafComputeStatus::SUCCESS);
+    EXPECT_EQ(segmented[1], num_frames);
+    for (unsigned i = 0; i < num_frames; i++) {
+      EXPECT_EQ(segmented[4 + i], single[4 + i])
+          << "frame " << i << " of " << num_segments << " segments";
+    }
+    EXPECT_EQ(segmented[4 + num_frames], single[4 + num_frames])
+        << "pooled, " << num_segments << " segments";
+  }
+}
+
+TEST_F(Ffvmaflib, NativeScoresAtTheSourceSize) {
+  // 720p.mp4 is 853x480.
+  const std::string video_path = VideoPath("720p.mp4");
+  ScoringOptions options;
+  options.resolution = ScoringResolution::NATIVE;
+  std::pair<int, int> scoring_size;
+  const std::vector<float> bicubic =
+      ScoreEachFrame(video_path, video_path, options, 0, &scoring_size);
+  EXPECT_EQ(scoring_size, std::make_pair(853, 480));
+  const unsigned num_frames = bicubic[0];
+  ASSERT_GT(num_frames, 0u);
+
+  // Frames which aren't scaled don't depend on the scaler.
+  options.scaler_flags = SWS_POINT;
+  const std::vector<float> point =
+      ScoreEachFrame(video_path, video_path, options);
+  for (unsigned i = 0; i < 7 + num_frames; i++) {
+    if (i != 2) EXPECT_EQ(point[i], bicubic[i]) << "at index " << i;
+  }
+}
+
+TEST_F(Ffvmaflib, FixedScalesToTheRequestedSize) {
+  const std::string video_path = VideoPath("720p.mp4");
+  ScoringOptions options;
+  options.resolution = ScoringResolution::FIXED;
+  options.target_width = 640;
+  options.target_height = 360;
+  std::pair<int, int> scoring_size;
+  const std::vector<float> bicubic =
+      ScoreEachFrame(video_path, video_path, options, 0, &scoring_size);
+  EXPECT_EQ(scoring_size, std::make_pair(640, 360));
+  const unsigned num_frames = bicubic[0];
+  ASSERT_GT(num_frames, 0u);
+
+  // Scaled frames, and with them the motion scored, depend on the scaler.
+  options.scaler_flags = SWS_POINT;
+  const std::vector<float> point =
+      ScoreEachFrame(video_path, video_path, options);
+  EXPECT_NE(point[4 + num_frames], bicubic[4 + num_frames]);
+}
+
+TEST_F(Ffvmaflib, MismatchedSizesUnderEachPolicy) {
+  // The reference is 853x480 and the test video 1920x1080.
+  const std::string reference_path = VideoPath("720p.mp4");
+  const std::string test_path = VideoPath("sample.mp4");
+  const struct {
+    ScoringResolution resolution;
+    std::pair<int, int> scoring_size;
+  } kCases[] = {
+      // NATIVE falls back to the fixed target when the sizes differ.
+      {ScoringResolution::NATIVE, {640, 360}},
+      {ScoringResolution::SCALE_TEST_TO_REFERENCE, {853, 480}},
+      {ScoringResolution::FIXED, {640, 360}},
+  };
+  for (const auto& c : kCases) {
+    ScoringOptions options;
+    options.resolution = c.resolution;
+    options.target_width = 640;
+    options.target_height = 360;
+    std::pair<int, int> scoring_size;
+    const std::vector<float> output =
+        ScoreEachFrame(reference_path, test_path, options, 0, &scoring_size);
+    EXPECT_EQ(scoring_size, c.scoring_size)
+        << "policy " << static_cast<int>(c.resolution);
+    const unsigned num_frames = output[0];
+    EXPECT_GT(num_frames, 0u);
+    EXPECT_EQ(output[1], num_frames);
+    EXPECT_GE(output[4 + num_frames], 0.0f);
+    EXPECT_LE(output[4 + num_frames], 100.0f);
+  }
+}
+
+// A frame of a pattern moving with index in the format, with noise added when
+// distorted. Samples are 8-bit values shifted up to the format's bit depth.
+AVFrame* PatternFrame(AVPixelFormat format, int index, bool distorted) {
+  AVFrame* frame = av_frame_alloc();
+  frame->width = 320;
+  frame->height = 240;
+  frame->format = format;
+  av_frame_get_buffer(frame, 0);
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+  const int shift = desc->comp[0].depth - 8;
+  uint32_t noise = 1 + index;
+  for (int plane = 0; plane < 3; plane++) {
+    const int w_shift = plane ? desc->log2_chroma_w : 0;
+    const int h_shift = plane ? desc->log2_chroma_h : 0;
+    const int w = (frame->width + (1 << w_shift) - 1) >> w_shift;
+    const int h = (frame->height + (1 << h_shift) - 1) >> h_shift;
+    for (int y = 0; y < h; y++) {
+      uint8_t* row = frame->data[plane] + y * frame->linesize[plane];
+      for (int x = 0; x < w; x++) {
+        int v = plane ? 128 + (x - y) / 8
+                      : 16 + (x * 3 + y * 2 + index * 5) % 160 +
+                            ((x / 16 + y / 16 + index) % 2) * 40;
+        if (distorted) {
+          noise = noise * 1103515245 + 12345;
+          v += static_cast<int>((noise >> 16) % 13) - 6;
+        }
+        v = std::min(std::max(v, 0), 255) << shift;
+        if (shift)
+          reinterpret_cast<uint16_t*>(row)[x] = v;
+        else
+          row[x] = v;
+      }
+    }
+  }
+  return frame;
+}
+
+// The frame converted to 8-bit YUV420P.
+AVFrame* ConvertTo8Bit420(const AVFrame* src) {
+  AVFrame* frame = av_frame_alloc();
+  frame->width = src->width;
+  frame->height = src->height;
+  frame->format = AV_PIX_FMT_YUV420P;
+  av_frame_get_buffer(frame, 0);
+  SwsContext* sws_context = sws_getContext(
+      src->width, src->height, (AVPixelFormat)src->format, frame->width,
+      frame->height, AV_PIX_FMT_YUV420P, SWS_BICUBIC, NULL, NULL, NULL);
+  sws_scale(sws_context, src->data, src->linesize, 0, src->height,
+            frame->data, frame->linesize);
+  sws_freeContext(sws_context);
+  return frame;
+}
+
+struct ConvertedScore {
+  double pooled = 0.0;
+  // The first reference picture as it was scored.
+  VmafPixelFormat pix_fmt = VMAF_PIX_FMT_UNKNOWN;
+  unsigned bpc = 0;
+  bool wrapped = false;
+};
+
+// Converts the frames with ConvertFrameForScoring at their own size and
+// scores the distorted against the reference ones. Chroma is read, by PSNR, so
+// that the pictures keep it.
+ConvertedScore ScoreConvertedFrames(const std::vector<AVFrame*>& reference,
+                                    const std::vector<AVFrame*>& distorted) {
+  ConvertedScore result;
+  VmafConfiguration config = {
+      .log_level = VMAF_LOG_LEVEL_NONE,
+  };
+  VmafContext* vmaf;
+  EXPECT_EQ(vmaf_init(&vmaf, config), 0);
+  VmafModel* model[1] = {nullptr};
+  VmafModelCollection* model_collection[1] = {nullptr};
+  uint64_t model_collection_count = 0;
+  const std::string model_buffer = ReadModel();
+  EXPECT_EQ(InitializeVmaf(vmaf, model, model_collection,
+                           &model_collection_count, model_buffer.data(),
+                           model_buffer.size(), false),
+            0);
+  EXPECT_EQ(vmaf_use_feature(vmaf, "psnr", nullptr), 0);
+
+  const ScoringOptions options;
+  for (unsigned i = 0; i < reference.size(); i++) {
+    VmafPicture pictures[2];
+    const AVFrame* frames[2] = {reference[i], distorted[i]};
+    for (int k = 0; k < 2; k++) {
+      EXPECT_EQ(ConvertFrameForScoring(frames[k], frames[k]->width,
+                                       frames[k]->height, options, vmaf,
+                                       &pictures[k]),
+                0);
+    }
+    if (i == 0) {
+      result.pix_fmt = pictures[0].pix_fmt;
+      result.bpc = pictures[0].bpc;
+      result.wrapped = pictures[0].data[0] == reference[0]->data[0];
+    }
+    EXPECT_EQ(vmaf_read_pictures(vmaf, &pictures[0], &pictures[1], i), 0);
+  }
+  EXPECT_EQ(vmaf_read_pictures(vmaf, NULL, NULL, 0), 0);
+  EXPECT_EQ(vmaf_score_pooled(vmaf, model[0], VMAF_POOL_METHOD_MEAN,
+                              &result.pooled, 0, reference.size() - 1),
+            0);
+  vmaf_model_release(model[0]);
+  vmaf_close(vmaf);
+  return result;
+}
+
+// Scores a few frames of the pattern in the format, and the same frames
+// converted to 8-bit YUV420P, and checks how the former were passed to libvmaf.
+void ExpectNativeFormatScoresLike8Bit420(AVPixelFormat format,
+                                         VmafPixelFormat pix_fmt,
+                                         unsigned bpc) {
+  std::vector<AVFrame*> reference, distorted, reference_8bit, distorted_8bit;
+  for (int i = 0; i < 6; i++) {
+    reference.push_back(PatternFrame(format, i, false));
+    distorted.push_back(PatternFrame(format, i, true));
+    reference_8bit.push_back(ConvertTo8Bit420(reference.back()));
+    distorted_8bit.push_back(ConvertTo8Bit420(distorted.back()));
+  }
+
+  const ConvertedScore native = ScoreConvertedFrames(reference, distorted);
+  EXPECT_EQ(native.pix_fmt, pix_fmt);
+  EXPECT_EQ(native.bpc, bpc);
+  // Nothing was converted.
+  EXPECT_TRUE(native.wrapped);
+
+  const ConvertedScore converted =
+      ScoreConvertedFrames(reference_8bit, distorted_8bit);
+  EXPECT_EQ(converted.pix_fmt, VMAF_PIX_FMT_YUV420P);
+  EXPECT_EQ(converted.bpc, 8u);
+  EXPECT_GT(native.pooled, 0.0);
+  EXPECT_NEAR(native.pooled, converted.pooled, 1.0);
+
+  for (auto* frames : {&reference, &distorted, &reference_8bit,
+                       &distorted_8bit}) {
+    for (AVFrame*& frame : *frames) av_frame_free(&frame);
+  }
+}
+
+TEST_F(Ffvmaflib, TenBitFramesAreScoredAtTheirOwnDepth) {
+  ExpectNativeFormatScoresLike8Bit420(AV_PIX_FMT_YUV420P10,
+                                      VMAF_PIX_FMT_YUV420P, 10);
+}
+
+TEST_F(Ffvmaflib, Yuv444FramesAreScoredWithTheirChroma) {
+  ExpectNativeFormatScoresLike8Bit420(AV_PIX_FMT_YUV444P,
+                                      VMAF_PIX_FMT_YUV444P, 8);
+}
@@ -9,7 +9,8 @@
 #include "ffvmaf_lib.h"
 
 /* Prepare the in-memory buffer and loaders for VMAF models. */
-VmafModelBuffer vmaf_model_buffer({"vmaf_v0.6.1neg.json", "vmaf_v0.6.1.json"}, "https://vmaf.dev/models/");
+VmafModelBuffer vmaf_model_buffer({"vmaf_v0.6.1neg.json", "vmaf_v0.6.1.json", "vmaf_4k_v0.6.1.json"},
+                                  "https://vmaf.dev/models/");
 
 void downloadSucceeded(emscripten_fetch_t *fetch) {
   const char *model_name = static_cast<char *>(fetch->userData);
@@ -98,6 +99,7 @@ int ComputeVmaf(const std::string &reference_file,
   VmafConfiguration cfg = {
       .log_level = VMAF_LOG_LEVEL_INFO,
       .n_threads = 1,
+      .max_inflight_frames = 8,
   };
   VmafContext *vmaf;
   VmafModel **model;
@@ -122,10 +124,26 @@ int ComputeVmaf(const std::string &reference_file,
   model_collection_count = 0;
 
 
-  const char *model_name = use_neg_mode ? "vmaf_v0.6.1neg.json" : "vmaf_v0.6.1.json";
-  InitializeVmaf(vmaf, model, model_collection, &model_collection_count,
-                 vmaf_model_buffer.GetBuffer(model_name),
-                 vmaf_model_buffer.GetBufferSize(model_name), use_phone_model);
+  // The model is picked once the videos are open. Score at the native resolution when they share it, so that e.g. 720p
+  // ladder rungs are not upscaled, and use the 4K model for 2160p content.
+  ScoringOptions scoring_options;
+  scoring_options.resolution = ScoringResolution::NATIVE;
+  const auto load_model = [&](int scoring_width, int scoring_height) -> VmafModel * {
+    const char *model_name = "vmaf_v0.6.1.json";
+    if (use_neg_mode) {
+      model_name = "vmaf_v0.6.1neg.json";
+    } else if (IsUHDResolution(scoring_width, scoring_height)) {
+      model_name = "vmaf_4k_v0.6.1.json";
+    }
+    if (InitializeVmaf(vmaf, model, model_collection, &model_collection_count,
+                       vmaf_model_buffer.GetBuffer(model_name),
+                       vmaf_model_buffer.GetBufferSize(model_name), use_phone_model) != 0) {
+      return nullptr;
+    }
+    // The built-in models are a fixed set, so keep them loaded for the next comparison instead of parsing them again.
+    vmaf_model_pin(model[0]);
+    return model[0];
+  };
   VmafComputeStatus compute_return_value = ComputeVmafForEachFrame(reference_file,
                           test_file,
                           display_frame_sws_context,
@@ -134,12 +152,13 @@ int ComputeVmaf(const std::string &reference_file,
                           min_score_ref_frame,
                           min_score_test_frame,
                           vmaf,
-                          model[0],
+                          load_model,
                           max_score_ref_frame_buffer,
                           max_score_test_frame_buffer,
                           min_score_ref_frame_buffer,
                           min_score_test_frame_buffer,
-                          output_buffer);
+                          output_buffer,
+                          scoring_options);
 
   // Freeing up resources
   av_frame_free(&max_score_ref_frame);
@@ -148,11 +167,11 @@ int ComputeVmaf(const std::string &reference_file,
   av_frame_free(&min_score_test_frame);
   sws_freeContext(display_frame_sws_context);
 
-  vmaf_model_destroy(model[0]);
+  vmaf_model_release(model[0]);
   free(model);
 
   if (model_collection_count != 0)
-    vmaf_model_collection_destroy(model_collection[0]);
+    vmaf_model_collection_release(model_collection[0]);
   free(model_collection);
 
   vmaf_close(vmaf);
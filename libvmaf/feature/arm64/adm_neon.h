@@ -5,7 +5,7 @@
 #include "feature/integer_adm.h"
 
 void adm_dwt2_8_neon(const uint8_t *src, const adm_dwt_band_t *dst,
-                     AdmBuffer *buf, int w, int h, int src_stride,
-                     int dst_stride);
+                     AdmBuffer *buf, int w, int src_stride,
+                     int dst_stride, int row0, int row1);
 
 #endif /* ARM64_ADM_H_ */
@@ -8,42 +8,6 @@
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
-static FORCE_INLINE inline void
-pad_top_and_bottom(VifBuffer buf, unsigned h, int fwidth)
-{
-    const unsigned fwidth_half = fwidth / 2;
-    unsigned char *ref = buf.ref;
-    unsigned char *dis = buf.dis;
-    for (unsigned i = 1; i <= fwidth_half; ++i) {
-        size_t offset = buf.stride * i;
-        memcpy(ref - offset, ref + offset, buf.stride);
-        memcpy(dis - offset, dis + offset, buf.stride);
-        memcpy(ref + buf.stride * (h - 1) + buf.stride * i,
-               ref + buf.stride * (h - 1) - buf.stride * i,
-               buf.stride);
-        memcpy(dis + buf.stride * (h - 1) + buf.stride * i,
-               dis + buf.stride * (h - 1) - buf.stride * i,
-               buf.stride);
-    }
-}
-
-static FORCE_INLINE inline void
-decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
-{
-    uint16_t *ref = buf.ref;
-    uint16_t *dis = buf.dis;
-    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
-    const ptrdiff_t mu_stride = buf.stride_16 / sizeof(uint16_t);
-
-    for (unsigned i = 0; i < h / 2; ++i) {
-        for (unsigned j = 0; j < w / 2; ++j) {
-            ref[i * stride + j] = buf.mu1[(i * 2) * mu_stride + (j * 2)];
-            dis[i * stride + j] = buf.mu2[(i * 2) * mu_stride + (j * 2)];
-        }
-    }
-    pad_top_and_bottom(buf, h / 2, vif_filter1d_width[scale]);
-}
-
 
 // 32 BITS macros //
 
@@ -240,7 +204,8 @@ decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
 
 // End of macros
 
-void vif_subsample_rd_8_neon(VifBuffer buf, unsigned int w, unsigned int h)
+void vif_subsample_rd_8_neon(VifBuffer buf, unsigned int w, unsigned int y0,
+                             unsigned int y1)
 {
     const unsigned int uiw15 = (w > 15 ? w - 15 : 0);
     const unsigned int fwidth = vif_filter1d_width[1];
@@ -248,14 +213,14 @@ void vif_subsample_rd_8_neon(VifBuffer buf, unsigned int w, unsigned int h)
     const uint8_t *ref = (uint8_t *)buf.ref;
     const uint8_t *dis = (uint8_t *)buf.dis;
     const ptrdiff_t dst_stride = buf.stride_16 / sizeof(uint16_t);
-    ptrdiff_t i_dst_stride = 0;
+    ptrdiff_t i_dst_stride = y0 * dst_stride;
 
     const uint32x4_t offset_vec_v = vdupq_n_u32(128);
     const int32x4_t shift_vec_v = vdupq_n_s32(-8);
     const uint32x4_t offset_vec_h = vdupq_n_u32(32768);
     const int32x4_t shift_vec_h = vdupq_n_s32(-16);
 
-    for (unsigned int i = 0; i < h; ++i, i_dst_stride += dst_stride)
+    for (unsigned int i = y0; i < y1; ++i, i_dst_stride += dst_stride)
     {
 
         int ii = i - fwidth / 2;
@@ -360,17 +325,17 @@ void vif_subsample_rd_8_neon(VifBuffer buf, unsigned int w, unsigned int h)
                 accum_ref += fcoeff * buf.tmp.ref_convol[jj_check];
                 accum_dis += fcoeff * buf.tmp.dis_convol[jj_check];
             }
-            buf.mu1[i * i_dst_stride + j] = (uint16_t)(accum_ref >> 16);
-            buf.mu2[i * i_dst_stride + j] = (uint16_t)(accum_dis >> 16);
+            buf.mu1[i_dst_stride + j] = (uint16_t)(accum_ref >> 16);
+            buf.mu2[i_dst_stride + j] = (uint16_t)(accum_dis >> 16);
         }
     }
 
-    decimate_and_pad(buf, w, h, 0);
 }
 
 
 
-void vif_subsample_rd_16_neon(VifBuffer buf, unsigned int w, unsigned int h, int scale, int bpc)
+void vif_subsample_rd_16_neon(VifBuffer buf, unsigned int w, unsigned int y0,
+                              unsigned int y1, int scale, int bpc)
 {
     const unsigned int uiw15 = (w > 15 ? w - 15 : 0);
     const unsigned int fwidth = vif_filter1d_width[scale + 1];
@@ -398,9 +363,9 @@ void vif_subsample_rd_16_neon(VifBuffer buf, unsigned int w, unsigned int h, int
 
     const ptrdiff_t stride_v = buf.stride / sizeof(uint16_t);
     const ptrdiff_t stride_h = buf.stride_16 / sizeof(uint16_t);
-    ptrdiff_t i_dst_stride = 0;
+    ptrdiff_t i_dst_stride = y0 * stride_h;
 
-    for (unsigned i = 0; i < h; ++i, i_dst_stride += stride_h)
+    for (unsigned i = y0; i < y1; ++i, i_dst_stride += stride_h)
     {
 
         int ii = i - fwidth / 2;
@@ -496,16 +461,15 @@ void vif_subsample_rd_16_neon(VifBuffer buf, unsigned int w, unsigned int h, int
                 accum_ref += fcoeff * buf.tmp.ref_convol[jj_check];
                 accum_dis += fcoeff * buf.tmp.dis_convol[jj_check];
             }
-            buf.mu1[i * i_dst_stride + j] = (uint16_t)(accum_ref >> 16);
-            buf.mu2[i * i_dst_stride + j] = (uint16_t)(accum_dis >> 16);
+            buf.mu1[i_dst_stride + j] = (uint16_t)(accum_ref >> 16);
+            buf.mu2[i_dst_stride + j] = (uint16_t)(accum_dis >> 16);
         }
     }
 
-    decimate_and_pad(buf, w, h, scale);
 }
 
 
-void vif_statistic_8_neon(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h)
+void vif_statistic_8_neon(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h)
 {
     const unsigned int uiw15 = (w > 15 ? w - 15 : 0);
     const unsigned int uiw7 = (w > 7 ? w - 7 : 0);
@@ -767,11 +731,13 @@ void vif_statistic_8_neon(struct VifPublicState *s, float *num, float *den, unsi
             }
         }
     }
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
-void vif_statistic_16_neon(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale)
+void vif_statistic_16_neon(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale)
 {
     const unsigned int uiw7 = (w > 7 ? w - 7 : 0);
     const unsigned int fwidth = vif_filter1d_width[scale];
@@ -1053,14 +1019,16 @@ void vif_statistic_16_neon(struct VifPublicState *s, float *num, float *den, uns
         if (j != w)
         {
             VifResiduals residuals =
-                vif_compute_line_residuals(s, j, w, bpc, scale);
+                vif_compute_line_residuals(s, j, w, scale);
             accum_num_log += residuals.accum_num_log;
             accum_den_log += residuals.accum_den_log;
             accum_num_non_log += residuals.accum_num_non_log;
             accum_den_non_log += residuals.accum_den_non_log;
         }
     }
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
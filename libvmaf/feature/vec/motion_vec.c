@@ -0,0 +1,151 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "libvmaf/feature/vec/motion_vec.h"
+#include "libvmaf/feature/vec/vec.h"
+#include "libvmaf/src/integer_motion.h"
+
+void x_convolution_16_vec(const uint16_t *src, uint16_t *dst, unsigned width,
+                          unsigned height, ptrdiff_t src_stride,
+                          ptrdiff_t dst_stride)
+{
+    const unsigned radius = filter_width / 2;
+    const unsigned left_edge = radius;
+    const unsigned right_edge = width - (filter_width - radius);
+    const unsigned shift_add_round = 32768;
+
+    for (unsigned i = 0; i < height; ++i) {
+        const uint16_t *src_p = src + i * src_stride - radius;
+        uint16_t *dst_p = dst + i * dst_stride;
+
+        for (unsigned j = 0; j < left_edge; j++) {
+            dst_p[j] = (edge_16(true, src, width, height, src_stride, i, j) +
+                        shift_add_round) >> 16;
+        }
+
+        unsigned j = left_edge;
+        for (; j + VEC_LANES <= right_edge; j += VEC_LANES) {
+            vec_u32 accum = { 0 };
+            for (unsigned k = 0; k < filter_width; ++k)
+                accum += vec_load_u16(src_p + j + k) * (uint32_t)filter[k];
+            vec_store_u16(dst_p + j, (accum + shift_add_round) >> 16);
+        }
+        for (; j < right_edge; j++) {
+            uint32_t accum = 0;
+            for (unsigned k = 0; k < filter_width; ++k)
+                accum += filter[k] * src_p[j + k];
+            dst_p[j] = (accum + shift_add_round) >> 16;
+        }
+
+        for (j = right_edge; j < width; j++) {
+            dst_p[j] = (edge_16(true, src, width, height, src_stride, i, j) +
+                        shift_add_round) >> 16;
+        }
+    }
+}
+
+/* Row i - radius + k, mirrored at the edges the way edge_16() does. */
+static inline int tap_row(int i, int k, int height)
+{
+    int i_tap = i - filter_width / 2 + k;
+    if (i_tap < 0)
+        i_tap = -i_tap;
+    else if (i_tap >= height)
+        i_tap = height - (i_tap - height + 1);
+    return i_tap;
+}
+
+static inline void y_convolution(const void *src, bool u8, uint16_t *dst,
+                                 unsigned width, unsigned height,
+                                 ptrdiff_t src_stride, ptrdiff_t dst_stride,
+                                 unsigned shift_var)
+{
+    const uint32_t add_before_shift = 1u << (shift_var - 1);
+
+    for (unsigned i = 0; i < height; i++) {
+        const uint8_t *row_8[5];
+        const uint16_t *row_16[5];
+        for (int k = 0; k < filter_width; ++k) {
+            const ptrdiff_t offset = tap_row(i, k, height) * src_stride;
+            row_8[k] = (const uint8_t *)src + offset;
+            row_16[k] = (const uint16_t *)src + offset;
+        }
+        uint16_t *dst_p = dst + i * dst_stride;
+
+        unsigned j = 0;
+        for (; j + VEC_LANES <= width; j += VEC_LANES) {
+            vec_u32 accum = { 0 };
+            for (int k = 0; k < filter_width; ++k) {
+                const vec_u32 x = u8 ? vec_load_u8(row_8[k] + j)
+                                     : vec_load_u16(row_16[k] + j);
+                accum += x * (uint32_t)filter[k];
+            }
+            vec_store_u16(dst_p + j, (accum + add_before_shift) >> shift_var);
+        }
+        for (; j < width; j++) {
+            uint32_t accum = 0;
+            for (int k = 0; k < filter_width; ++k)
+                accum += filter[k] * (u8 ? row_8[k][j] : row_16[k][j]);
+            dst_p[j] = (accum + add_before_shift) >> shift_var;
+        }
+    }
+}
+
+void y_convolution_8_vec(void *src, uint16_t *dst, unsigned width,
+                         unsigned height, ptrdiff_t src_stride,
+                         ptrdiff_t dst_stride, unsigned inp_size_bits)
+{
+    (void) inp_size_bits;
+    y_convolution(src, true, dst, width, height, src_stride, dst_stride, 8);
+}
+
+void y_convolution_16_vec(void *src, uint16_t *dst, unsigned width,
+                          unsigned height, ptrdiff_t src_stride,
+                          ptrdiff_t dst_stride, unsigned inp_size_bits)
+{
+    y_convolution(src, false, dst, width, height, src_stride, dst_stride,
+                  inp_size_bits);
+}
+
+void sad_vec(VmafPicture *pic_a, VmafPicture *pic_b, uint64_t *sad)
+{
+    *sad = 0;
+
+    const uint16_t *a = pic_a->data[0];
+    const uint16_t *b = pic_b->data[0];
+    for (unsigned i = 0; i < pic_a->h[0]; i++) {
+        vec_u32 accum = { 0 };
+        unsigned j = 0;
+        for (; j + VEC_LANES <= pic_a->w[0]; j += VEC_LANES) {
+            const vec_i32 d = (vec_i32)vec_load_u16(a + j) -
+                              (vec_i32)vec_load_u16(b + j);
+            accum += (vec_u32)((d ^ (d >> 31)) - (d >> 31));
+        }
+        uint32_t inner_sad = vec_hsum_u32(accum);
+        for (; j < pic_a->w[0]; j++)
+            inner_sad += abs(a[j] - b[j]);
+        *sad += inner_sad;
+        a += (pic_a->stride[0] / 2);
+        b += (pic_b->stride[0] / 2);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#ifndef VEC_VEC_H_
+#define VEC_VEC_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Thin wrapper over GCC/Clang vector extensions. Every type has VEC_LANES
+ * lanes, so converting between them is lane for lane, and the compiler maps
+ * the operators onto SSE/AVX, NEON or WASM SIMD128 depending on the target
+ * flags. Arithmetic wraps like the scalar C it replaces.
+ */
+#define VEC_LANES 8
+
+typedef uint8_t vec_u8 __attribute__((vector_size(VEC_LANES)));
+typedef uint16_t vec_u16 __attribute__((vector_size(VEC_LANES * 2)));
+typedef uint32_t vec_u32 __attribute__((vector_size(VEC_LANES * 4)));
+typedef int32_t vec_i32 __attribute__((vector_size(VEC_LANES * 4)));
+typedef uint64_t vec_u64 __attribute__((vector_size(VEC_LANES * 8)));
+
+#define vec_cvt(v, type) __builtin_convertvector(v, type)
+
+/* Unaligned loads and stores; memcpy compiles to a single vector move. */
+static inline vec_u32 vec_load_u8(const uint8_t *p)
+{
+    vec_u8 v;
+    memcpy(&v, p, sizeof(v));
+    return vec_cvt(v, vec_u32);
+}
+
+static inline vec_u32 vec_load_u16(const uint16_t *p)
+{
+    vec_u16 v;
+    memcpy(&v, p, sizeof(v));
+    return vec_cvt(v, vec_u32);
+}
+
+static inline vec_u32 vec_load_u32(const uint32_t *p)
+{
+    vec_u32 v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/* Stores the low 16 bits of every lane. */
+static inline void vec_store_u16(uint16_t *p, vec_u32 v)
+{
+    const vec_u16 w = vec_cvt(v, vec_u16);
+    memcpy(p, &w, sizeof(w));
+}
+
+static inline void vec_store_u32(uint32_t *p, vec_u32 v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void vec_store_i32(int32_t *p, vec_i32 v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline vec_u64 vec_widen(vec_u32 v)
+{
+    return vec_cvt(v, vec_u64);
+}
+
+/* Low 32 bits of every lane. */
+static inline vec_u32 vec_narrow(vec_u64 v)
+{
+    return vec_cvt(v, vec_u32);
+}
+
+static inline uint32_t vec_hsum_u32(vec_u32 v)
+{
+    uint32_t sum = 0;
+    for (unsigned k = 0; k < VEC_LANES; k++)
+        sum += v[k];
+    return sum;
+}
+
+#endif /* VEC_VEC_H_ */
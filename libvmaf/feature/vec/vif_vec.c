@@ -0,0 +1,372 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libvmaf/feature/vec/vec.h"
+#include "libvmaf/feature/vec/vif_vec.h"
+#include "libvmaf/src/integer_vif.h"
+
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+
+static const int32_t sigma_nsq = 65536 << 1;
+
+/* The per-pixel tail of vif_statistic_8/16, see there. */
+static inline void vif_accumulate(VifResiduals *r, int32_t sigma1_sq,
+                                  int32_t sigma2_sq, int32_t sigma12,
+                                  const uint16_t *log2_table,
+                                  double vif_enhn_gain_limit)
+{
+    sigma2_sq = MAX(sigma2_sq, 0);
+    if (sigma1_sq >= sigma_nsq) {
+        r->accum_den_log +=
+            log2_32(log2_table, sigma_nsq + sigma1_sq) - 2048 * 17;
+
+        if (sigma12 > 0 && sigma2_sq > 0) {
+            const double eps = 65536 * 1.0e-10;
+            double g = sigma12 / (sigma1_sq + eps);
+            int32_t sv_sq = sigma2_sq - g * sigma12;
+
+            sv_sq = (uint32_t)(MAX(sv_sq, 0));
+
+            g = MIN(g, vif_enhn_gain_limit);
+
+            uint32_t numer1 = (sv_sq + sigma_nsq);
+            int64_t numer1_tmp = (int64_t)((g * g * sigma1_sq)) + numer1;
+            r->accum_num_log += log2_64(log2_table, numer1_tmp) -
+                                log2_64(log2_table, numer1);
+        }
+    } else {
+        r->accum_num_non_log += sigma2_sq;
+        r->accum_den_non_log++;
+    }
+}
+
+/* Horizontal pass and residuals of one row of the padded tmp buffers. */
+static VifResiduals statistic_row(VifPublicState *s, unsigned w, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    const VifBuffer buf = s->buf;
+    VifResiduals r = { 0 };
+
+    unsigned j = 0;
+    for (; j + VEC_LANES <= w; j += VEC_LANES) {
+        vec_u32 mu1 = { 0 }, mu2 = { 0 };
+        vec_u64 xx = { 0 }, yy = { 0 }, xy = { 0 };
+        for (unsigned fj = 0; fj < fwidth; ++fj) {
+            const int jj = j - fwidth / 2 + fj;
+            const uint32_t fcoeff = vif_filt[fj];
+            mu1 += vec_load_u32(buf.tmp.mu1 + jj) * fcoeff;
+            mu2 += vec_load_u32(buf.tmp.mu2 + jj) * fcoeff;
+            xx += vec_widen(vec_load_u32(buf.tmp.ref + jj)) * fcoeff;
+            yy += vec_widen(vec_load_u32(buf.tmp.dis + jj)) * fcoeff;
+            xy += vec_widen(vec_load_u32(buf.tmp.ref_dis + jj)) * fcoeff;
+        }
+
+        const vec_u64 mu1_64 = vec_widen(mu1), mu2_64 = vec_widen(mu2);
+        const vec_u32 mu1_sq = vec_narrow((mu1_64 * mu1_64 + 2147483648u) >> 32);
+        const vec_u32 mu2_sq = vec_narrow((mu2_64 * mu2_64 + 2147483648u) >> 32);
+        const vec_u32 mu1_mu2 = vec_narrow((mu1_64 * mu2_64 + 2147483648u) >> 32);
+
+        int32_t sigma1_sq[VEC_LANES], sigma2_sq[VEC_LANES], sigma12[VEC_LANES];
+        vec_store_i32(sigma1_sq, (vec_i32)(vec_narrow((xx + 32768) >> 16) - mu1_sq));
+        vec_store_i32(sigma2_sq, (vec_i32)(vec_narrow((yy + 32768) >> 16) - mu2_sq));
+        vec_store_i32(sigma12, (vec_i32)(vec_narrow((xy + 32768) >> 16) - mu1_mu2));
+
+        for (unsigned k = 0; k < VEC_LANES; k++) {
+            vif_accumulate(&r, sigma1_sq[k], sigma2_sq[k], sigma12[k],
+                           s->log2_table, s->vif_enhn_gain_limit);
+        }
+    }
+
+    if (j < w)
+        vif_residuals_add(&r, vif_compute_line_residuals(s, j, w, scale));
+    return r;
+}
+
+void vif_statistic_8_vec(struct VifPublicState *s, VifResiduals *out,
+                         unsigned w, unsigned h)
+{
+    const unsigned fwidth = vif_filter1d_width[0];
+    const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
+    const VifBuffer buf = s->buf;
+    const uint8_t *ref = buf.ref;
+    const uint8_t *dis = buf.dis;
+    VifResiduals residuals = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        const int ii = i - fwidth / 2;
+
+        //VERTICAL
+        unsigned j = 0;
+        for (; j + VEC_LANES <= w; j += VEC_LANES) {
+            vec_u32 mu1 = { 0 }, mu2 = { 0 }, xx = { 0 }, yy = { 0 }, xy = { 0 };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * buf.stride + j;
+                const uint32_t fcoeff = vif_filt_s0[fi];
+                const vec_u32 x = vec_load_u8(ref + offset);
+                const vec_u32 y = vec_load_u8(dis + offset);
+                const vec_u32 fx = x * fcoeff, fy = y * fcoeff;
+                mu1 += fx;
+                mu2 += fy;
+                xx += fx * x;
+                yy += fy * y;
+                xy += fx * y;
+            }
+            vec_store_u32(buf.tmp.mu1 + j, (mu1 + 128) >> 8);
+            vec_store_u32(buf.tmp.mu2 + j, (mu2 + 128) >> 8);
+            vec_store_u32(buf.tmp.ref + j, xx);
+            vec_store_u32(buf.tmp.dis + j, yy);
+            vec_store_u32(buf.tmp.ref_dis + j, xy);
+        }
+        for (; j < w; ++j) {
+            uint32_t mu1 = 0, mu2 = 0, xx = 0, yy = 0, xy = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * buf.stride + j;
+                const uint32_t fcoeff = vif_filt_s0[fi];
+                const uint32_t fx = fcoeff * ref[offset];
+                const uint32_t fy = fcoeff * dis[offset];
+                mu1 += fx;
+                mu2 += fy;
+                xx += fx * ref[offset];
+                yy += fy * dis[offset];
+                xy += fx * dis[offset];
+            }
+            buf.tmp.mu1[j] = (mu1 + 128) >> 8;
+            buf.tmp.mu2[j] = (mu2 + 128) >> 8;
+            buf.tmp.ref[j] = xx;
+            buf.tmp.dis[j] = yy;
+            buf.tmp.ref_dis[j] = xy;
+        }
+
+        PADDING_SQ_DATA(buf, w, fwidth / 2);
+
+        //HORIZONTAL
+        vif_residuals_add(&residuals, statistic_row(s, w, 0));
+    }
+    *out = residuals;
+}
+
+void vif_statistic_16_vec(struct VifPublicState *s, VifResiduals *out,
+                          unsigned w, unsigned h, int bpc, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    const VifBuffer buf = s->buf;
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    const uint16_t *dis = buf.dis;
+    VifResiduals residuals = { 0 };
+
+    int32_t add_shift_round_VP, shift_VP;
+    int32_t add_shift_round_VP_sq, shift_VP_sq;
+    if (scale == 0) {
+        shift_VP = bpc;
+        add_shift_round_VP = 1 << (bpc - 1);
+        shift_VP_sq = (bpc - 8) * 2;
+        add_shift_round_VP_sq = (bpc == 8) ? 0 : 1 << (shift_VP_sq - 1);
+    } else {
+        shift_VP = 16;
+        add_shift_round_VP = 32768;
+        shift_VP_sq = 16;
+        add_shift_round_VP_sq = 32768;
+    }
+
+    for (unsigned i = 0; i < h; ++i) {
+        const int ii = i - fwidth / 2;
+
+        //VERTICAL
+        unsigned j = 0;
+        for (; j + VEC_LANES <= w; j += VEC_LANES) {
+            vec_u32 mu1 = { 0 }, mu2 = { 0 };
+            vec_u64 xx = { 0 }, yy = { 0 }, xy = { 0 };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * stride + j;
+                const uint32_t fcoeff = vif_filt[fi];
+                const vec_u32 x = vec_load_u16(ref + offset);
+                const vec_u32 y = vec_load_u16(dis + offset);
+                const vec_u32 fx = x * fcoeff, fy = y * fcoeff;
+                mu1 += fx;
+                mu2 += fy;
+                xx += vec_widen(fx) * vec_widen(x);
+                yy += vec_widen(fy) * vec_widen(y);
+                xy += vec_widen(fx) * vec_widen(y);
+            }
+            vec_store_u32(buf.tmp.mu1 + j,
+                          ((mu1 + add_shift_round_VP) >> shift_VP) & 0xffff);
+            vec_store_u32(buf.tmp.mu2 + j,
+                          ((mu2 + add_shift_round_VP) >> shift_VP) & 0xffff);
+            vec_store_u32(buf.tmp.ref + j,
+                          vec_narrow((xx + add_shift_round_VP_sq) >> shift_VP_sq));
+            vec_store_u32(buf.tmp.dis + j,
+                          vec_narrow((yy + add_shift_round_VP_sq) >> shift_VP_sq));
+            vec_store_u32(buf.tmp.ref_dis + j,
+                          vec_narrow((xy + add_shift_round_VP_sq) >> shift_VP_sq));
+        }
+        for (; j < w; ++j) {
+            uint32_t mu1 = 0, mu2 = 0;
+            uint64_t xx = 0, yy = 0, xy = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * stride + j;
+                const uint32_t fcoeff = vif_filt[fi];
+                const uint32_t fx = fcoeff * ref[offset];
+                const uint32_t fy = fcoeff * dis[offset];
+                mu1 += fx;
+                mu2 += fy;
+                xx += fx * (uint64_t)ref[offset];
+                yy += fy * (uint64_t)dis[offset];
+                xy += fx * (uint64_t)dis[offset];
+            }
+            buf.tmp.mu1[j] = (uint16_t)((mu1 + add_shift_round_VP) >> shift_VP);
+            buf.tmp.mu2[j] = (uint16_t)((mu2 + add_shift_round_VP) >> shift_VP);
+            buf.tmp.ref[j] = (uint32_t)((xx + add_shift_round_VP_sq) >> shift_VP_sq);
+            buf.tmp.dis[j] = (uint32_t)((yy + add_shift_round_VP_sq) >> shift_VP_sq);
+            buf.tmp.ref_dis[j] = (uint32_t)((xy + add_shift_round_VP_sq) >> shift_VP_sq);
+        }
+
+        PADDING_SQ_DATA(buf, w, fwidth / 2);
+
+        //HORIZONTAL
+        vif_residuals_add(&residuals, statistic_row(s, w, scale));
+    }
+    *out = residuals;
+}
+
+/* Horizontal pass of subsample_rd_8/16 from the padded convolution rows. */
+static void subsample_row(VifBuffer buf, unsigned w, unsigned i,
+                          unsigned fwidth, const uint16_t *vif_filt)
+{
+    const ptrdiff_t stride = buf.stride_16 / sizeof(uint16_t);
+    uint16_t *mu1 = buf.mu1 + i * stride;
+    uint16_t *mu2 = buf.mu2 + i * stride;
+
+    unsigned j = 0;
+    for (; j + VEC_LANES <= w; j += VEC_LANES) {
+        vec_u32 accum_ref = { 0 }, accum_dis = { 0 };
+        for (unsigned fj = 0; fj < fwidth; ++fj) {
+            const int jj = j - fwidth / 2 + fj;
+            const uint32_t fcoeff = vif_filt[fj];
+            accum_ref += vec_load_u32(buf.tmp.ref_convol + jj) * fcoeff;
+            accum_dis += vec_load_u32(buf.tmp.dis_convol + jj) * fcoeff;
+        }
+        vec_store_u16(mu1 + j, (accum_ref + 32768) >> 16);
+        vec_store_u16(mu2 + j, (accum_dis + 32768) >> 16);
+    }
+    for (; j < w; ++j) {
+        uint32_t accum_ref = 0, accum_dis = 0;
+        for (unsigned fj = 0; fj < fwidth; ++fj) {
+            const int jj = j - fwidth / 2 + fj;
+            accum_ref += vif_filt[fj] * buf.tmp.ref_convol[jj];
+            accum_dis += vif_filt[fj] * buf.tmp.dis_convol[jj];
+        }
+        mu1[j] = (uint16_t)((accum_ref + 32768) >> 16);
+        mu2[j] = (uint16_t)((accum_dis + 32768) >> 16);
+    }
+}
+
+void vif_subsample_rd_8_vec(VifBuffer buf, unsigned w, unsigned y0,
+                            unsigned y1)
+{
+    const unsigned fwidth = vif_filter1d_width[1];
+    const uint16_t *vif_filt_s1 = vif_filter1d_table[1];
+    const uint8_t *ref = buf.ref;
+    const uint8_t *dis = buf.dis;
+
+    for (unsigned i = y0; i < y1; ++i) {
+        const int ii = i - fwidth / 2;
+
+        //VERTICAL
+        unsigned j = 0;
+        for (; j + VEC_LANES <= w; j += VEC_LANES) {
+            vec_u32 accum_ref = { 0 }, accum_dis = { 0 };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * buf.stride + j;
+                const uint32_t fcoeff = vif_filt_s1[fi];
+                accum_ref += vec_load_u8(ref + offset) * fcoeff;
+                accum_dis += vec_load_u8(dis + offset) * fcoeff;
+            }
+            vec_store_u32(buf.tmp.ref_convol + j, (accum_ref + 128) >> 8);
+            vec_store_u32(buf.tmp.dis_convol + j, (accum_dis + 128) >> 8);
+        }
+        for (; j < w; ++j) {
+            uint32_t accum_ref = 0, accum_dis = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * buf.stride + j;
+                accum_ref += vif_filt_s1[fi] * (uint32_t)ref[offset];
+                accum_dis += vif_filt_s1[fi] * (uint32_t)dis[offset];
+            }
+            buf.tmp.ref_convol[j] = (accum_ref + 128) >> 8;
+            buf.tmp.dis_convol[j] = (accum_dis + 128) >> 8;
+        }
+
+        PADDING_SQ_DATA_2(buf, w, fwidth / 2);
+
+        //HORIZONTAL
+        subsample_row(buf, w, i, fwidth, vif_filt_s1);
+    }
+}
+
+void vif_subsample_rd_16_vec(VifBuffer buf, unsigned w, unsigned y0,
+                             unsigned y1, int scale, int bpc)
+{
+    const unsigned fwidth = vif_filter1d_width[scale + 1];
+    const uint16_t *vif_filt = vif_filter1d_table[scale + 1];
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    const uint16_t *dis = buf.dis;
+    const int32_t add_shift_round_VP = scale == 0 ? 1 << (bpc - 1) : 32768;
+    const int32_t shift_VP = scale == 0 ? bpc : 16;
+
+    for (unsigned i = y0; i < y1; ++i) {
+        const int ii = i - fwidth / 2;
+
+        //VERTICAL
+        unsigned j = 0;
+        for (; j + VEC_LANES <= w; j += VEC_LANES) {
+            vec_u32 accum_ref = { 0 }, accum_dis = { 0 };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * stride + j;
+                const uint32_t fcoeff = vif_filt[fi];
+                accum_ref += vec_load_u16(ref + offset) * fcoeff;
+                accum_dis += vec_load_u16(dis + offset) * fcoeff;
+            }
+            vec_store_u32(buf.tmp.ref_convol + j,
+                          ((accum_ref + add_shift_round_VP) >> shift_VP) & 0xffff);
+            vec_store_u32(buf.tmp.dis_convol + j,
+                          ((accum_dis + add_shift_round_VP) >> shift_VP) & 0xffff);
+        }
+        for (; j < w; ++j) {
+            uint32_t accum_ref = 0, accum_dis = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                const ptrdiff_t offset = (ii + (int)fi) * stride + j;
+                accum_ref += vif_filt[fi] * (uint32_t)ref[offset];
+                accum_dis += vif_filt[fi] * (uint32_t)dis[offset];
+            }
+            buf.tmp.ref_convol[j] = (uint16_t)((accum_ref + add_shift_round_VP) >> shift_VP);
+            buf.tmp.dis_convol[j] = (uint16_t)((accum_dis + add_shift_round_VP) >> shift_VP);
+        }
+
+        PADDING_SQ_DATA_2(buf, w, fwidth / 2);
+
+        //HORIZONTAL
+        subsample_row(buf, w, i, fwidth, vif_filt);
+    }
+}
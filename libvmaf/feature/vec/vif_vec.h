@@ -0,0 +1,34 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#ifndef VEC_VIF_H_
+#define VEC_VIF_H_
+
+#include "libvmaf/src/integer_vif.h"
+
+void vif_subsample_rd_8_vec(VifBuffer buf, unsigned w, unsigned y0,
+                            unsigned y1);
+
+void vif_subsample_rd_16_vec(VifBuffer buf, unsigned w, unsigned y0,
+                             unsigned y1, int scale, int bpc);
+
+void vif_statistic_8_vec(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h);
+
+void vif_statistic_16_vec(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+
+#endif /* VEC_VIF_H_ */
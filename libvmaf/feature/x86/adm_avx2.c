@@ -16,260 +16,1700 @@
  *
  */
 
-#include "feature/integer_adm.h"
+#include "libvmaf/src/integer_adm.h"
 
 #include <immintrin.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
 
-void adm_dwt2_8_avx2(const uint8_t *src, const adm_dwt_band_t *dst,
-                     AdmBuffer *buf, int w, int h, int src_stride,
-                     int dst_stride)
+#define MIN(x, y) (((x) < (y)) ? (x) : (y))
+#define MAX(x, y) (((x) > (y)) ? (x) : (y))
+
+/*
+ * Helpers for the kernels below. AVX2 multiplies 32-bit lanes into 64-bit
+ * products only for the even lanes, so kernels that need 64-bit precision
+ * work on the even and odd lanes separately and interleave the results.
+ */
+
+/* Low 32 bits of the 64-bit lanes of even and odd, as eight 32-bit lanes. */
+static inline __m256i interleave_lo32(__m256i even, __m256i odd)
+{
+    return _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+}
+
+/* Low 32 bits of the 64-bit lanes of a, then those of b. */
+static inline __m256i concat_lo32(__m256i a, __m256i b)
+{
+    const __m256i idx = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    return _mm256_blend_epi32(_mm256_permutevar8x32_epi32(a, idx),
+                              _mm256_permutevar8x32_epi32(b, idx), 0xF0);
+}
+
+/* Arithmetic right shift of 64-bit lanes, which AVX2 lacks. */
+static inline __m256i sra_epi64(__m256i x, __m128i count)
+{
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    return _mm256_sub_epi64(_mm256_srl_epi64(_mm256_xor_si256(x, bias), count),
+                            _mm256_srl_epi64(bias, count));
+}
+
+static inline __m256i srav_epi64(__m256i x, __m256i count)
+{
+    const __m256i bias = _mm256_set1_epi64x(INT64_MIN);
+    return _mm256_sub_epi64(_mm256_srlv_epi64(_mm256_xor_si256(x, bias), count),
+                            _mm256_srlv_epi64(bias, count));
+}
+
+/* Signed even lanes of a times unsigned even lanes of b, as 64 bits. */
+static inline __m256i mul_epi32_epu32(__m256i a, __m256i b)
+{
+    const __m256i neg = _mm256_shuffle_epi32(_mm256_srai_epi32(a, 31), 0xA0);
+    return _mm256_sub_epi64(_mm256_mul_epu32(a, b),
+                            _mm256_and_si256(neg, _mm256_slli_epi64(b, 32)));
+}
+
+/* Wraps 32-bit lanes to 16 bits, as storing an int to an int16_t does. */
+static inline __m256i wrap_epi16(__m256i x)
+{
+    return _mm256_srai_epi32(_mm256_slli_epi32(x, 16), 16);
+}
+
+static inline __m128i pack_epi16(__m256i x)
+{
+    x = wrap_epi16(x);
+    return _mm_packs_epi32(_mm256_castsi256_si128(x),
+                           _mm256_extracti128_si256(x, 1));
+}
+
+static inline __m256i load_epi16(const int16_t *p)
+{
+    return _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)p));
+}
+
+static inline __m256i load_epi32(const int32_t *p)
+{
+    return _mm256_loadu_si256((const __m256i *)p);
+}
+
+static inline uint64_t hsum_epi64(__m256i x)
+{
+    const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(x),
+                                    _mm256_extracti128_si256(x, 1));
+    return _mm_cvtsi128_si64(_mm_add_epi64(s, _mm_unpackhi_epi64(s, s)));
+}
+
+/* Lanes of a vector starting at column j0 which lie at or after column j. */
+static inline __m256i lanes_from(int j0, int j)
+{
+    return _mm256_cmpgt_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                              _mm256_set1_epi32(j - j0 - 1));
+}
+
+static inline __m256d lo_pd(__m256i x)
+{
+    return _mm256_cvtepi32_pd(_mm256_castsi256_si128(x));
+}
+
+static inline __m256d hi_pd(__m256i x)
+{
+    return _mm256_cvtepi32_pd(_mm256_extracti128_si256(x, 1));
+}
+
+static inline __m256i join_epi32(__m128i lo, __m128i hi)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+}
+
+/* Exact conversion of 64-bit lanes of magnitude below 2^51 to double. */
+static inline __m256d cvtepi64_pd(__m256i x)
+{
+    const __m256i magic = _mm256_set1_epi64x(0x4338000000000000LL);
+    return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(x, magic)),
+                         _mm256_castsi256_pd(magic));
+}
+
+/* Nonzero if a 64-bit lane of x is not within (-2^51, 2^51). */
+static inline __m256i beyond_2p51(__m256i x)
+{
+    return _mm256_srli_epi64(_mm256_add_epi64(x, _mm256_set1_epi64x(1LL << 51)),
+                             52);
+}
+
+static void dwt2_horz_px(const int16_t *tmplo, const int16_t *tmphi,
+                         const adm_dwt_band_t *dst, int **ind_x,
+                         ptrdiff_t row, int j)
 {
     const int16_t *filter_lo = dwt2_db2_coeffs_lo;
     const int16_t *filter_hi = dwt2_db2_coeffs_hi;
-
-    const int16_t shift_HP = 16;
     const int32_t add_shift_HP = 32768;
+    const int16_t shift_HP = 16;
+
+    const int j0 = ind_x[0][j], j1 = ind_x[1][j];
+    const int j2 = ind_x[2][j], j3 = ind_x[3][j];
+    int32_t accum;
+
+    int16_t s0 = tmplo[j0], s1 = tmplo[j1], s2 = tmplo[j2], s3 = tmplo[j3];
+
+    accum = 0;
+    accum += (int32_t)filter_lo[0] * s0;
+    accum += (int32_t)filter_lo[1] * s1;
+    accum += (int32_t)filter_lo[2] * s2;
+    accum += (int32_t)filter_lo[3] * s3;
+    dst->band_a[row + j] = (accum + add_shift_HP) >> shift_HP;
+
+    accum = 0;
+    accum += (int32_t)filter_hi[0] * s0;
+    accum += (int32_t)filter_hi[1] * s1;
+    accum += (int32_t)filter_hi[2] * s2;
+    accum += (int32_t)filter_hi[3] * s3;
+    dst->band_v[row + j] = (accum + add_shift_HP) >> shift_HP;
+
+    s0 = tmphi[j0], s1 = tmphi[j1], s2 = tmphi[j2], s3 = tmphi[j3];
+
+    accum = 0;
+    accum += (int32_t)filter_lo[0] * s0;
+    accum += (int32_t)filter_lo[1] * s1;
+    accum += (int32_t)filter_lo[2] * s2;
+    accum += (int32_t)filter_lo[3] * s3;
+    dst->band_h[row + j] = (accum + add_shift_HP) >> shift_HP;
+
+    accum = 0;
+    accum += (int32_t)filter_hi[0] * s0;
+    accum += (int32_t)filter_hi[1] * s1;
+    accum += (int32_t)filter_hi[2] * s2;
+    accum += (int32_t)filter_hi[3] * s3;
+    dst->band_d[row + j] = (accum + add_shift_HP) >> shift_HP;
+}
+
+/* Lo and hi filtered outputs j to j + 15 of a row of 16-bit samples, whose
+ * taps are 2j - 1 to 2j + 32, none of them mirrored. */
+static inline void dwt2_horz_16(const int16_t *tmp, int16_t *lo, int16_t *hi,
+                                int j)
+{
+    const __m256i fl0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[0] | (dwt2_db2_coeffs_lo[1] << 16));
+    const __m256i fl1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[2] | (dwt2_db2_coeffs_lo[3] << 16));
+    const __m256i fh0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[0] | (dwt2_db2_coeffs_hi[1] << 16));
+    const __m256i fh1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[2] | (dwt2_db2_coeffs_hi[3] << 16));
+    const __m256i add_shift_HP = _mm256_set1_epi32(32768);
+
+    const __m256i s00 = _mm256_loadu_si256((__m256i *)(tmp + 2 * j - 1));
+    const __m256i s22 = _mm256_loadu_si256((__m256i *)(tmp + 2 * j + 1));
+    const __m256i s33 = _mm256_loadu_si256((__m256i *)(tmp + 2 * j + 15));
+    const __m256i s44 = _mm256_loadu_si256((__m256i *)(tmp + 2 * j + 17));
+
+    __m256i acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s00, fl0),
+                                      _mm256_madd_epi16(s22, fl1));
+    __m256i acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s33, fl0),
+                                      _mm256_madd_epi16(s44, fl1));
+    acc_lo = _mm256_srli_epi32(_mm256_add_epi32(acc_lo, add_shift_HP), 16);
+    acc_hi = _mm256_srli_epi32(_mm256_add_epi32(acc_hi, add_shift_HP), 16);
+    _mm256_storeu_si256((__m256i *)(lo + j),
+        _mm256_permute4x64_epi64(_mm256_packus_epi32(acc_lo, acc_hi), 0xD8));
+
+    acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s00, fh0),
+                              _mm256_madd_epi16(s22, fh1));
+    acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s33, fh0),
+                              _mm256_madd_epi16(s44, fh1));
+    acc_lo = _mm256_srli_epi32(_mm256_add_epi32(acc_lo, add_shift_HP), 16);
+    acc_hi = _mm256_srli_epi32(_mm256_add_epi32(acc_hi, add_shift_HP), 16);
+    _mm256_storeu_si256((__m256i *)(hi + j),
+        _mm256_permute4x64_epi64(_mm256_packus_epi32(acc_lo, acc_hi), 0xD8));
+}
+
+/* Vertical pass of columns j to j + 15 of an 8-bit picture. */
+static inline void dwt2_vert_8(const uint8_t *src, int16_t *tmplo,
+                               int16_t *tmphi, int **ind_y, int i, int j,
+                               int src_stride)
+{
+    const __m256i fl0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[0] | (dwt2_db2_coeffs_lo[1] << 16));
+    const __m256i fl1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[2] | (dwt2_db2_coeffs_lo[3] << 16));
+    const __m256i fh0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[0] | (dwt2_db2_coeffs_hi[1] << 16));
+    const __m256i fh1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[2] | (dwt2_db2_coeffs_hi[3] << 16));
+    const __m256i dwt2_db2_coeffs_lo_sum_const = _mm256_set1_epi32(5931776);
+    const __m256i add_shift_VP = _mm256_set1_epi32(128);
+    const __m256i zero = _mm256_setzero_si256();
+
+    const __m256i s0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+        (__m128i *)(src + ind_y[0][i] * src_stride + j)));
+    const __m256i s1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+        (__m128i *)(src + ind_y[1][i] * src_stride + j)));
+    const __m256i s2 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+        (__m128i *)(src + ind_y[2][i] * src_stride + j)));
+    const __m256i s3 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
+        (__m128i *)(src + ind_y[3][i] * src_stride + j)));
+
+    const __m256i s01lo = _mm256_unpacklo_epi16(s0, s1);
+    const __m256i s01hi = _mm256_unpackhi_epi16(s0, s1);
+    const __m256i s23lo = _mm256_unpacklo_epi16(s2, s3);
+    const __m256i s23hi = _mm256_unpackhi_epi16(s2, s3);
+
+    __m256i acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s01lo, fl0),
+                                      _mm256_madd_epi16(s23lo, fl1));
+    __m256i acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s01hi, fl0),
+                                      _mm256_madd_epi16(s23hi, fl1));
+    acc_lo = _mm256_sub_epi32(acc_lo, dwt2_db2_coeffs_lo_sum_const);
+    acc_hi = _mm256_sub_epi32(acc_hi, dwt2_db2_coeffs_lo_sum_const);
+    acc_lo = _mm256_srli_epi32(_mm256_add_epi32(acc_lo, add_shift_VP), 8);
+    acc_hi = _mm256_srli_epi32(_mm256_add_epi32(acc_hi, add_shift_VP), 8);
+    acc_lo = _mm256_blend_epi16(acc_lo, zero, 0xAA);
+    acc_hi = _mm256_blend_epi16(acc_hi, zero, 0xAA);
+    _mm256_storeu_si256((__m256i *)(tmplo + j),
+                        _mm256_packus_epi32(acc_lo, acc_hi));
+
+    acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s01lo, fh0),
+                              _mm256_madd_epi16(s23lo, fh1));
+    acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s01hi, fh0),
+                              _mm256_madd_epi16(s23hi, fh1));
+    acc_lo = _mm256_srli_epi32(_mm256_add_epi32(acc_lo, add_shift_VP), 8);
+    acc_hi = _mm256_srli_epi32(_mm256_add_epi32(acc_hi, add_shift_VP), 8);
+    acc_lo = _mm256_blend_epi16(acc_lo, zero, 0xAA);
+    acc_hi = _mm256_blend_epi16(acc_hi, zero, 0xAA);
+    _mm256_storeu_si256((__m256i *)(tmphi + j),
+                        _mm256_packus_epi32(acc_lo, acc_hi));
+}
+
+/* Horizontal pass of a row of the 16-bit intermediates of the dwt: the
+ * outputs whose taps are not mirrored at either edge are vectorized, with
+ * the last vector overlapping the one before. */
+static void dwt2_horz(const int16_t *tmplo, const int16_t *tmphi,
+                      const adm_dwt_band_t *dst, int **ind_x, ptrdiff_t row,
+                      int w)
+{
+    const int w_out = (w + 1) / 2;
+    const int j_end = (w - 1) / 2;
+
+    dwt2_horz_px(tmplo, tmphi, dst, ind_x, row, 0);
+    int j = 1;
+    if (j_end - j >= 16) {
+        for (; j + 16 <= j_end; j += 16) {
+            dwt2_horz_16(tmplo, dst->band_a + row, dst->band_v + row, j);
+            dwt2_horz_16(tmphi, dst->band_h + row, dst->band_d + row, j);
+        }
+        if (j < j_end) {
+            j = j_end - 16;
+            dwt2_horz_16(tmplo, dst->band_a + row, dst->band_v + row, j);
+            dwt2_horz_16(tmphi, dst->band_h + row, dst->band_d + row, j);
+            j = j_end;
+        }
+    }
+    for (; j < w_out; ++j)
+        dwt2_horz_px(tmplo, tmphi, dst, ind_x, row, j);
+}
+
+void adm_dwt2_8_avx2(const uint8_t *src, const adm_dwt_band_t *dst,
+                     AdmBuffer *buf, int w, int src_stride,
+                     int dst_stride, int row0, int row1)
+{
     int **ind_y = buf->ind_y;
     int **ind_x = buf->ind_x;
 
     int16_t *tmplo = (int16_t *)buf->tmp_ref;
     int16_t *tmphi = tmplo + w;
-    int32_t accum;
 
-    __m256i dwt2_db2_coeffs_lo_sum_const = _mm256_set1_epi32(5931776);
-    __m256i fl0 =
-        _mm256_broadcastd_epi32(_mm_loadu_si128((__m128i *)filter_lo));
-    __m256i fl1 =
-        _mm256_broadcastd_epi32(_mm_loadu_si128((__m128i *)(filter_lo + 2)));
-    __m256i fh0 =
-        _mm256_broadcastd_epi32(_mm_loadu_si128((__m128i *)filter_hi));
-    __m256i fh1 =
-        _mm256_broadcastd_epi32(_mm_loadu_si128((__m128i *)(filter_hi + 2)));
-    __m256i add_shift_VP_vex = _mm256_set1_epi32(128);
-    __m256i pad_register = _mm256_setzero_si256();
-    __m256i add_shift_HP_vex = _mm256_set1_epi32(32768);
-
-    for (int i = 0; i < (h + 1) / 2; ++i) {
+    for (int i = row0; i < row1; ++i) {
+        /* Vertical pass; w > 32, the last vector overlaps the one before. */
+        int j = 0;
+        for (; j + 16 <= w; j += 16)
+            dwt2_vert_8(src, tmplo, tmphi, ind_y, i, j, src_stride);
+        if (j < w)
+            dwt2_vert_8(src, tmplo, tmphi, ind_y, i, w - 16, src_stride);
+
+        /* Horizontal pass (lo and hi). */
+        dwt2_horz(tmplo, tmphi, dst, ind_x, (ptrdiff_t)i * dst_stride, w);
+    }
+}
+
+/* Vertical pass of columns j to j + 15 of a 16-bit picture. Samples are
+ * biased by -32768 to fit the signed multiplies and the bias is folded into
+ * the rounding constants; the 32-bit sums wrap just as the C sums do. */
+static inline void dwt2_vert_16(const uint16_t *src, int16_t *tmplo,
+                                int16_t *tmphi, int **ind_y, int i, int j,
+                                int src_stride, __m256i add_lo, __m256i add_hi,
+                                __m128i shift_VP)
+{
+    const __m256i fl0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[0] | (dwt2_db2_coeffs_lo[1] << 16));
+    const __m256i fl1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_lo[2] | (dwt2_db2_coeffs_lo[3] << 16));
+    const __m256i fh0 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[0] | (dwt2_db2_coeffs_hi[1] << 16));
+    const __m256i fh1 = _mm256_set1_epi32(
+        (uint16_t)dwt2_db2_coeffs_hi[2] | (dwt2_db2_coeffs_hi[3] << 16));
+    const __m256i bias = _mm256_set1_epi16(INT16_MIN);
+    const __m256i zero = _mm256_setzero_si256();
+
+    const __m256i s0 = _mm256_xor_si256(bias, _mm256_loadu_si256(
+        (__m256i *)(src + ind_y[0][i] * src_stride + j)));
+    const __m256i s1 = _mm256_xor_si256(bias, _mm256_loadu_si256(
+        (__m256i *)(src + ind_y[1][i] * src_stride + j)));
+    const __m256i s2 = _mm256_xor_si256(bias, _mm256_loadu_si256(
+        (__m256i *)(src + ind_y[2][i] * src_stride + j)));
+    const __m256i s3 = _mm256_xor_si256(bias, _mm256_loadu_si256(
+        (__m256i *)(src + ind_y[3][i] * src_stride + j)));
+
+    const __m256i s01lo = _mm256_unpacklo_epi16(s0, s1);
+    const __m256i s01hi = _mm256_unpackhi_epi16(s0, s1);
+    const __m256i s23lo = _mm256_unpacklo_epi16(s2, s3);
+    const __m256i s23hi = _mm256_unpackhi_epi16(s2, s3);
+
+    __m256i acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s01lo, fl0),
+                                      _mm256_madd_epi16(s23lo, fl1));
+    __m256i acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s01hi, fl0),
+                                      _mm256_madd_epi16(s23hi, fl1));
+    acc_lo = _mm256_srl_epi32(_mm256_add_epi32(acc_lo, add_lo), shift_VP);
+    acc_hi = _mm256_srl_epi32(_mm256_add_epi32(acc_hi, add_lo), shift_VP);
+    acc_lo = _mm256_blend_epi16(acc_lo, zero, 0xAA);
+    acc_hi = _mm256_blend_epi16(acc_hi, zero, 0xAA);
+    _mm256_storeu_si256((__m256i *)(tmplo + j),
+                        _mm256_packus_epi32(acc_lo, acc_hi));
+
+    acc_lo = _mm256_add_epi32(_mm256_madd_epi16(s01lo, fh0),
+                              _mm256_madd_epi16(s23lo, fh1));
+    acc_hi = _mm256_add_epi32(_mm256_madd_epi16(s01hi, fh0),
+                              _mm256_madd_epi16(s23hi, fh1));
+    acc_lo = _mm256_srl_epi32(_mm256_add_epi32(acc_lo, add_hi), shift_VP);
+    acc_hi = _mm256_srl_epi32(_mm256_add_epi32(acc_hi, add_hi), shift_VP);
+    acc_lo = _mm256_blend_epi16(acc_lo, zero, 0xAA);
+    acc_hi = _mm256_blend_epi16(acc_hi, zero, 0xAA);
+    _mm256_storeu_si256((__m256i *)(tmphi + j),
+                        _mm256_packus_epi32(acc_lo, acc_hi));
+}
+
+void adm_dwt2_16_avx2(const uint16_t *src, const adm_dwt_band_t *dst,
+                      AdmBuffer *buf, int w, int src_stride,
+                      int dst_stride, int inp_size_bits, int row0, int row1)
+{
+    const int32_t add_shift_VP = 1 << (inp_size_bits - 1);
+    const __m128i shift_VP = _mm_cvtsi32_si128(inp_size_bits);
+    const __m256i add_lo = _mm256_set1_epi32(
+        dwt2_db2_coeffs_lo_sum * (32768 - add_shift_VP) + add_shift_VP);
+    const __m256i add_hi = _mm256_set1_epi32(
+        dwt2_db2_coeffs_hi_sum * (32768 - add_shift_VP) + add_shift_VP);
+
+    int **ind_y = buf->ind_y;
+    int **ind_x = buf->ind_x;
+
+    int16_t *tmplo = (int16_t *)buf->tmp_ref;
+    int16_t *tmphi = tmplo + w;
+
+    for (int i = row0; i < row1; ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * dst_stride;
+
+        /* Vertical pass; w > 32, the last vector overlaps the one before. */
+        int j = 0;
+        for (; j + 16 <= w; j += 16) {
+            dwt2_vert_16(src, tmplo, tmphi, ind_y, i, j, src_stride,
+                         add_lo, add_hi, shift_VP);
+        }
+        if (j < w) {
+            dwt2_vert_16(src, tmplo, tmphi, ind_y, i, w - 16, src_stride,
+                         add_lo, add_hi, shift_VP);
+        }
+
+        /* Horizontal pass (lo and hi). */
+        dwt2_horz(tmplo, tmphi, dst, ind_x, row, w);
+    }
+}
+
+static void dwt2_s123_vert_px(const int32_t *src, int32_t *tmplo,
+                              int32_t *tmphi, int **ind_y, int i, int j,
+                              int src_stride, int32_t add_VP, int16_t shift_VP)
+{
+    const int16_t *filter_lo = dwt2_db2_coeffs_lo;
+    const int16_t *filter_hi = dwt2_db2_coeffs_hi;
+
+    const int32_t s10 = src[ind_y[0][i] * src_stride + j];
+    const int32_t s11 = src[ind_y[1][i] * src_stride + j];
+    const int32_t s12 = src[ind_y[2][i] * src_stride + j];
+    const int32_t s13 = src[ind_y[3][i] * src_stride + j];
+    int64_t accum;
+
+    accum = 0;
+    accum += (int64_t)filter_lo[0] * s10;
+    accum += (int64_t)filter_lo[1] * s11;
+    accum += (int64_t)filter_lo[2] * s12;
+    accum += (int64_t)filter_lo[3] * s13;
+    tmplo[j] = (int32_t)((accum + add_VP) >> shift_VP);
+
+    accum = 0;
+    accum += (int64_t)filter_hi[0] * s10;
+    accum += (int64_t)filter_hi[1] * s11;
+    accum += (int64_t)filter_hi[2] * s12;
+    accum += (int64_t)filter_hi[3] * s13;
+    tmphi[j] = (int32_t)((accum + add_VP) >> shift_VP);
+}
+
+static void dwt2_s123_horz_px(const int32_t *tmplo, const int32_t *tmphi,
+                              const i4_adm_dwt_band_t *dst, int **ind_x,
+                              ptrdiff_t row, int j, int32_t add_HP,
+                              int16_t shift_HP)
+{
+    const int16_t *filter_lo = dwt2_db2_coeffs_lo;
+    const int16_t *filter_hi = dwt2_db2_coeffs_hi;
+
+    const int j0 = ind_x[0][j], j1 = ind_x[1][j];
+    const int j2 = ind_x[2][j], j3 = ind_x[3][j];
+    int64_t accum;
+
+    int32_t s10 = tmplo[j0], s11 = tmplo[j1], s12 = tmplo[j2], s13 = tmplo[j3];
+
+    accum = 0;
+    accum += (int64_t)filter_lo[0] * s10;
+    accum += (int64_t)filter_lo[1] * s11;
+    accum += (int64_t)filter_lo[2] * s12;
+    accum += (int64_t)filter_lo[3] * s13;
+    dst->band_a[row + j] = (int32_t)((accum + add_HP) >> shift_HP);
+
+    accum = 0;
+    accum += (int64_t)filter_hi[0] * s10;
+    accum += (int64_t)filter_hi[1] * s11;
+    accum += (int64_t)filter_hi[2] * s12;
+    accum += (int64_t)filter_hi[3] * s13;
+    dst->band_v[row + j] = (int32_t)((accum + add_HP) >> shift_HP);
+
+    s10 = tmphi[j0], s11 = tmphi[j1], s12 = tmphi[j2], s13 = tmphi[j3];
+
+    accum = 0;
+    accum += (int64_t)filter_lo[0] * s10;
+    accum += (int64_t)filter_lo[1] * s11;
+    accum += (int64_t)filter_lo[2] * s12;
+    accum += (int64_t)filter_lo[3] * s13;
+    dst->band_h[row + j] = (int32_t)((accum + add_HP) >> shift_HP);
+
+    accum = 0;
+    accum += (int64_t)filter_hi[0] * s10;
+    accum += (int64_t)filter_hi[1] * s11;
+    accum += (int64_t)filter_hi[2] * s12;
+    accum += (int64_t)filter_hi[3] * s13;
+    dst->band_d[row + j] = (int32_t)((accum + add_HP) >> shift_HP);
+}
+
+/* Sum of the taps s[k] times filter[k] in 64 bits, rounded and shifted. */
+static inline __m256i dwt2_s123_taps(const __m256i *s, const int16_t *filter,
+                                     __m256i add, __m128i shift)
+{
+    __m256i e = _mm256_setzero_si256();
+    __m256i o = _mm256_setzero_si256();
+    for (int k = 0; k < 4; k++) {
+        const __m256i f = _mm256_set1_epi64x(filter[k]);
+        e = _mm256_add_epi64(e, _mm256_mul_epi32(s[k], f));
+        o = _mm256_add_epi64(o, _mm256_mul_epi32(_mm256_srli_epi64(s[k], 32), f));
+    }
+    e = sra_epi64(_mm256_add_epi64(e, add), shift);
+    o = sra_epi64(_mm256_add_epi64(o, add), shift);
+    return interleave_lo32(e, o);
+}
+
+/* Lo and hi filtered outputs j to j + 7 of a row of 32-bit samples, whose
+ * taps are 2j - 1 to 2j + 17, none of them mirrored. */
+static inline void dwt2_s123_horz_8(const int32_t *tmp, int32_t *lo,
+                                    int32_t *hi, int j, __m256i add,
+                                    __m128i shift)
+{
+    const int32_t *p = tmp + 2 * j - 1;
+    __m256i lo_e = _mm256_setzero_si256(), lo_o = _mm256_setzero_si256();
+    __m256i hi_e = _mm256_setzero_si256(), hi_o = _mm256_setzero_si256();
+
+    /* The even lanes of the taps loaded at p + k hold tap k of outputs j to
+     * j + 3, and those loaded at p + 8 + k that of outputs j + 4 to j + 7. */
+    for (int k = 0; k < 4; k++) {
+        const __m256i fl = _mm256_set1_epi64x(dwt2_db2_coeffs_lo[k]);
+        const __m256i fh = _mm256_set1_epi64x(dwt2_db2_coeffs_hi[k]);
+        const __m256i s0 = load_epi32(p + k);
+        const __m256i s1 = load_epi32(p + 8 + k);
+        lo_e = _mm256_add_epi64(lo_e, _mm256_mul_epi32(s0, fl));
+        lo_o = _mm256_add_epi64(lo_o, _mm256_mul_epi32(s1, fl));
+        hi_e = _mm256_add_epi64(hi_e, _mm256_mul_epi32(s0, fh));
+        hi_o = _mm256_add_epi64(hi_o, _mm256_mul_epi32(s1, fh));
+    }
+
+    lo_e = sra_epi64(_mm256_add_epi64(lo_e, add), shift);
+    lo_o = sra_epi64(_mm256_add_epi64(lo_o, add), shift);
+    hi_e = sra_epi64(_mm256_add_epi64(hi_e, add), shift);
+    hi_o = sra_epi64(_mm256_add_epi64(hi_o, add), shift);
+    _mm256_storeu_si256((__m256i *)(lo + j), concat_lo32(lo_e, lo_o));
+    _mm256_storeu_si256((__m256i *)(hi + j), concat_lo32(hi_e, hi_o));
+}
+
+void adm_dwt2_s123_avx2(const int32_t *src, const i4_adm_dwt_band_t *dst,
+                        AdmBuffer *buf, int w, int src_stride,
+                        int dst_stride, int scale, int row0, int row1)
+{
+    int **ind_y = buf->ind_y;
+    int **ind_x = buf->ind_x;
+
+    const int32_t add_bef_shift_round_VP[3] = { 0, 32768, 32768 };
+    const int32_t add_bef_shift_round_HP[3] = { 16384, 32768, 16384 };
+    const int16_t shift_VerticalPass[3] = { 0, 16, 16 };
+    const int16_t shift_HorizontalPass[3] = { 15, 16, 15 };
+
+    const int32_t add_VP = add_bef_shift_round_VP[scale - 1];
+    const int32_t add_HP = add_bef_shift_round_HP[scale - 1];
+    const int16_t shift_VP = shift_VerticalPass[scale - 1];
+    const int16_t shift_HP = shift_HorizontalPass[scale - 1];
+    const __m256i add_VP_vec = _mm256_set1_epi64x(add_VP);
+    const __m256i add_HP_vec = _mm256_set1_epi64x(add_HP);
+    const __m128i shift_VP_vec = _mm_cvtsi32_si128(shift_VP);
+    const __m128i shift_HP_vec = _mm_cvtsi32_si128(shift_HP);
+
+    int32_t *tmplo = buf->tmp_ref;
+    int32_t *tmphi = tmplo + w;
+
+    /* Outputs whose taps, plus the one past them, are not mirrored. */
+    const int w_out = (w + 1) / 2;
+    const int j_end = (w - 2) / 2;
+
+    for (int i = row0; i < row1; ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * dst_stride;
+
         /* Vertical pass. */
+        int j = 0;
+        if (w >= 8) {
+            const int32_t *s[4] = {
+                src + ind_y[0][i] * src_stride, src + ind_y[1][i] * src_stride,
+                src + ind_y[2][i] * src_stride, src + ind_y[3][i] * src_stride,
+            };
+            for (;; j += 8) {
+                if (j + 8 > w) j = w - 8;
+                const __m256i taps[4] = {
+                    load_epi32(s[0] + j), load_epi32(s[1] + j),
+                    load_epi32(s[2] + j), load_epi32(s[3] + j),
+                };
+                _mm256_storeu_si256((__m256i *)(tmplo + j), dwt2_s123_taps(
+                    taps, dwt2_db2_coeffs_lo, add_VP_vec, shift_VP_vec));
+                _mm256_storeu_si256((__m256i *)(tmphi + j), dwt2_s123_taps(
+                    taps, dwt2_db2_coeffs_hi, add_VP_vec, shift_VP_vec));
+                if (j + 8 == w) break;
+            }
+        }
+        else {
+            for (; j < w; ++j) {
+                dwt2_s123_vert_px(src, tmplo, tmphi, ind_y, i, j, src_stride,
+                                  add_VP, shift_VP);
+            }
+        }
+
+        /* Horizontal pass (lo and hi). */
+        dwt2_s123_horz_px(tmplo, tmphi, dst, ind_x, row, 0, add_HP, shift_HP);
+        j = 1;
+        if (j_end - j >= 8) {
+            for (; j + 8 <= j_end; j += 8) {
+                dwt2_s123_horz_8(tmplo, dst->band_a + row, dst->band_v + row,
+                                 j, add_HP_vec, shift_HP_vec);
+                dwt2_s123_horz_8(tmphi, dst->band_h + row, dst->band_d + row,
+                                 j, add_HP_vec, shift_HP_vec);
+            }
+            if (j < j_end) {
+                j = j_end - 8;
+                dwt2_s123_horz_8(tmplo, dst->band_a + row, dst->band_v + row,
+                                 j, add_HP_vec, shift_HP_vec);
+                dwt2_s123_horz_8(tmphi, dst->band_h + row, dst->band_d + row,
+                                 j, add_HP_vec, shift_HP_vec);
+                j = j_end;
+            }
+        }
+        for (; j < w_out; ++j) {
+            dwt2_s123_horz_px(tmplo, tmphi, dst, ind_x, row, j, add_HP,
+                              shift_HP);
+        }
+    }
+}
+
+/* Column and row range decoupled and csf filtered, as in the C kernels. */
+static void adm_decouple_range(int w, int h, int *left, int *top, int *right,
+                               int *bottom)
+{
+    *left = w * ADM_BORDER_FACTOR - 0.5 - 1; // -1 for filter tap
+    *top = h * ADM_BORDER_FACTOR - 0.5 - 1;
+    *right = w - *left + 2; // +2 for filter tap
+    *bottom = h - *top + 2;
+
+    if (*left < 0) *left = 0;
+    if (*right > w) *right = w;
+    if (*top < 0) *top = 0;
+    if (*bottom > h) *bottom = h;
+}
+
+static void decouple_px(AdmBuffer *buf, ptrdiff_t off, float cos_1deg_sq,
+                        double adm_enhn_gain_limit)
+{
+    const adm_dwt_band_t *ref = &buf->ref_dwt2;
+    const adm_dwt_band_t *dis = &buf->dis_dwt2;
+    const adm_dwt_band_t *r = &buf->decouple_r;
+    const adm_dwt_band_t *a = &buf->decouple_a;
+
+    const int16_t o[3] = { ref->band_h[off], ref->band_v[off], ref->band_d[off] };
+    const int16_t t[3] = { dis->band_h[off], dis->band_v[off], dis->band_d[off] };
+    int16_t *r_bands[3] = { r->band_h, r->band_v, r->band_d };
+    int16_t *a_bands[3] = { a->band_h, a->band_v, a->band_d };
+
+    const int64_t ot_dp = (int64_t)o[0] * t[0] + (int64_t)o[1] * t[1];
+    const int64_t o_mag_sq = (int64_t)o[0] * o[0] + (int64_t)o[1] * o[1];
+    const int64_t t_mag_sq = (int64_t)t[0] * t[0] + (int64_t)t[1] * t[1];
+
+    const int angle_flag = (((float)ot_dp / 4096.0) >= 0.0f) &&
+        (((float)ot_dp / 4096.0) * ((float)ot_dp / 4096.0) >=
+            cos_1deg_sq * ((float)o_mag_sq / 4096.0) * ((float)t_mag_sq / 4096.0));
+
+    for (int k = 0; k < 3; k++) {
+        const int32_t tmp_k = (o[k] == 0) ?
+            32768 : (((int64_t)div_lookup[o[k] + 32768] * t[k]) + 16384) >> 15;
+        const int32_t kk = tmp_k < 0 ? 0 : (tmp_k > 32768 ? 32768 : tmp_k);
+
+        int16_t rst = ((kk * o[k]) + 16384) >> 15;
+        const float rst_f = ((float)kk / 32768) * ((float)o[k] / 64);
+
+        if (angle_flag && (rst_f > 0.)) rst = MIN((rst * adm_enhn_gain_limit), t[k]);
+        if (angle_flag && (rst_f < 0.)) rst = MAX((rst * adm_enhn_gain_limit), t[k]);
+
+        r_bands[k][off] = rst;
+        a_bands[k][off] = t[k] - rst;
+    }
+}
+
+/* Angle flags from the dot product and squared magnitudes in double, which
+ * hold them exactly, rounded through float as the C code does. */
+static inline __m256d angle_flag_pd(__m256d ot, __m256d o, __m256d t,
+                                    __m256d cos_1deg_sq)
+{
+    const __m256d q12 = _mm256_set1_pd(1.0 / 4096.0);
+    ot = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_cvtpd_ps(ot)), q12);
+    o = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_cvtpd_ps(o)), q12);
+    t = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_cvtpd_ps(t)), q12);
+
+    const __m256d lhs = _mm256_mul_pd(ot, ot);
+    const __m256d rhs = _mm256_mul_pd(_mm256_mul_pd(cos_1deg_sq, o), t);
+    return _mm256_and_pd(_mm256_cmp_pd(ot, _mm256_setzero_pd(), _CMP_GE_OQ),
+                         _mm256_cmp_pd(lhs, rhs, _CMP_GE_OQ));
+}
+
+/* Clamps rst to the distorted coefficient t where the angle flag is set and
+ * rst is nonzero with the sign of o, after scaling it by the gain limit. */
+static inline __m256i enhance_rst(__m256i rst, __m256i k, __m256i o,
+                                  __m256i t, __m256i flag, __m256d egl)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i kpos = _mm256_and_si256(flag, _mm256_cmpgt_epi32(k, zero));
+    const __m256i up = _mm256_and_si256(kpos, _mm256_cmpgt_epi32(o, zero));
+    const __m256i down = _mm256_and_si256(kpos, _mm256_cmpgt_epi32(zero, o));
+
+    const __m256d r0 = _mm256_mul_pd(lo_pd(rst), egl);
+    const __m256d r1 = _mm256_mul_pd(hi_pd(rst), egl);
+    const __m256d t0 = lo_pd(t), t1 = hi_pd(t);
+
+    const __m256i rst_min =
+        join_epi32(_mm256_cvttpd_epi32(_mm256_min_pd(r0, t0)),
+                   _mm256_cvttpd_epi32(_mm256_min_pd(r1, t1)));
+    const __m256i rst_max =
+        join_epi32(_mm256_cvttpd_epi32(_mm256_max_pd(r0, t0)),
+                   _mm256_cvttpd_epi32(_mm256_max_pd(r1, t1)));
+
+    rst = _mm256_blendv_epi8(rst, rst_min, up);
+    return _mm256_blendv_epi8(rst, rst_max, down);
+}
+
+static inline __m256i decouple_rst_8(__m256i o, __m256i t, __m256i flag,
+                                     __m256d egl)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one_q15 = _mm256_set1_epi32(32768);
+    const __m256i rnd = _mm256_set1_epi64x(16384);
+    const __m128i shift = _mm_cvtsi32_si128(15);
+
+    /* The quotient fits 32 bits, so only its low half is kept. */
+    const __m256i recip =
+        _mm256_i32gather_epi32(div_lookup, _mm256_add_epi32(o, one_q15), 4);
+    const __m256i ke = sra_epi64(_mm256_add_epi64(
+        _mm256_mul_epi32(recip, t), rnd), shift);
+    const __m256i ko = sra_epi64(_mm256_add_epi64(_mm256_mul_epi32(
+        _mm256_srli_epi64(recip, 32), _mm256_srli_epi64(t, 32)), rnd), shift);
+
+    __m256i k = interleave_lo32(ke, ko);
+    k = _mm256_min_epi32(_mm256_max_epi32(k, zero), one_q15);
+    k = _mm256_blendv_epi8(k, one_q15, _mm256_cmpeq_epi32(o, zero));
+
+    const __m256i rst = _mm256_srai_epi32(_mm256_add_epi32(
+        _mm256_mullo_epi32(k, o), _mm256_set1_epi32(16384)), 15);
+    return enhance_rst(rst, k, o, t, flag, egl);
+}
+
+static inline void decouple_8(AdmBuffer *buf, ptrdiff_t off,
+                              __m256d cos_1deg_sq, __m256d egl)
+{
+    const adm_dwt_band_t *ref = &buf->ref_dwt2;
+    const adm_dwt_band_t *dis = &buf->dis_dwt2;
+    const adm_dwt_band_t *r = &buf->decouple_r;
+    const adm_dwt_band_t *a = &buf->decouple_a;
+
+    const __m256i oh = load_epi16(ref->band_h + off);
+    const __m256i ov = load_epi16(ref->band_v + off);
+    const __m256i od = load_epi16(ref->band_d + off);
+    const __m256i th = load_epi16(dis->band_h + off);
+    const __m256i tv = load_epi16(dis->band_v + off);
+    const __m256i td = load_epi16(dis->band_d + off);
 
-        for (int j = 0; j < w; j = j + 16) {
-
-            __m256i accum_mu2_lo, accum_mu2_hi, accum_mu1_lo, accum_mu1_hi;
-            accum_mu2_lo = accum_mu2_hi = accum_mu1_lo = accum_mu1_hi =
-                _mm256_setzero_si256();
-            __m256i s0, s1, s2, s3;
-
-            s0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
-                (__m128i *)(src + (ind_y[0][i] * src_stride) + j)));
-            s1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
-                (__m128i *)(src + (ind_y[1][i] * src_stride) + j)));
-            s2 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
-                (__m128i *)(src + (ind_y[2][i] * src_stride) + j)));
-            s3 = _mm256_cvtepu8_epi16(_mm_loadu_si128(
-                (__m128i *)(src + (ind_y[3][i] * src_stride) + j)));
-
-            __m256i s0lo = _mm256_unpacklo_epi16(s0, s1);
-            __m256i s0hi = _mm256_unpackhi_epi16(s0, s1);
-            accum_mu2_lo =
-                _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s0lo, fl0));
-            accum_mu2_hi =
-                _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s0hi, fl0));
-
-            __m256i s1lo = _mm256_unpacklo_epi16(s2, s3);
-            __m256i s1hi = _mm256_unpackhi_epi16(s2, s3);
-            accum_mu2_lo =
-                _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s1lo, fl1));
-            accum_mu2_hi =
-                _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s1hi, fl1));
-
-            accum_mu2_lo =
-                _mm256_sub_epi32(accum_mu2_lo, dwt2_db2_coeffs_lo_sum_const);
-            accum_mu2_hi =
-                _mm256_sub_epi32(accum_mu2_hi, dwt2_db2_coeffs_lo_sum_const);
-
-            accum_mu2_lo = _mm256_add_epi32(accum_mu2_lo, add_shift_VP_vex);
-            accum_mu2_lo = _mm256_srli_epi32(accum_mu2_lo, 0x08);
-            accum_mu2_hi = _mm256_add_epi32(accum_mu2_hi, add_shift_VP_vex);
-            accum_mu2_hi = _mm256_srli_epi32(accum_mu2_hi, 0x08);
-            accum_mu2_lo = _mm256_blend_epi16(accum_mu2_lo, pad_register, 0xAA);
-            accum_mu2_hi = _mm256_blend_epi16(accum_mu2_hi, pad_register, 0xAA);
-
-            accum_mu2_hi = _mm256_packus_epi32(accum_mu2_lo, accum_mu2_hi);
-            _mm256_storeu_si256((__m256i *)(tmplo + j), accum_mu2_hi);
-
-            accum_mu1_lo =
-                _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s0lo, fh0));
-            accum_mu1_hi =
-                _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s0hi, fh0));
-            accum_mu1_lo =
-                _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s1lo, fh1));
-            accum_mu1_hi =
-                _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s1hi, fh1));
-
-            accum_mu1_lo = _mm256_add_epi32(accum_mu1_lo, add_shift_VP_vex);
-            accum_mu1_lo = _mm256_srli_epi32(accum_mu1_lo, 0x08);
-            accum_mu1_hi = _mm256_add_epi32(accum_mu1_hi, add_shift_VP_vex);
-            accum_mu1_hi = _mm256_srli_epi32(accum_mu1_hi, 0x08);
-            accum_mu1_lo = _mm256_blend_epi16(accum_mu1_lo, pad_register, 0xAA);
-            accum_mu1_hi = _mm256_blend_epi16(accum_mu1_hi, pad_register, 0xAA);
-            accum_mu1_hi = _mm256_packus_epi32(accum_mu1_lo, accum_mu1_hi);
-            _mm256_storeu_si256((__m256i *)(tmphi + j), accum_mu1_hi);
-            // for( int k =0; k<16;k++){
-            //     fprintf(stderr, "actual value hi tmp is %d \n",tmphi[j +k]);
-            // }
+    __m256d flag[2];
+    for (int half = 0; half < 2; half++) {
+        const __m256d ohd = half ? hi_pd(oh) : lo_pd(oh);
+        const __m256d ovd = half ? hi_pd(ov) : lo_pd(ov);
+        const __m256d thd = half ? hi_pd(th) : lo_pd(th);
+        const __m256d tvd = half ? hi_pd(tv) : lo_pd(tv);
+        const __m256d ot_dp = _mm256_add_pd(_mm256_mul_pd(ohd, thd),
+                                            _mm256_mul_pd(ovd, tvd));
+        const __m256d o_mag_sq = _mm256_add_pd(_mm256_mul_pd(ohd, ohd),
+                                               _mm256_mul_pd(ovd, ovd));
+        const __m256d t_mag_sq = _mm256_add_pd(_mm256_mul_pd(thd, thd),
+                                               _mm256_mul_pd(tvd, tvd));
+        flag[half] = angle_flag_pd(ot_dp, o_mag_sq, t_mag_sq, cos_1deg_sq);
+    }
+    const __m256i angle_flag = concat_lo32(_mm256_castpd_si256(flag[0]),
+                                           _mm256_castpd_si256(flag[1]));
+
+    const __m256i rst_h = decouple_rst_8(oh, th, angle_flag, egl);
+    const __m256i rst_v = decouple_rst_8(ov, tv, angle_flag, egl);
+    const __m256i rst_d = decouple_rst_8(od, td, angle_flag, egl);
+
+    _mm_storeu_si128((__m128i *)(r->band_h + off), pack_epi16(rst_h));
+    _mm_storeu_si128((__m128i *)(r->band_v + off), pack_epi16(rst_v));
+    _mm_storeu_si128((__m128i *)(r->band_d + off), pack_epi16(rst_d));
+    _mm_storeu_si128((__m128i *)(a->band_h + off),
+                     pack_epi16(_mm256_sub_epi32(th, rst_h)));
+    _mm_storeu_si128((__m128i *)(a->band_v + off),
+                     pack_epi16(_mm256_sub_epi32(tv, rst_v)));
+    _mm_storeu_si128((__m128i *)(a->band_d + off),
+                     pack_epi16(_mm256_sub_epi32(td, rst_d)));
+}
+
+void adm_decouple_avx2(AdmBuffer *buf, int w, int h, int stride,
+                       double adm_enhn_gain_limit, int row0, int row1)
+{
+    const float cos_1deg_sq = cos(1.0 * M_PI / 180.0) * cos(1.0 * M_PI / 180.0);
+    const __m256d cos_1deg_sq_pd = _mm256_set1_pd(cos_1deg_sq);
+    const __m256d egl = _mm256_set1_pd(adm_enhn_gain_limit);
+
+    int left, top, right, bottom;
+    adm_decouple_range(w, h, &left, &top, &right, &bottom);
+
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * stride;
+        if (right - left < 8) {
+            for (int j = left; j < right; ++j)
+                decouple_px(buf, row + j, cos_1deg_sq, adm_enhn_gain_limit);
+            continue;
         }
+        int j = left;
+        for (; j + 8 <= right; j += 8)
+            decouple_8(buf, row + j, cos_1deg_sq_pd, egl);
+        if (j < right)
+            decouple_8(buf, row + right - 8, cos_1deg_sq_pd, egl);
+    }
+}
+
+static void decouple_s123_px(AdmBuffer *buf, ptrdiff_t off, float cos_1deg_sq,
+                             double adm_enhn_gain_limit)
+{
+    const i4_adm_dwt_band_t *ref = &buf->i4_ref_dwt2;
+    const i4_adm_dwt_band_t *dis = &buf->i4_dis_dwt2;
+    const i4_adm_dwt_band_t *r = &buf->i4_decouple_r;
+    const i4_adm_dwt_band_t *a = &buf->i4_decouple_a;
+
+    const int32_t o[3] = { ref->band_h[off], ref->band_v[off], ref->band_d[off] };
+    const int32_t t[3] = { dis->band_h[off], dis->band_v[off], dis->band_d[off] };
+    int32_t *r_bands[3] = { r->band_h, r->band_v, r->band_d };
+    int32_t *a_bands[3] = { a->band_h, a->band_v, a->band_d };
+
+    const int64_t ot_dp = (int64_t)o[0] * t[0] + (int64_t)o[1] * t[1];
+    const int64_t o_mag_sq = (int64_t)o[0] * o[0] + (int64_t)o[1] * o[1];
+    const int64_t t_mag_sq = (int64_t)t[0] * t[0] + (int64_t)t[1] * t[1];
+
+    const int angle_flag = (((float)ot_dp / 4096.0) >= 0.0f) &&
+        (((float)ot_dp / 4096.0) * ((float)ot_dp / 4096.0) >=
+            cos_1deg_sq * ((float)o_mag_sq / 4096.0) * ((float)t_mag_sq / 4096.0));
+
+    for (int k = 0; k < 3; k++) {
+        int32_t k_shift = 0;
+        const uint32_t abs_o = abs(o[k]);
+        const int8_t k_sign = (o[k] < 0 ? -1 : 1);
+        const uint16_t k_msb =
+            (abs_o < (32768) ? abs_o : get_best15_from32(abs_o, &k_shift));
+
+        const int64_t tmp_k = (o[k] == 0) ? 32768 :
+            (((int64_t)div_lookup[k_msb + 32768] * t[k]) * (k_sign) +
+                (1 << (14 + k_shift))) >> (15 + k_shift);
+        const int64_t kk = tmp_k < 0 ? 0 : (tmp_k > 32768 ? 32768 : tmp_k);
+
+        int32_t rst = ((kk * o[k]) + 16384) >> 15;
+        const float rst_f = ((float)kk / 32768) * ((float)o[k] / 64);
+
+        if (angle_flag && (rst_f > 0.)) rst = MIN((rst * adm_enhn_gain_limit), t[k]);
+        if (angle_flag && (rst_f < 0.)) rst = MAX((rst * adm_enhn_gain_limit), t[k]);
+
+        r_bands[k][off] = rst;
+        a_bands[k][off] = t[k] - rst;
+    }
+}
+
+static inline __m256i decouple_s123_rst_8(__m256i o, __m256i t, __m256i flag,
+                                          __m256d egl)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i one_q15 = _mm256_set1_epi32(32768);
+    const __m256i one_q15_64 = _mm256_set1_epi64x(32768);
+    const __m256i lo32 = _mm256_set1_epi64x(0xFFFFFFFF);
+
+    /* Best 15 bits of |o| >= 2^15, from the exponent of the exactly
+     * converted top 24 bits of |o|, and the shift they were taken at. */
+    const __m256i abs_o = _mm256_abs_epi32(o);
+    const __m256i big = _mm256_cmpgt_epi32(abs_o, _mm256_set1_epi32(32767));
+    const __m256i msb = _mm256_sub_epi32(_mm256_srli_epi32(_mm256_castps_si256(
+        _mm256_cvtepi32_ps(_mm256_srli_epi32(abs_o, 8))), 23),
+        _mm256_set1_epi32(127 - 8));
+    const __m256i shift =
+        _mm256_and_si256(big, _mm256_sub_epi32(msb, _mm256_set1_epi32(14)));
+    const __m256i best15 = _mm256_blendv_epi8(abs_o, _mm256_srlv_epi32(
+        _mm256_add_epi32(abs_o, _mm256_sllv_epi32(one, _mm256_sub_epi32(shift, one))),
+        shift), big);
 
-        int j0 = ind_x[0][0];
-        int j1 = ind_x[1][0];
-        int j2 = ind_x[2][0];
-        int j3 = ind_x[3][0];
-
-        int16_t s0 = tmplo[j0];
-        int16_t s1 = tmplo[j1];
-        int16_t s2 = tmplo[j2];
-        int16_t s3 = tmplo[j3];
-
-        accum = 0;
-        accum += (int32_t)filter_lo[0] * s0;
-        accum += (int32_t)filter_lo[1] * s1;
-        accum += (int32_t)filter_lo[2] * s2;
-        accum += (int32_t)filter_lo[3] * s3;
-        dst->band_a[i * dst_stride] = (accum + add_shift_HP) >> shift_HP;
-
-        accum = 0;
-        accum += (int32_t)filter_hi[0] * s0;
-        accum += (int32_t)filter_hi[1] * s1;
-        accum += (int32_t)filter_hi[2] * s2;
-        accum += (int32_t)filter_hi[3] * s3;
-        dst->band_v[i * dst_stride] = (accum + add_shift_HP) >> shift_HP;
-
-        s0 = tmphi[j0];
-        s1 = tmphi[j1];
-        s2 = tmphi[j2];
-        s3 = tmphi[j3];
-
-        accum = 0;
-        accum += (int32_t)filter_lo[0] * s0;
-        accum += (int32_t)filter_lo[1] * s1;
-        accum += (int32_t)filter_lo[2] * s2;
-        accum += (int32_t)filter_lo[3] * s3;
-        dst->band_h[i * dst_stride] = (accum + add_shift_HP) >> shift_HP;
-
-        accum = 0;
-        accum += (int32_t)filter_hi[0] * s0;
-        accum += (int32_t)filter_hi[1] * s1;
-        accum += (int32_t)filter_hi[2] * s2;
-        accum += (int32_t)filter_hi[3] * s3;
-        dst->band_d[i * dst_stride] = (accum + add_shift_HP) >> shift_HP;
-
-        for (int j = 1; j < (w + 1) / 2; j = j + 16) {
+    const __m256i recip =
+        _mm256_i32gather_epi32(div_lookup, _mm256_add_epi32(best15, one_q15), 4);
+    const __m256i sign = _mm256_srai_epi32(o, 31);
+    const __m256i sign_e = _mm256_shuffle_epi32(sign, 0xA0);
+    const __m256i sign_o = _mm256_shuffle_epi32(sign, 0xF5);
+    const __m256i shift_e = _mm256_and_si256(shift, lo32);
+    const __m256i shift_o = _mm256_srli_epi64(shift, 32);
+
+    __m256i ke = _mm256_mul_epi32(recip, t);
+    __m256i ko = _mm256_mul_epi32(_mm256_srli_epi64(recip, 32),
+                                  _mm256_srli_epi64(t, 32));
+    ke = _mm256_sub_epi64(_mm256_xor_si256(ke, sign_e), sign_e);
+    ko = _mm256_sub_epi64(_mm256_xor_si256(ko, sign_o), sign_o);
+    ke = _mm256_add_epi64(ke, _mm256_sllv_epi64(_mm256_set1_epi64x(1),
+        _mm256_add_epi64(shift_e, _mm256_set1_epi64x(14))));
+    ko = _mm256_add_epi64(ko, _mm256_sllv_epi64(_mm256_set1_epi64x(1),
+        _mm256_add_epi64(shift_o, _mm256_set1_epi64x(14))));
+    ke = srav_epi64(ke, _mm256_add_epi64(shift_e, _mm256_set1_epi64x(15)));
+    ko = srav_epi64(ko, _mm256_add_epi64(shift_o, _mm256_set1_epi64x(15)));
+
+    /* Clamp to [0, 32768] in 64 bits, the quotient may not fit 32. */
+    ke = _mm256_blendv_epi8(ke, one_q15_64, _mm256_cmpgt_epi64(ke, one_q15_64));
+    ko = _mm256_blendv_epi8(ko, one_q15_64, _mm256_cmpgt_epi64(ko, one_q15_64));
+    ke = _mm256_andnot_si256(_mm256_cmpgt_epi64(zero, ke), ke);
+    ko = _mm256_andnot_si256(_mm256_cmpgt_epi64(zero, ko), ko);
+
+    __m256i k = interleave_lo32(ke, ko);
+    k = _mm256_blendv_epi8(k, one_q15, _mm256_cmpeq_epi32(o, zero));
+
+    const __m256i rnd = _mm256_set1_epi64x(16384);
+    const __m256i re = _mm256_srli_epi64(_mm256_add_epi64(
+        _mm256_mul_epi32(k, o), rnd), 15);
+    const __m256i ro = _mm256_srli_epi64(_mm256_add_epi64(_mm256_mul_epi32(
+        _mm256_srli_epi64(k, 32), _mm256_srli_epi64(o, 32)), rnd), 15);
+    const __m256i rst = interleave_lo32(re, ro);
+
+    return enhance_rst(rst, k, o, t, flag, egl);
+}
+
+/* Returns false, leaving the pixels alone, if the dot products do not all
+ * convert to double exactly. */
+static inline bool decouple_s123_8(AdmBuffer *buf, ptrdiff_t off,
+                                   __m256d cos_1deg_sq, __m256d egl)
+{
+    const i4_adm_dwt_band_t *ref = &buf->i4_ref_dwt2;
+    const i4_adm_dwt_band_t *dis = &buf->i4_dis_dwt2;
+    const i4_adm_dwt_band_t *r = &buf->i4_decouple_r;
+    const i4_adm_dwt_band_t *a = &buf->i4_decouple_a;
+
+    const __m256i oh = load_epi32(ref->band_h + off);
+    const __m256i ov = load_epi32(ref->band_v + off);
+    const __m256i od = load_epi32(ref->band_d + off);
+    const __m256i th = load_epi32(dis->band_h + off);
+    const __m256i tv = load_epi32(dis->band_v + off);
+    const __m256i td = load_epi32(dis->band_d + off);
+
+    __m256i ot_dp[2], o_mag_sq[2], t_mag_sq[2];
+    __m256i beyond = _mm256_setzero_si256();
+    for (int odd = 0; odd < 2; odd++) {
+        const __m256i ohx = odd ? _mm256_srli_epi64(oh, 32) : oh;
+        const __m256i ovx = odd ? _mm256_srli_epi64(ov, 32) : ov;
+        const __m256i thx = odd ? _mm256_srli_epi64(th, 32) : th;
+        const __m256i tvx = odd ? _mm256_srli_epi64(tv, 32) : tv;
+        ot_dp[odd] = _mm256_add_epi64(_mm256_mul_epi32(ohx, thx),
+                                      _mm256_mul_epi32(ovx, tvx));
+        o_mag_sq[odd] = _mm256_add_epi64(_mm256_mul_epi32(ohx, ohx),
+                                         _mm256_mul_epi32(ovx, ovx));
+        t_mag_sq[odd] = _mm256_add_epi64(_mm256_mul_epi32(thx, thx),
+                                         _mm256_mul_epi32(tvx, tvx));
+        beyond = _mm256_or_si256(beyond, beyond_2p51(ot_dp[odd]));
+        beyond = _mm256_or_si256(beyond, beyond_2p51(o_mag_sq[odd]));
+        beyond = _mm256_or_si256(beyond, beyond_2p51(t_mag_sq[odd]));
+    }
+    if (!_mm256_testz_si256(beyond, beyond)) return false;
+
+    __m256i flag[2];
+    for (int odd = 0; odd < 2; odd++) {
+        flag[odd] = _mm256_castpd_si256(angle_flag_pd(cvtepi64_pd(ot_dp[odd]),
+            cvtepi64_pd(o_mag_sq[odd]), cvtepi64_pd(t_mag_sq[odd]),
+            cos_1deg_sq));
+    }
+    const __m256i angle_flag = interleave_lo32(flag[0], flag[1]);
+
+    const __m256i rst_h = decouple_s123_rst_8(oh, th, angle_flag, egl);
+    const __m256i rst_v = decouple_s123_rst_8(ov, tv, angle_flag, egl);
+    const __m256i rst_d = decouple_s123_rst_8(od, td, angle_flag, egl);
+
+    _mm256_storeu_si256((__m256i *)(r->band_h + off), rst_h);
+    _mm256_storeu_si256((__m256i *)(r->band_v + off), rst_v);
+    _mm256_storeu_si256((__m256i *)(r->band_d + off), rst_d);
+    _mm256_storeu_si256((__m256i *)(a->band_h + off), _mm256_sub_epi32(th, rst_h));
+    _mm256_storeu_si256((__m256i *)(a->band_v + off), _mm256_sub_epi32(tv, rst_v));
+    _mm256_storeu_si256((__m256i *)(a->band_d + off), _mm256_sub_epi32(td, rst_d));
+    return true;
+}
+
+void adm_decouple_s123_avx2(AdmBuffer *buf, int w, int h, int stride,
+                            double adm_enhn_gain_limit, int row0, int row1)
+{
+    const float cos_1deg_sq = cos(1.0 * M_PI / 180.0) * cos(1.0 * M_PI / 180.0);
+    const __m256d cos_1deg_sq_pd = _mm256_set1_pd(cos_1deg_sq);
+    const __m256d egl = _mm256_set1_pd(adm_enhn_gain_limit);
+
+    int left, top, right, bottom;
+    adm_decouple_range(w, h, &left, &top, &right, &bottom);
+
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * stride;
+        for (int j = left; j < right; j += 8) {
+            /* The last vector overlaps the one before; decoupling is
+             * elementwise, so pixels done twice come out the same. */
+            const int j0 = right - left < 8 ? j : MIN(j, right - 8);
+            if (right - j0 < 8 ||
+                !decouple_s123_8(buf, row + j0, cos_1deg_sq_pd, egl))
             {
-                __m256i accum_mu2_lo, accum_mu2_hi, accum_mu1_lo, accum_mu1_hi;
-                accum_mu2_lo = accum_mu2_hi = accum_mu1_lo = accum_mu1_hi =
-                    _mm256_setzero_si256();
-
-                __m256i s00, s22, s33, s44;
-
-                s00 = _mm256_loadu_si256((__m256i *)(tmplo + ind_x[0][j]));
-                s22 = _mm256_loadu_si256((__m256i *)(tmplo + ind_x[2][j]));
-                s33 = _mm256_loadu_si256((__m256i *)(tmplo + 16 + ind_x[0][j]));
-                s44 = _mm256_loadu_si256((__m256i *)(tmplo + 16 + ind_x[2][j]));
-
-                accum_mu2_lo =
-                    _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s00, fl0));
-                accum_mu2_hi =
-                    _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s33, fl0));
-                accum_mu2_lo =
-                    _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s22, fl1));
-                accum_mu2_hi =
-                    _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s44, fl1));
-
-                accum_mu2_lo = _mm256_add_epi32(accum_mu2_lo, add_shift_HP_vex);
-                accum_mu2_lo = _mm256_srli_epi32(accum_mu2_lo, 0x10);
-                accum_mu2_hi = _mm256_add_epi32(accum_mu2_hi, add_shift_HP_vex);
-                accum_mu2_hi = _mm256_srli_epi32(accum_mu2_hi, 0x10);
-
-                accum_mu2_hi = _mm256_packus_epi32(accum_mu2_lo, accum_mu2_hi);
-                accum_mu2_hi = _mm256_permute4x64_epi64(accum_mu2_hi, 0xD8);
-                _mm256_storeu_si256(
-                    (__m256i *)(dst->band_a + i * dst_stride + j),
-                    accum_mu2_hi);
-
-                accum_mu1_lo =
-                    _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s00, fh0));
-                accum_mu1_hi =
-                    _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s33, fh0));
-                accum_mu1_lo =
-                    _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s22, fh1));
-                accum_mu1_hi =
-                    _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s44, fh1));
-
-                accum_mu1_lo = _mm256_add_epi32(accum_mu1_lo, add_shift_HP_vex);
-                accum_mu1_lo = _mm256_srli_epi32(accum_mu1_lo, 0x10);
-                accum_mu1_hi = _mm256_add_epi32(accum_mu1_hi, add_shift_HP_vex);
-                accum_mu1_hi = _mm256_srli_epi32(accum_mu1_hi, 0x10);
-
-                accum_mu1_hi = _mm256_packus_epi32(accum_mu1_lo, accum_mu1_hi);
-                accum_mu1_hi = _mm256_permute4x64_epi64(accum_mu1_hi, 0xD8);
-                _mm256_storeu_si256(
-                    (__m256i *)(dst->band_v + i * dst_stride + j),
-                    accum_mu1_hi);
+                for (int jj = j0; jj < MIN(j0 + 8, right); ++jj) {
+                    decouple_s123_px(buf, row + jj, cos_1deg_sq,
+                                     adm_enhn_gain_limit);
+                }
             }
+        }
+    }
+}
 
-            {
-                __m256i accum_mu2_lo, accum_mu2_hi, accum_mu1_lo, accum_mu1_hi;
-                accum_mu2_lo = accum_mu2_hi = accum_mu1_lo = accum_mu1_hi =
-                    _mm256_setzero_si256();
-
-                __m256i s00, s22, s33, s44;
-
-                __m256i add_shift_HP_vex = _mm256_set1_epi32(32768);
-
-                s00 = _mm256_loadu_si256((__m256i *)(tmphi + ind_x[0][j]));
-                s22 = _mm256_loadu_si256((__m256i *)(tmphi + ind_x[2][j]));
-                s33 = _mm256_loadu_si256((__m256i *)(tmphi + 16 + ind_x[0][j]));
-                s44 = _mm256_loadu_si256((__m256i *)(tmphi + 16 + ind_x[2][j]));
-
-                accum_mu2_lo =
-                    _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s00, fl0));
-                accum_mu2_hi =
-                    _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s33, fl0));
-                accum_mu2_lo =
-                    _mm256_add_epi32(accum_mu2_lo, _mm256_madd_epi16(s22, fl1));
-                accum_mu2_hi =
-                    _mm256_add_epi32(accum_mu2_hi, _mm256_madd_epi16(s44, fl1));
-
-                accum_mu2_lo = _mm256_add_epi32(accum_mu2_lo, add_shift_HP_vex);
-                accum_mu2_lo = _mm256_srli_epi32(accum_mu2_lo, 0x10);
-                accum_mu2_hi = _mm256_add_epi32(accum_mu2_hi, add_shift_HP_vex);
-                accum_mu2_hi = _mm256_srli_epi32(accum_mu2_hi, 0x10);
-
-                accum_mu2_hi = _mm256_packus_epi32(accum_mu2_lo, accum_mu2_hi);
-                accum_mu2_hi = _mm256_permute4x64_epi64(accum_mu2_hi, 0xD8);
-                _mm256_storeu_si256(
-                    (__m256i *)(dst->band_h + i * dst_stride + j),
-                    accum_mu2_hi);
-
-                accum_mu1_lo =
-                    _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s00, fh0));
-                accum_mu1_hi =
-                    _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s33, fh0));
-                accum_mu1_lo =
-                    _mm256_add_epi32(accum_mu1_lo, _mm256_madd_epi16(s22, fh1));
-                accum_mu1_hi =
-                    _mm256_add_epi32(accum_mu1_hi, _mm256_madd_epi16(s44, fh1));
-
-                accum_mu1_lo = _mm256_add_epi32(accum_mu1_lo, add_shift_HP_vex);
-                accum_mu1_lo = _mm256_srli_epi32(accum_mu1_lo, 0x10);
-                accum_mu1_hi = _mm256_add_epi32(accum_mu1_hi, add_shift_HP_vex);
-                accum_mu1_hi = _mm256_srli_epi32(accum_mu1_hi, 0x10);
-
-                accum_mu1_hi = _mm256_packus_epi32(accum_mu1_lo, accum_mu1_hi);
-                accum_mu1_hi = _mm256_permute4x64_epi64(accum_mu1_hi, 0xD8);
-                _mm256_storeu_si256(
-                    (__m256i *)(dst->band_d + i * dst_stride + j),
-                    accum_mu1_hi);
+void adm_csf_avx2(AdmBuffer *buf, int theta, int w, int h, int stride,
+                  double adm_norm_view_dist, int adm_ref_display_height,
+                  int row0, int row1)
+{
+    const adm_dwt_band_t *src = &buf->decouple_a;
+    const adm_dwt_band_t *dst = &buf->csf_a;
+    const adm_dwt_band_t *flt = &buf->csf_f;
+
+    const int16_t *src_angles[3] = { src->band_h, src->band_v, src->band_d };
+    int16_t *dst_angles[3] = { dst->band_h, dst->band_v, dst->band_d };
+    int16_t *flt_angles[3] = { flt->band_h, flt->band_v, flt->band_d };
+
+    const float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 1, adm_norm_view_dist, adm_ref_display_height);
+    const float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 2, adm_norm_view_dist, adm_ref_display_height);
+    const float rfactor1[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    uint16_t i_rfactor[3];
+    if (fabs(adm_norm_view_dist * adm_ref_display_height - DEFAULT_ADM_NORM_VIEW_DIST * DEFAULT_ADM_REF_DISPLAY_HEIGHT) < 1.0e-8) {
+        i_rfactor[0] = 36453;
+        i_rfactor[1] = 36453;
+        i_rfactor[2] = 49417;
+    }
+    else {
+        const double pow2_21 = pow(2, 21);
+        const double pow2_23 = pow(2, 23);
+        i_rfactor[0] = (uint16_t) (rfactor1[0] * pow2_21);
+        i_rfactor[1] = (uint16_t) (rfactor1[1] * pow2_21);
+        i_rfactor[2] = (uint16_t) (rfactor1[2] * pow2_23);
+    }
+
+    const uint8_t i_shifts[3] = { 15, 15, 17 };
+    const uint16_t i_shiftsadd[3] = { 16384, 16384, 65535 };
+    const uint16_t FIX_ONE_BY_30 = 4369; //(1/30)*2^17
+
+    const __m256i rfactor = _mm256_set1_epi32(i_rfactor[theta]);
+    const __m256i shift_add = _mm256_set1_epi32(i_shiftsadd[theta]);
+    const __m128i shift = _mm_cvtsi32_si128(i_shifts[theta]);
+    const __m256i one_by_30 = _mm256_set1_epi32(FIX_ONE_BY_30);
+    const __m256i rnd = _mm256_set1_epi32(2048);
+
+    int left, top, right, bottom;
+    adm_decouple_range(w, h, &left, &top, &right, &bottom);
+
+    const int16_t *src_ptr = src_angles[theta];
+    int16_t *dst_ptr = dst_angles[theta];
+    int16_t *flt_ptr = flt_angles[theta];
+
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * stride;
+
+        int j = left;
+        if (right - left >= 8) {
+            for (;; j += 8) {
+                if (j + 8 > right) j = right - 8;
+                __m256i v = _mm256_mullo_epi32(load_epi16(src_ptr + row + j),
+                                               rfactor);
+                v = wrap_epi16(_mm256_sra_epi32(_mm256_add_epi32(v, shift_add),
+                                                shift));
+                const __m256i f = _mm256_srai_epi32(_mm256_add_epi32(
+                    _mm256_mullo_epi32(one_by_30, _mm256_abs_epi32(v)), rnd), 12);
+                _mm_storeu_si128((__m128i *)(dst_ptr + row + j), pack_epi16(v));
+                _mm_storeu_si128((__m128i *)(flt_ptr + row + j), pack_epi16(f));
+                if (j + 8 == right) break;
+            }
+            continue;
+        }
+        for (; j < right; ++j) {
+            int32_t dst_val = i_rfactor[theta] * (int32_t)src_ptr[row + j];
+            int16_t i16_dst_val = ((int16_t)((dst_val + i_shiftsadd[theta]) >> i_shifts[theta]));
+            dst_ptr[row + j] = i16_dst_val;
+            flt_ptr[row + j] = ((int16_t)(((FIX_ONE_BY_30 * abs((int32_t)i16_dst_val))
+                + 2048) >> 12));
+        }
+    }
+}
+
+void i4_adm_csf_avx2(AdmBuffer *buf, int theta, int scale, int w, int h,
+                     int stride, double adm_norm_view_dist,
+                     int adm_ref_display_height, int row0, int row1)
+{
+    const i4_adm_dwt_band_t *src = &buf->i4_decouple_a;
+    const i4_adm_dwt_band_t *dst = &buf->i4_csf_a;
+    const i4_adm_dwt_band_t *flt = &buf->i4_csf_f;
+
+    const int32_t *src_angles[3] = { src->band_h, src->band_v, src->band_d };
+    int32_t *dst_angles[3] = { dst->band_h, dst->band_v, dst->band_d };
+    int32_t *flt_angles[3] = { flt->band_h, flt->band_v, flt->band_d };
+
+    const float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 1, adm_norm_view_dist, adm_ref_display_height);
+    const float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 2, adm_norm_view_dist, adm_ref_display_height);
+    const float rfactor1[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    const double pow2_32 = pow(2, 32);
+    const uint32_t i_rfactor[3] = { (uint32_t)(rfactor1[0] * pow2_32),
+                                    (uint32_t)(rfactor1[1] * pow2_32),
+                                    (uint32_t)(rfactor1[2] * pow2_32) };
+
+    const uint32_t FIX_ONE_BY_30 = 143165577;
+    const uint32_t shift_dst[3] = { 28, 28, 28 };
+    const uint32_t shift_flt[3] = { 32, 32, 32 };
+    int32_t add_bef_shift_dst[3], add_bef_shift_flt[3];
+
+    for (unsigned idx = 0; idx < 3; ++idx) {
+        add_bef_shift_dst[idx] = (1u << (shift_dst[idx] - 1));
+        add_bef_shift_flt[idx] = (1u << (shift_flt[idx] - 1));
+    }
+
+    const __m256i rfactor = _mm256_set1_epi32((int32_t)i_rfactor[theta]);
+    const __m256i one_by_30 = _mm256_set1_epi32((int32_t)FIX_ONE_BY_30);
+    const __m256i add_dst = _mm256_set1_epi64x(add_bef_shift_dst[scale - 1]);
+    const __m256i add_flt = _mm256_set1_epi64x(add_bef_shift_flt[scale - 1]);
+    const __m128i sh_dst = _mm_cvtsi32_si128(shift_dst[scale - 1]);
+    const __m128i sh_flt = _mm_cvtsi32_si128(shift_flt[scale - 1]);
+
+    int left, top, right, bottom;
+    adm_decouple_range(w, h, &left, &top, &right, &bottom);
+
+    const int32_t *src_ptr = src_angles[theta];
+    int32_t *dst_ptr = dst_angles[theta];
+    int32_t *flt_ptr = flt_angles[theta];
+
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
+        const ptrdiff_t row = (ptrdiff_t)i * stride;
+
+        int j = left;
+        if (right - left >= 8) {
+            for (;; j += 8) {
+                if (j + 8 > right) j = right - 8;
+                const __m256i s = load_epi32(src_ptr + row + j);
+                const __m256i de = sra_epi64(_mm256_add_epi64(
+                    mul_epi32_epu32(s, rfactor), add_dst), sh_dst);
+                const __m256i dod = sra_epi64(_mm256_add_epi64(mul_epi32_epu32(
+                    _mm256_srli_epi64(s, 32), rfactor), add_dst), sh_dst);
+                const __m256i d = interleave_lo32(de, dod);
+
+                const __m256i ad = _mm256_abs_epi32(d);
+                const __m256i fe = sra_epi64(_mm256_add_epi64(
+                    _mm256_mul_epu32(ad, one_by_30), add_flt), sh_flt);
+                const __m256i fo = sra_epi64(_mm256_add_epi64(_mm256_mul_epu32(
+                    _mm256_srli_epi64(ad, 32), one_by_30), add_flt), sh_flt);
+
+                _mm256_storeu_si256((__m256i *)(dst_ptr + row + j), d);
+                _mm256_storeu_si256((__m256i *)(flt_ptr + row + j),
+                                    interleave_lo32(fe, fo));
+                if (j + 8 == right) break;
+            }
+            continue;
+        }
+        for (; j < right; ++j) {
+            int32_t dst_val = (int32_t)(((i_rfactor[theta] * (int64_t)src_ptr[row + j]) +
+                add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
+            dst_ptr[row + j] = dst_val;
+            flt_ptr[row + j] = (int32_t)((((int64_t)FIX_ONE_BY_30 * abs(dst_val)) +
+                add_bef_shift_flt[scale - 1]) >> shift_flt[scale - 1]);
+        }
+    }
+}
+
+void adm_csf_den_scale_avx2(const adm_dwt_band_t *src, int w, int h,
+                            int src_stride, int row0, int row1,
+                            uint64_t *accum)
+{
+    uint64_t accum_h = 0, accum_v = 0, accum_d = 0;
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    int32_t shift_accum = (int32_t)ceil(log2((bottom - top)*(right - left)) - 20);
+    shift_accum = shift_accum > 0 ? shift_accum : 0;
+    int32_t add_shift_accum =
+        shift_accum > 0 ? (1 << (shift_accum - 1)) : 0;
+
+    const int band_top = MAX(top, row0);
+    const int band_bottom = MIN(bottom, row1);
+
+    const int16_t *src_bands[3] = { src->band_h, src->band_v, src->band_d };
+    uint64_t *accum_bands[3] = { &accum_h, &accum_v, &accum_d };
+
+    for (int i = band_top; i < band_bottom; ++i) {
+        for (int k = 0; k < 3; k++) {
+            const int16_t *src_row = src_bands[k] + (ptrdiff_t)i * src_stride;
+            uint64_t accum_inner = 0;
+
+            int j = left;
+            if (right - left >= 8) {
+                __m256i acc = _mm256_setzero_si256();
+                for (; j + 8 <= right; j += 8) {
+                    const __m256i x = _mm256_abs_epi32(load_epi16(src_row + j));
+                    const __m256i x_sq = _mm256_mullo_epi32(x, x);
+                    acc = _mm256_add_epi64(acc, _mm256_mul_epu32(x_sq, x));
+                    acc = _mm256_add_epi64(acc, _mm256_mul_epu32(
+                        _mm256_srli_epi64(x_sq, 32), _mm256_srli_epi64(x, 32)));
+                }
+                if (j < right) {
+                    const __m256i x = _mm256_and_si256(
+                        lanes_from(right - 8, j),
+                        _mm256_abs_epi32(load_epi16(src_row + right - 8)));
+                    const __m256i x_sq = _mm256_mullo_epi32(x, x);
+                    acc = _mm256_add_epi64(acc, _mm256_mul_epu32(x_sq, x));
+                    acc = _mm256_add_epi64(acc, _mm256_mul_epu32(
+                        _mm256_srli_epi64(x_sq, 32), _mm256_srli_epi64(x, 32)));
+                    j = right;
+                }
+                accum_inner = hsum_epi64(acc);
+            }
+            for (; j < right; ++j) {
+                const uint16_t x = (uint16_t)abs(src_row[j]);
+                accum_inner += ((uint64_t)x * x) * x;
+            }
+            *accum_bands[k] += (accum_inner + add_shift_accum) >> shift_accum;
+        }
+    }
+
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+/* Cubes of the 32-bit coefficients as adm_csf_den_s123() rounds them. */
+static inline __m256i csf_den_s123_cube(__m256i x, __m256i add_sq,
+                                        __m128i shift_sq, __m256i add_cub,
+                                        __m128i shift_cub)
+{
+    const __m256i sq = _mm256_srl_epi64(
+        _mm256_add_epi64(_mm256_mul_epu32(x, x), add_sq), shift_sq);
+    const __m256i cub = _mm256_add_epi64(_mm256_mul_epu32(sq, x),
+        _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(sq, 32), x), 32));
+    return _mm256_srl_epi64(_mm256_add_epi64(cub, add_cub), shift_cub);
+}
+
+void adm_csf_den_s123_avx2(const i4_adm_dwt_band_t *src, int scale, int w,
+                           int h, int src_stride, int row0, int row1,
+                           uint64_t *accum)
+{
+    uint64_t accum_h = 0, accum_v = 0, accum_d = 0;
+    const uint32_t shift_sq[3] = { 31, 30, 31 };
+    const uint32_t add_shift_sq[3] =
+        { 1u << shift_sq[0], 1u << shift_sq[1], 1u << shift_sq[2] };
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    uint32_t shift_cub = (uint32_t)ceil(log2(right - left));
+    uint32_t add_shift_cub = (uint32_t)pow(2, (shift_cub - 1));
+    uint32_t shift_accum = (uint32_t)ceil(log2(bottom - top));
+    uint32_t add_shift_accum = (uint32_t)pow(2, (shift_accum - 1));
+
+    const __m256i add_sq = _mm256_set1_epi64x(add_shift_sq[scale - 1]);
+    const __m128i sh_sq = _mm_cvtsi32_si128(shift_sq[scale - 1]);
+    const __m256i add_cub = _mm256_set1_epi64x(add_shift_cub);
+    const __m128i sh_cub = _mm_cvtsi32_si128(shift_cub);
+
+    const int band_top = MAX(top, row0);
+    const int band_bottom = MIN(bottom, row1);
+
+    const int32_t *src_bands[3] = { src->band_h, src->band_v, src->band_d };
+    uint64_t *accum_bands[3] = { &accum_h, &accum_v, &accum_d };
+
+    for (int i = band_top; i < band_bottom; ++i) {
+        for (int k = 0; k < 3; k++) {
+            const int32_t *src_row = src_bands[k] + (ptrdiff_t)i * src_stride;
+            uint64_t accum_inner = 0;
+
+            int j = left;
+            if (right - left >= 8) {
+                __m256i acc = _mm256_setzero_si256();
+                for (; j < right; j += 8) {
+                    /* The last vector overlaps the one before, whose
+                     * columns are masked out of it. */
+                    const int j0 = MIN(j, right - 8);
+                    const __m256i x = _mm256_abs_epi32(load_epi32(src_row + j0));
+                    const __m256i keep = lanes_from(j0, j);
+                    const __m256i keep_e = _mm256_shuffle_epi32(keep, 0xA0);
+                    const __m256i keep_o = _mm256_shuffle_epi32(keep, 0xF5);
+                    acc = _mm256_add_epi64(acc, _mm256_and_si256(keep_e,
+                        csf_den_s123_cube(x, add_sq, sh_sq, add_cub, sh_cub)));
+                    acc = _mm256_add_epi64(acc, _mm256_and_si256(keep_o,
+                        csf_den_s123_cube(_mm256_srli_epi64(x, 32), add_sq,
+                                          sh_sq, add_cub, sh_cub)));
+                }
+                accum_inner = hsum_epi64(acc);
             }
+            for (; j < right; ++j) {
+                const uint32_t x = (uint32_t)abs(src_row[j]);
+                accum_inner += ((((((uint64_t)x * x) + add_shift_sq[scale - 1]) >>
+                    shift_sq[scale - 1]) * x) + add_shift_cub) >> shift_cub;
+            }
+            *accum_bands[k] += (accum_inner + add_shift_accum) >> shift_accum;
         }
     }
+
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+/* Rounding of one band of adm_cm() or i4_adm_cm(). */
+typedef struct CmRound {
+    int shift_sub;
+    int32_t add_sq, shift_sq;
+    uint32_t add_cub, shift_cub;
+} CmRound;
+
+static inline int64_t cm_round_px(int32_t x, int32_t thr, const CmRound *c)
+{
+    x = abs(x) - ((int32_t)(thr) << c->shift_sub);
+    x = x < 0 ? 0 : x;
+    const int32_t x_sq = (int32_t)((((int64_t)x * x) + c->add_sq) >> c->shift_sq);
+    return (((int64_t)x_sq * x) + c->add_cub) >> c->shift_cub;
+}
+
+/* Sum of cm_round_px() over the lanes of x kept, as four 64-bit lanes. Lanes
+ * zeroed before squaring round to zero, as add_sq is below 1 << shift_sq. */
+static inline __m256i cm_round_8(__m256i x, __m256i thr, __m256i keep,
+                                 const CmRound *c)
+{
+    const __m256i add_sq = _mm256_set1_epi64x(c->add_sq);
+    const __m128i sh_sq = _mm_cvtsi32_si128(c->shift_sq);
+    const __m256i add_cub = _mm256_set1_epi64x(c->add_cub);
+    const __m128i sh_cub = _mm_cvtsi32_si128(c->shift_cub);
+
+    x = _mm256_sub_epi32(_mm256_abs_epi32(x),
+        _mm256_sll_epi32(thr, _mm_cvtsi32_si128(c->shift_sub)));
+    x = _mm256_and_si256(keep, _mm256_max_epi32(x, _mm256_setzero_si256()));
+    const __m256i xo = _mm256_srli_epi64(x, 32);
+
+    const __m256i sq_e = _mm256_srl_epi64(
+        _mm256_add_epi64(_mm256_mul_epu32(x, x), add_sq), sh_sq);
+    const __m256i sq_o = _mm256_srl_epi64(
+        _mm256_add_epi64(_mm256_mul_epu32(xo, xo), add_sq), sh_sq);
+    const __m256i val_e = sra_epi64(
+        _mm256_add_epi64(_mm256_mul_epi32(sq_e, x), add_cub), sh_cub);
+    const __m256i val_o = sra_epi64(
+        _mm256_add_epi64(_mm256_mul_epi32(sq_o, xo), add_cub), sh_cub);
+    return _mm256_add_epi64(val_e, val_o);
+}
+
+/* Rows and columns of adm_cm() and i4_adm_cm(), which take the neighbours of
+ * pixels on the frame edge mirrored. */
+typedef struct CmRows {
+    int w, left, right, start_col, end_col;
+    uint32_t add_shift_inner_accum, shift_inner_accum;
+} CmRows;
+
+static void cm_rows(int w, int h, int row0, int row1, CmRows *c,
+                    int *start_row, int *end_row, bool *do_top,
+                    bool *do_bottom)
+{
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    c->w = w;
+    c->left = left;
+    c->right = right;
+    c->start_col = (left > 1) ? left : 1;
+    c->end_col = (right < (w - 1)) ? right : (w - 1);
+    c->shift_inner_accum = (uint32_t)ceil(log2(h));
+    c->add_shift_inner_accum = (uint32_t)pow(2, (c->shift_inner_accum - 1));
+
+    *start_row = MAX((top > 1) ? top : 1, row0);
+    *end_row = MIN((bottom < (h - 1)) ? bottom : (h - 1), row1);
+    *do_top = row0 == 0 && top <= 0;
+    *do_bottom = row1 == h && bottom > (h - 1);
+}
+
+typedef struct CmBands16 {
+    const int16_t *src[3];
+    const int16_t *angles[3], *flt_angles[3];
+    int src_stride, csf_a_stride;
+    int32_t rfactor[3];
+    CmRound round[3];
+} CmBands16;
+
+static inline int32_t cm_thr_px(const CmBands16 *b, int iu, int i, int id,
+                                int jl, int j, int jr)
+{
+    const ptrdiff_t s = b->csf_a_stride;
+    int32_t thr = 0;
+    for (int theta = 0; theta < 3; ++theta) {
+        const int16_t *up = b->flt_angles[theta] + iu * s;
+        const int16_t *mid = b->flt_angles[theta] + i * s;
+        const int16_t *dn = b->flt_angles[theta] + id * s;
+        const int16_t *src_ptr = b->angles[theta] + i * s;
+        int32_t sum = 0;
+        sum += up[jl];
+        sum += up[j];
+        sum += up[jr];
+        sum += mid[jl];
+        sum += (int16_t)(((ONE_BY_15 * abs((int32_t) src_ptr[j]))+ 2048)>>12);
+        sum += mid[jr];
+        sum += dn[jl];
+        sum += dn[j];
+        sum += dn[jr];
+        thr += sum;
+    }
+    return thr;
+}
+
+static inline __m256i cm_thr_8(const CmBands16 *b, int iu, int i, int id,
+                               int j)
+{
+    const ptrdiff_t s = b->csf_a_stride;
+    const __m256i one_by_15 = _mm256_set1_epi32(ONE_BY_15);
+    const __m256i rnd = _mm256_set1_epi32(2048);
+    __m256i thr = _mm256_setzero_si256();
+    for (int theta = 0; theta < 3; ++theta) {
+        const int16_t *up = b->flt_angles[theta] + iu * s + j;
+        const int16_t *mid = b->flt_angles[theta] + i * s + j;
+        const int16_t *dn = b->flt_angles[theta] + id * s + j;
+        const __m256i a = _mm256_abs_epi32(load_epi16(b->angles[theta] + i * s + j));
+        __m256i sum = wrap_epi16(_mm256_srai_epi32(_mm256_add_epi32(
+            _mm256_mullo_epi32(one_by_15, a), rnd), 12));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+            _mm256_add_epi32(load_epi16(up - 1), load_epi16(up)),
+            _mm256_add_epi32(load_epi16(up + 1), load_epi16(mid - 1))));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+            _mm256_add_epi32(load_epi16(mid + 1), load_epi16(dn - 1)),
+            _mm256_add_epi32(load_epi16(dn), load_epi16(dn + 1))));
+        thr = _mm256_add_epi32(thr, sum);
+    }
+    return thr;
+}
+
+static inline void cm_px(const CmBands16 *b, int iu, int i, int id, int jl,
+                         int j, int jr, int64_t *accum_inner)
+{
+    const int32_t thr = cm_thr_px(b, iu, i, id, jl, j, jr);
+    for (int k = 0; k < 3; k++) {
+        const int32_t x = b->src[k][i * b->src_stride + j] * b->rfactor[k];
+        accum_inner[k] += cm_round_px(x, thr, &b->round[k]);
+    }
+}
+
+/* Row i of adm_cm(), with rows iu and id above and below it. */
+static void cm_row(const CmBands16 *b, const CmRows *c, int iu, int i, int id,
+                   int64_t *accum)
+{
+    int64_t accum_inner[3] = { 0 };
+    const int w = c->w;
+
+    if (c->left <= 0) cm_px(b, iu, i, id, 1, 0, 1, accum_inner);
+
+    int j = c->start_col;
+    if (c->end_col - c->start_col >= 8) {
+        __m256i acc[3] = {
+            _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(),
+        };
+        for (; j < c->end_col; j += 8) {
+            /* The last vector overlaps the one before, whose columns are
+             * masked out of it. */
+            const int j0 = MIN(j, c->end_col - 8);
+            const __m256i keep = lanes_from(j0, j);
+            const __m256i thr = cm_thr_8(b, iu, i, id, j0);
+            for (int k = 0; k < 3; k++) {
+                const __m256i x = _mm256_mullo_epi32(
+                    load_epi16(b->src[k] + i * b->src_stride + j0),
+                    _mm256_set1_epi32(b->rfactor[k]));
+                acc[k] = _mm256_add_epi64(acc[k],
+                                          cm_round_8(x, thr, keep, &b->round[k]));
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            accum_inner[k] += hsum_epi64(acc[k]);
+    }
+    for (; j < c->end_col; ++j)
+        cm_px(b, iu, i, id, j - 1, j, j + 1, accum_inner);
+
+    if (c->right > (w - 1)) cm_px(b, iu, i, id, w - 2, w - 1, w - 1, accum_inner);
+
+    for (int k = 0; k < 3; k++) {
+        accum[k] += (accum_inner[k] + c->add_shift_inner_accum) >>
+                    c->shift_inner_accum;
+    }
+}
+
+void adm_cm_avx2(AdmBuffer *buf, int w, int h, int src_stride,
+                 int csf_a_stride, double adm_norm_view_dist,
+                 int adm_ref_display_height, int row0, int row1,
+                 int64_t *accum)
+{
+    const adm_dwt_band_t *src   = &buf->decouple_r;
+    const adm_dwt_band_t *csf_f = &buf->csf_f;
+    const adm_dwt_band_t *csf_a = &buf->csf_a;
+
+    const float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 1, adm_norm_view_dist, adm_ref_display_height);
+    const float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 2, adm_norm_view_dist, adm_ref_display_height);
+    const float rfactor1[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    uint16_t i_rfactor[3];
+    if (fabs(adm_norm_view_dist * adm_ref_display_height - DEFAULT_ADM_NORM_VIEW_DIST * DEFAULT_ADM_REF_DISPLAY_HEIGHT) < 1.0e-8) {
+        i_rfactor[0] = 36453;
+        i_rfactor[1] = 36453;
+        i_rfactor[2] = 49417;
+    }
+    else {
+        const double pow2_21 = pow(2, 21);
+        const double pow2_23 = pow(2, 23);
+        i_rfactor[0] = (uint16_t) (rfactor1[0] * pow2_21);
+        i_rfactor[1] = (uint16_t) (rfactor1[1] * pow2_21);
+        i_rfactor[2] = (uint16_t) (rfactor1[2] * pow2_23);
+    }
+
+    const uint32_t shift_xhcub = (uint32_t)ceil(log2(w) - 4);
+    const uint32_t shift_xdcub = (uint32_t)ceil(log2(w) - 3);
+
+    const CmBands16 b = {
+        .src = { src->band_h, src->band_v, src->band_d },
+        .angles = { csf_a->band_h, csf_a->band_v, csf_a->band_d },
+        .flt_angles = { csf_f->band_h, csf_f->band_v, csf_f->band_d },
+        .src_stride = src_stride,
+        .csf_a_stride = csf_a_stride,
+        .rfactor = { i_rfactor[0], i_rfactor[1], i_rfactor[2] },
+        .round = {
+            { 10, 268435456, 29, (uint32_t)pow(2, (shift_xhcub - 1)), shift_xhcub },
+            { 10, 268435456, 29, (uint32_t)pow(2, (shift_xhcub - 1)), shift_xhcub },
+            { 12, 536870912, 30, (uint32_t)pow(2, (shift_xdcub - 1)), shift_xdcub },
+        },
+    };
+
+    CmRows c;
+    int start_row, end_row;
+    bool do_top, do_bottom;
+    cm_rows(w, h, row0, row1, &c, &start_row, &end_row, &do_top, &do_bottom);
+
+    int64_t accum_band[3] = { 0 };
+    if (do_top) cm_row(&b, &c, 1, 0, 1, accum_band);
+    for (int i = start_row; i < end_row; ++i)
+        cm_row(&b, &c, i - 1, i, i + 1, accum_band);
+    if (do_bottom) cm_row(&b, &c, h - 2, h - 1, h - 1, accum_band);
+
+    accum[0] += accum_band[0];
+    accum[1] += accum_band[1];
+    accum[2] += accum_band[2];
+}
+
+typedef struct CmBands32 {
+    const int32_t *src[3];
+    const int32_t *angles[3], *flt_angles[3];
+    int src_stride, csf_a_stride;
+    uint32_t rfactor[3];
+    int32_t add_bef_shift_dst, add_bef_shift_flt;
+    uint32_t shift_dst, shift_flt;
+    CmRound round;
+} CmBands32;
+
+static inline int32_t i4_cm_thr_px(const CmBands32 *b, int iu, int i, int id,
+                                   int jl, int j, int jr)
+{
+    const ptrdiff_t s = b->csf_a_stride;
+    int32_t thr = 0;
+    for (int theta = 0; theta < 3; ++theta) {
+        const int32_t *up = b->flt_angles[theta] + iu * s;
+        const int32_t *mid = b->flt_angles[theta] + i * s;
+        const int32_t *dn = b->flt_angles[theta] + id * s;
+        const int32_t *src_ptr = b->angles[theta] + i * s;
+        int32_t sum = 0;
+        sum += up[jl];
+        sum += up[j];
+        sum += up[jr];
+        sum += mid[jl];
+        sum += (int32_t)((((int64_t)I4_ONE_BY_15 * abs(src_ptr[j])) +
+            b->add_bef_shift_flt) >> b->shift_flt);
+        sum += mid[jr];
+        sum += dn[jl];
+        sum += dn[j];
+        sum += dn[jr];
+        thr += sum;
+    }
+    return thr;
+}
+
+static inline __m256i i4_cm_thr_8(const CmBands32 *b, int iu, int i, int id,
+                                  int j)
+{
+    const ptrdiff_t s = b->csf_a_stride;
+    const __m256i one_by_15 = _mm256_set1_epi32(I4_ONE_BY_15);
+    const __m256i add_flt = _mm256_set1_epi64x(b->add_bef_shift_flt);
+    const __m128i sh_flt = _mm_cvtsi32_si128(b->shift_flt);
+    __m256i thr = _mm256_setzero_si256();
+    for (int theta = 0; theta < 3; ++theta) {
+        const int32_t *up = b->flt_angles[theta] + iu * s + j;
+        const int32_t *mid = b->flt_angles[theta] + i * s + j;
+        const int32_t *dn = b->flt_angles[theta] + id * s + j;
+        const __m256i a = _mm256_abs_epi32(load_epi32(b->angles[theta] + i * s + j));
+        const __m256i ce = sra_epi64(_mm256_add_epi64(
+            _mm256_mul_epu32(a, one_by_15), add_flt), sh_flt);
+        const __m256i co = sra_epi64(_mm256_add_epi64(_mm256_mul_epu32(
+            _mm256_srli_epi64(a, 32), one_by_15), add_flt), sh_flt);
+        __m256i sum = interleave_lo32(ce, co);
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+            _mm256_add_epi32(load_epi32(up - 1), load_epi32(up)),
+            _mm256_add_epi32(load_epi32(up + 1), load_epi32(mid - 1))));
+        sum = _mm256_add_epi32(sum, _mm256_add_epi32(
+            _mm256_add_epi32(load_epi32(mid + 1), load_epi32(dn - 1)),
+            _mm256_add_epi32(load_epi32(dn), load_epi32(dn + 1))));
+        thr = _mm256_add_epi32(thr, sum);
+    }
+    return thr;
+}
+
+static inline void i4_cm_px(const CmBands32 *b, int iu, int i, int id, int jl,
+                            int j, int jr, int64_t *accum_inner)
+{
+    const int32_t thr = i4_cm_thr_px(b, iu, i, id, jl, j, jr);
+    for (int k = 0; k < 3; k++) {
+        const int32_t x = (int32_t)((((int64_t)b->src[k][i * b->src_stride + j] *
+            b->rfactor[k]) + b->add_bef_shift_dst) >> b->shift_dst);
+        accum_inner[k] += cm_round_px(x, thr, &b->round);
+    }
+}
+
+/* Row i of i4_adm_cm(), with rows iu and id above and below it. */
+static void i4_cm_row(const CmBands32 *b, const CmRows *c, int iu, int i,
+                      int id, int64_t *accum)
+{
+    int64_t accum_inner[3] = { 0 };
+    const int w = c->w;
+
+    if (c->left <= 0) i4_cm_px(b, iu, i, id, 1, 0, 1, accum_inner);
+
+    int j = c->start_col;
+    if (c->end_col - c->start_col >= 8) {
+        const __m256i add_dst = _mm256_set1_epi64x(b->add_bef_shift_dst);
+        const __m128i sh_dst = _mm_cvtsi32_si128(b->shift_dst);
+        __m256i acc[3] = {
+            _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(),
+        };
+        for (; j < c->end_col; j += 8) {
+            const int j0 = MIN(j, c->end_col - 8);
+            const __m256i keep = lanes_from(j0, j);
+            const __m256i thr = i4_cm_thr_8(b, iu, i, id, j0);
+            for (int k = 0; k < 3; k++) {
+                const __m256i rf = _mm256_set1_epi32((int32_t)b->rfactor[k]);
+                const __m256i s = load_epi32(b->src[k] + i * b->src_stride + j0);
+                const __m256i xe = sra_epi64(_mm256_add_epi64(
+                    mul_epi32_epu32(s, rf), add_dst), sh_dst);
+                const __m256i xo = sra_epi64(_mm256_add_epi64(mul_epi32_epu32(
+                    _mm256_srli_epi64(s, 32), rf), add_dst), sh_dst);
+                acc[k] = _mm256_add_epi64(acc[k], cm_round_8(
+                    interleave_lo32(xe, xo), thr, keep, &b->round));
+            }
+        }
+        for (int k = 0; k < 3; k++)
+            accum_inner[k] += hsum_epi64(acc[k]);
+    }
+    for (; j < c->end_col; ++j)
+        i4_cm_px(b, iu, i, id, j - 1, j, j + 1, accum_inner);
+
+    if (c->right > (w - 1)) i4_cm_px(b, iu, i, id, w - 2, w - 1, w - 1, accum_inner);
+
+    for (int k = 0; k < 3; k++) {
+        accum[k] += (accum_inner[k] + c->add_shift_inner_accum) >>
+                    c->shift_inner_accum;
+    }
+}
+
+void i4_adm_cm_avx2(AdmBuffer *buf, int w, int h, int src_stride,
+                    int csf_a_stride, int scale, double adm_norm_view_dist,
+                    int adm_ref_display_height, int row0, int row1,
+                    int64_t *accum)
+{
+    const i4_adm_dwt_band_t *src = &buf->i4_decouple_r;
+    const i4_adm_dwt_band_t *csf_f = &buf->i4_csf_f;
+    const i4_adm_dwt_band_t *csf_a = &buf->i4_csf_a;
+
+    float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 1, adm_norm_view_dist, adm_ref_display_height);
+    float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 2, adm_norm_view_dist, adm_ref_display_height);
+    float rfactor1[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    const uint32_t shift_dst = 28, shift_flt = 32;
+    const uint32_t shift_cub = (uint32_t)ceil(log2(w));
+
+    const CmBands32 b = {
+        .src = { src->band_h, src->band_v, src->band_d },
+        .angles = { csf_a->band_h, csf_a->band_v, csf_a->band_d },
+        .flt_angles = { csf_f->band_h, csf_f->band_v, csf_f->band_d },
+        .src_stride = src_stride,
+        .csf_a_stride = csf_a_stride,
+        .rfactor = { (uint32_t)(rfactor1[0] * pow(2, 32)),
+                     (uint32_t)(rfactor1[1] * pow(2, 32)),
+                     (uint32_t)(rfactor1[2] * pow(2, 32)) },
+        .add_bef_shift_dst = (1u << (shift_dst - 1)),
+        .add_bef_shift_flt = (1u << (shift_flt - 1)),
+        .shift_dst = shift_dst,
+        .shift_flt = shift_flt,
+        .round = { 0, 536870912, 30, (uint32_t)pow(2, (shift_cub - 1)), shift_cub },
+    };
+
+    CmRows c;
+    int start_row, end_row;
+    bool do_top, do_bottom;
+    cm_rows(w, h, row0, row1, &c, &start_row, &end_row, &do_top, &do_bottom);
+
+    int64_t accum_band[3] = { 0 };
+    if (do_top) i4_cm_row(&b, &c, 1, 0, 1, accum_band);
+    for (int i = start_row; i < end_row; ++i)
+        i4_cm_row(&b, &c, i - 1, i, i + 1, accum_band);
+    if (do_bottom) i4_cm_row(&b, &c, h - 2, h - 1, h - 1, accum_band);
+
+    accum[0] += accum_band[0];
+    accum[1] += accum_band[1];
+    accum[2] += accum_band[2];
 }
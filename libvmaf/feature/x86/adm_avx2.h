@@ -19,10 +19,50 @@
 #ifndef X86_AVX2_ADM_H_
 #define X86_AVX2_ADM_H_
 
-#include "feature/integer_adm.h"
+#include "libvmaf/src/integer_adm.h"
 
 void adm_dwt2_8_avx2(const uint8_t *src, const adm_dwt_band_t *dst,
-                     AdmBuffer *buf, int w, int h, int src_stride,
-                     int dst_stride);
+                     AdmBuffer *buf, int w, int src_stride,
+                     int dst_stride, int row0, int row1);
+
+void adm_dwt2_16_avx2(const uint16_t *src, const adm_dwt_band_t *dst,
+                      AdmBuffer *buf, int w, int src_stride,
+                      int dst_stride, int inp_size_bits, int row0, int row1);
+
+void adm_dwt2_s123_avx2(const int32_t *src, const i4_adm_dwt_band_t *dst,
+                        AdmBuffer *buf, int w, int src_stride,
+                        int dst_stride, int scale, int row0, int row1);
+
+void adm_decouple_avx2(AdmBuffer *buf, int w, int h, int stride,
+                       double adm_enhn_gain_limit, int row0, int row1);
+
+void adm_decouple_s123_avx2(AdmBuffer *buf, int w, int h, int stride,
+                            double adm_enhn_gain_limit, int row0, int row1);
+
+void adm_csf_avx2(AdmBuffer *buf, int theta, int w, int h, int stride,
+                  double adm_norm_view_dist, int adm_ref_display_height,
+                  int row0, int row1);
+
+void i4_adm_csf_avx2(AdmBuffer *buf, int theta, int scale, int w, int h,
+                     int stride, double adm_norm_view_dist,
+                     int adm_ref_display_height, int row0, int row1);
+
+void adm_csf_den_scale_avx2(const adm_dwt_band_t *src, int w, int h,
+                            int src_stride, int row0, int row1,
+                            uint64_t *accum);
+
+void adm_csf_den_s123_avx2(const i4_adm_dwt_band_t *src, int scale, int w,
+                           int h, int src_stride, int row0, int row1,
+                           uint64_t *accum);
+
+void adm_cm_avx2(AdmBuffer *buf, int w, int h, int src_stride,
+                 int csf_a_stride, double adm_norm_view_dist,
+                 int adm_ref_display_height, int row0, int row1,
+                 int64_t *accum);
+
+void i4_adm_cm_avx2(AdmBuffer *buf, int w, int h, int src_stride,
+                    int csf_a_stride, int scale, double adm_norm_view_dist,
+                    int adm_ref_display_height, int row0, int row1,
+                    int64_t *accum);
 
 #endif /* X86_AVX2_ADM_H_ */
@@ -20,8 +20,8 @@
 #include <stdbool.h>
 #include <stddef.h>
 
-#include "feature/integer_motion.h"
-#include "feature/common/alignment.h"
+#include "libvmaf/src/integer_motion.h"
+#include "libvmaf/common/alignment.h"
 
 void x_convolution_16_avx2(const uint16_t *src, uint16_t *dst, unsigned width,
                            unsigned height, ptrdiff_t src_stride,
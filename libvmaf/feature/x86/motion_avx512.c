@@ -22,8 +22,8 @@
 #include <stddef.h>
 #include <string.h>
 
-#include "feature/integer_motion.h"
-#include "feature/common/alignment.h"
+#include "libvmaf/src/integer_motion.h"
+#include "libvmaf/common/alignment.h"
 
 #include <immintrin.h>
 
@@ -36,7 +36,6 @@ void x_convolution_16_avx512(const uint16_t *src, uint16_t *dst, unsigned width,
     const unsigned right_edge = vmaf_floorn(width - (filter_width - radius), 1);
     const unsigned shift_add_round = 32768;
     const unsigned vector_loop = (width>>5) -1;
-    uint16_t *tmpdst = dst;
     uint16_t *src_p = (uint16_t*) src + (left_edge - radius);
     unsigned nr = left_edge + 32 *vector_loop;
     uint16_t *src_pt = (uint16_t*) src + nr -radius;
@@ -0,0 +1,92 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <immintrin.h>
+
+#include "svm_avx2.h"
+
+/* Squared distances of x to eight support vectors at a time. Multiplies and
+ * adds are kept separate and in feature order, so that the distances match
+ * the scalar ones bit for bit. */
+static void sq_dist_1(const double *sv, unsigned sv_stride,
+                      unsigned n_features, const double *x, double *dist)
+{
+    for (unsigned i = 0; i < sv_stride; i += 8) {
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+        for (unsigned k = 0; k < n_features; k++) {
+            const double *row = sv + k * sv_stride + i;
+            const __m256d xk = _mm256_set1_pd(x[k]);
+            const __m256d d0 = _mm256_sub_pd(xk, _mm256_load_pd(row));
+            const __m256d d1 = _mm256_sub_pd(xk, _mm256_load_pd(row + 4));
+            sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(d0, d0));
+            sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(d1, d1));
+        }
+        _mm256_store_pd(dist + i, sum0);
+        _mm256_store_pd(dist + i + 4, sum1);
+    }
+}
+
+/* The same for four frames, each support vector loaded once for all four. */
+static void sq_dist_4(const double *sv, unsigned sv_stride,
+                      unsigned n_features, const double *x, double *dist)
+{
+    const double *x1 = x + n_features;
+    const double *x2 = x1 + n_features;
+    const double *x3 = x2 + n_features;
+
+    for (unsigned i = 0; i < sv_stride; i += 8) {
+        __m256d sum[4][2];
+        for (unsigned j = 0; j < 4; j++)
+            sum[j][0] = sum[j][1] = _mm256_setzero_pd();
+        for (unsigned k = 0; k < n_features; k++) {
+            const double *row = sv + k * sv_stride + i;
+            const __m256d r0 = _mm256_load_pd(row);
+            const __m256d r1 = _mm256_load_pd(row + 4);
+            const __m256d xk[4] = {
+                _mm256_set1_pd(x[k]), _mm256_set1_pd(x1[k]),
+                _mm256_set1_pd(x2[k]), _mm256_set1_pd(x3[k]),
+            };
+            for (unsigned j = 0; j < 4; j++) {
+                const __m256d d0 = _mm256_sub_pd(xk[j], r0);
+                const __m256d d1 = _mm256_sub_pd(xk[j], r1);
+                sum[j][0] = _mm256_add_pd(sum[j][0], _mm256_mul_pd(d0, d0));
+                sum[j][1] = _mm256_add_pd(sum[j][1], _mm256_mul_pd(d1, d1));
+            }
+        }
+        for (unsigned j = 0; j < 4; j++) {
+            _mm256_store_pd(dist + j * sv_stride + i, sum[j][0]);
+            _mm256_store_pd(dist + j * sv_stride + i + 4, sum[j][1]);
+        }
+    }
+}
+
+void svm_sq_dist_avx2(const double *sv, unsigned sv_stride,
+                      unsigned n_features, const double *x, unsigned n_x,
+                      double *dist)
+{
+    unsigned j = 0;
+    for (; j + 4 <= n_x; j += 4) {
+        sq_dist_4(sv, sv_stride, n_features, x + j * n_features,
+                  dist + j * sv_stride);
+    }
+    for (; j < n_x; j++) {
+        sq_dist_1(sv, sv_stride, n_features, x + j * n_features,
+                  dist + j * sv_stride);
+    }
+}
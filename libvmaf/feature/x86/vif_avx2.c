@@ -22,8 +22,8 @@
 #include <stdint.h>
 #include <string.h>
 #include <assert.h>
-#include "feature/integer_vif.h"
-#include "feature/common/macros.h"
+#include "libvmaf/src/integer_vif.h"
+#include "libvmaf/common/macros.h"
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
@@ -118,7 +118,7 @@ acc_right = _mm256_madd_epi16(_mm256_unpackhi_epi16(r0, zero), f); \
 }
 
 
-void vif_statistic_8_avx2(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h) {
+void vif_statistic_8_avx2(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h) {
     assert(vif_filter1d_width[0] == 17);
     static const unsigned fwidth = 17;
     const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
@@ -448,7 +448,9 @@ void vif_statistic_8_avx2(struct VifPublicState *s, float *num, float *den, unsi
                 _mm256_storeu_si256((__m256i*) & xy[8], acc1);
             }
 
-            for (unsigned int b = 0; b < 16; b++) {
+            // Lanes past the right edge hold padding, not picture columns.
+            const unsigned n_lanes = MIN(16, w - j);
+            for (unsigned int b = 0; b < n_lanes; b++) {
                 int32_t sigma1_sq = xx[b];
                 int32_t sigma2_sq = yy[b];
                 int32_t sigma12 = xy[b];
@@ -500,19 +502,20 @@ void vif_statistic_8_avx2(struct VifPublicState *s, float *num, float *den, unsi
     //den[0] = accum_den_log / 2048.0 + accum_den_non_log;
 
     //changed calculation to increase performance
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 
 }
 
-void vif_statistic_16_avx2(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale) {
+void vif_statistic_16_avx2(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale) {
     const unsigned fwidth = vif_filter1d_width[scale];
     const uint16_t *vif_filt = vif_filter1d_table[scale];
     VifBuffer buf = s->buf;
     const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
     int fwidth_half = fwidth >> 1;
 
-    int32_t add_shift_round_HP, shift_HP;
     int32_t add_shift_round_VP, shift_VP;
     int32_t add_shift_round_VP_sq, shift_VP_sq;
 
@@ -532,15 +535,11 @@ void vif_statistic_16_avx2(struct VifPublicState *s, float *num, float *den, uns
     ALIGNED(32) uint32_t xy[16];
 
     if (scale == 0) {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
         shift_VP = bpc;
         add_shift_round_VP = 1 << (bpc - 1);
         shift_VP_sq = (bpc - 8) * 2;
         add_shift_round_VP_sq = (bpc == 8) ? 0 : 1 << (shift_VP_sq - 1);
     } else {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
         shift_VP = 16;
         add_shift_round_VP = 32768;
         shift_VP_sq = 16;
@@ -1047,7 +1046,7 @@ void vif_statistic_16_avx2(struct VifPublicState *s, float *num, float *den, uns
 
         if ((n << 4) != w) {
             VifResiduals residuals =
-                vif_compute_line_residuals(s, n << 4, w, bpc, scale);
+                vif_compute_line_residuals(s, n << 4, w, scale);
             accum_num_log += residuals.accum_num_log;
             accum_den_log += residuals.accum_den_log;
             accum_num_non_log += residuals.accum_num_non_log;
@@ -1055,11 +1054,478 @@ void vif_statistic_16_avx2(struct VifPublicState *s, float *num, float *den, uns
         }
     }
 
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
-void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h) {
+// filter 8 samples of a row of 16-bit values held in 32 bits
+static FORCE_INLINE inline __m256i
+hfilter_mu(const uint32_t *src, const uint16_t *filt, unsigned fwidth)
+{
+    const unsigned half = fwidth / 2;
+    __m256i acc = _mm256_mullo_epi32(_mm256_loadu_si256((__m256i*)src),
+                                     _mm256_set1_epi32(filt[half]));
+    for (unsigned fj = 0; fj < half; ++fj) {
+        __m256i fq = _mm256_set1_epi32(filt[fj]);
+        __m256i m0 = _mm256_loadu_si256((__m256i*)(src - half + fj));
+        __m256i m1 = _mm256_loadu_si256((__m256i*)(src + half - fj));
+        acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(m0, fq));
+        acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(m1, fq));
+    }
+    return acc;
+}
+
+// filter 8 samples of a row of squares and round them back to 32 bits
+static FORCE_INLINE inline __m256i
+hfilter_sq(const uint32_t *src, const uint16_t *filt, unsigned fwidth)
+{
+    const unsigned half = fwidth / 2;
+    const __m256i rounder = _mm256_set1_epi64x(0x8000);
+    __m256i fq = _mm256_set1_epi64x(filt[half]);
+    __m256i m = _mm256_loadu_si256((__m256i*)src);
+    __m256i even = _mm256_add_epi64(rounder, _mm256_mul_epu32(m, fq));
+    __m256i odd = _mm256_add_epi64(rounder,
+        _mm256_mul_epu32(_mm256_srli_epi64(m, 32), fq));
+    for (unsigned fj = 0; fj < half; ++fj) {
+        fq = _mm256_set1_epi64x(filt[fj]);
+        __m256i m0 = _mm256_loadu_si256((__m256i*)(src - half + fj));
+        __m256i m1 = _mm256_loadu_si256((__m256i*)(src + half - fj));
+        even = _mm256_add_epi64(even, _mm256_mul_epu32(m0, fq));
+        even = _mm256_add_epi64(even, _mm256_mul_epu32(m1, fq));
+        odd = _mm256_add_epi64(odd,
+            _mm256_mul_epu32(_mm256_srli_epi64(m0, 32), fq));
+        odd = _mm256_add_epi64(odd,
+            _mm256_mul_epu32(_mm256_srli_epi64(m1, 32), fq));
+    }
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 16),
+                              _mm256_slli_epi64(odd, 16), 0xAA);
+}
+
+// (a * b + 2^31) >> 32 of 8 unsigned 32-bit samples
+static FORCE_INLINE inline __m256i mul_round_hi(__m256i a, __m256i b)
+{
+    const __m256i rounder = _mm256_set1_epi64x(0x80000000);
+    __m256i even = _mm256_add_epi64(_mm256_mul_epu32(a, b), rounder);
+    __m256i odd = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32),
+                                                    _mm256_srli_epi64(b, 32)),
+                                   rounder);
+    return _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+static void ref_stats_row_avx2(VifPublicState *s, VifRefStats ref_stats,
+                               unsigned i, unsigned w, int scale,
+                               VifResiduals *r)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    uint32_t *mu1 = ref_stats.mu1 + i * ref_stats.stride;
+    int32_t *sigma1_sq = ref_stats.sigma1_sq + i * ref_stats.stride;
+    ALIGNED(32) uint32_t mu1_tail[8];
+    ALIGNED(32) int32_t sigma1_sq_tail[8];
+
+    vif_pad_row(buf.tmp.mu1, w, fwidth / 2);
+    vif_pad_row(buf.tmp.ref, w, fwidth / 2);
+
+    for (unsigned j = 0; j < w; j += 8) {
+        __m256i mu = hfilter_mu(buf.tmp.mu1 + j, vif_filt, fwidth);
+        __m256i xx = _mm256_sub_epi32(hfilter_sq(buf.tmp.ref + j, vif_filt, fwidth),
+                                      mul_round_hi(mu, mu));
+
+        // Lanes past the right edge hold padding, and the next row follows.
+        const unsigned n_lanes = MIN(8, w - j);
+        if (n_lanes == 8) {
+            _mm256_storeu_si256((__m256i*)(mu1 + j), mu);
+            _mm256_storeu_si256((__m256i*)(sigma1_sq + j), xx);
+        }
+        else {
+            _mm256_store_si256((__m256i*)mu1_tail, mu);
+            _mm256_store_si256((__m256i*)sigma1_sq_tail, xx);
+            memcpy(mu1 + j, mu1_tail, n_lanes * sizeof(*mu1));
+            memcpy(sigma1_sq + j, sigma1_sq_tail, n_lanes * sizeof(*sigma1_sq));
+        }
+        for (unsigned b = 0; b < n_lanes; b++)
+            vif_accumulate_den(r, s->log2_table, sigma1_sq[j + b]);
+    }
+}
+
+// log2_64 of 4 integers held exactly in doubles, in [2^17, 2^52)
+static FORCE_INLINE inline __m256i log2_pd(const uint16_t *log2_table, __m256d x)
+{
+    // The top 16 bits of x are its leading one and 15 bits of the mantissa.
+    __m256i bits = _mm256_castpd_si256(x);
+    __m256i idx = _mm256_or_si256(
+        _mm256_and_si256(_mm256_srli_epi64(bits, 37), _mm256_set1_epi64x(0x7FFF)),
+        _mm256_set1_epi64x(0x8000));
+    __m256i k = _mm256_sub_epi64(_mm256_srli_epi64(bits, 52),
+                                 _mm256_set1_epi64x(1023 + 15));
+    // The table has an entry past 65535, so the 32-bit reads stay inside it.
+    __m128i log = _mm_and_si128(
+        _mm256_i64gather_epi32((const int *)log2_table, idx, 2),
+        _mm_set1_epi32(0xFFFF));
+    return _mm256_add_epi64(_mm256_cvtepi32_epi64(log), _mm256_slli_epi64(k, 11));
+}
+
+// vif_accumulate_num of 4 pixels, lane for lane, into 64-bit sums
+static FORCE_INLINE inline void
+accumulate_num_4(const uint16_t *log2_table, double vif_enhn_gain_limit,
+                 __m128i valid, __m128i sigma1_sq, __m128i sigma2_sq,
+                 __m128i sigma12, __m256i *num_log, __m256i *num_non_log)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m256d nsq = _mm256_set1_pd(vif_sigma_nsq);
+    __m128i big = _mm_cmpgt_epi32(sigma1_sq, _mm_set1_epi32(vif_sigma_nsq - 1));
+    __m128i small = _mm_andnot_si128(big, valid);
+    __m128i log_lanes = _mm_and_si128(_mm_and_si128(big, valid),
+        _mm_and_si128(_mm_cmpgt_epi32(sigma12, zero),
+                      _mm_cmpgt_epi32(sigma2_sq, zero)));
+
+    *num_non_log = _mm256_add_epi64(*num_non_log,
+        _mm256_cvtepi32_epi64(_mm_and_si128(small, sigma2_sq)));
+
+    // The same double arithmetic as the scalar code; lanes which take no log
+    // may divide by zero but are replaced before the logs.
+    __m256d s1 = _mm256_cvtepi32_pd(sigma1_sq);
+    __m256d s12 = _mm256_cvtepi32_pd(sigma12);
+    __m256d g = _mm256_div_pd(s12, _mm256_add_pd(s1, _mm256_set1_pd(65536 * 1.0e-10)));
+    __m128i sv_sq = _mm256_cvttpd_epi32(
+        _mm256_sub_pd(_mm256_cvtepi32_pd(sigma2_sq), _mm256_mul_pd(g, s12)));
+    sv_sq = _mm_max_epi32(sv_sq, zero);
+    g = _mm256_min_pd(g, _mm256_set1_pd(vif_enhn_gain_limit));
+
+    // g is at most the gain limit of 100, so g * g * sigma1_sq stays below
+    // 2^45 and every sum below is exact.
+    __m256d numer1 = _mm256_add_pd(_mm256_cvtepi32_pd(sv_sq), nsq);
+    __m256d numer1_tmp = _mm256_add_pd(
+        _mm256_round_pd(_mm256_mul_pd(_mm256_mul_pd(g, g), s1),
+                        _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC),
+        numer1);
+    __m256d mask = _mm256_castsi256_pd(_mm256_cvtepi32_epi64(log_lanes));
+    numer1 = _mm256_blendv_pd(nsq, numer1, mask);
+    numer1_tmp = _mm256_blendv_pd(nsq, numer1_tmp, mask);
+    *num_log = _mm256_add_epi64(*num_log,
+        _mm256_sub_epi64(log2_pd(log2_table, numer1_tmp),
+                         log2_pd(log2_table, numer1)));
+}
+
+static void dis_stats_row_avx2(VifPublicState *s, VifRefStats ref_stats,
+                               unsigned i, unsigned w, int scale,
+                               VifResiduals *r)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const uint32_t *mu1 = ref_stats.mu1 + i * ref_stats.stride;
+    const int32_t *sigma1_sq = ref_stats.sigma1_sq + i * ref_stats.stride;
+    ALIGNED(32) uint32_t mu1_tail[8] = { 0 };
+    ALIGNED(32) int32_t sigma1_sq_tail[8] = { 0 };
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    __m256i num_log = _mm256_setzero_si256();
+    __m256i num_non_log = _mm256_setzero_si256();
+
+    vif_pad_row(buf.tmp.mu2, w, fwidth / 2);
+    vif_pad_row(buf.tmp.dis, w, fwidth / 2);
+    vif_pad_row(buf.tmp.ref_dis, w, fwidth / 2);
+
+    for (unsigned j = 0; j < w; j += 8) {
+        // The statistics may end a mapped file, so never read past them.
+        const unsigned n_lanes = MIN(8, w - j);
+        __m256i mu;
+        if (n_lanes == 8) {
+            mu = _mm256_loadu_si256((__m256i*)(mu1 + j));
+        }
+        else {
+            memcpy(mu1_tail, mu1 + j, n_lanes * sizeof(*mu1));
+            mu = _mm256_load_si256((__m256i*)mu1_tail);
+        }
+
+        __m256i mu2 = hfilter_mu(buf.tmp.mu2 + j, vif_filt, fwidth);
+        __m256i sigma2_sq = _mm256_sub_epi32(
+            hfilter_sq(buf.tmp.dis + j, vif_filt, fwidth),
+            mul_round_hi(mu2, mu2));
+        __m256i sigma12 = _mm256_sub_epi32(
+            hfilter_sq(buf.tmp.ref_dis + j, vif_filt, fwidth),
+            mul_round_hi(mu, mu2));
+        sigma2_sq = _mm256_max_epi32(sigma2_sq, _mm256_setzero_si256());
+        __m256i xx;
+        if (n_lanes == 8) {
+            xx = _mm256_loadu_si256((__m256i*)(sigma1_sq + j));
+        }
+        else {
+            memcpy(sigma1_sq_tail, sigma1_sq + j, n_lanes * sizeof(*sigma1_sq));
+            xx = _mm256_load_si256((__m256i*)sigma1_sq_tail);
+        }
+        __m256i valid = _mm256_cmpgt_epi32(_mm256_set1_epi32(n_lanes), lane);
+
+        accumulate_num_4(s->log2_table, s->vif_enhn_gain_limit,
+                         _mm256_castsi256_si128(valid),
+                         _mm256_castsi256_si128(xx),
+                         _mm256_castsi256_si128(sigma2_sq),
+                         _mm256_castsi256_si128(sigma12),
+                         &num_log, &num_non_log);
+        accumulate_num_4(s->log2_table, s->vif_enhn_gain_limit,
+                         _mm256_extracti128_si256(valid, 1),
+                         _mm256_extracti128_si256(xx, 1),
+                         _mm256_extracti128_si256(sigma2_sq, 1),
+                         _mm256_extracti128_si256(sigma12, 1),
+                         &num_log, &num_non_log);
+    }
+
+    ALIGNED(32) int64_t sums[2][4];
+    _mm256_store_si256((__m256i*)sums[0], num_log);
+    _mm256_store_si256((__m256i*)sums[1], num_non_log);
+    r->accum_num_log += sums[0][0] + sums[0][1] + sums[0][2] + sums[0][3];
+    r->accum_num_non_log += sums[1][0] + sums[1][1] + sums[1][2] + sums[1][3];
+}
+
+void vif_statistic_ref_8_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h)
+{
+    static const unsigned fwidth = 17;
+    const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
+    VifBuffer buf = s->buf;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        // Filter vertically
+        for (unsigned jj = 0; jj < w; jj += 16) {
+            __m256i accum_ref_left, accum_ref_right;
+            __m256i accum_mu1_left, accum_mu1_right;
+
+            __m256i f0 = _mm256_set1_epi16(vif_filt_s0[fwidth / 2]);
+            __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * i) + jj)));
+
+            multiply2(accum_mu1_left, accum_mu1_right, r0, f0);
+            multiply3(accum_ref_left, accum_ref_right, r0, r0, f0);
+
+            for (unsigned int tap = 0; tap < fwidth / 2; tap++) {
+                int ii_check = i - fwidth / 2 + tap;
+                int ii_check_1 = i + fwidth / 2 - tap;
+
+                __m256i f0 = _mm256_set1_epi16(vif_filt_s0[tap]);
+                __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * ii_check) + jj)));
+                __m256i r1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * (ii_check_1)) + jj)));
+
+                multiply2_and_accumulate(accum_mu1_left, accum_mu1_right, r0, r1, f0);
+                multiply3_and_accumulate(accum_ref_left, accum_ref_right, r0, r0, f0);
+                multiply3_and_accumulate(accum_ref_left, accum_ref_right, r1, r1, f0);
+            }
+
+            __m256i x = _mm256_set1_epi32(128);
+            accum_mu1_left = _mm256_srli_epi32(_mm256_add_epi32(accum_mu1_left, x), 0x08);
+            accum_mu1_right = _mm256_srli_epi32(_mm256_add_epi32(accum_mu1_right, x), 0x08);
+
+            shuffle_and_save(buf.tmp.mu1 + jj, accum_mu1_left, accum_mu1_right);
+            shuffle_and_save(buf.tmp.ref + jj, accum_ref_left, accum_ref_right);
+        }
+
+        ref_stats_row_avx2(s, ref_stats, i, w, 0, &r);
+    }
+    *out = r;
+}
+
+void vif_statistic_dis_8_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h)
+{
+    static const unsigned fwidth = 17;
+    const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
+    VifBuffer buf = s->buf;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        // Filter vertically
+        for (unsigned jj = 0; jj < w; jj += 16) {
+            __m256i accum_dis_left, accum_dis_right;
+            __m256i accum_ref_dis_left, accum_ref_dis_right;
+            __m256i accum_mu2_left, accum_mu2_right;
+
+            __m256i f0 = _mm256_set1_epi16(vif_filt_s0[fwidth / 2]);
+            __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * i) + jj)));
+            __m256i d0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.dis) + (buf.stride * i) + jj)));
+
+            multiply2(accum_mu2_left, accum_mu2_right, d0, f0);
+            multiply3(accum_dis_left, accum_dis_right, d0, d0, f0);
+            multiply3(accum_ref_dis_left, accum_ref_dis_right, d0, r0, f0);
+
+            for (unsigned int tap = 0; tap < fwidth / 2; tap++) {
+                int ii_check = i - fwidth / 2 + tap;
+                int ii_check_1 = i + fwidth / 2 - tap;
+
+                __m256i f0 = _mm256_set1_epi16(vif_filt_s0[tap]);
+                __m256i r0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * ii_check) + jj)));
+                __m256i r1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * (ii_check_1)) + jj)));
+                __m256i d0 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.dis) + (buf.stride * ii_check) + jj)));
+                __m256i d1 = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.dis) + (buf.stride * (ii_check_1)) + jj)));
+
+                multiply2_and_accumulate(accum_mu2_left, accum_mu2_right, d0, d1, f0);
+                multiply3_and_accumulate(accum_dis_left, accum_dis_right, d0, d0, f0);
+                multiply3_and_accumulate(accum_dis_left, accum_dis_right, d1, d1, f0);
+                multiply3_and_accumulate(accum_ref_dis_left, accum_ref_dis_right, d0, r0, f0);
+                multiply3_and_accumulate(accum_ref_dis_left, accum_ref_dis_right, d1, r1, f0);
+            }
+
+            __m256i x = _mm256_set1_epi32(128);
+            accum_mu2_left = _mm256_srli_epi32(_mm256_add_epi32(accum_mu2_left, x), 0x08);
+            accum_mu2_right = _mm256_srli_epi32(_mm256_add_epi32(accum_mu2_right, x), 0x08);
+
+            shuffle_and_save(buf.tmp.mu2 + jj, accum_mu2_left, accum_mu2_right);
+            shuffle_and_save(buf.tmp.dis + jj, accum_dis_left, accum_dis_right);
+            shuffle_and_save(buf.tmp.ref_dis + jj, accum_ref_dis_left, accum_ref_dis_right);
+        }
+
+        dis_stats_row_avx2(s, ref_stats, i, w, 0, &r);
+    }
+    *out = r;
+}
+
+// multiply 16 samples by a filter tap into 32 bits (shuffled 0 1 2 3 8 9 10 11 / 4 5 6 7 12 13 14 15)
+static FORCE_INLINE inline void
+multiply_16(__m256i *mul_left, __m256i *mul_right, __m256i x, __m256i f)
+{
+    __m256i hi = _mm256_mulhi_epu16(x, f);
+    __m256i lo = _mm256_mullo_epi16(x, f);
+    *mul_left = _mm256_unpacklo_epi16(lo, hi);
+    *mul_right = _mm256_unpackhi_epi16(lo, hi);
+}
+
+// add the products of multiply_16 with 16 more samples in 64 bits (samples 0-3, 4-7, 8-11, 12-15)
+static FORCE_INLINE inline void
+multiply_and_accumulate_16(__m256i *accum, __m256i mul_left,
+                           __m256i mul_right, __m256i x)
+{
+    __m128i l0 = _mm256_castsi256_si128(x);
+    __m128i l1 = _mm256_extracti128_si256(x, 1);
+    accum[0] = _mm256_add_epi64(accum[0], _mm256_mul_epu32(
+        _mm256_cvtepu32_epi64(_mm256_castsi256_si128(mul_left)),
+        _mm256_cvtepu16_epi64(l0)));
+    accum[1] = _mm256_add_epi64(accum[1], _mm256_mul_epu32(
+        _mm256_cvtepu32_epi64(_mm256_castsi256_si128(mul_right)),
+        _mm256_cvtepu16_epi64(_mm_bsrli_si128(l0, 8))));
+    accum[2] = _mm256_add_epi64(accum[2], _mm256_mul_epu32(
+        _mm256_cvtepu32_epi64(_mm256_extracti128_si256(mul_left, 1)),
+        _mm256_cvtepu16_epi64(l1)));
+    accum[3] = _mm256_add_epi64(accum[3], _mm256_mul_epu32(
+        _mm256_cvtepu32_epi64(_mm256_extracti128_si256(mul_right, 1)),
+        _mm256_cvtepu16_epi64(_mm_bsrli_si128(l1, 8))));
+}
+
+// round and store 16 samples accumulated from multiply_16
+static FORCE_INLINE inline void
+round_and_save_16(uint32_t *dst, __m256i accum_left, __m256i accum_right,
+                  int32_t shift)
+{
+    const __m256i round = _mm256_set1_epi32(1 << (shift - 1));
+    accum_left = _mm256_srli_epi32(_mm256_add_epi32(accum_left, round), shift);
+    accum_right = _mm256_srli_epi32(_mm256_add_epi32(accum_right, round), shift);
+    shuffle_and_save(dst, accum_left, accum_right);
+}
+
+// round and store 16 samples accumulated from multiply_and_accumulate_16
+static FORCE_INLINE inline void
+round_and_save_sq_16(uint32_t *dst, const __m256i *accum, int32_t shift)
+{
+    const __m256i mask = _mm256_set_epi32(7, 5, 3, 1, 6, 4, 2, 0);
+    const __m256i round = _mm256_set1_epi64x(shift ? 1 << (shift - 1) : 0);
+    for (unsigned k = 0; k < 2; k++) {
+        __m256i a = _mm256_srli_epi64(_mm256_add_epi64(accum[2 * k], round), shift);
+        __m256i b = _mm256_srli_epi64(_mm256_add_epi64(accum[2 * k + 1], round), shift);
+        a = _mm256_blend_epi32(a, _mm256_slli_si256(b, 4), 0xAA);
+        _mm256_storeu_si256((__m256i*)(dst + 8 * k),
+                            _mm256_permutevar8x32_epi32(a, mask));
+    }
+}
+
+void vif_statistic_ref_16_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    const int32_t shift_VP = scale == 0 ? bpc : 16;
+    const int32_t shift_VP_sq = scale == 0 ? (bpc - 8) * 2 : 16;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        // VERTICAL
+        const int ii = i - fwidth / 2;
+        for (unsigned j = 0; j < w; j += 16) {
+            __m256i accum_mu1_left = _mm256_setzero_si256();
+            __m256i accum_mu1_right = _mm256_setzero_si256();
+            __m256i accum_ref[4] = {
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+            };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                __m256i f = _mm256_set1_epi16(vif_filt[fi]);
+                __m256i r0 = _mm256_loadu_si256((__m256i*)(ref + (ii + (int)fi) * stride + j));
+                __m256i rmul_left, rmul_right;
+                multiply_16(&rmul_left, &rmul_right, r0, f);
+                accum_mu1_left = _mm256_add_epi32(accum_mu1_left, rmul_left);
+                accum_mu1_right = _mm256_add_epi32(accum_mu1_right, rmul_right);
+                multiply_and_accumulate_16(accum_ref, rmul_left, rmul_right, r0);
+            }
+            round_and_save_16(buf.tmp.mu1 + j, accum_mu1_left, accum_mu1_right,
+                              shift_VP);
+            round_and_save_sq_16(buf.tmp.ref + j, accum_ref, shift_VP_sq);
+        }
+
+        ref_stats_row_avx2(s, ref_stats, i, w, scale, &r);
+    }
+    *out = r;
+}
+
+void vif_statistic_dis_16_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    const uint16_t *dis = buf.dis;
+    const int32_t shift_VP = scale == 0 ? bpc : 16;
+    const int32_t shift_VP_sq = scale == 0 ? (bpc - 8) * 2 : 16;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        // VERTICAL
+        const int ii = i - fwidth / 2;
+        for (unsigned j = 0; j < w; j += 16) {
+            __m256i accum_mu2_left = _mm256_setzero_si256();
+            __m256i accum_mu2_right = _mm256_setzero_si256();
+            __m256i accum_dis[4] = {
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+            };
+            __m256i accum_ref_dis[4] = {
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+                _mm256_setzero_si256(), _mm256_setzero_si256(),
+            };
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                __m256i f = _mm256_set1_epi16(vif_filt[fi]);
+                __m256i r0 = _mm256_loadu_si256((__m256i*)(ref + (ii + (int)fi) * stride + j));
+                __m256i d0 = _mm256_loadu_si256((__m256i*)(dis + (ii + (int)fi) * stride + j));
+                __m256i rmul_left, rmul_right, dmul_left, dmul_right;
+                multiply_16(&rmul_left, &rmul_right, r0, f);
+                multiply_16(&dmul_left, &dmul_right, d0, f);
+                accum_mu2_left = _mm256_add_epi32(accum_mu2_left, dmul_left);
+                accum_mu2_right = _mm256_add_epi32(accum_mu2_right, dmul_right);
+                multiply_and_accumulate_16(accum_dis, dmul_left, dmul_right, d0);
+                multiply_and_accumulate_16(accum_ref_dis, rmul_left, rmul_right, d0);
+            }
+            round_and_save_16(buf.tmp.mu2 + j, accum_mu2_left, accum_mu2_right,
+                              shift_VP);
+            round_and_save_sq_16(buf.tmp.dis + j, accum_dis, shift_VP_sq);
+            round_and_save_sq_16(buf.tmp.ref_dis + j, accum_ref_dis, shift_VP_sq);
+        }
+
+        dis_stats_row_avx2(s, ref_stats, i, w, scale, &r);
+    }
+    *out = r;
+}
+
+void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned y0,
+                             unsigned y1) {
     const unsigned fwidth = vif_filter1d_width[1];
     const uint16_t *vif_filt_s1 = vif_filter1d_table[1];
     const uint8_t *ref = (uint8_t *)buf.ref;
@@ -1076,7 +1542,7 @@ void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h) {
     __m256i fcoeff3 = _mm256_set1_epi16(vif_filt_s1[3]);
     __m256i fcoeff4 = _mm256_set1_epi16(vif_filt_s1[4]);
 
-    for (unsigned i = 0; i < h / 2; i ++) {
+    for (unsigned i = y0 / 2; i < y1 / 2; i ++) {
         // VERTICAL
         unsigned n = w >> 4;
         for (unsigned j = 0; j < n << 4; j = j + 16) {
@@ -1162,7 +1628,8 @@ void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h) {
             uint32_t accum_ref = 0;
             uint32_t accum_dis = 0;
             for (unsigned fi = 0; fi < fwidth; ++fi) {
-                int ii = i - fwidth_half;
+                // Row i of the output is filtered around source row 2 * i.
+                int ii = i * 2 - fwidth_half;
                 int ii_check = ii + fi;
                 const uint16_t fcoeff = vif_filt_s1[fi];
                 const uint8_t *ref = (uint8_t *)buf.ref;
@@ -1344,11 +1811,15 @@ void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h) {
             buf.mu2[i * stride + (j >> 1)] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
-    copy_and_pad(buf, w, h, 0);
 }
 
-void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned h, int scale,
-                             int bpc) {
+void vif_decimate_and_pad_8_avx2(VifBuffer buf, unsigned w, unsigned h,
+                                 int scale) {
+    copy_and_pad(buf, w, h, scale);
+}
+
+void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned y0,
+                              unsigned y1, int scale, int bpc) {
     const unsigned fwidth = vif_filter1d_width[scale + 1];
     const uint16_t *vif_filt = vif_filter1d_table[scale + 1];
     int32_t add_shift_round_VP, shift_VP;
@@ -1367,7 +1838,7 @@ void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned h, int scale,
         shift_VP = 16;
     }
 
-    for (unsigned i = 0; i < h / 2; i++) {
+    for (unsigned i = y0 / 2; i < y1 / 2; i++) {
         // VERTICAL
 
         unsigned n = w >> 4;
@@ -1509,9 +1980,14 @@ void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned h, int scale,
             buf.mu2[i * stride16 + j] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
+}
 
-    ref = buf.ref;
-    dis = buf.dis;
+void vif_decimate_and_pad_16_avx2(VifBuffer buf, unsigned w, unsigned h,
+                                  int scale) {
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const ptrdiff_t stride16 = buf.stride_16 / sizeof(uint16_t);
+    uint16_t *ref = buf.ref;
+    uint16_t *dis = buf.dis;
 
     for (unsigned i = 0; i < h / 2; ++i) {
         for (unsigned j = 0; j < w / 2; ++j) {
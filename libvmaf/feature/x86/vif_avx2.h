@@ -19,19 +19,34 @@
 #ifndef X86_AVX2_VIF_H_
 #define X86_AVX2_VIF_H_
 
-#include "feature/integer_vif.h"
+#include "libvmaf/src/integer_vif.h"
 
 void vif_filter1d_8_avx2(VifBuffer buf, unsigned w, unsigned h);
 
-void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h);
+void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned y0,
+                             unsigned y1);
 
-void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned h, int scale,
-                             int bpc);
+void vif_decimate_and_pad_8_avx2(VifBuffer buf, unsigned w, unsigned h,
+                                 int scale);
+
+void vif_subsample_rd_16_avx2(VifBuffer buf, unsigned w, unsigned y0,
+                              unsigned y1, int scale, int bpc);
+
+void vif_decimate_and_pad_16_avx2(VifBuffer buf, unsigned w, unsigned h,
+                                  int scale);
 
 void vif_filter1d_16_avx2(VifBuffer buf, unsigned w, unsigned h, int scale, int bpc);
 
-void vif_statistic_8_avx2(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h);
+void vif_statistic_8_avx2(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h);
+
+void vif_statistic_16_avx2(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+
+void vif_statistic_ref_8_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+
+void vif_statistic_dis_8_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+
+void vif_statistic_ref_16_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
 
-void vif_statistic_16_avx2(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale);
+void vif_statistic_dis_16_avx2(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
 
 #endif /* X86_AVX2_VIF_H_ */
@@ -23,48 +23,12 @@
 #include <string.h>
 #include <assert.h>
 #include "stdio.h"
-#include "feature/common/macros.h"
-#include "feature/integer_vif.h"
+#include "libvmaf/common/macros.h"
+#include "libvmaf/src/integer_vif.h"
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
-static inline void
-pad_top_and_bottom(VifBuffer buf, unsigned h, int fwidth)
-{
-    const unsigned fwidth_half = fwidth / 2;
-    unsigned char *ref = buf.ref;
-    unsigned char *dis = buf.dis;
-    for (unsigned i = 1; i <= fwidth_half; ++i) {
-        size_t offset = buf.stride * i;
-        memcpy(ref - offset, ref + offset, buf.stride);
-        memcpy(dis - offset, dis + offset, buf.stride);
-        memcpy(ref + buf.stride * (h - 1) + buf.stride * i,
-            ref + buf.stride * (h - 1) - buf.stride * i,
-            buf.stride);
-        memcpy(dis + buf.stride * (h - 1) + buf.stride * i,
-            dis + buf.stride * (h - 1) - buf.stride * i,
-            buf.stride);
-    }
-}
-
-static inline void
-decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
-{
-    uint16_t *ref = buf.ref;
-    uint16_t *dis = buf.dis;
-    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
-    const ptrdiff_t mu_stride = buf.stride_16 / sizeof(uint16_t);
-
-    for (unsigned i = 0; i < h / 2; ++i) {
-        for (unsigned j = 0; j < w / 2; ++j) {
-            ref[i * stride + j] = buf.mu1[(i * 2) * mu_stride + (j * 2)];
-            dis[i * stride + j] = buf.mu2[(i * 2) * mu_stride + (j * 2)];
-        }
-    }
-    pad_top_and_bottom(buf, h / 2, vif_filter1d_width[scale]);
-}
-
 typedef struct Residuals512 {
     __m512i maccum_num_log;
     __m512i maccum_den_log;
@@ -105,7 +69,6 @@ static inline void vif_statistic_avx512(Residuals512 *out, __m512i xx, __m512i x
         mden_val = _mm512_add_epi64(mden_val, _mm512_slli_epi64(mnorm, 11));
         mden_val = _mm512_sub_epi64(mden_val, _mm512_set1_epi64(2048 * 17));
         __mmask8 msigma1_mask = _mm512_cmpgt_epi64_mask(_mm512_set1_epi64(sigma_nsq), msigma1);
-        __mmask8 msigma2_mask = _mm512_cmpgt_epi64_mask(msigma2, _mm512_setzero_si512());
         //msigma12 = _mm512_and_si512_(msigma2_mask, msigma12);
         //maccum_x = _mm512_add_epi64(maccum_x, _mm512_andnot_si512(msigma1_mask, _mm512_add_epi64(mx, _mm512_set1_epi64(17))));
         __m512d msigma1_d = _mm512_cvtepu64_pd(msigma1);
@@ -142,12 +105,10 @@ static inline void vif_statistic_avx512(Residuals512 *out, __m512i xx, __m512i x
     out->maccum_den_non_log = maccum_den_non_log;
 }
 
-void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h) {
+void vif_statistic_8_avx512(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h) {
     const unsigned fwidth = vif_filter1d_width[0];
     const uint16_t *vif_filt = vif_filter1d_table[0];
     VifBuffer buf = s->buf;
-    const uint8_t *ref = (uint8_t*)buf.ref;
-    const uint8_t *dis = (uint8_t*)buf.dis;
     const unsigned fwidth_half = fwidth >> 1;
     const uint16_t *log2_table = s->log2_table;
     double vif_enhn_gain_limit = s->vif_enhn_gain_limit;
@@ -161,7 +122,6 @@ void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, un
 #endif
 
     //float equivalent of 2. (2 * 65536)
-    static const int32_t sigma_nsq = 65536 << 1;
 
     int64_t accum_num_log = 0;
     int64_t accum_den_log = 0;
@@ -179,11 +139,8 @@ void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, un
     for (unsigned i = 0; i < h; ++i)
     {
         //VERTICAL
-        int ii = i - fwidth_half;
         // Filter vertically
         for (unsigned jj = 0; jj < w; jj += 16) {
-            const uint8_t *ref = (uint8_t*)buf.ref;
-            const uint8_t *dis = (uint8_t*)buf.dis;
 
             __m512i f0 = _mm512_set1_epi32(vif_filt[fwidth / 2]);
             __m512i r0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * i) + jj)));
@@ -197,11 +154,8 @@ void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, un
             __m512i accum_ref_dis = _mm512_mullo_epi32(f0, _mm512_mullo_epi32(r0, d0));
 
             for (unsigned int tap = 0; tap < fwidth / 2; tap++) {
-                int ii = i - fwidth / 2;
                 int ii_check = i - fwidth / 2 + tap;
                 int ii_check_1 = i + fwidth / 2 - tap;
-                const uint8_t *ref = (uint8_t*)buf.ref;
-                const uint8_t *dis = (uint8_t*)buf.dis;
 
                 __m512i f0 = _mm512_set1_epi32(vif_filt[tap]);
                 __m512i r0 = _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i*)(((uint8_t*)buf.ref) + (buf.stride * ii_check) + jj)));
@@ -229,7 +183,6 @@ void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, un
         PADDING_SQ_DATA(buf, w, fwidth_half);
 
         //HORIZONTAL
-        const ptrdiff_t dst_stride = buf.stride_32 / sizeof(uint32_t);
         for (unsigned j = 0; j < w; j += 16) {
             __m512i mu1sq;
             __m512i mu2sq;
@@ -348,19 +301,19 @@ void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, un
     accum_den_log = _mm512_reduce_add_epi64(residuals.maccum_den_log);
     accum_num_non_log = _mm512_reduce_add_epi64(residuals.maccum_num_non_log);
     accum_den_non_log = _mm512_reduce_add_epi64(residuals.maccum_den_non_log);
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
-void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale) {
+void vif_statistic_16_avx512(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale) {
     const unsigned fwidth = vif_filter1d_width[scale];
     const uint16_t *vif_filt = vif_filter1d_table[scale];
     VifBuffer buf = s->buf;
-    const ptrdiff_t dst_stride = buf.stride_32 / sizeof(uint32_t);
     const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
     int fwidth_half = fwidth >> 1;
 
-    int32_t add_shift_round_HP, shift_HP;
     int32_t add_shift_round_VP, shift_VP;
     int32_t add_shift_round_VP_sq, shift_VP_sq;
     const uint16_t *log2_table = s->log2_table;
@@ -368,7 +321,6 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
     __m512i mask2 = _mm512_set_epi32(30, 28, 26, 24, 22, 20, 18, 16, 14, 12, 10, 8, 6, 4, 2, 0);
 
     //float equivalent of 2. (2 * 65536)
-    static const int32_t sigma_nsq = 65536 << 1;
 
     Residuals512 residuals;
     residuals.maccum_den_log = _mm512_setzero_si512();
@@ -383,8 +335,6 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
 
     if (scale == 0)
     {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
         shift_VP = bpc;
         add_shift_round_VP = 1 << (bpc - 1);
         shift_VP_sq = (bpc - 8) * 2;
@@ -392,8 +342,6 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
     }
     else
     {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
         shift_VP = 16;
         add_shift_round_VP = 32768;
         shift_VP_sq = 16;
@@ -408,7 +356,7 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
     {
         //VERTICAL
         int ii = i - fwidth_half;
-        int n = w >> 5;
+        unsigned n = w >> 5;
         for (unsigned j = 0; j < n << 5; j = j + 32)
         {
 
@@ -425,7 +373,6 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
             for (unsigned fi = 0; fi < fwidth; ++fi, ii_check = ii + fi)
             {
 
-                const uint16_t fcoeff = vif_filt[fi];
                 __m512i f1 = _mm512_set1_epi16(vif_filt[fi]);
                 __m512i ref1 = _mm512_loadu_si512(
                     (__m512i*)(ref + (ii_check * stride) + j));
@@ -700,7 +647,7 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
 
         if ((n << 4) != w) {
             VifResiduals residuals =
-                vif_compute_line_residuals(s, n << 4, w, bpc, scale);
+                vif_compute_line_residuals(s, n << 4, w, scale);
             accum_num_log += residuals.accum_num_log;
             accum_den_log += residuals.accum_den_log;
             accum_num_non_log += residuals.accum_num_non_log;
@@ -729,15 +676,17 @@ void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, u
     //den[0] = accum_den_log / 2048.0 + accum_den_non_log;
 
     //changed calculation to increase performance
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
-void vif_subsample_rd_8_avx512(VifBuffer buf, unsigned w, unsigned h)
+void vif_subsample_rd_8_avx512(VifBuffer buf, unsigned w, unsigned y0,
+                               unsigned y1)
 {
     const unsigned fwidth = vif_filter1d_width[1];
     const uint16_t *vif_filt_s1 = vif_filter1d_table[1];
-    int fwidth_x = (fwidth % 2 == 0) ? fwidth : fwidth + 1;
     const uint8_t *ref = (uint8_t *)(buf.ref);
     const uint8_t *dis = (uint8_t *)buf.dis;
     const ptrdiff_t stride = buf.stride_16 / sizeof(uint16_t);
@@ -770,10 +719,10 @@ void vif_subsample_rd_8_avx512(VifBuffer buf, unsigned w, unsigned h)
     __m512i fcoeff3 = _mm512_broadcastw_epi16(_mm_loadu_si128((__m128i *)(vif_filt_s1 + 3)));
     __m512i fcoeff4 = _mm512_broadcastw_epi16(_mm_loadu_si128((__m128i *)(vif_filt_s1 + 4)));
 
-    for (unsigned i = 0; i < h; ++i)
+    for (unsigned i = y0; i < y1; ++i)
     {
         //VERTICAL
-        int n = w >> 5;
+        unsigned n = w >> 5;
         int ii = i - fwidth_half;
         for (unsigned j = 0; j < n << 5; j = j + 32)
         {
@@ -1077,11 +1026,10 @@ void vif_subsample_rd_8_avx512(VifBuffer buf, unsigned w, unsigned h)
             buf.mu2[i * stride + j] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
-    decimate_and_pad(buf, w, h, 0);
 }
 
-void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale,
-                               int bpc)
+void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned y0,
+                                unsigned y1, int scale, int bpc)
 {
     const unsigned fwidth = vif_filter1d_width[scale + 1];
     const uint16_t *vif_filt = vif_filter1d_table[scale + 1];
@@ -1103,11 +1051,11 @@ void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale
         shift_VP = 16;
     }
 
-    for (unsigned i = 0; i < h; ++i)
+    for (unsigned i = y0; i < y1; ++i)
     {
         //VERTICAL
 
-        int n = w >> 4;
+        unsigned n = w >> 4;
         int ii = i - fwidth_half;
         for (unsigned j = 0; j < n << 4; j = j + 32)
         {
@@ -1119,7 +1067,6 @@ void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale
             for (unsigned fi = 0; fi < fwidth; ++fi, ii_check = ii + fi)
             {
 
-                const uint16_t fcoeff = vif_filt[fi];
                 __m512i f1 = _mm512_set1_epi16(vif_filt[fi]);
                 __m512i ref1 = _mm512_loadu_si512((__m512i *)(ref + (ii_check * stride) + j));
                 __m512i dis1 = _mm512_loadu_si512((__m512i *)(dis + (ii_check * stride) + j));
@@ -1184,8 +1131,6 @@ void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale
             int jj_check = jj;
             __m512i accumrlo, accumdlo, accumrhi, accumdhi;
             accumrlo = accumdlo = accumrhi = accumdhi = _mm512_setzero_si512();
-            const uint16_t *ref = (uint16_t *)buf.tmp.ref_convol;
-            const uint16_t *dis = (uint16_t *)buf.dis;
             for (unsigned fj = 0; fj < fwidth; ++fj, jj_check = jj + fj)
             {
 
@@ -1243,5 +1188,4 @@ void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale
             buf.mu2[i * stride16 + j] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
-    decimate_and_pad(buf, w, h, scale);
 }
@@ -19,15 +19,16 @@
 #ifndef X86_AVX512_VIF_H_
 #define X86_AVX512_VIF_H_
 
-#include "feature/integer_vif.h"
+#include "libvmaf/src/integer_vif.h"
 
-void vif_subsample_rd_8_avx2(VifBuffer buf, unsigned w, unsigned h);
+void vif_subsample_rd_8_avx512(VifBuffer buf, unsigned w, unsigned y0,
+                               unsigned y1);
 
-void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned h, int scale,
-                             int bpc);
+void vif_subsample_rd_16_avx512(VifBuffer buf, unsigned w, unsigned y0,
+                                unsigned y1, int scale, int bpc);
 
-void vif_statistic_8_avx512(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h);
+void vif_statistic_8_avx512(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h);
 
-void vif_statistic_16_avx512(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale);
+void vif_statistic_16_avx512(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
 
 #endif /* X86_AVX512_VIF_H_ */
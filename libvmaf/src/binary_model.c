@@ -0,0 +1,547 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "binary_model.h"
+#include "dict.h"
+#include "model.h"
+#include "svm.h"
+
+#define MAGIC_SIZE 8
+
+typedef struct {
+    const uint8_t *p, *end;
+} Reader;
+
+static size_t remaining(const Reader *r)
+{
+    return r->end - r->p;
+}
+
+static int read_u32(Reader *r, uint32_t *v)
+{
+    if (remaining(r) < 4) return -EINVAL;
+    const uint8_t *p = r->p;
+    *v = p[0] | (p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+    r->p += 4;
+    return 0;
+}
+
+static int read_f64(Reader *r, double *v)
+{
+    uint32_t lo, hi;
+    int err = read_u32(r, &lo);
+    if (err) return err;
+    err = read_u32(r, &hi);
+    if (err) return err;
+    const uint64_t u = ((uint64_t) hi << 32) | lo;
+    memcpy(v, &u, sizeof(*v));
+    return 0;
+}
+
+static int read_str(Reader *r, char **str)
+{
+    uint32_t len;
+    int err = read_u32(r, &len);
+    if (err) return err;
+    if (remaining(r) < len) return -EINVAL;
+    *str = malloc(len + 1);
+    if (!*str) return -ENOMEM;
+    memcpy(*str, r->p, len);
+    (*str)[len] = '\0';
+    r->p += len;
+    return 0;
+}
+
+static int read_feature(Reader *r, VmafModelFeature *feature)
+{
+    int err = read_str(r, &feature->name);
+    if (err) return err;
+
+    uint32_t n_opts;
+    err = read_u32(r, &n_opts);
+    if (err) return err;
+    for (unsigned i = 0; i < n_opts; i++) {
+        char *key = NULL, *val = NULL;
+        err = read_str(r, &key);
+        if (!err) err = read_str(r, &val);
+        // Values were normalized when the model was first read.
+        if (!err) err = vmaf_dictionary_set(&feature->opts_dict, key, val, 0);
+        free(key);
+        free(val);
+        if (err) return err;
+    }
+
+    err = read_f64(r, &feature->slope);
+    if (err) return err;
+    return read_f64(r, &feature->intercept);
+}
+
+static int read_svm(Reader *r, struct svm_model **svm, uint32_t svm_type,
+                    double gamma, double rho, unsigned n_sv,
+                    unsigned n_features)
+{
+    struct svm_model *const s = *svm = calloc(1, sizeof(*s));
+    if (!s) return -ENOMEM;
+    s->param.svm_type = svm_type;
+    s->param.kernel_type = RBF;
+    s->param.gamma = gamma;
+    s->nr_class = 2;
+    s->l = n_sv;
+
+    s->rho = malloc(sizeof(*s->rho));
+    if (!s->rho) return -ENOMEM;
+    s->rho[0] = rho;
+    s->sv_coef = calloc(1, sizeof(*s->sv_coef));
+    if (!s->sv_coef) return -ENOMEM;
+    s->sv_coef[0] = malloc(sizeof(**s->sv_coef) * n_sv);
+    if (!s->sv_coef[0]) return -ENOMEM;
+    s->SV = calloc(n_sv, sizeof(*s->SV));
+    if (!s->SV) return -ENOMEM;
+
+    // All support vectors share one allocation, as svm_free_model_content()
+    // expects, and list every feature so that no value is implied.
+    const unsigned sv_len = n_features + 1;
+    struct svm_node *x_space = malloc(sizeof(*x_space) * n_sv * sv_len);
+    if (!x_space) return -ENOMEM;
+    for (unsigned i = 0; i < n_sv; i++) {
+        s->SV[i] = x_space + i * sv_len;
+        s->SV[i][n_features].index = -1;
+        s->SV[i][n_features].value = 0.;
+    }
+    s->free_sv = 1;
+
+    for (unsigned i = 0; i < n_sv; i++) {
+        int err = read_f64(r, &s->sv_coef[0][i]);
+        if (err) return err;
+    }
+    for (unsigned k = 0; k < n_features; k++) {
+        for (unsigned i = 0; i < n_sv; i++) {
+            s->SV[i][k].index = k + 1;
+            int err = read_f64(r, &s->SV[i][k].value);
+            if (err) return err;
+        }
+    }
+
+    return 0;
+}
+
+static int read_model(Reader *r, VmafModel **model, VmafModelConfig *cfg)
+{
+    uint32_t type, norm_type, flags, svm_type, n_features, n_knots, n_sv,
+             reserved;
+    int err = 0;
+    err |= read_u32(r, &type);
+    err |= read_u32(r, &norm_type);
+    err |= read_u32(r, &flags);
+    err |= read_u32(r, &svm_type);
+    err |= read_u32(r, &n_features);
+    err |= read_u32(r, &n_knots);
+    err |= read_u32(r, &n_sv);
+    err |= read_u32(r, &reserved);
+    if (err) return -EINVAL;
+
+    if (type > VMAF_MODEL_RESIDUE_BOOTSTRAP_SVM_NUSVR) return -EINVAL;
+    if (norm_type > VMAF_MODEL_NORMALIZATION_TYPE_LINEAR_RESCALE)
+        return -EINVAL;
+    if (svm_type != EPSILON_SVR && svm_type != NU_SVR) return -EINVAL;
+    if (!n_sv) return -EINVAL;
+    // Reject counts the data can't hold before allocating for them.
+    if (n_knots > remaining(r) / 16) return -EINVAL;
+    if (n_features > remaining(r) / 24) return -EINVAL;
+    if (n_sv > remaining(r) / 8 / (n_features + 1)) return -EINVAL;
+
+    VmafModel *const m = *model = calloc(1, sizeof(*m));
+    if (!m) return -ENOMEM;
+    m->id = vmaf_model_generate_id();
+    m->type = type;
+    m->norm_type = norm_type;
+
+    m->name = vmaf_model_generate_name(cfg);
+    if (!m->name) return -ENOMEM;
+    m->feature = calloc(n_features ? n_features : 1, sizeof(*m->feature));
+    if (!m->feature) return -ENOMEM;
+    m->score_transform.knots.list =
+        calloc(n_knots ? n_knots : 1, sizeof(*m->score_transform.knots.list));
+    if (!m->score_transform.knots.list) return -ENOMEM;
+
+    double clip_min, clip_max, p0, p1, p2, gamma, rho;
+    err |= read_f64(r, &m->slope);
+    err |= read_f64(r, &m->intercept);
+    err |= read_f64(r, &clip_min);
+    err |= read_f64(r, &clip_max);
+    err |= read_f64(r, &p0);
+    err |= read_f64(r, &p1);
+    err |= read_f64(r, &p2);
+    err |= read_f64(r, &gamma);
+    err |= read_f64(r, &rho);
+    for (unsigned i = 0; i < n_knots; i++) {
+        err |= read_f64(r, &m->score_transform.knots.list[i].x);
+        err |= read_f64(r, &m->score_transform.knots.list[i].y);
+    }
+    if (err) return -EINVAL;
+
+    if ((flags & VMAF_BINARY_MODEL_SCORE_CLIP) &&
+        !(cfg->flags & VMAF_MODEL_FLAG_DISABLE_CLIP))
+    {
+        m->score_clip.enabled = true;
+        m->score_clip.min = clip_min;
+        m->score_clip.max = clip_max;
+    }
+
+    m->score_transform.enabled =
+        (flags & VMAF_BINARY_MODEL_TRANSFORM_ENABLED) ||
+        ((flags & VMAF_BINARY_MODEL_TRANSFORM) &&
+         (cfg->flags & VMAF_MODEL_FLAG_ENABLE_TRANSFORM));
+    m->score_transform.p0.enabled = flags & VMAF_BINARY_MODEL_TRANSFORM_P0;
+    m->score_transform.p0.value = p0;
+    m->score_transform.p1.enabled = flags & VMAF_BINARY_MODEL_TRANSFORM_P1;
+    m->score_transform.p1.value = p1;
+    m->score_transform.p2.enabled = flags & VMAF_BINARY_MODEL_TRANSFORM_P2;
+    m->score_transform.p2.value = p2;
+    m->score_transform.knots.enabled =
+        flags & VMAF_BINARY_MODEL_TRANSFORM_KNOTS;
+    m->score_transform.knots.n_knots = n_knots;
+    m->score_transform.out_lte_in =
+        flags & VMAF_BINARY_MODEL_TRANSFORM_OUT_LTE_IN;
+    m->score_transform.out_gte_in =
+        flags & VMAF_BINARY_MODEL_TRANSFORM_OUT_GTE_IN;
+
+    for (unsigned i = 0; i < n_features; i++) {
+        m->n_features++;
+        err = read_feature(r, &m->feature[i]);
+        if (err) return err;
+    }
+
+    return read_svm(r, &m->svm, svm_type, gamma, rho, n_sv, n_features);
+}
+
+static int read_header(Reader *r, uint32_t *n_models)
+{
+    if (!vmaf_is_binary_model((const char *) r->p, remaining(r)))
+        return -EINVAL;
+    r->p += MAGIC_SIZE;
+
+    uint32_t version;
+    int err = read_u32(r, &version);
+    if (err) return err;
+    if (version != VMAF_BINARY_MODEL_VERSION) return -EINVAL;
+    return read_u32(r, n_models);
+}
+
+bool vmaf_is_binary_model(const char *data, size_t data_len)
+{
+    if (!data) return false;
+    if (data_len < MAGIC_SIZE) return false;
+    return !memcmp(data, VMAF_BINARY_MODEL_MAGIC, MAGIC_SIZE);
+}
+
+bool vmaf_is_binary_model_path(const char *path)
+{
+    FILE *in = fopen(path, "rb");
+    if (!in) return false;
+    char magic[MAGIC_SIZE];
+    const size_t n = fread(magic, 1, sizeof(magic), in);
+    fclose(in);
+    return vmaf_is_binary_model(magic, n);
+}
+
+int vmaf_read_binary_model_from_buffer(VmafModel **model, VmafModelConfig *cfg,
+                                       const char *data, size_t data_len)
+{
+    if (!model) return -EINVAL;
+    if (!cfg) return -EINVAL;
+    if (!data) return -EINVAL;
+
+    Reader r = { (const uint8_t *) data, (const uint8_t *) data + data_len };
+    uint32_t n_models;
+    int err = read_header(&r, &n_models);
+    if (err) return err;
+    if (n_models != 1) return -EINVAL;
+
+    err = read_model(&r, model, cfg);
+    if (err) {
+        vmaf_model_destroy(*model);
+        *model = NULL;
+    }
+    return err;
+}
+
+int vmaf_read_binary_model_collection_from_buffer(VmafModel **model,
+                                       VmafModelCollection **model_collection,
+                                       VmafModelConfig *cfg,
+                                       const char *data, size_t data_len)
+{
+    if (!model) return -EINVAL;
+    if (!model_collection) return -EINVAL;
+    if (!cfg) return -EINVAL;
+    if (!data) return -EINVAL;
+
+    *model = NULL;
+    *model_collection = NULL;
+
+    Reader r = { (const uint8_t *) data, (const uint8_t *) data + data_len };
+    uint32_t n_models;
+    int err = read_header(&r, &n_models);
+    if (err) return err;
+    if (n_models < 2) return -EINVAL;
+
+    char *name = vmaf_model_generate_name(cfg);
+    if (!name) return -ENOMEM;
+    char cfg_name[strlen(name) + 5 + 1];
+    VmafModelConfig c = *cfg;
+    c.name = name;
+
+    for (unsigned i = 0; i < n_models; i++) {
+        VmafModel *m = NULL;
+        err = read_model(&r, &m, &c);
+        if (!err && i == 0)
+            *model = m;
+        else if (!err)
+            err = vmaf_model_collection_append(model_collection, m);
+        if (err) {
+            vmaf_model_destroy(m);
+            goto fail;
+        }
+        snprintf(cfg_name, sizeof(cfg_name), "%s_%04u", name, i + 1);
+        c.name = cfg_name;
+    }
+
+    free(name);
+    return 0;
+
+fail:
+    free(name);
+    vmaf_model_destroy(*model);
+    vmaf_model_collection_destroy(*model_collection);
+    *model = NULL;
+    *model_collection = NULL;
+    return err;
+}
+
+/* Mapping is only how the file is read: the model is parsed into buffers it
+ * owns, and the mapping is dropped once it is loaded. */
+static int map_file(const char *path, void **data, size_t *data_len)
+{
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) return -errno;
+
+    struct stat st;
+    int err = 0;
+    if (fstat(fd, &st)) {
+        err = -errno;
+        goto close_fd;
+    }
+    if (st.st_size <= 0) {
+        err = -EINVAL;
+        goto close_fd;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        err = -errno;
+        goto close_fd;
+    }
+    *data = map;
+    *data_len = st.st_size;
+
+close_fd:
+    close(fd);
+    return err;
+}
+
+int vmaf_read_binary_model_from_path(VmafModel **model, VmafModelConfig *cfg,
+                                     const char *path)
+{
+    void *data;
+    size_t data_len;
+    int err = map_file(path, &data, &data_len);
+    if (err) return err;
+    err = vmaf_read_binary_model_from_buffer(model, cfg, data, data_len);
+    munmap(data, data_len);
+    return err;
+}
+
+int vmaf_read_binary_model_collection_from_path(VmafModel **model,
+                                       VmafModelCollection **model_collection,
+                                       VmafModelConfig *cfg,
+                                       const char *path)
+{
+    void *data;
+    size_t data_len;
+    int err = map_file(path, &data, &data_len);
+    if (err) return err;
+    err = vmaf_read_binary_model_collection_from_buffer(model, model_collection,
+                                                        cfg, data, data_len);
+    munmap(data, data_len);
+    return err;
+}
+
+static void write_u32(FILE *out, uint32_t v)
+{
+    const uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+    fwrite(b, 1, sizeof(b), out);
+}
+
+static void write_f64(FILE *out, double v)
+{
+    uint64_t u;
+    memcpy(&u, &v, sizeof(u));
+    write_u32(out, u);
+    write_u32(out, u >> 32);
+}
+
+static void write_str(FILE *out, const char *str)
+{
+    const size_t len = strlen(str);
+    write_u32(out, len);
+    fwrite(str, 1, len, out);
+}
+
+static int check_svm(const VmafModel *model)
+{
+    const struct svm_model *svm = model->svm;
+    if (!svm) return -EINVAL;
+    if (svm->param.svm_type != EPSILON_SVR && svm->param.svm_type != NU_SVR)
+        return -EINVAL;
+    if (svm->param.kernel_type != RBF) return -EINVAL;
+    if (svm->nr_class != 2 || svm->l <= 0) return -EINVAL;
+
+    for (int i = 0; i < svm->l; i++) {
+        for (const struct svm_node *n = svm->SV[i]; n->index != -1; n++) {
+            if (n->index < 1 || (unsigned) n->index > model->n_features)
+                return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+static int write_model(FILE *out, const VmafModel *model)
+{
+    const struct svm_model *svm = model->svm;
+    const unsigned n_sv = svm->l;
+    const unsigned n_features = model->n_features;
+    const unsigned n_knots = model->score_transform.knots.enabled ?
+                             model->score_transform.knots.n_knots : 0;
+
+    double *sv = calloc((size_t) n_sv * n_features + 1, sizeof(*sv));
+    if (!sv) return -ENOMEM;
+    for (unsigned i = 0; i < n_sv; i++) {
+        for (const struct svm_node *n = svm->SV[i]; n->index != -1; n++)
+            sv[(n->index - 1) * n_sv + i] = n->value;
+    }
+
+    uint32_t flags = 0;
+    if (model->score_clip.enabled)
+        flags |= VMAF_BINARY_MODEL_SCORE_CLIP;
+    if (model->score_transform.enabled)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_ENABLED;
+    if (model->score_transform.p0.enabled)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_P0;
+    if (model->score_transform.p1.enabled)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_P1;
+    if (model->score_transform.p2.enabled)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_P2;
+    if (model->score_transform.knots.enabled)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_KNOTS;
+    if (model->score_transform.out_lte_in)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_OUT_LTE_IN;
+    if (model->score_transform.out_gte_in)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM_OUT_GTE_IN;
+    // A transform with nothing set maps scores to themselves, so whether the
+    // model had one only matters to VMAF_MODEL_FLAG_ENABLE_TRANSFORM.
+    if (flags & ~VMAF_BINARY_MODEL_SCORE_CLIP)
+        flags |= VMAF_BINARY_MODEL_TRANSFORM;
+
+    write_u32(out, model->type);
+    write_u32(out, model->norm_type);
+    write_u32(out, flags);
+    write_u32(out, svm->param.svm_type);
+    write_u32(out, n_features);
+    write_u32(out, n_knots);
+    write_u32(out, n_sv);
+    write_u32(out, 0);
+
+    write_f64(out, model->slope);
+    write_f64(out, model->intercept);
+    write_f64(out, model->score_clip.min);
+    write_f64(out, model->score_clip.max);
+    write_f64(out, model->score_transform.p0.value);
+    write_f64(out, model->score_transform.p1.value);
+    write_f64(out, model->score_transform.p2.value);
+    write_f64(out, svm->param.gamma);
+    write_f64(out, svm->rho[0]);
+    for (unsigned i = 0; i < n_knots; i++) {
+        write_f64(out, model->score_transform.knots.list[i].x);
+        write_f64(out, model->score_transform.knots.list[i].y);
+    }
+
+    for (unsigned i = 0; i < n_features; i++) {
+        const VmafModelFeature *feature = &model->feature[i];
+        const VmafDictionary *opts = feature->opts_dict;
+        write_str(out, feature->name);
+        write_u32(out, opts ? opts->cnt : 0);
+        for (unsigned j = 0; opts && j < opts->cnt; j++) {
+            write_str(out, opts->entry[j].key);
+            write_str(out, opts->entry[j].val);
+        }
+        write_f64(out, feature->slope);
+        write_f64(out, feature->intercept);
+    }
+
+    for (unsigned i = 0; i < n_sv; i++)
+        write_f64(out, svm->sv_coef[0][i]);
+    for (size_t i = 0; i < (size_t) n_sv * n_features; i++)
+        write_f64(out, sv[i]);
+
+    free(sv);
+    return 0;
+}
+
+int vmaf_write_binary_model(FILE *out, VmafModel *model,
+                            VmafModelCollection *model_collection)
+{
+    if (!out) return -EINVAL;
+    if (!model) return -EINVAL;
+
+    const unsigned n_models =
+        1 + (model_collection ? model_collection->cnt : 0);
+    int err = check_svm(model);
+    for (unsigned i = 1; !err && i < n_models; i++)
+        err = check_svm(model_collection->model[i - 1]);
+    if (err) return err;
+
+    fwrite(VMAF_BINARY_MODEL_MAGIC, 1, MAGIC_SIZE, out);
+    write_u32(out, VMAF_BINARY_MODEL_VERSION);
+    write_u32(out, n_models);
+
+    err = write_model(out, model);
+    for (unsigned i = 1; !err && i < n_models; i++)
+        err = write_model(out, model_collection->model[i - 1]);
+    if (err) return err;
+
+    return ferror(out) ? -EIO : 0;
+}
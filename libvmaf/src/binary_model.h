@@ -0,0 +1,106 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#ifndef __VMAF_BINARY_MODEL_H__
+#define __VMAF_BINARY_MODEL_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "model.h"
+
+/*
+ * Binary model format. Every field is little-endian: u32 is a 32-bit unsigned
+ * integer and f64 an IEEE-754 double. Strings are a u32 byte count followed
+ * by that many bytes, without a terminator.
+ *
+ *   header
+ *     u8[8]  magic, VMAF_BINARY_MODEL_MAGIC
+ *     u32    version, VMAF_BINARY_MODEL_VERSION
+ *     u32    n_models, more than 1 for a model collection
+ *   model, n_models times: the first model, then the collection in order
+ *     u32    type, enum VmafModelType
+ *     u32    norm_type, enum VmafModelNormalizationType
+ *     u32    flags, enum VmafBinaryModelFlags
+ *     u32    svm_type, EPSILON_SVR or NU_SVR; the kernel is always RBF
+ *     u32    n_features
+ *     u32    n_knots
+ *     u32    n_sv
+ *     u32    reserved, 0
+ *     f64    slope, intercept
+ *     f64    score_clip min, max
+ *     f64    score_transform p0, p1, p2
+ *     f64    gamma, rho
+ *     f64    knots[n_knots][2], x then y
+ *     feature, n_features times
+ *       str    name
+ *       u32    n_opts
+ *       str    key, str val, n_opts times
+ *       f64    slope, intercept
+ *     f64    sv_coef[n_sv]
+ *     f64    sv[n_features][n_sv], support vectors stored dense and
+ *            feature-major, features an SV does not list are 0
+ *
+ * Models are written as they were loaded. The VmafModelConfig flags are
+ * applied when a binary model is read, the same way the JSON reader does.
+ */
+
+#define VMAF_BINARY_MODEL_MAGIC "VMAFBMDL"
+#define VMAF_BINARY_MODEL_VERSION 1
+
+enum VmafBinaryModelFlags {
+    VMAF_BINARY_MODEL_SCORE_CLIP = 1 << 0,
+    VMAF_BINARY_MODEL_TRANSFORM = 1 << 1,
+    VMAF_BINARY_MODEL_TRANSFORM_ENABLED = 1 << 2,
+    VMAF_BINARY_MODEL_TRANSFORM_P0 = 1 << 3,
+    VMAF_BINARY_MODEL_TRANSFORM_P1 = 1 << 4,
+    VMAF_BINARY_MODEL_TRANSFORM_P2 = 1 << 5,
+    VMAF_BINARY_MODEL_TRANSFORM_KNOTS = 1 << 6,
+    VMAF_BINARY_MODEL_TRANSFORM_OUT_LTE_IN = 1 << 7,
+    VMAF_BINARY_MODEL_TRANSFORM_OUT_GTE_IN = 1 << 8,
+};
+
+bool vmaf_is_binary_model(const char *data, size_t data_len);
+
+bool vmaf_is_binary_model_path(const char *path);
+
+int vmaf_read_binary_model_from_buffer(VmafModel **model, VmafModelConfig *cfg,
+                                       const char *data, size_t data_len);
+
+int vmaf_read_binary_model_collection_from_buffer(VmafModel **model,
+                                       VmafModelCollection **model_collection,
+                                       VmafModelConfig *cfg,
+                                       const char *data, size_t data_len);
+
+/* The file is mapped rather than read, then parsed like a buffer. Nothing is
+ * used in place: the mapping is gone once the model is returned. */
+int vmaf_read_binary_model_from_path(VmafModel **model, VmafModelConfig *cfg,
+                                     const char *path);
+
+int vmaf_read_binary_model_collection_from_path(VmafModel **model,
+                                       VmafModelCollection **model_collection,
+                                       VmafModelConfig *cfg,
+                                       const char *path);
+
+/* Writes the model, followed by the models of the collection if there is
+ * one. Only RBF SVR models, i.e. all VMAF models, can be written. */
+int vmaf_write_binary_model(FILE *out, VmafModel *model,
+                            VmafModelCollection *model_collection);
+
+#endif /* __VMAF_BINARY_MODEL_H__ */
@@ -0,0 +1,201 @@
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "binary_model.h"
+#include "feature_collector.h"
+#include "libvmaf.h"
+#include "model.h"
+#include "predict.h"
+}
+
+#include "runfiles_util.h"
+
+namespace {
+
+constexpr unsigned kFrames = 64;
+
+std::string ModelPath(const std::string& name) {
+  return tools::GetModelRunfilesPathForTest() + name;
+}
+
+// Writes the model, and the collection if there is one, to a binary buffer.
+std::string WriteBinary(VmafModel* model,
+                        VmafModelCollection* model_collection) {
+  std::string data;
+  FILE* out = tmpfile();
+  if (!out) return data;
+  if (!vmaf_write_binary_model(out, model, model_collection)) {
+    data.resize(ftell(out));
+    rewind(out);
+    if (fread(&data[0], 1, data.size(), out) != data.size()) data.clear();
+  }
+  fclose(out);
+  return data;
+}
+
+// Predicts kFrames frames of random features, the same ones for every model
+// with the same features, without clipping or transforming the scores when
+// the flags say so.
+std::vector<double> Predict(VmafModel* model, uint64_t flags) {
+  std::vector<double> scores;
+  VmafFeatureCollector* feature_collector;
+  if (vmaf_feature_collector_init(&feature_collector)) return scores;
+  VmafPredictor* predictor;
+  if (vmaf_predictor_create(&predictor, model, feature_collector)) {
+    vmaf_feature_collector_destroy(feature_collector);
+    return scores;
+  }
+
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<double> feature(0.0, 1.0);
+  for (unsigned i = 0; i < kFrames; i++) {
+    for (unsigned j = 0; j < predictor->n_features; j++) {
+      vmaf_feature_collector_append(feature_collector,
+                                    predictor->feature[j].name, feature(rng),
+                                    i);
+    }
+    double score;
+    if (vmaf_predictor_predict(predictor, i, &score, false,
+                               static_cast<VmafModelFlags>(flags))) {
+      break;
+    }
+    scores.push_back(score);
+  }
+
+  vmaf_predictor_destroy(predictor);
+  vmaf_feature_collector_destroy(feature_collector);
+  return scores;
+}
+
+void ExpectSamePredictions(VmafModel* json, VmafModel* binary,
+                           uint64_t flags) {
+  ASSERT_EQ(json->n_features, binary->n_features);
+  for (unsigned i = 0; i < json->n_features; i++)
+    EXPECT_STREQ(json->feature[i].name, binary->feature[i].name);
+  EXPECT_STREQ(json->name, binary->name);
+
+  const std::vector<double> json_scores = Predict(json, flags);
+  const std::vector<double> binary_scores = Predict(binary, flags);
+  ASSERT_EQ(json_scores.size(), kFrames);
+  ASSERT_EQ(binary_scores.size(), kFrames);
+  for (unsigned i = 0; i < kFrames; i++) {
+    EXPECT_EQ(json_scores[i], binary_scores[i])
+        << json->name << " frame " << i;
+  }
+}
+
+class BinaryModelTest : public testing::TestWithParam<const char*> {};
+
+TEST_P(BinaryModelTest, PredictsLikeJson) {
+  VmafModelConfig cfg = {.flags = VMAF_MODEL_FLAGS_DEFAULT};
+  VmafModel* json;
+  const std::string json_path = ModelPath(GetParam());
+  ASSERT_EQ(vmaf_model_load_from_path(&json, &cfg, json_path.c_str()), 0);
+  const std::string data = WriteBinary(json, nullptr);
+  ASSERT_TRUE(vmaf_is_binary_model(data.data(), data.size()));
+
+  const uint64_t kLoadFlags[] = {
+      VMAF_MODEL_FLAGS_DEFAULT,
+      VMAF_MODEL_FLAG_DISABLE_CLIP | VMAF_MODEL_FLAG_ENABLE_TRANSFORM,
+  };
+  for (uint64_t flags : kLoadFlags) {
+    cfg.flags = flags;
+    VmafModel* flagged_json;
+    ASSERT_EQ(vmaf_model_load_from_path(&flagged_json, &cfg, json_path.c_str()),
+              0);
+    VmafModel* binary;
+    ASSERT_EQ(vmaf_model_load_from_buffer(&binary, &cfg, data.data(),
+                                          data.size()),
+              0);
+    ExpectSamePredictions(flagged_json, binary, 0);
+    ExpectSamePredictions(flagged_json, binary,
+                          VMAF_MODEL_FLAG_DISABLE_CLIP |
+                              VMAF_MODEL_FLAG_DISABLE_TRANSFORM);
+    vmaf_model_destroy(binary);
+    vmaf_model_destroy(flagged_json);
+  }
+  vmaf_model_destroy(json);
+}
+
+TEST_P(BinaryModelTest, LoadsFromPath) {
+  VmafModelConfig cfg = {.flags = VMAF_MODEL_FLAGS_DEFAULT};
+  VmafModel* json;
+  const std::string json_path = ModelPath(GetParam());
+  ASSERT_EQ(vmaf_model_load_from_path(&json, &cfg, json_path.c_str()), 0);
+  const std::string path =
+      testing::TempDir() + "/" + std::string(GetParam()) + ".bin";
+  FILE* out = fopen(path.c_str(), "wb");
+  ASSERT_NE(out, nullptr);
+  EXPECT_EQ(vmaf_write_binary_model(out, json, nullptr), 0);
+  ASSERT_EQ(fclose(out), 0);
+
+  VmafModel* binary;
+  ASSERT_EQ(vmaf_model_load_from_path(&binary, &cfg, path.c_str()), 0);
+  ExpectSamePredictions(json, binary, 0);
+  vmaf_model_destroy(binary);
+  vmaf_model_destroy(json);
+  remove(path.c_str());
+}
+
+TEST_P(BinaryModelTest, RejectsTruncatedData) {
+  VmafModelConfig cfg = {.flags = VMAF_MODEL_FLAGS_DEFAULT};
+  VmafModel* json;
+  const std::string json_path = ModelPath(GetParam());
+  ASSERT_EQ(vmaf_model_load_from_path(&json, &cfg, json_path.c_str()), 0);
+  const std::string data = WriteBinary(json, nullptr);
+  vmaf_model_destroy(json);
+
+  for (size_t len : {size_t{8}, size_t{16}, data.size() / 2, data.size() - 1}) {
+    VmafModel* binary = nullptr;
+    EXPECT_NE(vmaf_model_load_from_buffer(&binary, &cfg, data.data(), len), 0)
+        << len << " bytes";
+    EXPECT_EQ(binary, nullptr);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Models, BinaryModelTest,
+                         testing::Values("vmaf_v0.6.1.json",
+                                         "vmaf_v0.6.1neg.json",
+                                         "vmaf_4k_v0.6.1.json"));
+
+TEST(BinaryModelCollectionTest, PredictsLikeJson) {
+  VmafModelConfig cfg = {.name = "bootstrap",
+                         .flags = VMAF_MODEL_FLAGS_DEFAULT};
+  const std::string path = ModelPath("vmaf_b_v0.6.3.json");
+  VmafModel* json;
+  VmafModelCollection* json_collection;
+  ASSERT_EQ(vmaf_model_collection_load_from_path(&json, &json_collection, &cfg,
+                                                 path.c_str()),
+            0);
+  const std::string data = WriteBinary(json, json_collection);
+
+  VmafModel* binary;
+  VmafModelCollection* binary_collection;
+  ASSERT_EQ(vmaf_model_collection_load_from_buffer(
+                &binary, &binary_collection, &cfg, data.data(), data.size()),
+            0);
+  ExpectSamePredictions(json, binary, 0);
+  ASSERT_EQ(json_collection->cnt, binary_collection->cnt);
+  EXPECT_STREQ(json_collection->name, binary_collection->name);
+  for (unsigned i = 0; i < json_collection->cnt; i++) {
+    ExpectSamePredictions(json_collection->model[i],
+                          binary_collection->model[i], 0);
+  }
+
+  // A collection is not a model.
+  VmafModel* model = nullptr;
+  EXPECT_NE(
+      vmaf_model_load_from_buffer(&model, &cfg, data.data(), data.size()), 0);
+
+  vmaf_model_collection_destroy(binary_collection);
+  vmaf_model_destroy(binary);
+  vmaf_model_collection_destroy(json_collection);
+  vmaf_model_destroy(json);
+}
+
+}  // namespace
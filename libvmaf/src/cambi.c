@@ -31,7 +31,7 @@
 #include "picture.h"
 
 #if ARCH_X86
-#include "x86/cambi_avx2.h"
+#include "libvmaf/feature/x86/cambi_avx2.h"
 #endif
 
 /* Ratio of pixels for computation, must be 0 < topk <= 1.0 */
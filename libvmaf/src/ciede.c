@@ -386,4 +386,5 @@ VmafFeatureExtractor vmaf_fex_ciede = {
     .close = close,
     .priv_size = sizeof(CiedeState),
     .provided_features = provided_features,
+    .flags = VMAF_FEATURE_EXTRACTOR_CHROMA,
 };
@@ -35,5 +35,12 @@ void vmaf_set_cpu_flags_mask(const unsigned mask)
 
 unsigned vmaf_get_cpu_flags(void)
 {
-    return flags & flags_mask;
+    unsigned f = flags & flags_mask;
+#if ARCH_X86
+    /* Each x86 tier implies the ones below it, and kernels of a tier are
+     * picked without checking those. So masking a tier masks every tier
+     * above it too: only the bits below the lowest clear one are kept. */
+    f &= ((f + 1) ^ f) >> 1;
+#endif
+    return f;
 }
@@ -31,6 +31,19 @@ void vmaf_init_cpu(void);
 void vmaf_set_cpu_flags_mask(const unsigned mask);
 unsigned vmaf_get_cpu_flags(void);
 
+#if HAVE_VEC
+/* The portable vector kernels are built for SSE4.1 on x86, and for the
+ * baseline vector ISA on every other target. */
+static inline int vmaf_cpu_vec_enabled(void)
+{
+#if ARCH_X86
+    return !!(vmaf_get_cpu_flags() & VMAF_X86_CPU_FLAG_SSE41);
+#else
+    return 1;
+#endif
+}
+#endif
+
 #ifdef __cplusplus
 }
 #endif
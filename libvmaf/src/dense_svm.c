@@ -0,0 +1,142 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpu.h"
+#include "dense_svm.h"
+#include "mem.h"
+#include "svm.h"
+
+#if ARCH_X86
+#include "libvmaf/feature/x86/svm_avx2.h"
+#endif
+
+static void sq_dist_c(const double *sv, unsigned sv_stride,
+                      unsigned n_features, const double *x, unsigned n_x,
+                      double *dist)
+{
+    for (unsigned j = 0; j < n_x; j++, x += n_features, dist += sv_stride) {
+        for (unsigned i = 0; i < sv_stride; i++)
+            dist[i] = 0.;
+
+        for (unsigned k = 0; k < n_features; k++) {
+            const double *row = sv + k * sv_stride;
+            for (unsigned i = 0; i < sv_stride; i++) {
+                const double d = x[k] - row[i];
+                dist[i] += d * d;
+            }
+        }
+    }
+}
+
+int vmaf_dense_svm_init(VmafDenseSvm **svm, const struct svm_model *model,
+                        unsigned n_features)
+{
+    if (!svm) return -EINVAL;
+    if (!model) return -EINVAL;
+
+    const struct svm_parameter *param = &model->param;
+    if (param->svm_type != EPSILON_SVR && param->svm_type != NU_SVR)
+        return -EINVAL;
+    if (param->kernel_type != RBF)
+        return -EINVAL;
+
+    // Support vectors with features the frames do not have can't be dense.
+    for (int i = 0; i < model->l; i++) {
+        for (const struct svm_node *n = model->SV[i]; n->index != -1; n++) {
+            if (n->index < 1 || (unsigned) n->index > n_features)
+                return -EINVAL;
+        }
+    }
+
+    VmafDenseSvm *const s = *svm = malloc(sizeof(*s));
+    if (!s) return -ENOMEM;
+    memset(s, 0, sizeof(*s));
+    s->n_sv = model->l;
+    s->sv_stride = (s->n_sv + DENSE_SVM_SV_ALIGN - 1) / DENSE_SVM_SV_ALIGN *
+                   DENSE_SVM_SV_ALIGN;
+    s->n_features = n_features;
+    s->gamma = param->gamma;
+    s->rho = model->rho[0];
+
+    const size_t sv_sz = sizeof(*s->sv) * s->sv_stride * n_features;
+    const size_t row_sz = sizeof(double) * s->sv_stride;
+    const size_t dist_sz = row_sz * DENSE_SVM_BATCH;
+    s->sv = aligned_malloc(sv_sz ? sv_sz : MAX_ALIGN, MAX_ALIGN);
+    s->coef = aligned_malloc(row_sz ? row_sz : MAX_ALIGN, MAX_ALIGN);
+    s->dist = aligned_malloc(dist_sz ? dist_sz : MAX_ALIGN, MAX_ALIGN);
+    if (!s->sv || !s->coef || !s->dist) {
+        vmaf_dense_svm_destroy(s);
+        *svm = NULL;
+        return -ENOMEM;
+    }
+    memset(s->sv, 0, sv_sz);
+    memset(s->coef, 0, row_sz);
+
+    for (unsigned i = 0; i < s->n_sv; i++) {
+        for (const struct svm_node *n = model->SV[i]; n->index != -1; n++)
+            s->sv[(n->index - 1) * s->sv_stride + i] = n->value;
+        s->coef[i] = model->sv_coef[0][i];
+    }
+
+    s->sq_dist = sq_dist_c;
+#if ARCH_X86
+    unsigned flags = vmaf_get_cpu_flags();
+    if (flags & VMAF_X86_CPU_FLAG_AVX2)
+        s->sq_dist = svm_sq_dist_avx2;
+#endif
+
+    return 0;
+}
+
+// Summed in support vector order, like svm_predict_values().
+static double kernel_sum(const VmafDenseSvm *svm, const double *dist)
+{
+    double sum = 0.;
+    for (unsigned i = 0; i < svm->n_sv; i++)
+        sum += svm->coef[i] * exp(-svm->gamma * dist[i]);
+
+    return sum - svm->rho;
+}
+
+double vmaf_dense_svm_predict(VmafDenseSvm *svm, const double *x)
+{
+    svm->sq_dist(svm->sv, svm->sv_stride, svm->n_features, x, 1, svm->dist);
+    return kernel_sum(svm, svm->dist);
+}
+
+void vmaf_dense_svm_predict_batch(VmafDenseSvm *svm, const double *x,
+                                  unsigned n, double *prediction)
+{
+    svm->sq_dist(svm->sv, svm->sv_stride, svm->n_features, x, n, svm->dist);
+    for (unsigned j = 0; j < n; j++)
+        prediction[j] = kernel_sum(svm, svm->dist + j * svm->sv_stride);
+}
+
+void vmaf_dense_svm_destroy(VmafDenseSvm *svm)
+{
+    if (!svm) return;
+    aligned_free(svm->sv);
+    aligned_free(svm->coef);
+    aligned_free(svm->dist);
+    free(svm);
+}
@@ -0,0 +1,64 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#ifndef __VMAF_DENSE_SVM_H__
+#define __VMAF_DENSE_SVM_H__
+
+struct svm_model;
+
+/* Number of support vectors the distance kernels handle per iteration. */
+#define DENSE_SVM_SV_ALIGN 8
+
+/* Most frames vmaf_dense_svm_predict_batch() takes at once. */
+#define DENSE_SVM_BATCH 16
+
+/*
+ * Dense copy of an RBF kernel epsilon/nu-SVR, the kind every VMAF model uses.
+ * Support vectors are stored structure-of-arrays: one row per feature of
+ * sv_stride values, padded with zeroed support vectors to a multiple of
+ * DENSE_SVM_SV_ALIGN. Predictions are bit-exact with svm_predict(), since
+ * features missing from libsvm's sparse support vectors are zero and
+ * distances are accumulated in the same feature order.
+ */
+typedef struct VmafDenseSvm {
+    unsigned n_sv, sv_stride, n_features;
+    double gamma, rho;
+    double *sv;
+    double *coef;
+    double *dist;
+    void (*sq_dist)(const double *sv, unsigned sv_stride, unsigned n_features,
+                    const double *x, unsigned n_x, double *dist);
+} VmafDenseSvm;
+
+/* Returns -EINVAL for models of any other type or kernel, which are left to
+ * svm_predict(). */
+int vmaf_dense_svm_init(VmafDenseSvm **svm, const struct svm_model *model,
+                        unsigned n_features);
+
+/* x holds n_features values, feature i being libsvm's index i + 1. */
+double vmaf_dense_svm_predict(VmafDenseSvm *svm, const double *x);
+
+/* Predicts n frames, at most DENSE_SVM_BATCH, whose features follow each
+ * other in x. Each support vector is loaded once for several frames, and each
+ * prediction equals that of vmaf_dense_svm_predict(). */
+void vmaf_dense_svm_predict_batch(VmafDenseSvm *svm, const double *x,
+                                  unsigned n, double *prediction);
+
+void vmaf_dense_svm_destroy(VmafDenseSvm *svm);
+
+#endif /* __VMAF_DENSE_SVM_H__ */
@@ -330,6 +330,81 @@ unlock:
     return err;
 }
 
+int vmaf_feature_collector_get_id(VmafFeatureCollector *feature_collector,
+                                  const char *feature_name, unsigned *id)
+{
+    if (!feature_collector) return -EINVAL;
+    if (!feature_name) return -EINVAL;
+    if (!id) return -EINVAL;
+
+    pthread_mutex_lock(&(feature_collector->lock));
+    int err = -EINVAL;
+
+    for (unsigned i = 0; i < feature_collector->cnt; i++) {
+        if (!strcmp(feature_collector->feature_vector[i]->name, feature_name)) {
+            *id = i;
+            err = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&(feature_collector->lock));
+    return err;
+}
+
+int vmaf_feature_collector_append_by_id(VmafFeatureCollector *feature_collector,
+                                        unsigned id, double score,
+                                        unsigned index)
+{
+    if (!feature_collector) return -EINVAL;
+
+    pthread_mutex_lock(&(feature_collector->lock));
+    int err = 0;
+
+    if (id >= feature_collector->cnt) {
+        err = -EINVAL;
+        goto unlock;
+    }
+
+    err = feature_vector_append(feature_collector->feature_vector[id], index,
+                                score);
+
+unlock:
+    feature_collector->timer.end = clock();
+    pthread_mutex_unlock(&(feature_collector->lock));
+    return err;
+}
+
+int vmaf_feature_collector_get_score_by_id(VmafFeatureCollector *feature_collector,
+                                           unsigned id, double *score,
+                                           unsigned index)
+{
+    if (!feature_collector) return -EINVAL;
+    if (!score) return -EINVAL;
+
+    pthread_mutex_lock(&(feature_collector->lock));
+    int err = 0;
+
+    if (id >= feature_collector->cnt) {
+        err = -EINVAL;
+        goto unlock;
+    }
+
+    FeatureVector *feature_vector = feature_collector->feature_vector[id];
+    if (index >= feature_vector->capacity ||
+        !feature_vector->score[index].written)
+    {
+        err = -EINVAL;
+        goto unlock;
+    }
+
+    *score = feature_vector->score[index].value;
+
+unlock:
+    pthread_mutex_unlock(&(feature_collector->lock));
+    return err;
+}
+
 void vmaf_feature_collector_destroy(VmafFeatureCollector *feature_collector)
 {
     if (!feature_collector) return;
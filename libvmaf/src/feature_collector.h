@@ -64,6 +64,19 @@ int vmaf_feature_collector_get_score(VmafFeatureCollector *feature_collector,
                                      const char *feature_name, double *score,
                                      unsigned index);
 
+/* Ids stay valid for the collector's lifetime, since features are never
+ * removed. Looking a feature up by id skips the name search. */
+int vmaf_feature_collector_get_id(VmafFeatureCollector *feature_collector,
+                                  const char *feature_name, unsigned *id);
+
+int vmaf_feature_collector_append_by_id(VmafFeatureCollector *feature_collector,
+                                        unsigned id, double score,
+                                        unsigned index);
+
+int vmaf_feature_collector_get_score_by_id(VmafFeatureCollector *feature_collector,
+                                           unsigned id, double *score,
+                                           unsigned index);
+
 int vmaf_feature_collector_set_aggregate(VmafFeatureCollector *feature_collector,
                                          const char *feature_name,
                                          double score);
@@ -233,7 +233,7 @@ int vmaf_feature_extractor_context_destroy(VmafFeatureExtractorContext *fex_ctx)
 }
 
 int vmaf_fex_ctx_pool_create(VmafFeatureExtractorContextPool **pool,
-                             unsigned n_threads)
+                             unsigned n_threads, VmafThreadPool *thread_pool)
 {
     if (!pool) return -EINVAL;
     if (!n_threads) return -EINVAL;
@@ -243,6 +243,7 @@ int vmaf_fex_ctx_pool_create(VmafFeatureExtractorContextPool **pool,
     memset(p, 0, sizeof(*p));
 
     p->n_threads = n_threads;
+    p->thread_pool = thread_pool;
 
     p->cnt = 0;
     p->capacity = 8;
@@ -339,6 +340,7 @@ int vmaf_fex_ctx_pool_aquire(VmafFeatureExtractorContextPool *pool,
             }
             err = vmaf_feature_extractor_context_create(&f, entry->fex, d);
             if (err) goto unlock;
+            f->fex->thread_pool = pool->thread_pool;
         }
         if (!entry->ctx_list[i].in_use) {
             entry->ctx_list[i].fex_ctx = *fex_ctx = f;
@@ -28,9 +28,11 @@
 #include "opt.h"
 
 #include "picture.h"
+#include "thread_pool.h"
 
 enum VmafFeatureExtractorFlags {
     VMAF_FEATURE_EXTRACTOR_TEMPORAL = 1 << 0,
+    VMAF_FEATURE_EXTRACTOR_CHROMA = 1 << 1, ///< Reads the chroma planes.
 };
 
 typedef struct VmafFeatureExtractor {
@@ -84,6 +86,7 @@ typedef struct VmafFeatureExtractor {
     size_t priv_size; ///< sizeof private data.
     uint64_t flags; ///< Feauture extraction flags, binary or'd.
     const char **provided_features; ///< Provided feature list, NULL terminated.
+    VmafThreadPool *thread_pool; ///< Optional, for splitting up a picture.
 } VmafFeatureExtractor;
 
 VmafFeatureExtractor *vmaf_get_feature_extractor_by_name(const char *name);
@@ -136,10 +139,11 @@ typedef struct VmafFeatureExtractorContextPool {
     unsigned cnt, capacity;
     pthread_mutex_t lock;
     unsigned n_threads;
+    VmafThreadPool *thread_pool;
 } VmafFeatureExtractorContextPool;
 
 int vmaf_fex_ctx_pool_create(VmafFeatureExtractorContextPool **pool,
-                             unsigned n_threads);
+                             unsigned n_threads, VmafThreadPool *thread_pool);
 
 int vmaf_fex_ctx_pool_aquire(VmafFeatureExtractorContextPool *pool,
                              VmafFeatureExtractor *fex,
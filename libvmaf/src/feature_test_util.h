@@ -0,0 +1,135 @@
+#ifndef VMAF_FEATURE_TEST_UTIL_H_
+#define VMAF_FEATURE_TEST_UTIL_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "libvmaf.h"
+}
+
+namespace vmaf_test {
+
+// A luma plane and the bit depth its samples are in.
+struct Frame {
+  unsigned w, h, bpc;
+  std::vector<uint16_t> luma;
+};
+
+// Odd and even sizes, including widths which leave a partial vector in every
+// kernel and sizes close to the smallest the extractors accept.
+constexpr unsigned kEdgeSizes[][2] = {
+    {33, 33}, {64, 48}, {101, 57}, {250, 41}, {641, 361},
+};
+
+// Allocates a 4:2:0 picture holding the frame in its luma plane.
+inline int ToPicture(const Frame& f, VmafPicture* pic) {
+  int err = vmaf_picture_alloc(pic, VMAF_PIX_FMT_YUV420P, f.bpc, f.w, f.h);
+  if (err) return err;
+  for (unsigned y = 0; y < f.h; y++) {
+    uint8_t* row = static_cast<uint8_t*>(pic->data[0]) + y * pic->stride[0];
+    const uint16_t* in = &f.luma[y * f.w];
+    for (unsigned x = 0; x < f.w; x++) {
+      if (f.bpc > 8)
+        reinterpret_cast<uint16_t*>(row)[x] = in[x];
+      else
+        row[x] = static_cast<uint8_t>(in[x]);
+    }
+  }
+  return 0;
+}
+
+// Reads the features of each frame from a flushed context, in the order
+// given. A feature which wasn't written reads as -1.
+inline std::vector<std::vector<double>> ReadFeatures(
+    VmafContext* vmaf, unsigned n_frames,
+    const std::vector<std::string>& features) {
+  std::vector<std::vector<double>> scores;
+  for (unsigned i = 0; i < n_frames; i++) {
+    std::vector<double> frame_scores;
+    for (const std::string& name : features) {
+      double score = -1.0;
+      vmaf_feature_score_at_index(vmaf, name.c_str(), &score, i);
+      frame_scores.push_back(score);
+    }
+    scores.push_back(frame_scores);
+  }
+  return scores;
+}
+
+// Scores pairs of frames with the extractors, each with debug enabled and the
+// options given, under the cpumask on n_threads threads and returns the
+// features of each pair in the order given. A feature which wasn't written
+// reads as -1.
+inline std::vector<std::vector<double>> ScoreFeatures(
+    const std::vector<Frame>& ref, const std::vector<Frame>& dist,
+    const std::vector<std::string>& extractors,
+    const std::vector<std::string>& features, uint64_t cpumask,
+    const std::map<std::string, std::string>& options = {},
+    unsigned n_threads = 0) {
+  std::vector<std::vector<double>> scores;
+  VmafConfiguration config = {
+      .log_level = VMAF_LOG_LEVEL_NONE,
+      .n_threads = n_threads,
+      .cpumask = cpumask,
+  };
+  VmafContext* vmaf;
+  if (vmaf_init(&vmaf, config)) return scores;
+
+  for (const std::string& name : extractors) {
+    VmafFeatureDictionary* opts = nullptr;
+    vmaf_feature_dictionary_set(&opts, "debug", "true");
+    for (const auto& option : options) {
+      vmaf_feature_dictionary_set(&opts, option.first.c_str(),
+                                  option.second.c_str());
+    }
+    if (vmaf_use_feature(vmaf, name.c_str(), opts)) {
+      vmaf_feature_dictionary_free(&opts);
+      vmaf_close(vmaf);
+      return scores;
+    }
+  }
+
+  for (unsigned i = 0; i < ref.size(); i++) {
+    VmafPicture pic[2];
+    ToPicture(ref[i], &pic[0]);
+    ToPicture(dist[i], &pic[1]);
+    if (vmaf_read_pictures(vmaf, &pic[0], &pic[1], i)) break;
+  }
+  vmaf_read_pictures(vmaf, nullptr, nullptr, 0);
+
+  scores = ReadFeatures(vmaf, ref.size(), features);
+  vmaf_close(vmaf);
+  return scores;
+}
+
+// Expects the kernels left by the cpumask to give bit-exactly the scores of
+// the C kernels, which a cpumask of ~0 leaves alone.
+inline void ExpectMatchesC(const std::vector<Frame>& ref,
+                           const std::vector<Frame>& dist,
+                           const std::vector<std::string>& extractors,
+                           const std::vector<std::string>& features,
+                           uint64_t cpumask) {
+  const auto c_scores =
+      ScoreFeatures(ref, dist, extractors, features, ~UINT64_C(0));
+  const auto simd_scores =
+      ScoreFeatures(ref, dist, extractors, features, cpumask);
+  ASSERT_EQ(c_scores.size(), ref.size());
+  ASSERT_EQ(simd_scores.size(), ref.size());
+  for (unsigned i = 0; i < ref.size(); i++) {
+    for (unsigned k = 0; k < features.size(); k++) {
+      // Bit-exact, not approximately equal.
+      EXPECT_EQ(c_scores[i][k], simd_scores[i][k])
+          << features[k] << " of frame " << i << " at " << ref[i].w << "x"
+          << ref[i].h << ", " << ref[i].bpc << " bit";
+    }
+  }
+}
+
+}  // namespace vmaf_test
+
+#endif  // VMAF_FEATURE_TEST_UTIL_H_
@@ -17,6 +17,7 @@
  */
 
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "feature_extractor.h"
@@ -32,9 +33,32 @@ int feature_extractor_vector_init(RegisteredFeatureExtractors *rfe)
     rfe->fex_ctx = malloc(sz);
     if (!rfe->fex_ctx) return -ENOMEM;
     memset(rfe->fex_ctx, 0, sz);
+    sz = sizeof(*(rfe->feature_name)) * rfe->capacity;
+    rfe->feature_name = malloc(sz);
+    if (!rfe->feature_name) {
+        free(rfe->fex_ctx);
+        return -ENOMEM;
+    }
+    memset(rfe->feature_name, 0, sz);
     return 0;
 }
 
+bool feature_extractor_vector_contains(RegisteredFeatureExtractors *rfe,
+                                       const VmafFeatureExtractor *fex,
+                                       VmafDictionary *opts_dict)
+{
+    if (!rfe) return false;
+    if (!fex) return false;
+
+    for (unsigned i = 0; i < rfe->cnt; i++) {
+        if (strcmp(rfe->fex_ctx[i]->fex->name, fex->name)) continue;
+        if (vmaf_dictionary_compare(rfe->fex_ctx[i]->opts_dict, opts_dict))
+            continue;
+        return true;
+    }
+    return false;
+}
+
 int feature_extractor_vector_append(RegisteredFeatureExtractors *rfe,
                                     VmafFeatureExtractorContext *fex_ctx,
                                     uint64_t flags)
@@ -44,24 +68,17 @@ int feature_extractor_vector_append(RegisteredFeatureExtractors *rfe,
 
     (void) flags;
 
-    for (unsigned i = 0; i < rfe->cnt; i++) {
-        char *feature_a =
-            vmaf_feature_name_from_options(rfe->fex_ctx[i]->fex->name,
-                    rfe->fex_ctx[i]->fex->options, rfe->fex_ctx[i]->fex->priv);
-
-        char *feature_b =
-            vmaf_feature_name_from_options(fex_ctx->fex->name,
-                    fex_ctx->fex->options, fex_ctx->fex->priv);
+    // A name which could not be built matches none, as before.
+    char *feature_name =
+        vmaf_feature_name_from_options(fex_ctx->fex->name,
+                                       fex_ctx->fex->options,
+                                       fex_ctx->fex->priv);
 
-        int ret = 1;
-        if (feature_a && feature_b)
-            ret = strcmp(feature_a, feature_b);
-
-        free(feature_a);
-        free(feature_b);
-
-        if (ret) continue;
+    for (unsigned i = 0; feature_name && i < rfe->cnt; i++) {
+        if (!rfe->feature_name[i]) continue;
+        if (strcmp(rfe->feature_name[i], feature_name)) continue;
 
+        free(feature_name);
         return vmaf_feature_extractor_context_destroy(fex_ctx);
     }
 
@@ -69,11 +86,17 @@ int feature_extractor_vector_append(RegisteredFeatureExtractors *rfe,
         size_t capacity = rfe->capacity * 2;
         VmafFeatureExtractorContext **fex_ctx =
             realloc(rfe->fex_ctx, sizeof(*(rfe->fex_ctx)) * capacity);
-        if (!fex_ctx) return -ENOMEM;
+        if (!fex_ctx) goto fail;
         rfe->fex_ctx = fex_ctx;
+        char **names =
+            realloc(rfe->feature_name, sizeof(*(rfe->feature_name)) * capacity);
+        if (!names) goto fail;
+        rfe->feature_name = names;
         rfe->capacity = capacity;
-        for (unsigned i = rfe->cnt; i < rfe->capacity; i++)
+        for (unsigned i = rfe->cnt; i < rfe->capacity; i++) {
             rfe->fex_ctx[i] = NULL;
+            rfe->feature_name[i] = NULL;
+        }
     }
 
     const unsigned cnt = fex_ctx->opts_dict ? fex_ctx->opts_dict->cnt : 0;
@@ -88,8 +111,13 @@ int feature_extractor_vector_append(RegisteredFeatureExtractors *rfe,
                  fex_ctx->opts_dict->entry[i].val);
     }
 
+    rfe->feature_name[rfe->cnt] = feature_name;
     rfe->fex_ctx[rfe->cnt++] = fex_ctx;
     return 0;
+
+fail:
+    free(feature_name);
+    return -ENOMEM;
 }
 
 void feature_extractor_vector_destroy(RegisteredFeatureExtractors *rfe)
@@ -98,7 +126,9 @@ void feature_extractor_vector_destroy(RegisteredFeatureExtractors *rfe)
     for (unsigned i = 0; i < rfe->cnt; i++) {
         vmaf_feature_extractor_context_close(rfe->fex_ctx[i]);
         vmaf_feature_extractor_context_destroy(rfe->fex_ctx[i]);
+        free(rfe->feature_name[i]);
     }
     free(rfe->fex_ctx);
+    free(rfe->feature_name);
     return;
 }
@@ -19,15 +19,26 @@
 #ifndef __VMAF_SRC_FEX_CTX_VECTOR_H__
 #define __VMAF_SRC_FEX_CTX_VECTOR_H__
 
+#include <stdbool.h>
+
 #include "feature_extractor.h"
 
 typedef struct {
     VmafFeatureExtractorContext **fex_ctx;
+    char **feature_name;
     unsigned cnt, capacity;
 } RegisteredFeatureExtractors;
 
 int feature_extractor_vector_init(RegisteredFeatureExtractors *rfe);
 
+/* Whether a context of the extractor with the same options is registered,
+ * so that registering another one can be skipped before it is created. */
+bool feature_extractor_vector_contains(RegisteredFeatureExtractors *rfe,
+                                       const VmafFeatureExtractor *fex,
+                                       VmafDictionary *opts_dict);
+
+/* Contexts are keyed by the canonical feature name of the extractor and its
+ * parsed options. A context whose key is registered already is destroyed. */
 int feature_extractor_vector_append(RegisteredFeatureExtractors *rfe,
                                     VmafFeatureExtractorContext *fex_ctx,
                                     uint64_t flags);
@@ -16,6 +16,8 @@
  *
  */
 
+#include <stdlib.h>
+
 #include "cpu.h"
 #include "dict.h"
 #include "feature_collector.h"
@@ -23,14 +25,34 @@
 #include "feature_name.h"
 #include "integer_adm.h"
 #include "log.h"
+#include "reference_cache.h"
+#include "thread_pool.h"
 
 #if ARCH_X86
-#include "x86/adm_avx2.h"
+#include "libvmaf/feature/x86/adm_avx2.h"
 #elif ARCH_AARCH64
 #include "arm64/adm_neon.h"
 #include <arm_neon.h>
 #endif
 
+/* Row bands are never shorter than this, so that the rows each band reads
+ * from its neighbours stay a small fraction of its work. */
+#define ADM_MIN_BAND_ROWS 16
+
+/* Rows of a scale taken through all stages at once, and the rows of
+ * intermediate bands held for them, including one row either side. */
+#define ADM_TILE_ROWS 16
+#define ADM_TILE_ROWS_HELD (ADM_TILE_ROWS + 2)
+
+int32_t div_lookup[65537];
+
+/* A range of rows of each scale, with tile scratch of its own. */
+typedef struct AdmBand {
+    AdmBuffer buf;
+    int64_t cm_accum[3];
+    uint64_t den_accum[3];
+} AdmBand;
+
 typedef struct AdmState {
     size_t integer_stride;
     AdmBuffer buf;
@@ -39,11 +61,61 @@ typedef struct AdmState {
     double adm_norm_view_dist;
     int adm_ref_display_height;
     void (*dwt2_8)(const uint8_t *src, const adm_dwt_band_t *dst,
-                   AdmBuffer *buf, int w, int h, int src_stride,
-                   int dst_stride);
+                   AdmBuffer *buf, int w, int src_stride,
+                   int dst_stride, int row0, int row1);
+    void (*dwt2_16)(const uint16_t *src, const adm_dwt_band_t *dst,
+                    AdmBuffer *buf, int w, int src_stride,
+                    int dst_stride, int inp_size_bits, int row0, int row1);
+    void (*dwt2_s123)(const int32_t *src, const i4_adm_dwt_band_t *dst,
+                      AdmBuffer *buf, int w, int src_stride,
+                      int dst_stride, int scale, int row0, int row1);
+    void (*decouple)(AdmBuffer *buf, int w, int h, int stride,
+                     double adm_enhn_gain_limit, int row0, int row1);
+    void (*decouple_s123)(AdmBuffer *buf, int w, int h, int stride,
+                          double adm_enhn_gain_limit, int row0, int row1);
+    void (*csf)(AdmBuffer *buf, int theta, int w, int h, int stride,
+                double adm_norm_view_dist, int adm_ref_display_height,
+                int row0, int row1);
+    void (*i4_csf)(AdmBuffer *buf, int theta, int scale, int w, int h,
+                   int stride, double adm_norm_view_dist,
+                   int adm_ref_display_height, int row0, int row1);
+    void (*csf_den_scale)(const adm_dwt_band_t *src, int w, int h,
+                          int src_stride, int row0, int row1,
+                          uint64_t *accum);
+    void (*csf_den_s123)(const i4_adm_dwt_band_t *src, int scale, int w,
+                         int h, int src_stride, int row0, int row1,
+                         uint64_t *accum);
+    void (*cm)(AdmBuffer *buf, int w, int h, int src_stride,
+               int csf_a_stride, double adm_norm_view_dist,
+               int adm_ref_display_height, int row0, int row1,
+               int64_t *accum);
+    void (*i4_cm)(AdmBuffer *buf, int w, int h, int src_stride,
+                  int csf_a_stride, int scale, double adm_norm_view_dist,
+                  int adm_ref_display_height, int row0, int row1,
+                  int64_t *accum);
+    void *ll_buf;
+    int32_t *ll[2][2];
+    VmafThreadPool *thread_pool;
+    AdmBand *band;
+    unsigned n_bands;
     VmafDictionary *feature_name_dict;
+    char *reference_cache_path;
+    VmafReferenceCache *reference_cache;
+    /* Where the reference h, v and d bands of each scale start in a record. */
+    size_t ref_band_offset[4][3];
+    /* The record filled in on a cache miss. */
+    void *record;
 } AdmState;
 
+/*
+ * Everything integer_adm derives from the reference for one picture: the
+ * csf den sums of each scale, followed by the h, v and d dwt bands of each
+ * scale, 16-bit at scale 0 and 32-bit after, at the stride of the tiles.
+ */
+typedef struct AdmCacheHeader {
+    uint64_t den_accum[4][3];
+} AdmCacheHeader;
+
 static const VmafOption options[] = {
     {
         .name = "debug",
@@ -86,29 +158,18 @@ static const VmafOption options[] = {
         .max = 4320,
         .flags = VMAF_OPT_FLAG_FEATURE_PARAM,
     },
+    {
+        .name = "reference_cache",
+        .help = "path of a file caching reference-side adm intermediates "
+                "across runs against the same source, to which a key of the "
+                "options is appended",
+        .offset = offsetof(AdmState, reference_cache_path),
+        .type = VMAF_OPT_TYPE_STRING,
+        .default_val.s = NULL,
+    },
     { 0 }
 };
 
-/*
- * lambda = 0 (finest scale), 1, 2, 3 (coarsest scale);
- * theta = 0 (ll), 1 (lh - vertical), 2 (hh - diagonal), 3(hl - horizontal).
- */
-static inline float
-dwt_quant_step(const struct dwt_model_params *params, int lambda, int theta,
-        double adm_norm_view_dist, int adm_ref_display_height)
-{
-    // Formula (1), page 1165 - display visual resolution (DVR), in pixels/degree
-    // of visual angle. This should be 56.55
-    float r = adm_norm_view_dist * adm_ref_display_height * M_PI / 180.0;
-
-    // Formula (9), page 1171
-    float temp = log10(pow(2.0, lambda + 1)*params->f0*params->g[theta] / r);
-    float Q = 2.0*params->a*pow(10.0, params->k*temp*temp) /
-        dwt_7_9_basis_function_amplitudes[lambda][theta];
-
-    return Q;
-}
-
 // i = 0, j = 0: indices y: 1,0,1, x: 1,0,1  for Fixed-point
 #define ADM_CM_THRESH_S_0_0(angles,flt_angles,src_stride,accum,w,h,i,j) \
 { \
@@ -658,7 +719,7 @@ static void dwt2_src_indices_filt(int **src_ind_y, int **src_ind_x, int w, int h
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
 static void adm_decouple(AdmBuffer *buf, int w, int h, int stride,
-                         double adm_enhn_gain_limit)
+                         double adm_enhn_gain_limit, int row0, int row1)
 {
     const float cos_1deg_sq = cos(1.0 * M_PI / 180.0) * cos(1.0 * M_PI / 180.0);
 
@@ -687,7 +748,7 @@ static void adm_decouple(AdmBuffer *buf, int w, int h, int stride,
 
     int64_t ot_dp, o_mag_sq, t_mag_sq;
 
-    for (int i = top; i < bottom; ++i) {
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
         for (int j = left; j < right; ++j) {
             int16_t oh = ref->band_h[i * stride + j];
             int16_t ov = ref->band_v[i * stride + j];
@@ -777,17 +838,8 @@ static void adm_decouple(AdmBuffer *buf, int w, int h, int stride,
     }
 }
 
-static inline uint16_t get_best15_from32(uint32_t temp, int *x)
-{
-    int k = __builtin_clz(temp);    //built in for intel
-    k = 17 - k;
-    temp = (temp + (1 << (k - 1))) >> k;
-    *x = k;
-    return temp;
-}
-
 static void adm_decouple_s123(AdmBuffer *buf, int w, int h, int stride,
-                              double adm_enhn_gain_limit)
+                              double adm_enhn_gain_limit, int row0, int row1)
 {
     const float cos_1deg_sq = cos(1.0 * M_PI / 180.0) * cos(1.0 * M_PI / 180.0);
 
@@ -817,7 +869,7 @@ static void adm_decouple_s123(AdmBuffer *buf, int w, int h, int stride,
 
     int64_t ot_dp, o_mag_sq, t_mag_sq;
 
-    for (int i = top; i < bottom; ++i)
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i)
     {
         for (int j = left; j < right; ++j)
         {
@@ -929,8 +981,9 @@ static void adm_decouple_s123(AdmBuffer *buf, int w, int h, int stride,
     }
 }
 
-static void adm_csf(AdmBuffer *buf, int w, int h, int stride,
-                    double adm_norm_view_dist, int adm_ref_display_height)
+static void adm_csf(AdmBuffer *buf, int theta, int w, int h, int stride,
+                    double adm_norm_view_dist, int adm_ref_display_height,
+                    int row0, int row1)
 {
     const adm_dwt_band_t *src = &buf->decouple_a;
     const adm_dwt_band_t *dst = &buf->csf_a;
@@ -1001,28 +1054,27 @@ static void adm_csf(AdmBuffer *buf, int w, int h, int stride,
         bottom = h;
     }
 
-    for (int theta = 0; theta < 3; ++theta) {
-        const int16_t *src_ptr = src_angles[theta];
-        int16_t *dst_ptr = dst_angles[theta];
-        int16_t *flt_ptr = flt_angles[theta];
+    const int16_t *src_ptr = src_angles[theta];
+    int16_t *dst_ptr = dst_angles[theta];
+    int16_t *flt_ptr = flt_angles[theta];
 
-        for (int i = top; i < bottom; ++i) {
-            int src_offset = i * stride;
-            int dst_offset = i * stride;
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i) {
+        int src_offset = i * stride;
+        int dst_offset = i * stride;
 
-            for (int j = left; j < right; ++j) {
-                int32_t dst_val = i_rfactor[theta] * (int32_t)src_ptr[src_offset + j];
-                int16_t i16_dst_val = ((int16_t)((dst_val + i_shiftsadd[theta]) >> i_shifts[theta]));
-                dst_ptr[dst_offset + j] = i16_dst_val;
-                flt_ptr[dst_offset + j] = ((int16_t)(((FIX_ONE_BY_30 * abs((int32_t)i16_dst_val))
-                    + 2048) >> 12));
-            }
+        for (int j = left; j < right; ++j) {
+            int32_t dst_val = i_rfactor[theta] * (int32_t)src_ptr[src_offset + j];
+            int16_t i16_dst_val = ((int16_t)((dst_val + i_shiftsadd[theta]) >> i_shifts[theta]));
+            dst_ptr[dst_offset + j] = i16_dst_val;
+            flt_ptr[dst_offset + j] = ((int16_t)(((FIX_ONE_BY_30 * abs((int32_t)i16_dst_val))
+                + 2048) >> 12));
         }
     }
 }
 
-static void i4_adm_csf(AdmBuffer *buf, int scale, int w, int h, int stride,
-                       double adm_norm_view_dist, int adm_ref_display_height)
+static void i4_adm_csf(AdmBuffer *buf, int theta, int scale, int w, int h,
+                       int stride, double adm_norm_view_dist,
+                       int adm_ref_display_height, int row0, int row1)
 {
     const i4_adm_dwt_band_t *src = &buf->i4_decouple_a;
     const i4_adm_dwt_band_t *dst = &buf->i4_csf_a;
@@ -1075,39 +1127,35 @@ static void i4_adm_csf(AdmBuffer *buf, int scale, int w, int h, int stride,
         bottom = h;
     }
 
-    for (int theta = 0; theta < 3; ++theta)
+    const int32_t *src_ptr = src_angles[theta];
+    int32_t *dst_ptr = dst_angles[theta];
+    int32_t *flt_ptr = flt_angles[theta];
+
+    for (int i = MAX(top, row0); i < MIN(bottom, row1); ++i)
     {
-        const int32_t *src_ptr = src_angles[theta];
-        int32_t *dst_ptr = dst_angles[theta];
-        int32_t *flt_ptr = flt_angles[theta];
+        int src_offset = i * stride;
+        int dst_offset = i * stride;
 
-        for (int i = top; i < bottom; ++i)
+        for (int j = left; j < right; ++j)
         {
-            int src_offset = i * stride;
-            int dst_offset = i * stride;
-
-            for (int j = left; j < right; ++j)
-            {
-                int32_t dst_val = (int32_t)(((i_rfactor[theta] * (int64_t)src_ptr[src_offset + j]) +
-                    add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
-                dst_ptr[dst_offset + j] = dst_val;
-                flt_ptr[dst_offset + j] = (int32_t)((((int64_t)FIX_ONE_BY_30 * abs(dst_val)) +
-                    add_bef_shift_flt[scale - 1]) >> shift_flt[scale - 1]);
-            }
+            int32_t dst_val = (int32_t)(((i_rfactor[theta] * (int64_t)src_ptr[src_offset + j]) +
+                add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
+            dst_ptr[dst_offset + j] = dst_val;
+            flt_ptr[dst_offset + j] = (int32_t)((((int64_t)FIX_ONE_BY_30 * abs(dst_val)) +
+                add_bef_shift_flt[scale - 1]) >> shift_flt[scale - 1]);
         }
     }
 }
 
-static float adm_csf_den_scale(const adm_dwt_band_t *src, int w, int h,
-                               int src_stride,
-                               double adm_norm_view_dist, int adm_ref_display_height)
+/*
+ * Adds the cubed csf of rows [row0, row1) of the reference bands to accum[]
+ * for h, v and d. As with adm_cm(), rows are rounded into the sums one by
+ * one, so row ranges can be summed separately.
+ */
+static void adm_csf_den_scale(const adm_dwt_band_t *src, int w, int h,
+                              int src_stride, int row0, int row1,
+                              uint64_t *accum)
 {
-    // for ADM: scales goes from 0 to 3 but in noise floor paper, it goes from
-    // 1 to 4 (from finest scale to coarsest scale).
-    const float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 1, adm_norm_view_dist, adm_ref_display_height);
-    const float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 2, adm_norm_view_dist, adm_ref_display_height);
-    const float rfactor[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
-
     uint64_t accum_h = 0, accum_v = 0, accum_d = 0;
 
     /* The computation of the denominator scales is not required for the regions
@@ -1123,15 +1171,18 @@ static float adm_csf_den_scale(const adm_dwt_band_t *src, int w, int h,
     int32_t add_shift_accum =
         shift_accum > 0 ? (1 << (shift_accum - 1)) : 0;
 
+    const int band_top = MAX(top, row0);
+    const int band_bottom = MIN(bottom, row1);
+
     /**
      * The rfactor is multiplied at the end after cubing
      * Because d+ = (a[i]^3)*(r^3)
      * is equivalent to d+=a[i]^3 and d=d*(r^3)
      */
-    int16_t *src_h = src->band_h + top * src_stride;
-    int16_t *src_v = src->band_v + top * src_stride;
-    int16_t *src_d = src->band_d + top * src_stride;
-    for (int i = top; i < bottom; ++i) {
+    int16_t *src_h = src->band_h + band_top * src_stride;
+    int16_t *src_v = src->band_v + band_top * src_stride;
+    int16_t *src_d = src->band_d + band_top * src_stride;
+    for (int i = band_top; i < band_bottom; ++i) {
         uint64_t accum_inner_h = 0;
         uint64_t accum_inner_v = 0;
         uint64_t accum_inner_d = 0;
@@ -1160,6 +1211,31 @@ static float adm_csf_den_scale(const adm_dwt_band_t *src, int w, int h,
         src_v += src_stride;
         src_d += src_stride;
     }
+
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+static float adm_den_scale(const uint64_t *accum, int w, int h,
+                           double adm_norm_view_dist, int adm_ref_display_height)
+{
+    // for ADM: scales goes from 0 to 3 but in noise floor paper, it goes from
+    // 1 to 4 (from finest scale to coarsest scale).
+    const float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 1, adm_norm_view_dist, adm_ref_display_height);
+    const float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], 0, 2, adm_norm_view_dist, adm_ref_display_height);
+    const float rfactor[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    int32_t shift_accum = (int32_t)ceil(log2((bottom - top)*(right - left)) - 20);
+    shift_accum = shift_accum > 0 ? shift_accum : 0;
+
+    const uint64_t accum_h = accum[0], accum_v = accum[1], accum_d = accum[2];
+
     /**
      * rfactor is multiplied after cubing
      * accum_h,v,d is converted to floating-point for score calculation
@@ -1181,19 +1257,12 @@ static float adm_csf_den_scale(const adm_dwt_band_t *src, int w, int h,
 
 }
 
-static float adm_csf_den_s123(const i4_adm_dwt_band_t *src, int scale, int w, int h,
-                              int src_stride,
-                              double adm_norm_view_dist, int adm_ref_display_height)
+static void adm_csf_den_s123(const i4_adm_dwt_band_t *src, int scale, int w, int h,
+                             int src_stride, int row0, int row1,
+                             uint64_t *accum)
 {
-    // for ADM: scales goes from 0 to 3 but in noise floor paper, it goes from
-    // 1 to 4 (from finest scale to coarsest scale).
-    float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 1, adm_norm_view_dist, adm_ref_display_height);
-    float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 2, adm_norm_view_dist, adm_ref_display_height);
-    const float rfactor[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
-
     uint64_t accum_h = 0, accum_v = 0, accum_d = 0;
     const uint32_t shift_sq[3] = { 31, 30, 31 };
-    const uint32_t accum_convert_float[3] = { 32, 27, 23 };
     const uint32_t add_shift_sq[3] =
         { 1u << shift_sq[0], 1u << shift_sq[1], 1u << shift_sq[2] };
 
@@ -1210,10 +1279,13 @@ static float adm_csf_den_s123(const i4_adm_dwt_band_t *src, int scale, int w, in
     uint32_t shift_accum = (uint32_t)ceil(log2(bottom - top));
     uint32_t add_shift_accum = (uint32_t)pow(2, (shift_accum - 1));
 
-    int32_t *src_h = src->band_h + top * src_stride;
-    int32_t *src_v = src->band_v + top * src_stride;
-    int32_t *src_d = src->band_d + top * src_stride;
-    for (int i = top; i < bottom; ++i)
+    const int band_top = MAX(top, row0);
+    const int band_bottom = MIN(bottom, row1);
+
+    int32_t *src_h = src->band_h + band_top * src_stride;
+    int32_t *src_v = src->band_v + band_top * src_stride;
+    int32_t *src_d = src->band_d + band_top * src_stride;
+    for (int i = band_top; i < band_bottom; ++i)
     {
         uint64_t accum_inner_h = 0;
         uint64_t accum_inner_v = 0;
@@ -1246,6 +1318,33 @@ static float adm_csf_den_s123(const i4_adm_dwt_band_t *src, int scale, int w, in
         src_v += src_stride;
         src_d += src_stride;
     }
+
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+static float i4_adm_den_scale(const uint64_t *accum, int scale, int w, int h,
+                              double adm_norm_view_dist, int adm_ref_display_height)
+{
+    // for ADM: scales goes from 0 to 3 but in noise floor paper, it goes from
+    // 1 to 4 (from finest scale to coarsest scale).
+    float factor1 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 1, adm_norm_view_dist, adm_ref_display_height);
+    float factor2 = dwt_quant_step(&dwt_7_9_YCbCr_threshold[0], scale, 2, adm_norm_view_dist, adm_ref_display_height);
+    const float rfactor[3] = { 1.0f / factor1, 1.0f / factor1, 1.0f / factor2 };
+
+    const uint32_t accum_convert_float[3] = { 32, 27, 23 };
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    uint32_t shift_cub = (uint32_t)ceil(log2(right - left));
+    uint32_t shift_accum = (uint32_t)ceil(log2(bottom - top));
+
+    const uint64_t accum_h = accum[0], accum_v = accum[1], accum_d = accum[2];
+
     /**
      * All the results are converted to floating-point to calculate the scores
      * For all scales the final shift is 3*shifts from dwt - total shifts done here
@@ -1263,8 +1362,14 @@ static float adm_csf_den_s123(const i4_adm_dwt_band_t *src, int scale, int w, in
     return (den_scale_h + den_scale_v + den_scale_d);
 }
 
-static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stride,
-                    double adm_norm_view_dist, int adm_ref_display_height)
+/*
+ * Adds the masked contrast of rows [row0, row1) to accum[] for h, v and d.
+ * Every row is rounded into the sums on its own, so adding up the sums of
+ * consecutive row ranges gives the same result as a single call for all rows.
+ */
+static void adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stride,
+                   double adm_norm_view_dist, int adm_ref_display_height,
+                   int row0, int row1, int64_t *accum)
 {
     const adm_dwt_band_t *src   = &buf->decouple_r;
     const adm_dwt_band_t *csf_f = &buf->csf_f;
@@ -1336,6 +1441,10 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     const int end_col = (right < (w - 1)) ? right : (w - 1);
     const int start_row = (top > 1) ? top : 1;
     const int end_row = (bottom < (h - 1)) ? bottom : (h - 1);
+    const int band_start_row = MAX(start_row, row0);
+    const int band_end_row = MIN(end_row, row1);
+    const bool do_top = row0 == 0 && top <= 0;
+    const bool do_bottom = row1 == h && bottom > (h - 1);
 
     int i, j;
     int64_t val;
@@ -1345,7 +1454,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     int64_t accum_inner_h = 0, accum_inner_v = 0, accum_inner_d = 0;
 
     /* i=0,j=0 */
-    if ((top <= 0) && (left <= 0))
+    if (do_top && (left <= 0))
     {
         xh = (int32_t)src->band_h[0] * i_rfactor[0];
         xv = (int32_t)src->band_v[0] * i_rfactor[1];
@@ -1374,7 +1483,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
 
     /* i=0, j */
-    if (top <= 0) {
+    if (do_top) {
         for (j = start_col; j < end_col; ++j) {
             xh = src->band_h[j] * i_rfactor[0];
             xv = src->band_v[j] * i_rfactor[1];
@@ -1391,7 +1500,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
 
     /* i=0,j=w-1 */
-    if ((top <= 0) && (right > (w - 1)))
+    if (do_top && (right > (w - 1)))
     {
         xh = src->band_h[w - 1] * i_rfactor[0];
         xv = src->band_v[w - 1] * i_rfactor[1];
@@ -1412,7 +1521,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
 
     if ((left > 0) && (right <= (w - 1))) /* Completely within frame */
     {
-        for (i = start_row; i < end_row; ++i) {
+        for (i = band_start_row; i < band_end_row; ++i) {
             accum_inner_h = 0;
             accum_inner_v = 0;
             accum_inner_d = 0;
@@ -1436,7 +1545,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
     else if ((left <= 0) && (right <= (w - 1))) /* Right border within frame, left outside */
     {
-        for (i = start_row; i < end_row; ++i) {
+        for (i = band_start_row; i < band_end_row; ++i) {
             accum_inner_h = 0;
             accum_inner_v = 0;
             accum_inner_d = 0;
@@ -1475,7 +1584,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
     else if ((left > 0) && (right > (w - 1))) /* Left border within frame, right outside */
     {
-        for (i = start_row; i < end_row; ++i) {
+        for (i = band_start_row; i < band_end_row; ++i) {
             accum_inner_h = 0;
             accum_inner_v = 0;
             accum_inner_d = 0;
@@ -1514,7 +1623,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
     else /* Both borders outside frame */
     {
-        for (i = start_row; i < end_row; ++i) {
+        for (i = band_start_row; i < band_end_row; ++i) {
             accum_inner_h = 0;
             accum_inner_v = 0;
             accum_inner_d = 0;
@@ -1569,7 +1678,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     accum_inner_d = 0;
 
     /* i=h-1,j=0 */
-    if ((bottom > (h - 1)) && (left <= 0))
+    if (do_bottom && (left <= 0))
     {
         xh = src->band_h[(h - 1) * src_stride] * i_rfactor[0];
         xv = src->band_v[(h - 1) * src_stride] * i_rfactor[1];
@@ -1585,7 +1694,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
 
     /* i=h-1,j */
-    if (bottom > (h - 1)) {
+    if (do_bottom) {
         for (j = start_col; j < end_col; ++j) {
             xh = src->band_h[(h - 1) * src_stride + j] * i_rfactor[0];
             xv = src->band_v[(h - 1) * src_stride + j] * i_rfactor[1];
@@ -1602,7 +1711,7 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     }
 
     /* i-h-1,j=w-1 */
-    if ((bottom > (h - 1)) && (right > (w - 1)))
+    if (do_bottom && (right > (w - 1)))
     {
         xh = src->band_h[(h - 1) * src_stride + w - 1] * i_rfactor[0];
         xv = src->band_v[(h - 1) * src_stride + w - 1] * i_rfactor[1];
@@ -1621,6 +1730,25 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     accum_v += (accum_inner_v + add_shift_inner_accum) >> shift_inner_accum;
     accum_d += (accum_inner_d + add_shift_inner_accum) >> shift_inner_accum;
 
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+static float adm_cm_num_scale(const int64_t *accum, int w, int h)
+{
+    const uint32_t shift_xhcub = (uint32_t)ceil(log2(w) - 4);
+    const uint32_t shift_xvcub = (uint32_t)ceil(log2(w) - 4);
+    const uint32_t shift_xdcub = (uint32_t)ceil(log2(w) - 3);
+    const uint32_t shift_inner_accum = (uint32_t)ceil(log2(h));
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    const int64_t accum_h = accum[0], accum_v = accum[1], accum_d = accum[2];
+
     /**
      * For h and v total shifts pending from last stage is 6 rfactor[0,1] has 21 shifts
      * => after cubing (6+21)*3=81 after squaring shifted by 29
@@ -1644,8 +1772,9 @@ static float adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stri
     return (num_scale_h + num_scale_v + num_scale_d);
 }
 
-static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stride, int scale,
-                       double adm_norm_view_dist, int adm_ref_display_height)
+static void i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_stride, int scale,
+                      double adm_norm_view_dist, int adm_ref_display_height,
+                      int row0, int row1, int64_t *accum)
 {
     const i4_adm_dwt_band_t *src = &buf->i4_decouple_r;
     const i4_adm_dwt_band_t *csf_f = &buf->i4_csf_f;
@@ -1677,10 +1806,6 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     uint32_t shift_inner_accum = (uint32_t)ceil(log2(h));
     uint32_t add_shift_inner_accum = (uint32_t)pow(2, (shift_inner_accum - 1));
 
-    float final_shift[3] = { pow(2,(45 - shift_cub - shift_inner_accum)),
-                             pow(2,(39 - shift_cub - shift_inner_accum)),
-                             pow(2,(36 - shift_cub - shift_inner_accum)) };
-
     const int32_t shift_sq = 30;
     const int32_t add_shift_sq = 536870912; //2^29
     const int32_t shift_sub = 0;
@@ -1699,6 +1824,10 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     const int end_col = (right < (w - 1)) ? right : (w - 1);
     const int start_row = (top > 1) ? top : 1;
     const int end_row = (bottom < (h - 1)) ? bottom : (h - 1);
+    const int band_start_row = MAX(start_row, row0);
+    const int band_end_row = MIN(end_row, row1);
+    const bool do_top = row0 == 0 && top <= 0;
+    const bool do_bottom = row1 == h && bottom > (h - 1);
 
     int i, j;
     int32_t xh, xv, xd, thr;
@@ -1707,7 +1836,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     int64_t accum_h = 0, accum_v = 0, accum_d = 0;
     int64_t accum_inner_h = 0, accum_inner_v = 0, accum_inner_d = 0;
     /* i=0,j=0 */
-    if ((top <= 0) && (left <= 0))
+    if (do_top && (left <= 0))
     {
         xh = (int32_t)((((int64_t)src->band_h[0] * rfactor[0]) + add_bef_shift_dst[scale - 1])
             >> shift_dst[scale - 1]);
@@ -1727,7 +1856,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
 
     /* i=0, j */
-    if (top <= 0)
+    if (do_top)
     {
         for (j = start_col; j < end_col; ++j)
         {
@@ -1750,7 +1879,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
 
     /* i=0,j=w-1 */
-    if ((top <= 0) && (right > (w - 1)))
+    if (do_top && (right > (w - 1)))
     {
         xh = (int32_t)((((int64_t)src->band_h[w - 1] * rfactor[0]) +
             add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
@@ -1775,7 +1904,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
 
     if ((left > 0) && (right <= (w - 1))) /* Completely within frame */
     {
-        for (i = start_row; i < end_row; ++i)
+        for (i = band_start_row; i < band_end_row; ++i)
         {
             accum_inner_h = 0;
             accum_inner_v = 0;
@@ -1806,7 +1935,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
     else if ((left <= 0) && (right <= (w - 1))) /* Right border within frame, left outside */
     {
-        for (i = start_row; i < end_row; ++i)
+        for (i = band_start_row; i < band_end_row; ++i)
         {
             accum_inner_h = 0;
             accum_inner_v = 0;
@@ -1855,7 +1984,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
     else if ((left > 0) && (right > (w - 1))) /* Left border within frame, right outside */
     {
-        for (i = start_row; i < end_row; ++i)
+        for (i = band_start_row; i < band_end_row; ++i)
         {
             accum_inner_h = 0;
             accum_inner_v = 0;
@@ -1903,7 +2032,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
     else /* Both borders outside frame */
     {
-        for (i = start_row; i < end_row; ++i)
+        for (i = band_start_row; i < band_end_row; ++i)
         {
             accum_inner_h = 0;
             accum_inner_v = 0;
@@ -1972,7 +2101,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     accum_inner_d = 0;
 
     /* i=h-1,j=0 */
-    if ((bottom > (h - 1)) && (left <= 0))
+    if (do_bottom && (left <= 0))
     {
         xh = (int32_t)((((int64_t)src->band_h[(h - 1) * src_stride] * rfactor[0]) +
             add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
@@ -1992,7 +2121,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
 
     /* i=h-1,j */
-    if (bottom > (h - 1))
+    if (do_bottom)
     {
         for (j = start_col; j < end_col; ++j)
         {
@@ -2015,7 +2144,7 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     }
 
     /* i-h-1,j=w-1 */
-    if ((bottom > (h - 1)) && (right > (w - 1)))
+    if (do_bottom && (right > (w - 1)))
     {
         xh = (int32_t)((((int64_t)src->band_h[(h - 1) * src_stride + w - 1] * rfactor[0]) +
             add_bef_shift_dst[scale - 1]) >> shift_dst[scale - 1]);
@@ -2037,6 +2166,27 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     accum_v += (accum_inner_v + add_shift_inner_accum) >> shift_inner_accum;
     accum_d += (accum_inner_d + add_shift_inner_accum) >> shift_inner_accum;
 
+    accum[0] += accum_h;
+    accum[1] += accum_v;
+    accum[2] += accum_d;
+}
+
+static float i4_adm_cm_num_scale(const int64_t *accum, int w, int h, int scale)
+{
+    const uint32_t shift_cub = (uint32_t)ceil(log2(w));
+    const uint32_t shift_inner_accum = (uint32_t)ceil(log2(h));
+
+    const float final_shift[3] = { pow(2,(45 - shift_cub - shift_inner_accum)),
+                                   pow(2,(39 - shift_cub - shift_inner_accum)),
+                                   pow(2,(36 - shift_cub - shift_inner_accum)) };
+
+    const int left = w * ADM_BORDER_FACTOR - 0.5;
+    const int top = h * ADM_BORDER_FACTOR - 0.5;
+    const int right = w - left;
+    const int bottom = h - top;
+
+    const int64_t accum_h = accum[0], accum_v = accum[1], accum_d = accum[2];
+
     /**
      * Converted to floating-point for calculating the final scores
      * Final shifts is calculated from 3*(shifts_from_previous_stage(i.e src comes from dwt)+32)-total_shifts_done_in_this_function
@@ -2052,21 +2202,9 @@ static float i4_adm_cm(AdmBuffer *buf, int w, int h, int src_stride, int csf_a_s
     return (num_scale_h + num_scale_v + num_scale_d);
 }
 
-static void i16_to_i32(adm_dwt_band_t *src, i4_adm_dwt_band_t *dst,
-                       int w, int h, int stride)
-{
-    for (int i = 0; i < (h + 1) / 2; ++i) {
-        int16_t *src_band_a_addr = &src->band_a[i * stride];
-        int32_t *dst_band_a_addr = &dst->band_a[i * stride];
-        for (int j = 0; j < (w + 1) / 2; ++j) {
-            *(dst_band_a_addr++) = (int32_t)(*(src_band_a_addr++));
-        }
-    }
-}
-
 static void adm_dwt2_8(const uint8_t *src, const adm_dwt_band_t *dst,
-                       AdmBuffer *buf, int w, int h, int src_stride,
-                       int dst_stride)
+                       AdmBuffer *buf, int w, int src_stride,
+                       int dst_stride, int row0, int row1)
 {
     const int16_t *filter_lo = dwt2_db2_coeffs_lo;
     const int16_t *filter_hi = dwt2_db2_coeffs_hi;
@@ -2083,7 +2221,7 @@ static void adm_dwt2_8(const uint8_t *src, const adm_dwt_band_t *dst,
     int16_t *tmphi = tmplo + w;
     int32_t accum;
 
-    for (int i = 0; i < (h + 1) / 2; ++i) {
+    for (int i = row0; i < row1; ++i) {
         /* Vertical pass. */
         for (int j = 0; j < w; ++j) {
             uint16_t u_s0 = src[ind_y[0][i] * src_stride + j];
@@ -2162,8 +2300,9 @@ static void adm_dwt2_8(const uint8_t *src, const adm_dwt_band_t *dst,
     }
 }
 
-static void adm_dwt2_16(const uint16_t *src, const adm_dwt_band_t *dst, AdmBuffer *buf, int w, int h,
-                        int src_stride, int dst_stride, int inp_size_bits)
+static void adm_dwt2_16(const uint16_t *src, const adm_dwt_band_t *dst, AdmBuffer *buf, int w,
+                        int src_stride, int dst_stride, int inp_size_bits,
+                        int row0, int row1)
 {
     const int16_t *filter_lo = dwt2_db2_coeffs_lo;
     const int16_t *filter_hi = dwt2_db2_coeffs_hi;
@@ -2180,7 +2319,7 @@ static void adm_dwt2_16(const uint16_t *src, const adm_dwt_band_t *dst, AdmBuffe
     int16_t *tmphi = tmplo + w;
     int32_t accum;
 
-    for (int i = 0; i < (h + 1) / 2; ++i) {
+    for (int i = row0; i < row1; ++i) {
         /* Vertical pass. */
         for (int j = 0; j < w; ++j) {
             uint16_t u_s0 = src[ind_y[0][i] * src_stride + j];
@@ -2259,12 +2398,10 @@ static void adm_dwt2_16(const uint16_t *src, const adm_dwt_band_t *dst, AdmBuffe
     }
 }
 
-static void adm_dwt2_s123_combined(const int32_t *i4_ref_scale, const int32_t *i4_curr_dis,
-                                   AdmBuffer *buf, int w, int h, int ref_stride,
-                                   int dis_stride, int dst_stride, int scale)
+static void adm_dwt2_s123(const int32_t *src, const i4_adm_dwt_band_t *dst,
+                          AdmBuffer *buf, int w, int src_stride,
+                          int dst_stride, int scale, int row0, int row1)
 {
-    const i4_adm_dwt_band_t *i4_ref_dwt2 = &buf->i4_ref_dwt2;
-    const i4_adm_dwt_band_t *i4_dis_dwt2 = &buf->i4_dis_dwt2;
     int **ind_y = buf->ind_y;
     int **ind_x = buf->ind_x;
 
@@ -2276,55 +2413,34 @@ static void adm_dwt2_s123_combined(const int32_t *i4_ref_scale, const int32_t *i
     const int16_t shift_VerticalPass[3] = { 0, 16, 16 };
     const int16_t shift_HorizontalPass[3] = { 15, 16, 15 };
 
-    int32_t *tmplo_ref = buf->tmp_ref;
-    int32_t *tmphi_ref = tmplo_ref + w;
-    int32_t *tmplo_dis = tmphi_ref + w;
-    int32_t *tmphi_dis = tmplo_dis + w;
+    int32_t *tmplo = buf->tmp_ref;
+    int32_t *tmphi = tmplo + w;
     int32_t s10, s11, s12, s13;
 
-    int64_t accum_ref;
+    int64_t accum;
 
-    for (int i = 0; i < (h + 1) / 2; ++i)
+    for (int i = row0; i < row1; ++i)
     {
         /* Vertical pass. */
         for (int j = 0; j < w; ++j)
         {
-            s10 = i4_ref_scale[ind_y[0][i] * ref_stride + j];
-            s11 = i4_ref_scale[ind_y[1][i] * ref_stride + j];
-            s12 = i4_ref_scale[ind_y[2][i] * ref_stride + j];
-            s13 = i4_ref_scale[ind_y[3][i] * ref_stride + j];
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            tmplo_ref[j] = (int32_t)((accum_ref + add_bef_shift_round_VP[scale - 1])
-                >> shift_VerticalPass[scale - 1]);
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            tmphi_ref[j] = (int32_t)((accum_ref + add_bef_shift_round_VP[scale - 1])
-                >> shift_VerticalPass[scale - 1]);
-
-            s10 = i4_curr_dis[ind_y[0][i] * dis_stride + j];
-            s11 = i4_curr_dis[ind_y[1][i] * dis_stride + j];
-            s12 = i4_curr_dis[ind_y[2][i] * dis_stride + j];
-            s13 = i4_curr_dis[ind_y[3][i] * dis_stride + j];
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            tmplo_dis[j] = (int32_t)((accum_ref + add_bef_shift_round_VP[scale - 1])
+            s10 = src[ind_y[0][i] * src_stride + j];
+            s11 = src[ind_y[1][i] * src_stride + j];
+            s12 = src[ind_y[2][i] * src_stride + j];
+            s13 = src[ind_y[3][i] * src_stride + j];
+            accum = 0;
+            accum += (int64_t)filter_lo[0] * s10;
+            accum += (int64_t)filter_lo[1] * s11;
+            accum += (int64_t)filter_lo[2] * s12;
+            accum += (int64_t)filter_lo[3] * s13;
+            tmplo[j] = (int32_t)((accum + add_bef_shift_round_VP[scale - 1])
                 >> shift_VerticalPass[scale - 1]);
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            tmphi_dis[j] = (int32_t)((accum_ref + add_bef_shift_round_VP[scale - 1])
+            accum = 0;
+            accum += (int64_t)filter_hi[0] * s10;
+            accum += (int64_t)filter_hi[1] * s11;
+            accum += (int64_t)filter_hi[2] * s12;
+            accum += (int64_t)filter_hi[3] * s13;
+            tmphi[j] = (int32_t)((accum + add_bef_shift_round_VP[scale - 1])
                 >> shift_VerticalPass[scale - 1]);
         }
         /* Horizontal pass (lo and hi). */
@@ -2335,210 +2451,364 @@ static void adm_dwt2_s123_combined(const int32_t *i4_ref_scale, const int32_t *i
             int j2 = ind_x[2][j];
             int j3 = ind_x[3][j];
 
-            s10 = tmplo_ref[j0];
-            s11 = tmplo_ref[j1];
-            s12 = tmplo_ref[j2];
-            s13 = tmplo_ref[j3];
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            i4_ref_dwt2->band_a[i * dst_stride + j] = (int32_t)((accum_ref +
-                add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            i4_ref_dwt2->band_v[i * dst_stride + j] = (int32_t)((accum_ref +
-                add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
+            s10 = tmplo[j0];
+            s11 = tmplo[j1];
+            s12 = tmplo[j2];
+            s13 = tmplo[j3];
 
-            s10 = tmphi_ref[j0];
-            s11 = tmphi_ref[j1];
-            s12 = tmphi_ref[j2];
-            s13 = tmphi_ref[j3];
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            i4_ref_dwt2->band_h[i * dst_stride + j] = (int32_t)((accum_ref +
-                add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            i4_ref_dwt2->band_d[i * dst_stride + j] = (int32_t)((accum_ref +
+            accum = 0;
+            accum += (int64_t)filter_lo[0] * s10;
+            accum += (int64_t)filter_lo[1] * s11;
+            accum += (int64_t)filter_lo[2] * s12;
+            accum += (int64_t)filter_lo[3] * s13;
+            dst->band_a[i * dst_stride + j] = (int32_t)((accum +
                 add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
 
-            s10 = tmplo_dis[j0];
-            s11 = tmplo_dis[j1];
-            s12 = tmplo_dis[j2];
-            s13 = tmplo_dis[j3];
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            i4_dis_dwt2->band_a[i * dst_stride + j] = (int32_t)((accum_ref +
+            accum = 0;
+            accum += (int64_t)filter_hi[0] * s10;
+            accum += (int64_t)filter_hi[1] * s11;
+            accum += (int64_t)filter_hi[2] * s12;
+            accum += (int64_t)filter_hi[3] * s13;
+            dst->band_v[i * dst_stride + j] = (int32_t)((accum +
                 add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
 
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            i4_dis_dwt2->band_v[i * dst_stride + j] = (int32_t)((accum_ref +
-                add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
+            s10 = tmphi[j0];
+            s11 = tmphi[j1];
+            s12 = tmphi[j2];
+            s13 = tmphi[j3];
 
-            s10 = tmphi_dis[j0];
-            s11 = tmphi_dis[j1];
-            s12 = tmphi_dis[j2];
-            s13 = tmphi_dis[j3];
-
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_lo[0] * s10;
-            accum_ref += (int64_t)filter_lo[1] * s11;
-            accum_ref += (int64_t)filter_lo[2] * s12;
-            accum_ref += (int64_t)filter_lo[3] * s13;
-            i4_dis_dwt2->band_h[i * dst_stride + j] = (int32_t)((accum_ref +
+            accum = 0;
+            accum += (int64_t)filter_lo[0] * s10;
+            accum += (int64_t)filter_lo[1] * s11;
+            accum += (int64_t)filter_lo[2] * s12;
+            accum += (int64_t)filter_lo[3] * s13;
+            dst->band_h[i * dst_stride + j] = (int32_t)((accum +
                 add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
 
-            accum_ref = 0;
-            accum_ref += (int64_t)filter_hi[0] * s10;
-            accum_ref += (int64_t)filter_hi[1] * s11;
-            accum_ref += (int64_t)filter_hi[2] * s12;
-            accum_ref += (int64_t)filter_hi[3] * s13;
-            i4_dis_dwt2->band_d[i * dst_stride + j] = (int32_t)((accum_ref +
+            accum = 0;
+            accum += (int64_t)filter_hi[0] * s10;
+            accum += (int64_t)filter_hi[1] * s11;
+            accum += (int64_t)filter_hi[2] * s12;
+            accum += (int64_t)filter_hi[3] * s13;
+            dst->band_d[i * dst_stride + j] = (int32_t)((accum +
                 add_bef_shift_round_HP[scale - 1]) >> shift_HorizontalPass[scale - 1]);
         }
     }
 }
 
-void integer_compute_adm(AdmState *s, VmafPicture *ref_pic, VmafPicture *dis_pic,
-                         double *score, double *score_num, double *score_den, double *scores, AdmBuffer *buf,
-                         double adm_enhn_gain_limit,
-                         double adm_norm_view_dist, int adm_ref_display_height)
+/*
+ * Points the bands of buf at its tile scratch, to hold rows [row0, row0 +
+ * ADM_TILE_ROWS_HELD). Band pointers are set up so that the kernels, which
+ * address bands by frame row, can run on the tile unchanged. The 16-bit
+ * bands of scale 0 and the 32-bit bands of the other scales share slots.
+ */
+static void set_tile_rows(AdmBuffer *buf, int row0)
 {
-    int w = ref_pic->w[0];
-    int h = ref_pic->h[0];
-
-    const double numden_limit = 1e-10 * (w * h) / (1920.0 * 1080.0);
+    adm_dwt_band_t *band[6] = {
+        &buf->ref_dwt2, &buf->dis_dwt2, &buf->decouple_r,
+        &buf->decouple_a, &buf->csf_a, &buf->csf_f,
+    };
+    i4_adm_dwt_band_t *i4_band[6] = {
+        &buf->i4_ref_dwt2, &buf->i4_dis_dwt2, &buf->i4_decouple_r,
+        &buf->i4_decouple_a, &buf->i4_csf_a, &buf->i4_csf_f,
+    };
+
+    const size_t slot_sz = buf->ind_size_x * ADM_TILE_ROWS_HELD;
+    const ptrdiff_t offset = (ptrdiff_t)row0 * (buf->ind_size_x >> 2);
+    char *slot = buf->data_buf;
+
+    for (unsigned k = 0; k < 6; k++) {
+        int16_t **dst[4] = {
+            &band[k]->band_a, &band[k]->band_h,
+            &band[k]->band_v, &band[k]->band_d,
+        };
+        int32_t **i4_dst[4] = {
+            &i4_band[k]->band_a, &i4_band[k]->band_h,
+            &i4_band[k]->band_v, &i4_band[k]->band_d,
+        };
+        /* Only the dwt bands keep their approximation (a) band. */
+        for (unsigned b = k < 2 ? 0 : 1; b < 4; b++, slot += slot_sz) {
+            *dst[b] = (int16_t *)slot - offset;
+            *i4_dst[b] = (int32_t *)slot - offset;
+        }
+    }
+}
 
-    size_t curr_ref_stride;
-    size_t curr_dis_stride;
-    size_t buf_stride = buf->ind_size_x >> 2;
+/*
+ * Each ADM scale is split into row bands, one task on the thread pool per
+ * band. A band runs its rows through dwt, decouple, csf and cm a tile of
+ * ADM_TILE_ROWS rows at a time, so that intermediate bands stay in cache
+ * and only the approximation band, the input of the next scale, is written
+ * out for the whole frame.
+ */
+typedef struct AdmStage {
+    AdmState *s;
+    VmafPicture *pic[2];
+    const int32_t *ll_src[2];
+    int32_t *ll_dst[2];
+    int scale;
+    int src_w;
+    int w, h;
+    int stride;
+    unsigned n_bands;
+    double adm_enhn_gain_limit;
+    double adm_norm_view_dist;
+    int adm_ref_display_height;
+    /* The reference h, v and d bands of the scale in a cache record, read
+     * instead of computed if ref_cached, else written; NULL without one. */
+    char *ref_bands[3];
+    bool ref_cached;
+} AdmStage;
 
-    int32_t *i4_curr_ref_scale = NULL;
-    int32_t *i4_curr_dis_scale = NULL;
+static unsigned stage_bands(AdmState *s, int h)
+{
+    return MAX(1, MIN((int)s->n_bands, h / ADM_MIN_BAND_ROWS));
+}
 
-    if (ref_pic->bpc == 8) {
-        curr_ref_stride = ref_pic->stride[0];
-        curr_dis_stride = dis_pic->stride[0];
+static void store_ll_rows(AdmStage *stage, AdmBuffer *buf, unsigned i,
+                          int row0, int row1)
+{
+    const int stride = stage->stride;
+    int32_t *ll = stage->ll_dst[i];
+
+    if (stage->scale == 0) {
+        const int16_t *band_a = i ? buf->dis_dwt2.band_a : buf->ref_dwt2.band_a;
+        for (int y = row0; y < row1; ++y) {
+            for (int x = 0; x < stage->w; ++x)
+                ll[y * stride + x] = band_a[y * stride + x];
+        }
     }
     else {
-        curr_ref_stride = ref_pic->stride[0] >> 1;
-        curr_dis_stride = dis_pic->stride[0] >> 1;
+        const int32_t *band_a =
+            i ? buf->i4_dis_dwt2.band_a : buf->i4_ref_dwt2.band_a;
+        for (int y = row0; y < row1; ++y) {
+            memcpy(&ll[y * stride], &band_a[y * stride],
+                   stage->w * sizeof(*ll));
+        }
     }
+}
 
-    double num = 0;
-    double den = 0;
-	for (unsigned scale = 0; scale < 4; ++scale) {
-		float num_scale = 0.0;
-		float den_scale = 0.0;
+static void store_ref_rows(AdmStage *stage, AdmBuffer *buf, int row0,
+                           int row1)
+{
+    const size_t sample_sz = stage->scale ? sizeof(int32_t) : sizeof(int16_t);
+    const size_t stride = stage->stride * sample_sz;
+    const char *band[3] = {
+        stage->scale ? (char *)buf->i4_ref_dwt2.band_h : (char *)buf->ref_dwt2.band_h,
+        stage->scale ? (char *)buf->i4_ref_dwt2.band_v : (char *)buf->ref_dwt2.band_v,
+        stage->scale ? (char *)buf->i4_ref_dwt2.band_d : (char *)buf->ref_dwt2.band_d,
+    };
+
+    for (unsigned k = 0; k < 3; k++) {
+        for (int y = row0; y < row1; ++y) {
+            memcpy(stage->ref_bands[k] + y * stride, band[k] + y * stride,
+                   stage->w * sample_sz);
+        }
+    }
+}
 
-        dwt2_src_indices_filt(buf->ind_y, buf->ind_x, w, h);
-		if(scale==0) {
-            if (ref_pic->bpc == 8) {
-                s->dwt2_8(ref_pic->data[0], &buf->ref_dwt2, buf, w, h,
-                          curr_ref_stride, buf_stride);
-                s->dwt2_8(dis_pic->data[0], &buf->dis_dwt2, buf, w, h,
-                          curr_dis_stride, buf_stride);
+/* Points the reference bands of buf at those of a cache record. */
+static void load_ref_bands(AdmStage *stage, AdmBuffer *buf)
+{
+    if (stage->scale == 0) {
+        buf->ref_dwt2.band_h = (int16_t *)stage->ref_bands[0];
+        buf->ref_dwt2.band_v = (int16_t *)stage->ref_bands[1];
+        buf->ref_dwt2.band_d = (int16_t *)stage->ref_bands[2];
+    }
+    else {
+        buf->i4_ref_dwt2.band_h = (int32_t *)stage->ref_bands[0];
+        buf->i4_ref_dwt2.band_v = (int32_t *)stage->ref_bands[1];
+        buf->i4_ref_dwt2.band_d = (int32_t *)stage->ref_bands[2];
+    }
+}
+
+static void adm_tile(AdmStage *stage, AdmBand *band, int row0, int row1)
+{
+    AdmState *s = stage->s;
+    AdmBuffer *buf = &band->buf;
+    const int w = stage->w;
+    const int h = stage->h;
+    const int stride = stage->stride;
+
+    /* The rows either side of the tile feed the cm thresholds of its first
+     * and last rows. */
+    const int top = MAX(row0 - 1, 0);
+    const int bottom = MIN(row1 + 1, h);
+    set_tile_rows(buf, top);
+
+    /* A cache hit leaves only the distorted picture to transform. */
+    if (stage->ref_cached)
+        load_ref_bands(stage, buf);
+
+    for (unsigned i = stage->ref_cached; i < 2; i++) {
+        if (stage->scale == 0) {
+            const adm_dwt_band_t *dwt2 = i ? &buf->dis_dwt2 : &buf->ref_dwt2;
+            VmafPicture *pic = stage->pic[i];
+            if (pic->bpc == 8) {
+                s->dwt2_8(pic->data[0], dwt2, buf, stage->src_w, pic->stride[0],
+                          stride, top, bottom);
             }
             else {
-                adm_dwt2_16(ref_pic->data[0], &buf->ref_dwt2, buf, w, h,
-                            curr_ref_stride, buf_stride, ref_pic->bpc);
-                adm_dwt2_16(dis_pic->data[0], &buf->dis_dwt2, buf, w, h,
-                            curr_dis_stride, buf_stride, dis_pic->bpc);
+                s->dwt2_16(pic->data[0], dwt2, buf, stage->src_w,
+                           pic->stride[0] >> 1, stride, pic->bpc, top, bottom);
             }
+        }
+        else {
+            const i4_adm_dwt_band_t *i4_dwt2 =
+                i ? &buf->i4_dis_dwt2 : &buf->i4_ref_dwt2;
+            s->dwt2_s123(stage->ll_src[i], i4_dwt2, buf, stage->src_w,
+                         stride, stride, stage->scale, top, bottom);
+        }
+        if (stage->ll_dst[i])
+            store_ll_rows(stage, buf, i, row0, row1);
+        if (!i && stage->ref_bands[0])
+            store_ref_rows(stage, buf, row0, row1);
+    }
 
-			i16_to_i32(&buf->ref_dwt2, &buf->i4_ref_dwt2, w, h, buf_stride);
-			i16_to_i32(&buf->dis_dwt2, &buf->i4_dis_dwt2, w, h, buf_stride);
-
-			w = (w + 1) / 2;
-			h = (h + 1) / 2;
-
-			adm_decouple(buf, w, h, buf_stride, adm_enhn_gain_limit);
-
-			den_scale = adm_csf_den_scale(&buf->ref_dwt2, w, h, buf_stride,
-                                 adm_norm_view_dist, adm_ref_display_height);
+    if (stage->scale == 0) {
+        s->decouple(buf, w, h, stride, stage->adm_enhn_gain_limit,
+                    top, bottom);
+        for (int theta = 0; theta < 3; ++theta) {
+            s->csf(buf, theta, w, h, stride, stage->adm_norm_view_dist,
+                   stage->adm_ref_display_height, top, bottom);
+        }
+        if (!stage->ref_cached) {
+            s->csf_den_scale(&buf->ref_dwt2, w, h, stride, row0, row1,
+                             band->den_accum);
+        }
+        s->cm(buf, w, h, stride, stride, stage->adm_norm_view_dist,
+              stage->adm_ref_display_height, row0, row1, band->cm_accum);
+    }
+    else {
+        s->decouple_s123(buf, w, h, stride, stage->adm_enhn_gain_limit,
+                         top, bottom);
+        for (int theta = 0; theta < 3; ++theta) {
+            s->i4_csf(buf, theta, stage->scale, w, h, stride,
+                      stage->adm_norm_view_dist,
+                      stage->adm_ref_display_height, top, bottom);
+        }
+        if (!stage->ref_cached) {
+            s->csf_den_s123(&buf->i4_ref_dwt2, stage->scale, w, h, stride,
+                            row0, row1, band->den_accum);
+        }
+        s->i4_cm(buf, w, h, stride, stride, stage->scale,
+                 stage->adm_norm_view_dist, stage->adm_ref_display_height,
+                 row0, row1, band->cm_accum);
+    }
+}
 
-			adm_csf(buf, w, h, buf_stride, adm_norm_view_dist, adm_ref_display_height);
+static void scale_band(void *data, unsigned i)
+{
+    AdmStage *stage = data;
+    AdmBand *band = &stage->s->band[i];
 
-			num_scale = adm_cm(buf, w, h, buf_stride, buf_stride,
-                               adm_norm_view_dist, adm_ref_display_height);
-		}
-		else {
-            adm_dwt2_s123_combined(i4_curr_ref_scale, i4_curr_dis_scale, buf, w, h, curr_ref_stride,
-                                   curr_dis_stride, buf_stride, scale);
+    memset(band->cm_accum, 0, sizeof(band->cm_accum));
+    memset(band->den_accum, 0, sizeof(band->den_accum));
 
-			w = (w + 1) / 2;
-			h = (h + 1) / 2;
+    const int row0 = stage->h * i / stage->n_bands;
+    const int row1 = stage->h * (i + 1) / stage->n_bands;
+    for (int y = row0; y < row1; y += ADM_TILE_ROWS)
+        adm_tile(stage, band, y, MIN(y + ADM_TILE_ROWS, row1));
+}
 
-			adm_decouple_s123(buf, w, h, buf_stride, adm_enhn_gain_limit);
+void integer_compute_adm(AdmState *s, VmafPicture *ref_pic, VmafPicture *dis_pic,
+                         double *score, double *score_num, double *score_den, double *scores, AdmBuffer *buf,
+                         double adm_enhn_gain_limit,
+                         double adm_norm_view_dist, int adm_ref_display_height,
+                         void *record, bool ref_cached)
+{
+    int w = ref_pic->w[0];
+    int h = ref_pic->h[0];
 
-			den_scale = adm_csf_den_s123(
-			        &buf->i4_ref_dwt2, scale, w, h, buf_stride,
-			        adm_norm_view_dist, adm_ref_display_height);
+    const double numden_limit = 1e-10 * (w * h) / (1920.0 * 1080.0);
 
-			i4_adm_csf(buf, scale, w, h, buf_stride,
-              adm_norm_view_dist, adm_ref_display_height);
+    AdmStage stage = {
+        .s = s,
+        .pic = { ref_pic, dis_pic },
+        .stride = buf->ind_size_x >> 2,
+        .adm_enhn_gain_limit = adm_enhn_gain_limit,
+        .adm_norm_view_dist = adm_norm_view_dist,
+        .adm_ref_display_height = adm_ref_display_height,
+        .ref_cached = ref_cached,
+    };
+    AdmCacheHeader *header = record;
 
-			num_scale = i4_adm_cm(buf, w, h, buf_stride, buf_stride, scale,
-                         adm_norm_view_dist, adm_ref_display_height);
-		}
+    double num = 0;
+    double den = 0;
+    for (unsigned scale = 0; scale < 4; ++scale) {
+        float num_scale = 0.0;
+        float den_scale = 0.0;
 
-		num += num_scale;
-		den += den_scale;
+        dwt2_src_indices_filt(buf->ind_y, buf->ind_x, w, h);
 
-		i4_curr_ref_scale = buf->i4_ref_dwt2.band_a;
-		i4_curr_dis_scale = buf->i4_dis_dwt2.band_a;
+        /* The approximation bands of consecutive scales take turns in the
+         * two ll buffers; the last scale has no use for its own. */
+        stage.scale = scale;
+        stage.src_w = w;
+        for (unsigned i = 0; i < 2; i++) {
+            stage.ll_src[i] = scale ? s->ll[(scale - 1) & 1][i] : NULL;
+            stage.ll_dst[i] = scale < 3 ? s->ll[scale & 1][i] : NULL;
+        }
+        /* Nothing is left to transform of a cached reference. */
+        if (ref_cached)
+            stage.ll_dst[0] = NULL;
+        for (unsigned k = 0; k < 3 && record; k++)
+            stage.ref_bands[k] = (char *)record + s->ref_band_offset[scale][k];
+
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+
+        stage.w = w;
+        stage.h = h;
+        stage.n_bands = stage_bands(s, h);
+        vmaf_thread_pool_parallel_for(s->thread_pool, scale_band, &stage,
+                                      stage.n_bands);
+
+        /* Integer sums, added up in band order, give the same score for any
+         * number of bands. */
+        int64_t cm_accum[3] = { 0 };
+        uint64_t den_accum[3] = { 0 };
+        for (unsigned i = 0; i < stage.n_bands; i++) {
+            for (unsigned k = 0; k < 3; k++) {
+                cm_accum[k] += s->band[i].cm_accum[k];
+                den_accum[k] += s->band[i].den_accum[k];
+            }
+        }
+        if (ref_cached)
+            memcpy(den_accum, header->den_accum[scale], sizeof(den_accum));
+        else if (header)
+            memcpy(header->den_accum[scale], den_accum, sizeof(den_accum));
+
+        if (scale == 0) {
+            num_scale = adm_cm_num_scale(cm_accum, w, h);
+            den_scale = adm_den_scale(den_accum, w, h, adm_norm_view_dist,
+                                      adm_ref_display_height);
+        }
+        else {
+            num_scale = i4_adm_cm_num_scale(cm_accum, w, h, scale);
+            den_scale = i4_adm_den_scale(den_accum, scale, w, h,
+                                         adm_norm_view_dist,
+                                         adm_ref_display_height);
+        }
 
-		curr_ref_stride = buf_stride;
-		curr_dis_stride = buf_stride;
+        num += num_scale;
+        den += den_scale;
 
-		scores[2 * scale + 0] = num_scale;
-		scores[2 * scale + 1] = den_scale;
-	}
+        scores[2 * scale + 0] = num_scale;
+        scores[2 * scale + 1] = den_scale;
+    }
 
-	num = num < numden_limit ? 0 : num;
-	den = den < numden_limit ? 0 : den;
+    num = num < numden_limit ? 0 : num;
+    den = den < numden_limit ? 0 : den;
 
-	if (den == 0.0) {
-		*score = 1.0f;
-	}
-	else {
-		*score = num / den;
-	}
+    if (den == 0.0) {
+        *score = 1.0f;
+    }
+    else {
+        *score = num / den;
+    }
     *score_num = num;
     *score_den = den;
-
-}
-
-static inline void *init_dwt_band(adm_dwt_band_t *band, char *data_top, size_t stride)
-{
-    band->band_a = (int16_t *)data_top; data_top += stride;
-    band->band_h = (int16_t *)data_top; data_top += stride;
-    band->band_v = (int16_t *)data_top; data_top += stride;
-    band->band_d = (int16_t *)data_top; data_top += stride;
-    return data_top;
 }
 
 static inline void *init_index(int32_t **index, char *data_top, size_t stride)
@@ -2550,39 +2820,86 @@ static inline void *init_index(int32_t **index, char *data_top, size_t stride)
     return data_top;
 }
 
-static inline void *i4_init_dwt_band(i4_adm_dwt_band_t *band, char *data_top, size_t stride)
+static void close_bands(AdmState *s)
 {
-    band->band_a = (int32_t *)data_top; data_top += stride;
-    band->band_h = (int32_t *)data_top; data_top += stride;
-    band->band_v = (int32_t *)data_top; data_top += stride;
-    band->band_d = (int32_t *)data_top; data_top += stride;
-    return data_top;
+    if (!s->band) return;
+    for (unsigned i = 0; i < s->n_bands; i++) {
+        if (s->band[i].buf.data_buf) aligned_free(s->band[i].buf.data_buf);
+        if (s->band[i].buf.tmp_ref)  aligned_free(s->band[i].buf.tmp_ref);
+    }
+    free(s->band);
+    s->band = NULL;
 }
 
-static inline void *init_dwt_band_hvd(adm_dwt_band_t *band, char *data_top, size_t stride)
+static int init_bands(AdmState *s, unsigned h)
 {
-    band->band_a = NULL;
-    band->band_h = (int16_t *)data_top; data_top += stride;
-    band->band_v = (int16_t *)data_top; data_top += stride;
-    band->band_d = (int16_t *)data_top; data_top += stride;
-    return data_top;
+    /* Stages with rows to split use at most one band per pool thread. */
+    const unsigned n_threads = vmaf_thread_pool_n_threads(s->thread_pool);
+    s->n_bands = MAX(1, MIN((int)n_threads, (int)((h + 1) / 2) / ADM_MIN_BAND_ROWS));
+    s->band = calloc(s->n_bands, sizeof(*s->band));
+    if (!s->band) return -ENOMEM;
+
+    for (unsigned i = 0; i < s->n_bands; i++) {
+        AdmBuffer *buf = &s->band[i].buf;
+        *buf = s->buf;
+        buf->data_buf = aligned_malloc(s->buf.ind_size_x * ADM_TILE_ROWS_HELD *
+                                       NUM_BUFS_ADM, MAX_ALIGN);
+        if (!buf->data_buf) return -ENOMEM;
+        buf->tmp_ref = aligned_malloc(s->integer_stride * 2, MAX_ALIGN);
+        if (!buf->tmp_ref) return -ENOMEM;
+    }
+    return 0;
 }
 
-static inline void *i4_init_dwt_band_hvd(i4_adm_dwt_band_t *band, char *data_top, size_t stride)
+/* Lays the bands of each scale out after the header, at the tile stride and
+ * 32-byte aligned, with room for the kernels to read a vector past the last
+ * row. */
+static size_t layout_record(AdmState *s, unsigned h)
 {
-    band->band_a = NULL;
-    band->band_h = (int32_t *)data_top; data_top += stride;
-    band->band_v = (int32_t *)data_top; data_top += stride;
-    band->band_d = (int32_t *)data_top; data_top += stride;
-    return data_top;
+    const size_t stride = s->buf.ind_size_x >> 2;
+    size_t offset = ALIGN_CEIL(sizeof(AdmCacheHeader));
+    for (unsigned scale = 0; scale < 4; scale++) {
+        h = (h + 1) / 2;
+        const size_t sample_sz = scale ? sizeof(int32_t) : sizeof(int16_t);
+        for (unsigned k = 0; k < 3; k++) {
+            s->ref_band_offset[scale][k] = offset;
+            offset += ALIGN_CEIL(stride * h * sample_sz);
+        }
+    }
+    return offset + MAX_ALIGN;
+}
+
+static int init_reference_cache(AdmState *s, unsigned bpc, unsigned w,
+                                unsigned h)
+{
+    /* The dwt bands only depend on the picture, which the record layout
+     * follows, but the den sums weigh them by the viewing conditions. */
+    uint64_t nvd_bits;
+    memcpy(&nvd_bits, &s->adm_norm_view_dist, sizeof(nvd_bits));
+    uint64_t key = vmaf_reference_cache_hash_string(0, "integer_adm/1");
+    key = vmaf_reference_cache_hash_combine(key, w);
+    key = vmaf_reference_cache_hash_combine(key, h);
+    key = vmaf_reference_cache_hash_combine(key, bpc);
+    key = vmaf_reference_cache_hash_combine(key, nvd_bits);
+    key = vmaf_reference_cache_hash_combine(key, s->adm_ref_display_height);
+
+    const size_t record_size = layout_record(s, h);
+    s->record = aligned_malloc(record_size, MAX_ALIGN);
+    if (!s->record) return -ENOMEM;
+    /* Keep the padding of written records deterministic. */
+    memset(s->record, 0, record_size);
+
+    return vmaf_reference_cache_open(&s->reference_cache,
+                                     s->reference_cache_path, key,
+                                     record_size);
 }
 
 static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
                 unsigned bpc, unsigned w, unsigned h)
 {
     AdmState *s = fex->priv;
+    int err = -ENOMEM;
     (void) pix_fmt;
-    (void) bpc;
 
     if (w <= 32 || h <= 32) {
         vmaf_log(VMAF_LOG_LEVEL_ERROR,
@@ -2593,11 +2910,31 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
     }
 
     s->dwt2_8 = adm_dwt2_8;
+    s->dwt2_16 = adm_dwt2_16;
+    s->dwt2_s123 = adm_dwt2_s123;
+    s->decouple = adm_decouple;
+    s->decouple_s123 = adm_decouple_s123;
+    s->csf = adm_csf;
+    s->i4_csf = i4_adm_csf;
+    s->csf_den_scale = adm_csf_den_scale;
+    s->csf_den_s123 = adm_csf_den_s123;
+    s->cm = adm_cm;
+    s->i4_cm = i4_adm_cm;
 
 #if ARCH_X86
     unsigned flags = vmaf_get_cpu_flags();
     if (flags & VMAF_X86_CPU_FLAG_AVX2) {
-        if (!(w % 8)) s->dwt2_8 = adm_dwt2_8_avx2;
+        s->dwt2_8 = adm_dwt2_8_avx2;
+        s->dwt2_16 = adm_dwt2_16_avx2;
+        s->dwt2_s123 = adm_dwt2_s123_avx2;
+        s->decouple = adm_decouple_avx2;
+        s->decouple_s123 = adm_decouple_s123_avx2;
+        s->csf = adm_csf_avx2;
+        s->i4_csf = i4_adm_csf_avx2;
+        s->csf_den_scale = adm_csf_den_scale_avx2;
+        s->csf_den_s123 = adm_csf_den_s123_avx2;
+        s->cm = adm_cm_avx2;
+        s->i4_cm = i4_adm_cm_avx2;
     }
 #elif ARCH_AARCH64
     if (!(w % 8))
@@ -2607,53 +2944,54 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
     s->integer_stride   = ALIGN_CEIL(w * sizeof(int32_t));
     s->buf.ind_size_x   = ALIGN_CEIL(((w + 1) / 2) * sizeof(int32_t));
     s->buf.ind_size_y   = ALIGN_CEIL(((h + 1) / 2) * sizeof(int32_t));
-    size_t buf_sz_one   = s->buf.ind_size_x * ((h + 1) / 2);
 
-    s->buf.data_buf     = aligned_malloc(buf_sz_one * NUM_BUFS_ADM, MAX_ALIGN);
-    if (!s->buf.data_buf) goto fail;
-    s->buf.tmp_ref      = aligned_malloc(s->integer_stride * 4, MAX_ALIGN);
-    if (!s->buf.tmp_ref) goto fail;
     s->buf.buf_x_orig   = aligned_malloc(s->buf.ind_size_x * 4, MAX_ALIGN);
     if (!s->buf.buf_x_orig) goto fail;
     s->buf.buf_y_orig   = aligned_malloc(s->buf.ind_size_y * 4, MAX_ALIGN);
     if (!s->buf.buf_y_orig) goto fail;
 
-    void *data_top = s->buf.data_buf;
-    data_top = init_dwt_band(&s->buf.ref_dwt2, data_top, buf_sz_one / 2);
-    data_top = init_dwt_band(&s->buf.dis_dwt2, data_top, buf_sz_one / 2);
-    data_top = init_dwt_band_hvd(&s->buf.decouple_r, data_top, buf_sz_one / 2);
-    data_top = init_dwt_band_hvd(&s->buf.decouple_a, data_top, buf_sz_one / 2);
-    data_top = init_dwt_band_hvd(&s->buf.csf_a, data_top, buf_sz_one / 2);
-    data_top = init_dwt_band_hvd(&s->buf.csf_f, data_top, buf_sz_one / 2);
-
-    data_top = i4_init_dwt_band(&s->buf.i4_ref_dwt2, data_top, buf_sz_one);
-    data_top = i4_init_dwt_band(&s->buf.i4_dis_dwt2, data_top, buf_sz_one);
-    data_top = i4_init_dwt_band_hvd(&s->buf.i4_decouple_r, data_top, buf_sz_one);
-    data_top = i4_init_dwt_band_hvd(&s->buf.i4_decouple_a, data_top, buf_sz_one);
-    data_top = i4_init_dwt_band_hvd(&s->buf.i4_csf_a, data_top, buf_sz_one);
-    data_top = i4_init_dwt_band_hvd(&s->buf.i4_csf_f, data_top, buf_sz_one);
-
     void *ind_buf_y = s->buf.buf_y_orig;
     init_index(s->buf.ind_y, ind_buf_y, s->buf.ind_size_y);
     void *ind_buf_x = s->buf.buf_x_orig;
     init_index(s->buf.ind_x, ind_buf_x, s->buf.ind_size_x);
 
+    /* Approximation bands of scale 0 and scale 1, for ref and dis. */
+    const size_t ll_sz_0 = s->buf.ind_size_x * ((h + 1) / 2);
+    const size_t ll_sz_1 = s->buf.ind_size_x * ((h + 3) / 4);
+    s->ll_buf = aligned_malloc(2 * (ll_sz_0 + ll_sz_1), MAX_ALIGN);
+    if (!s->ll_buf) goto fail;
+    char *ll_top = s->ll_buf;
+    s->ll[0][0] = (int32_t *)ll_top; ll_top += ll_sz_0;
+    s->ll[0][1] = (int32_t *)ll_top; ll_top += ll_sz_0;
+    s->ll[1][0] = (int32_t *)ll_top; ll_top += ll_sz_1;
+    s->ll[1][1] = (int32_t *)ll_top;
+
     div_lookup_generator();
 
+    s->thread_pool = fex->thread_pool;
+    if (init_bands(s, h)) goto fail;
+
     s->feature_name_dict =
         vmaf_feature_name_dict_from_provided_features(fex->provided_features,
                 fex->options, s);
     if (!s->feature_name_dict) goto fail;
 
+    if (s->reference_cache_path) {
+        err = init_reference_cache(s, bpc, w, h);
+        if (err) goto fail;
+    }
+
     return 0;
 
 fail:
-    if (s->buf.data_buf)    aligned_free(s->buf.data_buf);
-    if (s->buf.tmp_ref)     aligned_free(s->buf.tmp_ref);
     if (s->buf.buf_x_orig)  aligned_free(s->buf.buf_x_orig);
     if (s->buf.buf_y_orig)  aligned_free(s->buf.buf_y_orig);
+    if (s->ll_buf)          aligned_free(s->ll_buf);
+    if (s->record)          aligned_free(s->record);
+    s->record = NULL;
+    close_bands(s);
     vmaf_dictionary_free(&s->feature_name_dict);
-    return -ENOMEM;
+    return err;
 }
 
 static int extract(VmafFeatureExtractor *fex,
@@ -2677,10 +3015,30 @@ static int extract(VmafFeatureExtractor *fex,
         return -EINVAL;
     }
 
+    /* With a cache, the reference bands are read from its record on a hit,
+     * which is mapped read-only, or written to a record of ours on a miss. */
+    uint64_t content_hash = 0;
+    void *record = NULL;
+    bool ref_cached = false;
+    if (s->reference_cache) {
+        content_hash = vmaf_reference_cache_hash_luma(ref_pic);
+        const void *cached = vmaf_reference_cache_find(s->reference_cache,
+                                                       index, content_hash);
+        ref_cached = cached != NULL;
+        record = cached ? (void *)cached : s->record;
+    }
+
     integer_compute_adm(s, ref_pic, dist_pic, &score, &score_num, &score_den,
                         scores, &s->buf,
                         s->adm_enhn_gain_limit,
-                        s->adm_norm_view_dist, s->adm_ref_display_height);
+                        s->adm_norm_view_dist, s->adm_ref_display_height,
+                        record, ref_cached);
+
+    if (record && !ref_cached) {
+        err = vmaf_reference_cache_store(s->reference_cache, index,
+                                         content_hash, record);
+        if (err) return err;
+    }
 
     err |= vmaf_feature_collector_append_with_dict(feature_collector,
             s->feature_name_dict, "VMAF_integer_feature_adm2_score", score,
@@ -2743,14 +3101,18 @@ static int extract(VmafFeatureExtractor *fex,
 static int close(VmafFeatureExtractor *fex)
 {
     AdmState *s = fex->priv;
+    int err = 0;
 
-    if (s->buf.data_buf)    aligned_free(s->buf.data_buf);
-    if (s->buf.tmp_ref)     aligned_free(s->buf.tmp_ref);
     if (s->buf.buf_x_orig)  aligned_free(s->buf.buf_x_orig);
     if (s->buf.buf_y_orig)  aligned_free(s->buf.buf_y_orig);
+    if (s->ll_buf)          aligned_free(s->ll_buf);
+    if (s->record)          aligned_free(s->record);
+    if (s->reference_cache)
+        err = vmaf_reference_cache_close(s->reference_cache);
+    close_bands(s);
     vmaf_dictionary_free(&s->feature_name_dict);
 
-    return 0;
+    return err;
 }
 
 static const char *provided_features[] = {
@@ -8,7 +8,8 @@
 #include <stdint.h>
 #include <string.h>
 
-static int32_t div_lookup[65537];
+/* Shared by the C and SIMD kernels, filled in by div_lookup_generator(). */
+extern int32_t div_lookup[65537];
 static const int32_t div_Q_factor = 1073741824; // 2^30
 
 static inline void div_lookup_generator() {
@@ -35,8 +36,8 @@ typedef struct i4_adm_dwt_band_t {
 
 typedef struct AdmBuffer {
     size_t ind_size_x, ind_size_y; // strides size for intermidate buffers
-    void *data_buf;   // buffer for adm intermidiate data calculations
-    void *tmp_ref;    // buffer for adm intermidiate data calculations
+    void *data_buf;   // tile scratch for the intermediate bands of a strip of rows
+    void *tmp_ref;    // row scratch for the dwt
     void *buf_x_orig; // buffer for storing imgcoeff values along x.
     void *buf_y_orig; // buffer for storing imgcoeff values along y.
     int *ind_y[4], *ind_x[4];
@@ -56,8 +57,9 @@ typedef struct AdmBuffer {
     i4_adm_dwt_band_t i4_csf_f;
 } AdmBuffer;
 
+/* Tile scratch slots: a, h, v, d of ref and dis, h, v, d of the rest. */
 #ifndef NUM_BUFS_ADM
-#define NUM_BUFS_ADM 30
+#define NUM_BUFS_ADM 20
 #endif
 
 #ifndef M_PI
@@ -155,4 +157,33 @@ static const float dwt_7_9_basis_function_amplitudes[6][4] = {
     {0.045943, 0.059758, 0.077727, 0.059758},
     {0.023013, 0.030018, 0.039156, 0.030018}};
 
+/*
+ * lambda = 0 (finest scale), 1, 2, 3 (coarsest scale);
+ * theta = 0 (ll), 1 (lh - vertical), 2 (hh - diagonal), 3(hl - horizontal).
+ */
+static inline float
+dwt_quant_step(const struct dwt_model_params *params, int lambda, int theta,
+        double adm_norm_view_dist, int adm_ref_display_height)
+{
+    // Formula (1), page 1165 - display visual resolution (DVR), in pixels/degree
+    // of visual angle. This should be 56.55
+    float r = adm_norm_view_dist * adm_ref_display_height * M_PI / 180.0;
+
+    // Formula (9), page 1171
+    float temp = log10(pow(2.0, lambda + 1)*params->f0*params->g[theta] / r);
+    float Q = 2.0*params->a*pow(10.0, params->k*temp*temp) /
+        dwt_7_9_basis_function_amplitudes[lambda][theta];
+
+    return Q;
+}
+
+static inline uint16_t get_best15_from32(uint32_t temp, int *x)
+{
+    int k = __builtin_clz(temp);    //built in for intel
+    k = 17 - k;
+    temp = (temp + (1 << (k - 1))) >> k;
+    *x = k;
+    return temp;
+}
+
 #endif /* _FEATURE_ADM_H_ */
@@ -0,0 +1,168 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "libavcodec/avcodec.h"
+#include "libavformat/avformat.h"
+#include "libvmaf.h"
+}
+
+#include "feature_test_util.h"
+#include "runfiles_util.h"
+
+namespace {
+
+// Every feature the "adm" extractor writes with debug enabled.
+const std::vector<std::string> kAdmFeatures = {
+    "VMAF_integer_feature_adm2_score",
+    "integer_adm_scale0",
+    "integer_adm_scale1",
+    "integer_adm_scale2",
+    "integer_adm_scale3",
+    "integer_adm",
+    "integer_adm_num",
+    "integer_adm_den",
+    "integer_adm_num_scale0",
+    "integer_adm_den_scale0",
+    "integer_adm_num_scale1",
+    "integer_adm_den_scale1",
+    "integer_adm_num_scale2",
+    "integer_adm_den_scale2",
+    "integer_adm_num_scale3",
+    "integer_adm_den_scale3",
+};
+
+using vmaf_test::Frame;
+
+Frame NoiseFrame(unsigned w, unsigned h, unsigned bpc, std::mt19937* rng) {
+  Frame f = {w, h, bpc, std::vector<uint16_t>(w * h)};
+  std::uniform_int_distribution<int> sample(0, (1 << bpc) - 1);
+  for (uint16_t& v : f.luma) v = sample(*rng);
+  return f;
+}
+
+// Blurs, adds noise and clips, so that the distorted frame both loses and
+// gains detail against the reference and exercises every masking branch.
+Frame Distort(const Frame& ref, std::mt19937* rng) {
+  Frame f = ref;
+  const int max = (1 << ref.bpc) - 1;
+  std::normal_distribution<double> noise(0.0, max / 64.0);
+  for (unsigned y = 0; y < ref.h; y++) {
+    for (unsigned x = 0; x < ref.w; x++) {
+      const unsigned l = x ? x - 1 : x, r = x + 1 < ref.w ? x + 1 : x;
+      const uint16_t* row = &ref.luma[y * ref.w];
+      int v = (row[l] + 2 * row[x] + row[r] + 2) / 4;
+      v += static_cast<int>(noise(*rng));
+      f.luma[y * ref.w + x] = v < 0 ? 0 : v > max ? max : v;
+    }
+  }
+  return f;
+}
+
+// Decodes the luma plane of up to max_frames frames of an 8-bit video.
+std::vector<Frame> DecodeLuma(const std::string& path, unsigned max_frames) {
+  std::vector<Frame> frames;
+  AVFormatContext* fmt = nullptr;
+  if (avformat_open_input(&fmt, path.c_str(), nullptr, nullptr) < 0)
+    return frames;
+  const AVCodec* codec = nullptr;
+  const int stream = av_find_best_stream(fmt, AVMEDIA_TYPE_VIDEO, -1, -1,
+                                         &codec, 0);
+  AVCodecContext* dec = stream >= 0 ? avcodec_alloc_context3(codec) : nullptr;
+  if (!dec ||
+      avcodec_parameters_to_context(dec, fmt->streams[stream]->codecpar) < 0 ||
+      avcodec_open2(dec, codec, nullptr) < 0) {
+    avcodec_free_context(&dec);
+    avformat_close_input(&fmt);
+    return frames;
+  }
+
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* frame = av_frame_alloc();
+  bool draining = false;
+  while (frames.size() < max_frames) {
+    if (!draining) {
+      if (av_read_frame(fmt, pkt) < 0) {
+        draining = true;
+        avcodec_send_packet(dec, nullptr);
+      } else {
+        if (pkt->stream_index == stream) avcodec_send_packet(dec, pkt);
+        av_packet_unref(pkt);
+      }
+    }
+    const int err = avcodec_receive_frame(dec, frame);
+    if (err == AVERROR(EAGAIN) && !draining) continue;
+    if (err < 0) break;
+    Frame f = {static_cast<unsigned>(frame->width),
+               static_cast<unsigned>(frame->height), 8,
+               std::vector<uint16_t>(frame->width * frame->height)};
+    for (unsigned y = 0; y < f.h; y++) {
+      const uint8_t* row = frame->data[0] + y * frame->linesize[0];
+      for (unsigned x = 0; x < f.w; x++) f.luma[y * f.w + x] = row[x];
+    }
+    frames.push_back(f);
+    av_frame_unref(frame);
+  }
+  av_frame_free(&frame);
+  av_packet_free(&pkt);
+  avcodec_free_context(&dec);
+  avformat_close_input(&fmt);
+  return frames;
+}
+
+class IntegerAdmTest : public testing::Test {
+ protected:
+  void ExpectSimdMatchesC(const std::vector<Frame>& ref,
+                          const std::vector<Frame>& dist) {
+    // A cpumask of 0 lets the extractor use whatever the host supports.
+    vmaf_test::ExpectMatchesC(ref, dist, {"adm"}, kAdmFeatures, 0);
+  }
+
+  std::mt19937 rng_{20240601};
+};
+
+TEST_F(IntegerAdmTest, SimdMatchesCOnNoise) {
+  // A narrow, tall picture on top of the shared sizes, which leaves a partial
+  // vector at every scale of the vertical pass.
+  std::vector<std::vector<unsigned>> sizes = {{47, 300}};
+  for (const auto& size : vmaf_test::kEdgeSizes)
+    sizes.push_back({size[0], size[1]});
+  for (unsigned bpc : {8u, 10u}) {
+    for (const auto& size : sizes) {
+      std::vector<Frame> ref, dist;
+      for (int i = 0; i < 2; i++) {
+        ref.push_back(NoiseFrame(size[0], size[1], bpc, &rng_));
+        dist.push_back(Distort(ref.back(), &rng_));
+      }
+      ExpectSimdMatchesC(ref, dist);
+    }
+  }
+}
+
+TEST_F(IntegerAdmTest, SimdMatchesCOnVideo) {
+  const std::vector<Frame> ref =
+      DecodeLuma(tools::GetModelRunfilesPathForTest() + "720p.mp4", 3);
+  ASSERT_FALSE(ref.empty()) << "Failed to decode 720p.mp4";
+
+  std::vector<Frame> dist;
+  for (const Frame& f : ref) dist.push_back(Distort(f, &rng_));
+  ExpectSimdMatchesC(ref, dist);
+
+  // The same content at 10 bits.
+  std::vector<Frame> ref10 = ref, dist10 = dist;
+  for (Frame& f : ref10) {
+    f.bpc = 10;
+    for (uint16_t& v : f.luma) v <<= 2;
+  }
+  for (Frame& f : dist10) {
+    f.bpc = 10;
+    for (uint16_t& v : f.luma) v <<= 2;
+  }
+  ExpectSimdMatchesC(ref10, dist10);
+}
+
+}  // namespace
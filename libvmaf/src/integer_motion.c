@@ -29,11 +29,15 @@
 #include "integer_motion.h"
 #include "mem.h"
 #include "picture.h"
+#include "reference_cache.h"
 
+#if HAVE_VEC
+#include "libvmaf/feature/vec/motion_vec.h"
+#endif
 #if ARCH_X86
-#include "x86/motion_avx2.h"
+#include "libvmaf/feature/x86/motion_avx2.h"
 #if HAVE_AVX512
-#include "x86/motion_avx512.h"
+#include "libvmaf/feature/x86/motion_avx512.h"
 #endif
 #endif
 
@@ -52,8 +56,19 @@ typedef struct MotionState {
                           ptrdiff_t dst_stride);
     void (*sad)(VmafPicture *pic_a, VmafPicture *pic_b, uint64_t *sad);
     VmafDictionary *feature_name_dict;
+    char *reference_cache_path;
+    VmafReferenceCache *reference_cache;
+    uint64_t ref_hash[3];
+    /* Blurs skipped on cache hits are rebuilt from these on a later miss. */
+    VmafPicture ref[3];
+    bool blur_valid[3];
 } MotionState;
 
+/* Everything integer_motion derives from the reference for one picture. */
+typedef struct MotionCacheRecord {
+    uint64_t sad, sad2;
+} MotionCacheRecord;
+
 static const VmafOption options[] = {
     {
         .name = "debug",
@@ -71,6 +86,15 @@ static const VmafOption options[] = {
         .default_val.b = false,
         .flags = VMAF_OPT_FLAG_FEATURE_PARAM,
     },
+    {
+        .name = "reference_cache",
+        .help = "path of a file caching reference-side motion intermediates "
+                "across runs against the same source, to which a key of the "
+                "options is appended",
+        .offset = offsetof(MotionState, reference_cache_path),
+        .type = VMAF_OPT_TYPE_STRING,
+        .default_val.s = NULL,
+    },
     { 0 }
 };
 
@@ -274,6 +298,7 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
 {
     MotionState *s = fex->priv;
     int err = 0;
+    (void) pix_fmt;
 
     s->feature_name_dict =
         vmaf_feature_name_dict_from_provided_features(fex->provided_features,
@@ -295,6 +320,15 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
 
     s->y_convolution = bpc == 8 ? y_convolution_8 : y_convolution_16;
     s->x_convolution = x_convolution_16;
+    s->sad = sad_c;
+
+#if HAVE_VEC
+    if (vmaf_cpu_vec_enabled()) {
+        s->y_convolution = bpc == 8 ? y_convolution_8_vec : y_convolution_16_vec;
+        s->x_convolution = x_convolution_16_vec;
+        s->sad = sad_vec;
+    }
+#endif
 
 #if ARCH_X86
     unsigned flags = vmaf_get_cpu_flags();
@@ -306,9 +340,17 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
 #endif
 #endif
 
-    s->sad = sad_c;
     s->score = 0.;
 
+    if (s->reference_cache_path) {
+        const uint64_t key =
+            vmaf_reference_cache_hash_string(0, "integer_motion/2");
+        err = vmaf_reference_cache_open(&s->reference_cache,
+                                        s->reference_cache_path, key,
+                                        sizeof(MotionCacheRecord));
+        if (err) goto fail;
+    }
+
     return 0;
 
 fail:
@@ -341,23 +383,8 @@ static inline double normalize_and_scale_sad(uint64_t sad,
     return (float) (sad / 256.) / (w * h);
 }
 
-static int extract(VmafFeatureExtractor *fex,
-                   VmafPicture *ref_pic, VmafPicture *ref_pic_90,
-                   VmafPicture *dist_pic, VmafPicture *dist_pic_90,
-                   unsigned index, VmafFeatureCollector *feature_collector)
+static void blur(MotionState *s, VmafPicture *ref_pic, VmafPicture *dst)
 {
-    MotionState *s = fex->priv;
-    int err = 0;
-
-    (void) dist_pic;
-    (void) ref_pic_90;
-    (void) dist_pic_90;
-
-    s->index = index;
-    const unsigned blur_idx_0 = (index + 0) % 3;
-    const unsigned blur_idx_1 = (index + 1) % 3;
-    const unsigned blur_idx_2 = (index + 2) % 3;
-
     const ptrdiff_t y_src_stride =
         ref_pic->bpc == 8 ? ref_pic->stride[0] : ref_pic->stride[0] / 2;
 
@@ -365,9 +392,25 @@ static int extract(VmafFeatureExtractor *fex,
                      ref_pic->h[0], y_src_stride, s->tmp.stride[0] / 2,
                      ref_pic->bpc);
 
-    s->x_convolution(s->tmp.data[0], s->blur[blur_idx_0].data[0],
+    s->x_convolution(s->tmp.data[0], dst->data[0],
                      s->tmp.w[0], s->tmp.h[0], s->tmp.stride[0] / 2,
-                     s->blur[blur_idx_0].stride[0] / 2);
+                     dst->stride[0] / 2);
+}
+
+/* Blurs the picture kept in slot idx if a cache hit skipped it. */
+static void restore_blur(MotionState *s, unsigned idx)
+{
+    if (s->blur_valid[idx]) return;
+    blur(s, &s->ref[idx], &s->blur[idx]);
+    s->blur_valid[idx] = true;
+    vmaf_picture_unref(&s->ref[idx]);
+}
+
+static int append_scores(MotionState *s, unsigned index,
+                         MotionCacheRecord *record, unsigned w, unsigned h,
+                         VmafFeatureCollector *feature_collector)
+{
+    int err = 0;
 
     if (index == 0) {
         err = vmaf_feature_collector_append(feature_collector,
@@ -381,10 +424,7 @@ static int extract(VmafFeatureExtractor *fex,
         return err;
     }
 
-    uint64_t sad;
-    s->sad(&s->blur[blur_idx_2], &s->blur[blur_idx_0], &sad);
-    double score = s->score =
-        normalize_and_scale_sad(sad, ref_pic->w[0], ref_pic->h[0]);
+    double score = s->score = normalize_and_scale_sad(record->sad, w, h);
 
     if (s->debug) {
         err |= vmaf_feature_collector_append(feature_collector,
@@ -396,9 +436,7 @@ static int extract(VmafFeatureExtractor *fex,
     if (index == 1)
         return 0;
 
-    uint64_t sad2;
-    s->sad(&s->blur[blur_idx_2], &s->blur[blur_idx_1], &sad2);
-    double score2 = normalize_and_scale_sad(sad2, ref_pic->w[0], ref_pic->h[0]);
+    double score2 = normalize_and_scale_sad(record->sad2, w, h);
 
     score2 = score2 < score ? score2 : score;
     err = vmaf_feature_collector_append(feature_collector,
@@ -407,6 +445,72 @@ static int extract(VmafFeatureExtractor *fex,
     return err;
 }
 
+static int extract(VmafFeatureExtractor *fex,
+                   VmafPicture *ref_pic, VmafPicture *ref_pic_90,
+                   VmafPicture *dist_pic, VmafPicture *dist_pic_90,
+                   unsigned index, VmafFeatureCollector *feature_collector)
+{
+    MotionState *s = fex->priv;
+    int err = 0;
+
+    (void) dist_pic;
+    (void) ref_pic_90;
+    (void) dist_pic_90;
+
+    s->index = index;
+    const unsigned blur_idx_0 = (index + 0) % 3;
+    const unsigned blur_idx_1 = (index + 1) % 3;
+    const unsigned blur_idx_2 = (index + 2) % 3;
+
+    MotionCacheRecord record = { 0 };
+    uint64_t record_hash = 0;
+
+    if (s->reference_cache) {
+        /* A record depends on this picture and the two before it. */
+        s->ref_hash[blur_idx_0] = vmaf_reference_cache_hash_luma(ref_pic);
+        record_hash = s->ref_hash[blur_idx_0];
+        if (index >= 1)
+            record_hash = vmaf_reference_cache_hash_combine(record_hash,
+                                                           s->ref_hash[blur_idx_2]);
+        if (index >= 2)
+            record_hash = vmaf_reference_cache_hash_combine(record_hash,
+                                                           s->ref_hash[blur_idx_1]);
+
+        if (vmaf_reference_cache_lookup(s->reference_cache, index,
+                                        record_hash, &record) == 1)
+        {
+            vmaf_picture_unref(&s->ref[blur_idx_0]);
+            err = vmaf_picture_ref(&s->ref[blur_idx_0], ref_pic);
+            if (err) return err;
+            s->blur_valid[blur_idx_0] = false;
+            return append_scores(s, index, &record, ref_pic->w[0],
+                                 ref_pic->h[0], feature_collector);
+        }
+    }
+
+    blur(s, ref_pic, &s->blur[blur_idx_0]);
+    s->blur_valid[blur_idx_0] = true;
+    vmaf_picture_unref(&s->ref[blur_idx_0]);
+
+    if (index >= 1) {
+        restore_blur(s, blur_idx_2);
+        s->sad(&s->blur[blur_idx_2], &s->blur[blur_idx_0], &record.sad);
+    }
+    if (index >= 2) {
+        restore_blur(s, blur_idx_1);
+        s->sad(&s->blur[blur_idx_2], &s->blur[blur_idx_1], &record.sad2);
+    }
+
+    if (s->reference_cache) {
+        err = vmaf_reference_cache_store(s->reference_cache, index,
+                                         record_hash, &record);
+        if (err) return err;
+    }
+
+    return append_scores(s, index, &record, ref_pic->w[0], ref_pic->h[0],
+                         feature_collector);
+}
+
 static int close(VmafFeatureExtractor *fex)
 {
     MotionState *s = fex->priv;
@@ -417,6 +521,10 @@ static int close(VmafFeatureExtractor *fex)
     err |= vmaf_picture_unref(&s->blur[2]);
     err |= vmaf_picture_unref(&s->tmp);
     err |= vmaf_dictionary_free(&s->feature_name_dict);
+    for (unsigned i = 0; i < 3; i++)
+        vmaf_picture_unref(&s->ref[i]);
+    if (s->reference_cache)
+        err |= vmaf_reference_cache_close(s->reference_cache);
     return err;
 }
 
@@ -264,5 +264,5 @@ VmafFeatureExtractor vmaf_fex_psnr = {
     .flush = flush,
     .priv_size = sizeof(PsnrState),
     .provided_features = provided_features,
-    .flags = VMAF_FEATURE_EXTRACTOR_TEMPORAL,
+    .flags = VMAF_FEATURE_EXTRACTOR_TEMPORAL | VMAF_FEATURE_EXTRACTOR_CHROMA,
 };
@@ -31,26 +31,66 @@
 
 #include "picture.h"
 #include "integer_vif.h"
+#include "reference_cache.h"
 
+#if HAVE_VEC
+#include "libvmaf/feature/vec/vif_vec.h"
+#endif
 #if ARCH_X86
-#include "x86/vif_avx2.h"
+#include "libvmaf/feature/x86/vif_avx2.h"
 #if HAVE_AVX512
-#include "x86/vif_avx512.h"
+#include "libvmaf/feature/x86/vif_avx512.h"
 #endif
 #elif ARCH_AARCH64
 #include "arm64/vif_neon.h"
 #endif
 
+/* Bands are never shorter than this, so that the rows each band reads from
+ * its neighbours stay a small fraction of its work. */
+#define VIF_MIN_BAND_ROWS 32
+
+/* A horizontal band of the picture, with row buffers of its own. */
+typedef struct VifBand {
+    VifPublicState public;
+    void *data;
+    VifResiduals residuals;
+    VifResiduals ref_residuals;
+} VifBand;
+
 typedef struct VifState {
     VifPublicState public;
+    uint16_t log2_table[65537];
     bool debug;
-    void (*subsample_rd_8)(VifBuffer buf, unsigned w, unsigned h);
-    void (*subsample_rd_16)(VifBuffer buf, unsigned w, unsigned h, int scale, int bpc);
-    void (*vif_statistic_8)(VifPublicState *s, float *num, float *den, unsigned w, unsigned h);
-    void (*vif_statistic_16)(VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale);
+    void (*subsample_rd_8)(VifBuffer buf, unsigned w, unsigned y0, unsigned y1);
+    void (*subsample_rd_16)(VifBuffer buf, unsigned w, unsigned y0, unsigned y1, int scale, int bpc);
+    void (*decimate_and_pad_8)(VifBuffer buf, unsigned w, unsigned h, int scale);
+    void (*decimate_and_pad_16)(VifBuffer buf, unsigned w, unsigned h, int scale);
+    void (*vif_statistic_8)(VifPublicState *s, VifResiduals *out, unsigned w, unsigned h);
+    void (*vif_statistic_16)(VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+    void (*vif_statistic_ref_8)(VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+    void (*vif_statistic_dis_8)(VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+    void (*vif_statistic_ref_16)(VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+    void (*vif_statistic_dis_16)(VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+    VmafThreadPool *thread_pool;
+    VifBand *band;
+    unsigned n_bands;
     VmafDictionary *feature_name_dict;
+    char *reference_cache_path;
+    VmafReferenceCache *reference_cache;
+    /* Where the reference statistics of each scale start in a record. */
+    size_t mu1_offset[4], sigma1_sq_offset[4];
+    /* The record filled in on a cache miss. */
+    void *record;
 } VifState;
 
+/*
+ * Everything integer_vif derives from the reference for one picture: the den
+ * sums of each scale, followed by the mu1 and sigma1_sq planes of each scale.
+ */
+typedef struct VifCacheHeader {
+    VifResiduals ref_residuals[4];
+} VifCacheHeader;
+
 static const VmafOption options[] = {
     {
         .name = "debug",
@@ -71,6 +111,15 @@ static const VmafOption options[] = {
         .max = DEFAULT_VIF_ENHN_GAIN_LIMIT,
         .flags = VMAF_OPT_FLAG_FEATURE_PARAM,
     },
+    {
+        .name = "reference_cache",
+        .help = "path of a file caching reference-side vif intermediates "
+                "across runs against the same source, to which a key of the "
+                "options is appended",
+        .offset = offsetof(VifState, reference_cache_path),
+        .type = VMAF_OPT_TYPE_STRING,
+        .default_val.s = NULL,
+    },
     { 0 }
 };
 
@@ -93,8 +142,7 @@ pad_top_and_bottom(VifBuffer buf, unsigned h, int fwidth)
     }
 }
 
-static FORCE_INLINE inline void
-decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
+static void decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
 {
     uint16_t *ref = buf.ref;
     uint16_t *dis = buf.dis;
@@ -110,12 +158,12 @@ decimate_and_pad(VifBuffer buf, unsigned w, unsigned h, int scale)
     pad_top_and_bottom(buf, h / 2, vif_filter1d_width[scale]);
 }
 
-static void subsample_rd_8(VifBuffer buf, unsigned w, unsigned h)
+static void subsample_rd_8(VifBuffer buf, unsigned w, unsigned y0, unsigned y1)
 {
     const unsigned fwidth = vif_filter1d_width[1];
     const uint16_t *vif_filt_s1 = vif_filter1d_table[1];
 
-    for (unsigned i = 0; i < h; ++i) {
+    for (unsigned i = y0; i < y1; ++i) {
         //VERTICAL
         for (unsigned j = 0; j < w; ++j) {
             uint32_t accum_ref = 0;
@@ -151,10 +199,9 @@ static void subsample_rd_8(VifBuffer buf, unsigned w, unsigned h)
             buf.mu2[i * stride + j] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
-    decimate_and_pad(buf, w, h, 0);
 }
 
-static void subsample_rd_16(VifBuffer buf, unsigned w, unsigned h, int scale, int bpc)
+static void subsample_rd_16(VifBuffer buf, unsigned w, unsigned y0, unsigned y1, int scale, int bpc)
 {
     const unsigned fwidth = vif_filter1d_width[scale + 1];
     const uint16_t *vif_filt = vif_filter1d_table[scale + 1];
@@ -169,7 +216,7 @@ static void subsample_rd_16(VifBuffer buf, unsigned w, unsigned h, int scale, in
         shift_VP = 16;
     }
 
-    for (unsigned i = 0; i < h; ++i) {
+    for (unsigned i = y0; i < y1; ++i) {
         //VERTICAL
         for (unsigned j = 0; j < w; ++j) {
             uint32_t accum_ref = 0;
@@ -206,7 +253,6 @@ static void subsample_rd_16(VifBuffer buf, unsigned w, unsigned h, int scale, in
             buf.mu2[i * stride + j] = (uint16_t)((accum_dis + 32768) >> 16);
         }
     }
-    decimate_and_pad(buf, w, h, scale);
 }
 
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
@@ -219,7 +265,7 @@ static inline void log_generate(uint16_t *log2_table)
     }
 }
 
-void vif_statistic_8(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h) {
+void vif_statistic_8(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h) {
     const unsigned fwidth = vif_filter1d_width[0];
     const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
     VifBuffer buf = s->buf;
@@ -338,11 +384,13 @@ void vif_statistic_8(struct VifPublicState *s, float *num, float *den, unsigned
             }
         }
     }
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
-void vif_statistic_16(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale) {
+void vif_statistic_16(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale) {
     const unsigned fwidth = vif_filter1d_width[scale];
     const uint16_t *vif_filt = vif_filter1d_table[scale];
     VifBuffer buf = s->buf;
@@ -481,42 +529,26 @@ void vif_statistic_16(struct VifPublicState *s, float *num, float *den, unsigned
             }
         }
     }
-    num[0] = accum_num_log / 2048.0 + (accum_den_non_log - ((accum_num_non_log) / 16384.0) / (65025.0));
-    den[0] = accum_den_log / 2048.0 + accum_den_non_log;
+    out->accum_num_log = accum_num_log;
+    out->accum_den_log = accum_den_log;
+    out->accum_num_non_log = accum_num_non_log;
+    out->accum_den_non_log = accum_den_non_log;
 }
 
 VifResiduals vif_compute_line_residuals(VifPublicState *s, unsigned from,
-                                        unsigned to, int bpc, int scale)
+                                        unsigned to, int scale)
 {
     VifResiduals residuals = { 0 };
     const unsigned fwidth = vif_filter1d_width[scale];
     const uint16_t *vif_filt = vif_filter1d_table[scale];
     VifBuffer buf = s->buf;
-    int32_t add_shift_round_HP, shift_HP;
-//  int32_t add_shift_round_VP, shift_VP;
-//  int32_t add_shift_round_VP_sq;
-   // int32_t shift_VP_sq;
+    // The vertical pass already brought every scale to 16 bits.
+    const int32_t shift_HP = 16;
+    const int32_t add_shift_round_HP = 32768;
     const uint16_t *log2_table = s->log2_table;
     double vif_enhn_gain_limit = s->vif_enhn_gain_limit;
     static const int32_t sigma_nsq = 65536 << 1;
 
-    if (scale == 0) {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
-        // shift_VP = bpc;
-        // add_shift_round_VP = 1 << (bpc - 1);
-       // shift_VP_sq = (bpc - 8) * 2;
-       // add_shift_round_VP_sq = (bpc == 8) ? 0 : 1 << (shift_VP_sq - 1);
-    }
-    else {
-        shift_HP = 16;
-        add_shift_round_HP = 32768;
-        // shift_VP = 16;
-       // add_shift_round_VP = 32768;
-       // shift_VP_sq = 16;
-        // add_shift_round_VP_sq = 32768;
-    }
-
     //HORIZONTAL
     for (unsigned j = from; j < to; ++j) {
         uint32_t accum_mu1 = 0;
@@ -593,6 +625,312 @@ VifResiduals vif_compute_line_residuals(VifPublicState *s, unsigned from,
 }
 
 
+/* Horizontal pass of the reference over a vertically filtered row. */
+static void ref_stats_row(VifPublicState *s, VifRefStats ref_stats,
+                          unsigned i, unsigned w, int scale, VifResiduals *r)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    uint32_t *mu1 = ref_stats.mu1 + i * ref_stats.stride;
+    int32_t *sigma1_sq = ref_stats.sigma1_sq + i * ref_stats.stride;
+
+    vif_pad_row(buf.tmp.mu1, w, fwidth / 2);
+    vif_pad_row(buf.tmp.ref, w, fwidth / 2);
+
+    for (unsigned j = 0; j < w; ++j) {
+        uint32_t accum_mu1 = 0;
+        uint64_t accum_ref = 0;
+        for (unsigned fj = 0; fj < fwidth; ++fj) {
+            int jj_check = j - fwidth / 2 + fj;
+            const uint16_t fcoeff = vif_filt[fj];
+            accum_mu1 += fcoeff * ((uint32_t)buf.tmp.mu1[jj_check]);
+            accum_ref += fcoeff * ((uint64_t)buf.tmp.ref[jj_check]);
+        }
+        uint32_t mu1_sq_val = (uint32_t)((((uint64_t)accum_mu1 * accum_mu1)
+            + 2147483648) >> 32);
+        uint32_t xx_filt_val = (uint32_t)((accum_ref + 32768) >> 16);
+
+        mu1[j] = accum_mu1;
+        sigma1_sq[j] = (int32_t)(xx_filt_val - mu1_sq_val);
+        vif_accumulate_den(r, s->log2_table, sigma1_sq[j]);
+    }
+}
+
+/* Horizontal pass of the distorted picture over a vertically filtered row,
+ * given the reference statistics of the row. */
+static void dis_stats_row(VifPublicState *s, VifRefStats ref_stats,
+                          unsigned i, unsigned w, int scale, VifResiduals *r)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const uint32_t *mu1 = ref_stats.mu1 + i * ref_stats.stride;
+    const int32_t *sigma1_sq = ref_stats.sigma1_sq + i * ref_stats.stride;
+
+    vif_pad_row(buf.tmp.mu2, w, fwidth / 2);
+    vif_pad_row(buf.tmp.dis, w, fwidth / 2);
+    vif_pad_row(buf.tmp.ref_dis, w, fwidth / 2);
+
+    for (unsigned j = 0; j < w; ++j) {
+        uint32_t accum_mu2 = 0;
+        uint64_t accum_dis = 0;
+        uint64_t accum_ref_dis = 0;
+        for (unsigned fj = 0; fj < fwidth; ++fj) {
+            int jj_check = j - fwidth / 2 + fj;
+            const uint16_t fcoeff = vif_filt[fj];
+            accum_mu2 += fcoeff * ((uint32_t)buf.tmp.mu2[jj_check]);
+            accum_dis += fcoeff * ((uint64_t)buf.tmp.dis[jj_check]);
+            accum_ref_dis += fcoeff * ((uint64_t)buf.tmp.ref_dis[jj_check]);
+        }
+        uint32_t mu2_sq_val = (uint32_t)((((uint64_t)accum_mu2 * accum_mu2)
+            + 2147483648) >> 32);
+        uint32_t mu1_mu2_val = (uint32_t)((((uint64_t)mu1[j] * accum_mu2)
+            + 2147483648) >> 32);
+        uint32_t yy_filt_val = (uint32_t)((accum_dis + 32768) >> 16);
+        uint32_t xy_filt_val = (uint32_t)((accum_ref_dis + 32768) >> 16);
+
+        int32_t sigma2_sq = (int32_t)(yy_filt_val - mu2_sq_val);
+        int32_t sigma12 = (int32_t)(xy_filt_val - mu1_mu2_val);
+
+        vif_accumulate_num(r, s->log2_table, s->vif_enhn_gain_limit,
+                           sigma1_sq[j], MAX(sigma2_sq, 0), sigma12);
+    }
+}
+
+void vif_statistic_ref_8(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h)
+{
+    const unsigned fwidth = vif_filter1d_width[0];
+    const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
+    VifBuffer buf = s->buf;
+    const uint8_t *ref = buf.ref;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        //VERTICAL
+        for (unsigned j = 0; j < w; ++j) {
+            uint32_t accum_mu1 = 0;
+            uint32_t accum_ref = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                int ii_check = i - fwidth / 2 + fi;
+                const uint16_t fcoeff = vif_filt_s0[fi];
+                uint16_t imgcoeff_ref = ref[ii_check * buf.stride + j];
+                uint32_t img_coeff_ref = fcoeff * (uint32_t)imgcoeff_ref;
+                accum_mu1 += img_coeff_ref;
+                accum_ref += img_coeff_ref * (uint32_t)imgcoeff_ref;
+            }
+            buf.tmp.mu1[j] = (accum_mu1 + 128) >> 8;
+            buf.tmp.ref[j] = accum_ref;
+        }
+
+        //HORIZONTAL
+        ref_stats_row(s, ref_stats, i, w, 0, &r);
+    }
+    *out = r;
+}
+
+void vif_statistic_dis_8(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h)
+{
+    const unsigned fwidth = vif_filter1d_width[0];
+    const uint16_t *vif_filt_s0 = vif_filter1d_table[0];
+    VifBuffer buf = s->buf;
+    const uint8_t *ref = buf.ref;
+    const uint8_t *dis = buf.dis;
+    VifResiduals r = { 0 };
+
+    for (unsigned i = 0; i < h; ++i) {
+        //VERTICAL
+        for (unsigned j = 0; j < w; ++j) {
+            uint32_t accum_mu2 = 0;
+            uint32_t accum_dis = 0;
+            uint32_t accum_ref_dis = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                int ii_check = i - fwidth / 2 + fi;
+                const uint16_t fcoeff = vif_filt_s0[fi];
+                uint16_t imgcoeff_ref = ref[ii_check * buf.stride + j];
+                uint16_t imgcoeff_dis = dis[ii_check * buf.stride + j];
+                uint32_t img_coeff_ref = fcoeff * (uint32_t)imgcoeff_ref;
+                uint32_t img_coeff_dis = fcoeff * (uint32_t)imgcoeff_dis;
+                accum_mu2 += img_coeff_dis;
+                accum_dis += img_coeff_dis * (uint32_t)imgcoeff_dis;
+                accum_ref_dis += img_coeff_ref * (uint32_t)imgcoeff_dis;
+            }
+            buf.tmp.mu2[j] = (accum_mu2 + 128) >> 8;
+            buf.tmp.dis[j] = accum_dis;
+            buf.tmp.ref_dis[j] = accum_ref_dis;
+        }
+
+        //HORIZONTAL
+        dis_stats_row(s, ref_stats, i, w, 0, &r);
+    }
+    *out = r;
+}
+
+void vif_statistic_ref_16(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    VifResiduals r = { 0 };
+
+    const int32_t shift_VP = scale == 0 ? bpc : 16;
+    const int32_t add_shift_round_VP = 1 << (shift_VP - 1);
+    const int32_t shift_VP_sq = scale == 0 ? (bpc - 8) * 2 : 16;
+    const int32_t add_shift_round_VP_sq =
+        shift_VP_sq ? 1 << (shift_VP_sq - 1) : 0;
+
+    for (unsigned i = 0; i < h; ++i) {
+        //VERTICAL
+        for (unsigned j = 0; j < w; ++j) {
+            uint32_t accum_mu1 = 0;
+            uint64_t accum_ref = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                int ii_check = i - fwidth / 2 + fi;
+                const uint16_t fcoeff = vif_filt[fi];
+                uint16_t imgcoeff_ref = ref[ii_check * stride + j];
+                uint32_t img_coeff_ref = fcoeff * (uint32_t)imgcoeff_ref;
+                accum_mu1 += img_coeff_ref;
+                accum_ref += img_coeff_ref * (uint64_t)imgcoeff_ref;
+            }
+            buf.tmp.mu1[j] = (uint16_t)((accum_mu1 + add_shift_round_VP) >> shift_VP);
+            buf.tmp.ref[j] = (uint32_t)((accum_ref + add_shift_round_VP_sq) >> shift_VP_sq);
+        }
+
+        //HORIZONTAL
+        ref_stats_row(s, ref_stats, i, w, scale, &r);
+    }
+    *out = r;
+}
+
+void vif_statistic_dis_16(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale)
+{
+    const unsigned fwidth = vif_filter1d_width[scale];
+    const uint16_t *vif_filt = vif_filter1d_table[scale];
+    VifBuffer buf = s->buf;
+    const ptrdiff_t stride = buf.stride / sizeof(uint16_t);
+    const uint16_t *ref = buf.ref;
+    const uint16_t *dis = buf.dis;
+    VifResiduals r = { 0 };
+
+    const int32_t shift_VP = scale == 0 ? bpc : 16;
+    const int32_t add_shift_round_VP = 1 << (shift_VP - 1);
+    const int32_t shift_VP_sq = scale == 0 ? (bpc - 8) * 2 : 16;
+    const int32_t add_shift_round_VP_sq =
+        shift_VP_sq ? 1 << (shift_VP_sq - 1) : 0;
+
+    for (unsigned i = 0; i < h; ++i) {
+        //VERTICAL
+        for (unsigned j = 0; j < w; ++j) {
+            uint32_t accum_mu2 = 0;
+            uint64_t accum_dis = 0;
+            uint64_t accum_ref_dis = 0;
+            for (unsigned fi = 0; fi < fwidth; ++fi) {
+                int ii_check = i - fwidth / 2 + fi;
+                const uint16_t fcoeff = vif_filt[fi];
+                uint16_t imgcoeff_ref = ref[ii_check * stride + j];
+                uint16_t imgcoeff_dis = dis[ii_check * stride + j];
+                uint32_t img_coeff_ref = fcoeff * (uint32_t)imgcoeff_ref;
+                uint32_t img_coeff_dis = fcoeff * (uint32_t)imgcoeff_dis;
+                accum_mu2 += img_coeff_dis;
+                accum_dis += img_coeff_dis * (uint64_t)imgcoeff_dis;
+                accum_ref_dis += img_coeff_ref * (uint64_t)imgcoeff_dis;
+            }
+            buf.tmp.mu2[j] = (uint16_t)((accum_mu2 + add_shift_round_VP) >> shift_VP);
+            buf.tmp.dis[j] = (uint32_t)((accum_dis + add_shift_round_VP_sq) >> shift_VP_sq);
+            buf.tmp.ref_dis[j] = (uint32_t)((accum_ref_dis + add_shift_round_VP_sq) >> shift_VP_sq);
+        }
+
+        //HORIZONTAL
+        dis_stats_row(s, ref_stats, i, w, scale, &r);
+    }
+    *out = r;
+}
+
+static size_t row_buffers_size(VifBuffer buf)
+{
+    return 5 * buf.stride_32 + 7 * buf.stride_tmp;
+}
+
+static void set_row_buffers(VifBuffer *buf, void *data)
+{
+    buf->mu1_32 = data; data += buf->stride_32;
+    buf->mu2_32 = data; data += buf->stride_32;
+    buf->ref_sq = data; data += buf->stride_32;
+    buf->dis_sq = data; data += buf->stride_32;
+    buf->ref_dis = data; data += buf->stride_32;
+    buf->tmp.mu1 = data; data += buf->stride_tmp;
+    buf->tmp.mu2 = data; data += buf->stride_tmp;
+    buf->tmp.ref = data; data += buf->stride_tmp;
+    buf->tmp.dis = data; data += buf->stride_tmp;
+    buf->tmp.ref_dis = data; data += buf->stride_tmp;
+    buf->tmp.ref_convol = data; data += buf->stride_tmp;
+    buf->tmp.dis_convol = data;
+}
+
+static int init_bands(VifState *s, unsigned h)
+{
+    const unsigned n_threads = vmaf_thread_pool_n_threads(s->thread_pool);
+    s->n_bands = MAX(1, MIN(n_threads, h / VIF_MIN_BAND_ROWS));
+    s->band = calloc(s->n_bands, sizeof(*s->band));
+    if (!s->band) return -ENOMEM;
+
+    for (unsigned i = 0; i < s->n_bands; i++) {
+        VifBand *band = &s->band[i];
+        band->public = s->public;
+        band->data = aligned_malloc(row_buffers_size(band->public.buf),
+                                    MAX_ALIGN);
+        if (!band->data) return -ENOMEM;
+        set_row_buffers(&band->public.buf, band->data);
+    }
+    return 0;
+}
+
+static void close_bands(VifState *s)
+{
+    if (!s->band) return;
+    for (unsigned i = 0; i < s->n_bands; i++) {
+        if (s->band[i].data) aligned_free(s->band[i].data);
+    }
+    free(s->band);
+    s->band = NULL;
+}
+
+/* Lays the planes of each scale out after the header, 8-byte aligned. */
+static size_t layout_record(VifState *s, unsigned w, unsigned h)
+{
+    size_t offset = sizeof(VifCacheHeader);
+    for (unsigned scale = 0; scale < 4; scale++) {
+        const size_t plane_size = ((size_t)w * h * sizeof(uint32_t) + 7) & ~7;
+        s->mu1_offset[scale] = offset;
+        offset += plane_size;
+        s->sigma1_sq_offset[scale] = offset;
+        offset += plane_size;
+        w /= 2; h /= 2;
+    }
+    return offset;
+}
+
+static int init_reference_cache(VifState *s, unsigned bpc, unsigned w,
+                                 unsigned h)
+{
+    /* The reference statistics do not depend on any option, only on the
+     * picture size, which the record layout follows. */
+    uint64_t key = vmaf_reference_cache_hash_string(0, "integer_vif/1");
+    key = vmaf_reference_cache_hash_combine(key, w);
+    key = vmaf_reference_cache_hash_combine(key, h);
+    key = vmaf_reference_cache_hash_combine(key, bpc);
+
+    const size_t record_size = layout_record(s, w, h);
+    s->record = aligned_malloc(record_size, MAX_ALIGN);
+    if (!s->record) return -ENOMEM;
+
+    return vmaf_reference_cache_open(&s->reference_cache,
+                                     s->reference_cache_path, key,
+                                     record_size);
+}
+
 static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
                 unsigned bpc, unsigned w, unsigned h)
 {
@@ -600,22 +938,45 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
 
     s->subsample_rd_8 = subsample_rd_8;
     s->subsample_rd_16 = subsample_rd_16;
+    s->decimate_and_pad_8 = decimate_and_pad;
+    s->decimate_and_pad_16 = decimate_and_pad;
     s->vif_statistic_8 = vif_statistic_8;
     s->vif_statistic_16 = vif_statistic_16;
+    s->vif_statistic_ref_8 = vif_statistic_ref_8;
+    s->vif_statistic_dis_8 = vif_statistic_dis_8;
+    s->vif_statistic_ref_16 = vif_statistic_ref_16;
+    s->vif_statistic_dis_16 = vif_statistic_dis_16;
+
+#if HAVE_VEC
+    if (vmaf_cpu_vec_enabled()) {
+        s->subsample_rd_8 = vif_subsample_rd_8_vec;
+        s->subsample_rd_16 = vif_subsample_rd_16_vec;
+        s->vif_statistic_8 = vif_statistic_8_vec;
+        s->vif_statistic_16 = vif_statistic_16_vec;
+    }
+#endif
 
 #if ARCH_X86
     unsigned flags = vmaf_get_cpu_flags();
     if (flags & VMAF_X86_CPU_FLAG_AVX2) {
         s->subsample_rd_8 = vif_subsample_rd_8_avx2;
         s->subsample_rd_16 = vif_subsample_rd_16_avx2;
+        s->decimate_and_pad_8 = vif_decimate_and_pad_8_avx2;
+        s->decimate_and_pad_16 = vif_decimate_and_pad_16_avx2;
         s->vif_statistic_8 = vif_statistic_8_avx2;
         s->vif_statistic_16 = vif_statistic_16_avx2;
+        s->vif_statistic_ref_8 = vif_statistic_ref_8_avx2;
+        s->vif_statistic_dis_8 = vif_statistic_dis_8_avx2;
+        s->vif_statistic_ref_16 = vif_statistic_ref_16_avx2;
+        s->vif_statistic_dis_16 = vif_statistic_dis_16_avx2;
     }
 /*
 #if HAVE_AVX512
     if (flags & VMAF_X86_CPU_FLAG_AVX512) {
         s->subsample_rd_8 = vif_subsample_rd_8_avx2;
         s->subsample_rd_16 = vif_subsample_rd_16_avx512;
+        s->decimate_and_pad_8 = vif_decimate_and_pad_8_avx2;
+        s->decimate_and_pad_16 = decimate_and_pad;
         s->vif_statistic_8 = vif_statistic_8_avx512;
         s->vif_statistic_16 = vif_statistic_16_avx512;
     }
@@ -628,6 +989,7 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
     s->vif_statistic_16 = vif_statistic_16_neon;
 #endif
 
+    s->public.log2_table = s->log2_table;
     log_generate(s->public.log2_table);
 
     (void)pix_fmt;
@@ -641,8 +1003,7 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
     const size_t frame_size = s->public.buf.stride * h;
     const size_t pad_size = s->public.buf.stride * 8;
     const size_t data_sz =
-        2 * (pad_size + frame_size + pad_size) + 2 * (h * s->public.buf.stride_16) +
-        5 * (s->public.buf.stride_32) + 7 * s->public.buf.stride_tmp;
+        2 * (pad_size + frame_size + pad_size) + 2 * (h * s->public.buf.stride_16);
     void *data = aligned_malloc(data_sz, MAX_ALIGN);
     if (!data) return -ENOMEM;
 
@@ -650,31 +1011,37 @@ static int init(VmafFeatureExtractor *fex, enum VmafPixelFormat pix_fmt,
     s->public.buf.ref = data; data += frame_size + pad_size + pad_size;
     s->public.buf.dis = data; data += frame_size + pad_size;
     s->public.buf.mu1 = data; data += h * s->public.buf.stride_16;
-    s->public.buf.mu2 = data; data += h * s->public.buf.stride_16;
-    s->public.buf.mu1_32 = data; data += s->public.buf.stride_32;
-    s->public.buf.mu2_32 = data; data += s->public.buf.stride_32;
-    s->public.buf.ref_sq = data; data += s->public.buf.stride_32;
-    s->public.buf.dis_sq = data; data += s->public.buf.stride_32;
-    s->public.buf.ref_dis = data; data += s->public.buf.stride_32;
-    s->public.buf.tmp.mu1 = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.mu2 = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.ref = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.dis = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.ref_dis = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.ref_convol = data; data += s->public.buf.stride_tmp;
-    s->public.buf.tmp.dis_convol = data;
+    s->public.buf.mu2 = data;
+
+    /* Row buffers belong to the bands, which each filter a range of rows of
+     * the shared picture buffers above. */
+    s->thread_pool = fex->thread_pool;
+    int err = init_bands(s, h);
+    if (err) goto fail;
 
     s->feature_name_dict =
         vmaf_feature_name_dict_from_provided_features(fex->provided_features,
                 fex->options, s);
-    if (!s->feature_name_dict) goto fail;
+    if (!s->feature_name_dict) {
+        err = -ENOMEM;
+        goto fail;
+    }
+
+    if (s->reference_cache_path) {
+        err = init_reference_cache(s, bpc, w, h);
+        if (err) goto fail;
+    }
 
     return 0;
 
 fail:
-    if (data) aligned_free(data);
+    close_bands(s);
+    aligned_free(s->public.buf.data);
+    s->public.buf.data = NULL;
+    if (s->record) aligned_free(s->record);
+    s->record = NULL;
     vmaf_dictionary_free(&s->feature_name_dict);
-    return -ENOMEM;
+    return err;
 }
 
 typedef struct VifScore {
@@ -762,6 +1129,88 @@ static int write_scores(VmafFeatureCollector *feature_collector, unsigned index,
     return err;
 }
 
+typedef struct VifStage {
+    VifState *s;
+    unsigned w, h, bpc, scale;
+    unsigned n_bands;
+    /* Reference statistics of the scale, if cached, and whether they were
+     * read back rather than to be filled in. */
+    VifRefStats ref_stats;
+    bool ref_cached;
+} VifStage;
+
+static unsigned stage_bands(VifState *s, unsigned h)
+{
+    return MAX(1, MIN(s->n_bands, h / VIF_MIN_BAND_ROWS));
+}
+
+/* Band edges are even, so that they line up with the rows kept when
+ * subsampling. */
+static void band_rows(VifStage *stage, unsigned i, unsigned *y0, unsigned *y1)
+{
+    *y0 = (stage->h * i / stage->n_bands) & ~1u;
+    *y1 = i + 1 == stage->n_bands ?
+          stage->h : (stage->h * (i + 1) / stage->n_bands) & ~1u;
+}
+
+static void subsample_band(void *data, unsigned i)
+{
+    VifStage *stage = data;
+    VifState *s = stage->s;
+
+    unsigned y0, y1;
+    band_rows(stage, i, &y0, &y1);
+    if (stage->bpc == 8 && stage->scale == 1)
+        s->subsample_rd_8(s->band[i].public.buf, stage->w, y0, y1);
+    else
+        s->subsample_rd_16(s->band[i].public.buf, stage->w, y0, y1,
+                           stage->scale - 1, stage->bpc);
+}
+
+static void statistic_band(void *data, unsigned i)
+{
+    VifStage *stage = data;
+    VifState *s = stage->s;
+    VifBand *band = &s->band[i];
+
+    unsigned y0, y1;
+    band_rows(stage, i, &y0, &y1);
+    VifPublicState public = band->public;
+    public.buf.ref = (uint8_t *)public.buf.ref + y0 * public.buf.stride;
+    public.buf.dis = (uint8_t *)public.buf.dis + y0 * public.buf.stride;
+
+    band->ref_residuals = (VifResiduals) { 0 };
+    if (!stage->ref_stats.mu1) {
+        if (stage->bpc == 8 && stage->scale == 0)
+            s->vif_statistic_8(&public, &band->residuals, stage->w, y1 - y0);
+        else
+            s->vif_statistic_16(&public, &band->residuals, stage->w, y1 - y0,
+                                stage->bpc, stage->scale);
+        return;
+    }
+
+    VifRefStats ref_stats = stage->ref_stats;
+    ref_stats.mu1 += y0 * ref_stats.stride;
+    ref_stats.sigma1_sq += y0 * ref_stats.stride;
+    if (stage->bpc == 8 && stage->scale == 0) {
+        if (!stage->ref_cached) {
+            s->vif_statistic_ref_8(&public, ref_stats, &band->ref_residuals,
+                                   stage->w, y1 - y0);
+        }
+        s->vif_statistic_dis_8(&public, ref_stats, &band->residuals,
+                               stage->w, y1 - y0);
+    }
+    else {
+        if (!stage->ref_cached) {
+            s->vif_statistic_ref_16(&public, ref_stats, &band->ref_residuals,
+                                    stage->w, y1 - y0, stage->bpc,
+                                    stage->scale);
+        }
+        s->vif_statistic_dis_16(&public, ref_stats, &band->residuals,
+                                stage->w, y1 - y0, stage->bpc, stage->scale);
+    }
+}
+
 static int extract(VmafFeatureExtractor *fex,
                    VmafPicture *ref_pic, VmafPicture *ref_pic_90,
                    VmafPicture *dist_pic, VmafPicture *dist_pic_90,
@@ -790,24 +1239,75 @@ static int extract(VmafFeatureExtractor *fex,
     }
     pad_top_and_bottom(s->public.buf, h, vif_filter1d_width[0]);
 
+    /* With a cache, the reference statistics are read from its record on a
+     * hit, which is mapped read-only, or written to a record of ours on a
+     * miss. */
+    uint64_t content_hash = 0;
+    void *record = NULL;
+    VifStage stage = { .s = s, .bpc = ref_pic->bpc };
+    if (s->reference_cache) {
+        content_hash = vmaf_reference_cache_hash_luma(ref_pic);
+        const void *cached = vmaf_reference_cache_find(s->reference_cache,
+                                                       index, content_hash);
+        stage.ref_cached = cached != NULL;
+        record = cached ? (void *)cached : s->record;
+    }
+    VifCacheHeader *header = record;
+
     VifScore vif_score;
     for (unsigned scale = 0; scale < 4; ++scale) {
+        stage.scale = scale;
         if (scale > 0) {
+            /* Bands read rows of their neighbours, so the picture is only
+             * decimated in place once every band is done. */
+            stage.w = w;
+            stage.h = h;
+            stage.n_bands = stage_bands(s, h);
+            vmaf_thread_pool_parallel_for(s->thread_pool, subsample_band,
+                                          &stage, stage.n_bands);
             if (ref_pic->bpc == 8 && scale == 1)
-                s->subsample_rd_8(s->public.buf, w, h);
+                s->decimate_and_pad_8(s->public.buf, w, h, 0);
             else
-                s->subsample_rd_16(s->public.buf, w, h, scale - 1, ref_pic->bpc);
+                s->decimate_and_pad_16(s->public.buf, w, h, scale - 1);
 
             w /= 2; h /= 2;
         }
 
-        if (ref_pic->bpc == 8 && scale == 0) {
-            s->vif_statistic_8(&s->public, &vif_score.scale[scale].num, &vif_score.scale[scale].den, w, h);
+        stage.w = w;
+        stage.h = h;
+        stage.n_bands = stage_bands(s, h);
+        if (record) {
+            stage.ref_stats = (VifRefStats) {
+                .mu1 = (uint32_t *)((char *)record + s->mu1_offset[scale]),
+                .sigma1_sq =
+                    (int32_t *)((char *)record + s->sigma1_sq_offset[scale]),
+                .stride = w,
+            };
         }
-        else {
-            s->vif_statistic_16(&s->public, &vif_score.scale[scale].num, &vif_score.scale[scale].den, w, h, ref_pic->bpc, scale);
+        vmaf_thread_pool_parallel_for(s->thread_pool, statistic_band,
+                                      &stage, stage.n_bands);
+
+        /* Integer sums, added up in band order, give the same score for any
+         * number of bands. */
+        VifResiduals residuals = { 0 };
+        VifResiduals ref_residuals = { 0 };
+        for (unsigned i = 0; i < stage.n_bands; i++) {
+            vif_residuals_add(&residuals, s->band[i].residuals);
+            vif_residuals_add(&ref_residuals, s->band[i].ref_residuals);
         }
+        if (stage.ref_cached)
+            ref_residuals = header->ref_residuals[scale];
+        else if (header)
+            header->ref_residuals[scale] = ref_residuals;
+        vif_residuals_add(&residuals, ref_residuals);
+        vif_residuals_to_num_den(residuals, &vif_score.scale[scale].num,
+                                 &vif_score.scale[scale].den);
+    }
 
+    if (record && !stage.ref_cached) {
+        int err = vmaf_reference_cache_store(s->reference_cache, index,
+                                             content_hash, record);
+        if (err) return err;
     }
 
     return write_scores(feature_collector, index, vif_score, s);
@@ -816,8 +1316,13 @@ static int extract(VmafFeatureExtractor *fex,
 static int close(VmafFeatureExtractor *fex)
 {
     VifState *s = fex->priv;
+    int err = 0;
+    close_bands(s);
     if (s->public.buf.data) aligned_free(s->public.buf.data);
-    return 0;
+    if (s->record) aligned_free(s->record);
+    if (s->reference_cache)
+        err = vmaf_reference_cache_close(s->reference_cache);
+    return err;
 }
 
 static const char *provided_features[] = {
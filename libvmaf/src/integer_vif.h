@@ -19,6 +19,7 @@
 #ifndef FEATURE_VIF_H_
 #define FEATURE_VIF_H_
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <assert.h>
@@ -75,10 +76,26 @@ typedef struct VifResiduals {
 
 typedef struct VifPublicState {
     VifBuffer buf;
-    uint16_t log2_table[65537];
+    uint16_t *log2_table;
     double vif_enhn_gain_limit;
 } VifPublicState;
 
+static inline void vif_residuals_add(VifResiduals *sum, VifResiduals r)
+{
+    sum->accum_num_log += r.accum_num_log;
+    sum->accum_den_log += r.accum_den_log;
+    sum->accum_num_non_log += r.accum_num_non_log;
+    sum->accum_den_non_log += r.accum_den_non_log;
+}
+
+static inline void vif_residuals_to_num_den(VifResiduals r, float *num,
+                                            float *den)
+{
+    num[0] = r.accum_num_log / 2048.0 + (r.accum_den_non_log -
+             ((r.accum_num_non_log) / 16384.0) / (65025.0));
+    den[0] = r.accum_den_log / 2048.0 + r.accum_den_non_log;
+}
+
 static inline void PADDING_SQ_DATA(VifBuffer buf, int w, unsigned fwidth_half)
 {
     for (unsigned f = 1; f <= fwidth_half; ++f) {
@@ -100,6 +117,14 @@ static inline void PADDING_SQ_DATA(VifBuffer buf, int w, unsigned fwidth_half)
     }
 }
 
+static inline void vif_pad_row(uint32_t *row, int w, unsigned fwidth_half)
+{
+    for (unsigned f = 1; f <= fwidth_half; ++f) {
+        row[-(int)f] = row[f];
+        row[w - 1 + f] = row[w - 1 - f];
+    }
+}
+
 static inline void PADDING_SQ_DATA_2(VifBuffer buf, int w, unsigned fwidth_half)
 {
     for (unsigned f = 1; f <= fwidth_half; ++f) {
@@ -115,8 +140,35 @@ static inline void PADDING_SQ_DATA_2(VifBuffer buf, int w, unsigned fwidth_half)
     }
 }
 
-void vif_statistic_8(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h);
-void vif_statistic_16(struct VifPublicState *s, float *num, float *den, unsigned w, unsigned h, int bpc, int scale);
+/*
+ * The statistics cover rows [0, h) of s->buf.ref and s->buf.dis, reading up
+ * to half a filter width above and below. They return integer sums, so that
+ * a picture can be split into bands whose sums add up to exactly the same
+ * score.
+ */
+void vif_statistic_8(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h);
+void vif_statistic_16(struct VifPublicState *s, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+
+/*
+ * What the statistics derive from the reference alone, for each pixel of the
+ * rows they cover: the filtered reference and its variance.
+ */
+typedef struct VifRefStats {
+    uint32_t *mu1;
+    int32_t *sigma1_sq;
+    ptrdiff_t stride;
+} VifRefStats;
+
+/*
+ * The statistics split in two, so that the reference half can be kept across
+ * runs: vif_statistic_ref_* write the reference statistics and return the den
+ * sums, vif_statistic_dis_* read them back and return the num sums. Together
+ * they return exactly the sums of vif_statistic_8 and vif_statistic_16.
+ */
+void vif_statistic_ref_8(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+void vif_statistic_dis_8(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h);
+void vif_statistic_ref_16(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
+void vif_statistic_dis_16(struct VifPublicState *s, VifRefStats ref_stats, VifResiduals *out, unsigned w, unsigned h, int bpc, int scale);
 
 /*
  * Compute vif residuals on a vertically filtered line 
@@ -124,7 +176,7 @@ void vif_statistic_16(struct VifPublicState *s, float *num, float *den, unsigned
  * only when to is not a multiple of the block size, with from = (to / block_size) + block_size
  */
 VifResiduals vif_compute_line_residuals(VifPublicState *s, unsigned from,
-                                        unsigned to, int bpc, int scale);
+                                        unsigned to, int scale);
 
 
 #ifdef _MSC_VER
@@ -157,4 +209,44 @@ static inline int32_t log2_64(const uint16_t *log2_table, uint64_t temp)
     return log2_table[temp] + 2048 * k;
 }
 
+static const int32_t vif_sigma_nsq = 65536 << 1;
+
+/* The den sums of a pixel, which depend on the reference alone. */
+static inline void vif_accumulate_den(VifResiduals *r,
+                                      const uint16_t *log2_table,
+                                      int32_t sigma1_sq)
+{
+    if (sigma1_sq >= vif_sigma_nsq)
+        r->accum_den_log += log2_32(log2_table, vif_sigma_nsq + sigma1_sq) - 2048 * 17;
+    else
+        r->accum_den_non_log++;
+}
+
+/* The num sums of a pixel, with sigma2_sq already clamped to 0. */
+static inline void vif_accumulate_num(VifResiduals *r,
+                                      const uint16_t *log2_table,
+                                      double vif_enhn_gain_limit,
+                                      int32_t sigma1_sq, int32_t sigma2_sq,
+                                      int32_t sigma12)
+{
+    if (sigma1_sq >= vif_sigma_nsq) {
+        if (sigma12 > 0 && sigma2_sq > 0) {
+            const double eps = 65536 * 1.0e-10;
+            double g = sigma12 / (sigma1_sq + eps);
+            int32_t sv_sq = sigma2_sq - g * sigma12;
+
+            sv_sq = (uint32_t)(sv_sq > 0 ? sv_sq : 0);
+
+            g = g < vif_enhn_gain_limit ? g : vif_enhn_gain_limit;
+
+            uint32_t numer1 = (sv_sq + vif_sigma_nsq);
+            int64_t numer1_tmp = (int64_t)((g * g * sigma1_sq)) + numer1;
+            r->accum_num_log += log2_64(log2_table, numer1_tmp) - log2_64(log2_table, numer1);
+        }
+    }
+    else {
+        r->accum_num_non_log += sigma2_sq;
+    }
+}
+
 #endif /* _FEATURE_VIF_H_ */
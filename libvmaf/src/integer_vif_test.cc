@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "feature_test_util.h"
+
+namespace {
+
+// Every feature the "vif" extractor writes with debug enabled.
+const std::vector<std::string> kVifFeatures = {
+    "VMAF_integer_feature_vif_scale0_score",
+    "VMAF_integer_feature_vif_scale1_score",
+    "VMAF_integer_feature_vif_scale2_score",
+    "VMAF_integer_feature_vif_scale3_score",
+    "integer_vif",
+    "integer_vif_num",
+    "integer_vif_den",
+    "integer_vif_num_scale0",
+    "integer_vif_den_scale0",
+    "integer_vif_num_scale1",
+    "integer_vif_den_scale1",
+    "integer_vif_num_scale2",
+    "integer_vif_den_scale2",
+    "integer_vif_num_scale3",
+    "integer_vif_den_scale3",
+};
+
+using vmaf_test::Frame;
+
+Frame NoiseFrame(unsigned w, unsigned h, unsigned bpc, std::mt19937* rng) {
+  Frame f = {w, h, bpc, std::vector<uint16_t>(w * h)};
+  std::uniform_int_distribution<int> sample(0, (1 << bpc) - 1);
+  for (uint16_t& v : f.luma) v = sample(*rng);
+  return f;
+}
+
+TEST(IntegerVifTest, SimdMatchesCAtEveryWidth) {
+  // The AVX2 kernels work on 16 columns at a time and on half the width at
+  // each scale after the first, so odd heights and widths which are no
+  // multiple of 16 leave a tail at some scale.
+  std::vector<std::vector<unsigned>> sizes = {{641, 359}, {256, 41},
+                                              {248, 48}, {241, 48}};
+  for (const auto& size : vmaf_test::kEdgeSizes)
+    sizes.push_back({size[0], size[1]});
+
+  std::mt19937 rng(20240601);
+  for (unsigned bpc : {8u, 10u}) {
+    for (const auto& size : sizes) {
+      std::vector<Frame> ref, dist;
+      for (int i = 0; i < 2; i++) {
+        ref.push_back(NoiseFrame(size[0], size[1], bpc, &rng));
+        dist.push_back(NoiseFrame(size[0], size[1], bpc, &rng));
+      }
+      // A cpumask of 0 lets the extractor use whatever the host supports.
+      vmaf_test::ExpectMatchesC(ref, dist, {"vif"}, kVifFeatures, 0);
+    }
+  }
+}
+
+}  // namespace
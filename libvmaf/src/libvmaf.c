@@ -35,6 +35,8 @@
 #include "model.h"
 #include "output.h"
 #include "picture.h"
+#include "picture_pool.h"
+#include "ref.h"
 #include "predict.h"
 #include "thread_pool.h"
 
@@ -44,6 +46,8 @@ typedef struct VmafContext {
     RegisteredFeatureExtractors registered_feature_extractors;
     VmafFeatureExtractorContextPool *fex_ctx_pool;
     VmafThreadPool *thread_pool;
+    VmafRef *thread_pool_ref;
+    VmafPicturePool *picture_pool;
     struct {
         unsigned w, h;
         enum VmafPixelFormat pix_fmt;
@@ -51,9 +55,20 @@ typedef struct VmafContext {
     } pic_params;
     unsigned pic_cnt;
     bool flushed;
+    struct {
+        pthread_mutex_t lock;
+        pthread_cond_t done;
+        unsigned cnt;
+    } inflight;
+    struct {
+        VmafPredictor **predictor;
+        unsigned cnt, capacity;
+        pthread_mutex_t lock;
+    } predictors;
 } VmafContext;
 
-int vmaf_init(VmafContext **vmaf, VmafConfiguration cfg)
+static int init(VmafContext **vmaf, VmafConfiguration cfg,
+                VmafContext *parent)
 {
     if (!vmaf) return -EINVAL;
     int err = 0;
@@ -72,18 +87,41 @@ int vmaf_init(VmafContext **vmaf, VmafConfiguration cfg)
     if (err) goto free_v;
     err = feature_extractor_vector_init(&(v->registered_feature_extractors));
     if (err) goto free_feature_collector;
+    err = vmaf_picture_pool_init(&v->picture_pool);
+    if (err) goto free_feature_extractor_vector;
+    pthread_mutex_init(&(v->inflight.lock), NULL);
+    pthread_cond_init(&(v->inflight.done), NULL);
+    pthread_mutex_init(&(v->predictors.lock), NULL);
 
     if (v->cfg.n_threads > 0) {
-        err = vmaf_thread_pool_create(&v->thread_pool, v->cfg.n_threads);
-        if (err) goto free_feature_extractor_vector;
-        err = vmaf_fex_ctx_pool_create(&v->fex_ctx_pool, v->cfg.n_threads);
+        if (parent) {
+            v->thread_pool = parent->thread_pool;
+            v->thread_pool_ref = parent->thread_pool_ref;
+            vmaf_ref_fetch_increment(v->thread_pool_ref);
+        } else {
+            err = vmaf_thread_pool_create(&v->thread_pool, v->cfg.n_threads);
+            if (err) goto free_picture_pool;
+            err = vmaf_ref_init(&v->thread_pool_ref);
+            if (err) goto destroy_thread_pool;
+        }
+        err = vmaf_fex_ctx_pool_create(&v->fex_ctx_pool, v->cfg.n_threads,
+                                       v->thread_pool);
         if (err) goto free_thread_pool;
     }
 
     return 0;
 
 free_thread_pool:
+    if (vmaf_ref_fetch_decrement(v->thread_pool_ref) != 1)
+        goto free_picture_pool;
+    vmaf_ref_close(v->thread_pool_ref);
+destroy_thread_pool:
     vmaf_thread_pool_destroy(v->thread_pool);
+free_picture_pool:
+    pthread_mutex_destroy(&(v->inflight.lock));
+    pthread_cond_destroy(&(v->inflight.done));
+    pthread_mutex_destroy(&(v->predictors.lock));
+    vmaf_picture_pool_close(v->picture_pool);
 free_feature_extractor_vector:
     feature_extractor_vector_destroy(&(v->registered_feature_extractors));
 free_feature_collector:
@@ -94,6 +132,21 @@ fail:
     return -ENOMEM;
 }
 
+int vmaf_init(VmafContext **vmaf, VmafConfiguration cfg)
+{
+    return init(vmaf, cfg, NULL);
+}
+
+int vmaf_init_shared(VmafContext **vmaf, VmafConfiguration cfg,
+                     VmafContext *parent)
+{
+    if (!parent) return -EINVAL;
+    if (!parent->thread_pool) return -EINVAL;
+    if (!cfg.n_threads) return -EINVAL;
+
+    return init(vmaf, cfg, parent);
+}
+
 int vmaf_close(VmafContext *vmaf)
 {
     if (!vmaf) return -EINVAL;
@@ -101,13 +154,47 @@ int vmaf_close(VmafContext *vmaf)
     vmaf_thread_pool_wait(vmaf->thread_pool);
     feature_extractor_vector_destroy(&(vmaf->registered_feature_extractors));
     vmaf_feature_collector_destroy(vmaf->feature_collector);
-    vmaf_thread_pool_destroy(vmaf->thread_pool);
+    if (vmaf->thread_pool_ref &&
+        vmaf_ref_fetch_decrement(vmaf->thread_pool_ref) == 1)
+    {
+        vmaf_thread_pool_destroy(vmaf->thread_pool);
+        vmaf_ref_close(vmaf->thread_pool_ref);
+    }
     vmaf_fex_ctx_pool_destroy(vmaf->fex_ctx_pool);
+    pthread_mutex_destroy(&(vmaf->inflight.lock));
+    pthread_cond_destroy(&(vmaf->inflight.done));
+    for (unsigned i = 0; i < vmaf->predictors.cnt; i++)
+        vmaf_predictor_destroy(vmaf->predictors.predictor[i]);
+    free(vmaf->predictors.predictor);
+    pthread_mutex_destroy(&(vmaf->predictors.lock));
+    vmaf_picture_pool_close(vmaf->picture_pool);
     free(vmaf);
 
     return 0;
 }
 
+int vmaf_needs_chroma(VmafContext *vmaf)
+{
+    if (!vmaf) return -EINVAL;
+
+    RegisteredFeatureExtractors rfe = vmaf->registered_feature_extractors;
+    for (unsigned i = 0; i < rfe.cnt; i++) {
+        if (rfe.fex_ctx[i]->fex->flags & VMAF_FEATURE_EXTRACTOR_CHROMA)
+            return 1;
+    }
+
+    return 0;
+}
+
+int vmaf_fetch_picture(VmafContext *vmaf, VmafPicture *pic,
+                       enum VmafPixelFormat pix_fmt, unsigned bpc,
+                       unsigned w, unsigned h)
+{
+    if (!vmaf) return -EINVAL;
+
+    return vmaf_picture_pool_fetch(vmaf->picture_pool, pic, pix_fmt, bpc, w, h);
+}
+
 int vmaf_import_feature_score(VmafContext *vmaf, const char *feature_name,
                               double value, unsigned index)
 {
@@ -132,6 +219,10 @@ int vmaf_use_feature(VmafContext *vmaf, const char *feature_name,
         vmaf_get_feature_extractor_by_name(feature_name);
     if (!fex) return -EINVAL;
 
+    RegisteredFeatureExtractors *rfe = &(vmaf->registered_feature_extractors);
+    if (feature_extractor_vector_contains(rfe, fex, s))
+        return vmaf_dictionary_free(&s);
+
     VmafDictionary *d = NULL;
     if (s) {
         err = vmaf_dictionary_copy(&s, &d);
@@ -144,7 +235,6 @@ int vmaf_use_feature(VmafContext *vmaf, const char *feature_name,
     err = vmaf_feature_extractor_context_create(&fex_ctx, fex, d);
     if (err) return err;
 
-    RegisteredFeatureExtractors *rfe = &(vmaf->registered_feature_extractors);
     err = feature_extractor_vector_append(rfe, fex_ctx, 0);
     if (err)
         err |= vmaf_feature_extractor_context_destroy(fex_ctx);
@@ -171,6 +261,14 @@ int vmaf_use_features_from_model(VmafContext *vmaf, VmafModel *model)
             return -EINVAL;
         }
 
+        // Models share most features, and an extractor provides several of
+        // them: one context serves every model asking for the same options.
+        if (feature_extractor_vector_contains(rfe, fex,
+                                              model->feature[i].opts_dict))
+        {
+            continue;
+        }
+
         VmafFeatureExtractorContext *fex_ctx;
         VmafDictionary *d = NULL;
         if (model->feature[i].opts_dict) {
@@ -207,9 +305,51 @@ struct ThreadData {
     unsigned index;
     VmafFeatureCollector *feature_collector;
     VmafFeatureExtractorContextPool *fex_ctx_pool;
+    VmafContext *vmaf;
+    VmafRef *frame_ref;
     int err;
 };
 
+/* Waits for, or with cfg.nonblocking fails to get, a slot for one more
+ * picture pair when cfg.max_inflight_frames is set. */
+static int acquire_inflight_frame(VmafContext *vmaf)
+{
+    if (!vmaf->cfg.max_inflight_frames) return 0;
+
+    int err = 0;
+    pthread_mutex_lock(&(vmaf->inflight.lock));
+    while (vmaf->inflight.cnt >= vmaf->cfg.max_inflight_frames) {
+        if (vmaf->cfg.nonblocking) {
+            err = -EAGAIN;
+            goto unlock;
+        }
+        pthread_cond_wait(&(vmaf->inflight.done), &(vmaf->inflight.lock));
+    }
+    vmaf->inflight.cnt++;
+unlock:
+    pthread_mutex_unlock(&(vmaf->inflight.lock));
+    return err;
+}
+
+static void free_inflight_frame(VmafContext *vmaf)
+{
+    pthread_mutex_lock(&(vmaf->inflight.lock));
+    vmaf->inflight.cnt--;
+    pthread_cond_signal(&(vmaf->inflight.done));
+    pthread_mutex_unlock(&(vmaf->inflight.lock));
+}
+
+/* Drops one hold on a picture pair. The pair's slot is freed once its last
+ * extraction job and threaded_read_pictures() have both let go of it. */
+static void release_inflight_frame(VmafContext *vmaf, VmafRef *frame_ref)
+{
+    if (!frame_ref) return;
+    if (vmaf_ref_fetch_decrement(frame_ref) != 1) return;
+
+    vmaf_ref_close(frame_ref);
+    free_inflight_frame(vmaf);
+}
+
 static void threaded_extract_func(void *e)
 {
     struct ThreadData *f = e;
@@ -220,6 +360,7 @@ static void threaded_extract_func(void *e)
     f->err = vmaf_fex_ctx_pool_release(f->fex_ctx_pool, f->fex_ctx);
     vmaf_picture_unref(&f->ref);
     vmaf_picture_unref(&f->dist);
+    release_inflight_frame(f->vmaf, f->frame_ref);
 }
 
 static int threaded_read_pictures(VmafContext *vmaf, VmafPicture *ref,
@@ -231,6 +372,16 @@ static int threaded_read_pictures(VmafContext *vmaf, VmafPicture *ref,
 
     int err = 0;
 
+    /* Held by this function while it queues jobs and by each queued job. */
+    VmafRef *frame_ref = NULL;
+    if (vmaf->cfg.max_inflight_frames) {
+        err = vmaf_ref_init(&frame_ref);
+        if (err) {
+            free_inflight_frame(vmaf);
+            return err;
+        }
+    }
+
     for (unsigned i = 0; i < vmaf->registered_feature_extractors.cnt; i++) {
         VmafFeatureExtractor *fex =
             vmaf->registered_feature_extractors.fex_ctx[i]->fex;
@@ -246,11 +397,12 @@ static int threaded_read_pictures(VmafContext *vmaf, VmafPicture *ref,
         VmafFeatureExtractorContext *fex_ctx;
         err = vmaf_fex_ctx_pool_aquire(vmaf->fex_ctx_pool, fex, opts_dict,
                                        &fex_ctx);
-        if (err) return err;
+        if (err) goto release_frame;
 
         VmafPicture pic_a, pic_b;
         vmaf_picture_ref(&pic_a, ref);
         vmaf_picture_ref(&pic_b, dist);
+        if (frame_ref) vmaf_ref_fetch_increment(frame_ref);
 
         struct ThreadData data = {
             .fex_ctx = fex_ctx,
@@ -259,6 +411,8 @@ static int threaded_read_pictures(VmafContext *vmaf, VmafPicture *ref,
             .index = index,
             .feature_collector = vmaf->feature_collector,
             .fex_ctx_pool = vmaf->fex_ctx_pool,
+            .vmaf = vmaf,
+            .frame_ref = frame_ref,
             .err = 0,
         };
 
@@ -267,11 +421,16 @@ static int threaded_read_pictures(VmafContext *vmaf, VmafPicture *ref,
         if (err) {
             vmaf_picture_unref(&pic_a);
             vmaf_picture_unref(&pic_b);
-            return err;
+            if (frame_ref) vmaf_ref_fetch_decrement(frame_ref);
+            goto release_frame;
         }
     }
 
-    return vmaf_picture_unref(ref) | vmaf_picture_unref(dist);
+    err = vmaf_picture_unref(ref) | vmaf_picture_unref(dist);
+
+release_frame:
+    release_inflight_frame(vmaf, frame_ref);
+    return err;
 }
 
 static int validate_pic_params(VmafContext *vmaf, VmafPicture *ref,
@@ -337,12 +496,17 @@ int vmaf_read_pictures(VmafContext *vmaf, VmafPicture *ref, VmafPicture *dist,
 
     int err = 0;
 
-    vmaf->pic_cnt++;
     err = validate_pic_params(vmaf, ref, dist);
     if (err) return err;
 
-    if (vmaf->thread_pool)
+    if (vmaf->thread_pool) {
+        err = acquire_inflight_frame(vmaf);
+        if (err) return err;
+        vmaf->pic_cnt++;
         return threaded_read_pictures(vmaf, ref, dist, index);
+    }
+
+    vmaf->pic_cnt++;
 
     for (unsigned i = 0; i < vmaf->registered_feature_extractors.cnt; i++) {
         VmafFeatureExtractorContext *fex_ctx =
@@ -380,6 +544,49 @@ int vmaf_feature_score_at_index(VmafContext *vmaf, const char *feature_name,
 }
 
 
+/* Returns the context's predictor for the model, which is built the first time
+ * the model is scored. Must be called with predictors.lock held. */
+static int get_predictor(VmafContext *vmaf, VmafModel *model,
+                         VmafPredictor **predictor)
+{
+    for (unsigned i = 0; i < vmaf->predictors.cnt; i++) {
+        VmafPredictor *p = vmaf->predictors.predictor[i];
+        if (p->model == model && p->model_id == model->id) {
+            *predictor = p;
+            return 0;
+        }
+    }
+
+    VmafPredictor *p;
+    int err = vmaf_predictor_create(&p, model, vmaf->feature_collector);
+    if (err) return err;
+
+    // A predictor of an earlier model at the same address is stale.
+    for (unsigned i = 0; i < vmaf->predictors.cnt; i++) {
+        if (vmaf->predictors.predictor[i]->model == model) {
+            vmaf_predictor_destroy(vmaf->predictors.predictor[i]);
+            *predictor = vmaf->predictors.predictor[i] = p;
+            return 0;
+        }
+    }
+
+    if (vmaf->predictors.cnt == vmaf->predictors.capacity) {
+        const unsigned capacity =
+            vmaf->predictors.capacity ? vmaf->predictors.capacity * 2 : 4;
+        VmafPredictor **predictors =
+            realloc(vmaf->predictors.predictor, sizeof(*predictors) * capacity);
+        if (!predictors) {
+            vmaf_predictor_destroy(p);
+            return -ENOMEM;
+        }
+        vmaf->predictors.predictor = predictors;
+        vmaf->predictors.capacity = capacity;
+    }
+
+    *predictor = vmaf->predictors.predictor[vmaf->predictors.cnt++] = p;
+    return 0;
+}
+
 int vmaf_score_at_index(VmafContext *vmaf, VmafModel *model, double *score,
                         unsigned index)
 {
@@ -387,14 +594,40 @@ int vmaf_score_at_index(VmafContext *vmaf, VmafModel *model, double *score,
     if (!model) return -EINVAL;
     if (!score) return -EINVAL;
 
-    int err =
-        vmaf_feature_collector_get_score(vmaf->feature_collector, model->name,
-                                         score, index);
-    if (err) {
-        err = vmaf_predict_score_at_index(model, vmaf->feature_collector, index,
-                                          score, true, 0);
-    }
+    pthread_mutex_lock(&(vmaf->predictors.lock));
+
+    VmafPredictor *predictor;
+    int err = get_predictor(vmaf, model, &predictor);
+    if (err) goto unlock;
+
+    err = vmaf_predictor_get_prediction(predictor, index, score);
+    if (err)
+        err = vmaf_predictor_predict(predictor, index, score, true, 0);
 
+unlock:
+    pthread_mutex_unlock(&(vmaf->predictors.lock));
+    return err;
+}
+
+int vmaf_predict_scores_range(VmafContext *vmaf, VmafModel *model,
+                              double *scores, unsigned index_low,
+                              unsigned index_high)
+{
+    if (!vmaf) return -EINVAL;
+    if (!model) return -EINVAL;
+    if (index_low > index_high) return -EINVAL;
+
+    pthread_mutex_lock(&(vmaf->predictors.lock));
+
+    VmafPredictor *predictor;
+    int err = get_predictor(vmaf, model, &predictor);
+    if (err) goto unlock;
+
+    err = vmaf_predictor_predict_range(predictor, index_low, index_high,
+                                       vmaf->cfg.n_subsample, scores);
+
+unlock:
+    pthread_mutex_unlock(&(vmaf->predictors.lock));
     return err;
 }
 
@@ -406,10 +639,23 @@ int vmaf_score_at_index_model_collection(VmafContext *vmaf,
     if (!vmaf) return -EINVAL;
     if (!model_collection) return -EINVAL;
     if (!score) return -EINVAL;
+    if (!model_collection->cnt) return -EINVAL;
+
+    pthread_mutex_lock(&(vmaf->predictors.lock));
 
-    return vmaf_predict_score_at_index_model_collection(model_collection,
-                                                        vmaf->feature_collector,
-                                                        index, score);
+    int err = 0;
+    VmafPredictor *predictor[model_collection->cnt];
+    for (unsigned i = 0; i < model_collection->cnt; i++) {
+        err = get_predictor(vmaf, model_collection->model[i], &predictor[i]);
+        if (err) goto unlock;
+    }
+
+    err = vmaf_predict_score_at_index_model_collection(model_collection,
+                                                       predictor, index, score);
+
+unlock:
+    pthread_mutex_unlock(&(vmaf->predictors.lock));
+    return err;
 }
 
 int vmaf_feature_score_pooled(VmafContext *vmaf, const char *feature_name,
@@ -468,13 +714,9 @@ int vmaf_score_pooled(VmafContext *vmaf, VmafModel *model,
     if (index_low > index_high) return -EINVAL;
     if (!pool_method) return -EINVAL;
 
-    for (unsigned i = index_low; i <= index_high; i++) {
-        if ((vmaf->cfg.n_subsample > 1) && (i % vmaf->cfg.n_subsample))
-            continue;
-        double vmaf_score;
-        int err = vmaf_score_at_index(vmaf, model, &vmaf_score, i);
-        if (err) return err;
-    }
+    int err = vmaf_predict_scores_range(vmaf, model, NULL, index_low,
+                                        index_high);
+    if (err) return err;
 
     return vmaf_feature_score_pooled(vmaf, model->name, pool_method, score,
                                      index_low, index_high);
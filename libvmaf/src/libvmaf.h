@@ -19,6 +19,7 @@
 #ifndef __VMAF_H__
 #define __VMAF_H__
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -59,7 +60,9 @@ typedef struct VmafConfiguration {
     enum VmafLogLevel log_level;
     unsigned n_threads;
     unsigned n_subsample;
-    uint64_t cpumask;
+    uint64_t cpumask; ///< CPU flags to disable. Disabling a tier disables the ones above it.
+    unsigned max_inflight_frames; ///< Threaded only. 0 for no limit.
+    bool nonblocking; ///< Return -EAGAIN instead of waiting for a slot.
 } VmafConfiguration;
 
 typedef struct VmafContext VmafContext;
@@ -79,6 +82,28 @@ typedef struct VmafContext VmafContext;
  */
 int vmaf_init(VmafContext **vmaf, VmafConfiguration cfg);
 
+/**
+ * Allocate and open a VMAF instance which runs its feature extraction on the
+ * thread pool of another instance instead of starting threads of its own.
+ * Useful when scoring several distorted inputs against the same reference
+ * side by side. Flushing either instance waits for the jobs of both.
+ *
+ * @param vmaf   The VMAF instance to open.
+ *               Context should be cleaned up with `vmaf_close()` when finished.
+ *
+ * @param cfg    Configuration parameters. `n_threads` must be non-zero and
+ *               sizes the instance's pool of feature extractor contexts.
+ *
+ * @param parent VMAF instance opened with `n_threads` > 0 whose thread pool
+ *               is shared. The pool lives until every instance sharing it has
+ *               been closed, in any order.
+ *
+ *
+ * @return 0 on success, or < 0 (a negative errno code) on error.
+ */
+int vmaf_init_shared(VmafContext **vmaf, VmafConfiguration cfg,
+                     VmafContext *parent);
+
 /**
  * Register feature extractors required by a specific `VmafModel`.
  * This may be called multiple times using different models.
@@ -130,6 +155,48 @@ int vmaf_use_features_from_model_collection(VmafContext *vmaf,
 int vmaf_use_feature(VmafContext *vmaf, const char *feature_name,
                      VmafFeatureDictionary *opts_dict);
 
+/**
+ * Check whether any registered feature extractor reads the chroma planes.
+ * When none does, luma-only `VMAF_PIX_FMT_YUV400P` pictures give the same
+ * scores as full YUV pictures, so a caller can skip scaling and copying the
+ * chroma planes. Call this after the feature extractors are registered.
+ *
+ * @param vmaf The VMAF context allocated with `vmaf_init()`.
+ *
+ *
+ * @return 1 if chroma is needed, 0 if it is not, or < 0 (a negative errno
+ *         code) on error.
+ */
+int vmaf_needs_chroma(VmafContext *vmaf);
+
+/**
+ * Fetch a picture from the context's picture pool.
+ * Behaves like `vmaf_picture_alloc()`, but the buffer is recycled: once the
+ * last reference to the picture is dropped it returns to the pool and is
+ * handed out again by a later call with the same format and size. This keeps
+ * the steady state of a frame loop free of allocations. The buffer is not
+ * cleared between uses. Pictures still referenced when the context is closed
+ * are freed once they are unreferenced.
+ *
+ * @param vmaf    The VMAF context allocated with `vmaf_init()`.
+ *
+ * @param pic     Picture to initialize.
+ *
+ * @param pix_fmt Pixel format.
+ *
+ * @param bpc     Bits per component.
+ *
+ * @param w       Luma width.
+ *
+ * @param h       Luma height.
+ *
+ *
+ * @return 0 on success, or < 0 (a negative errno code) on error.
+ */
+int vmaf_fetch_picture(VmafContext *vmaf, VmafPicture *pic,
+                       enum VmafPixelFormat pix_fmt, unsigned bpc,
+                       unsigned w, unsigned h);
+
 /**
  * Import an external feature score.
  * Useful when pre-computed feature scores are available.
@@ -160,6 +227,12 @@ int vmaf_import_feature_score(VmafContext *vmaf, const char *feature_name,
  * When you're done reading pictures call this function again with both `ref`
  * and `dist` set to NULL to flush all feature extractors.
  *
+ * With `n_threads` > 0 and `max_inflight_frames` set, at most that many
+ * picture pairs are queued or being extracted at a time. When the limit is
+ * reached this function waits for a pair to finish, or returns -EAGAIN if
+ * `nonblocking` is set. After -EAGAIN the caller still owns both pictures
+ * and may retry with them.
+ *
  * @param vmaf  The VMAF context allocated with `vmaf_init()`.
  *
  * @param ref   Reference picture.
@@ -191,6 +264,31 @@ int vmaf_read_pictures(VmafContext *vmaf, VmafPicture *ref, VmafPicture *dist,
 int vmaf_score_at_index(VmafContext *vmaf, VmafModel *model, double *score,
                         unsigned index);
 
+/**
+ * Predict VMAF scores for a contiguous range of pictures in one call.
+ * Pictures skipped by `n_subsample` are not scored and their entries in
+ * `scores` are left untouched.
+ *
+ * @param vmaf        The VMAF context allocated with `vmaf_init()`.
+ *
+ * @param model       Opaque model context.
+ *
+ * @param scores      Predicted scores, `scores[i]` for picture
+ *                    `index_low + i`. Must hold
+ *                    `index_high - index_low + 1` entries. May be NULL when
+ *                    only the context's predictions are wanted.
+ *
+ * @param index_low   Low picture index of the range.
+ *
+ * @param index_high  High picture index of the range, inclusive.
+ *
+ *
+ * @return 0 on success, or < 0 (a negative errno code) on error.
+ */
+int vmaf_predict_scores_range(VmafContext *vmaf, VmafModel *model,
+                              double *scores, unsigned index_low,
+                              unsigned index_high);
+
 /**
  * Predict VMAF score at specific index, using a model collection.
  *
@@ -3,10 +3,11 @@ extern "C" {
 #include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
 }
+#include <fstream>
+#include <sstream>
 #include <string>
 
 #include "libvmaf.h"
-#include "read_json_model.h"
 
 int InitializeVmaf(VmafContext* vmaf, VmafModel** model,
                    VmafModelCollection** model_collection,
@@ -17,12 +18,24 @@ int InitializeVmaf(VmafContext* vmaf, VmafModel** model,
   VmafModelConfig model_config{
     .name = "default_vmaf_model",
   };
+  std::ifstream model_file(model_path, std::ios::binary);
+  std::stringstream model_data;
+  model_data << model_file.rdbuf();
+  const std::string model_buffer = model_data.str();
+  if (model_buffer.empty()) {
+    fprintf(stderr, "Problem reading model from path: %s\n", model_path);
+    return -1;
+  }
+
+  // The model is shared, through the registry, with every other context which
+  // loads the same file.
   fprintf(stderr, "ready to read model from buffer\n");
-  if (vmaf_read_json_model_from_path(&model[0], &model_config,
-                                       model_path)) {
-    int err = vmaf_read_json_model_collection_from_path(
+  if (vmaf_model_acquire_from_buffer(&model[0], &model_config,
+                                     model_buffer.data(),
+                                     model_buffer.size())) {
+    int err = vmaf_model_collection_acquire_from_buffer(
         &model[0], &model_collection[*model_collection_count], &model_config,
-        model_path);
+        model_buffer.data(), model_buffer.size());
 
     if (err) {
       fprintf(stderr, "Problem loading model. error_code: %d\n", err);
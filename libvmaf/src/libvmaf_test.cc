@@ -0,0 +1,141 @@
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "feature_test_util.h"
+
+namespace {
+
+using vmaf_test::Frame;
+
+const std::vector<std::string> kExtractors = {"vif", "adm", "motion"};
+
+const std::vector<std::string> kFeatures = {
+    "VMAF_integer_feature_vif_scale0_score",
+    "VMAF_integer_feature_vif_scale3_score",
+    "VMAF_integer_feature_adm2_score",
+    "VMAF_integer_feature_motion_score",
+    "VMAF_integer_feature_motion2_score",
+};
+
+Frame NoiseFrame(unsigned w, unsigned h, std::mt19937* rng) {
+  Frame f = {w, h, 8, std::vector<uint16_t>(w * h)};
+  std::uniform_int_distribution<int> sample(0, 255);
+  for (uint16_t& v : f.luma) v = sample(*rng);
+  return f;
+}
+
+// Frames large enough that extracting one takes far longer than a call to
+// vmaf_read_pictures(), so the pair read before is still in flight.
+void MakeFrames(std::vector<Frame>* ref, std::vector<Frame>* dist) {
+  std::mt19937 rng(3);
+  for (unsigned i = 0; i < 6; i++) {
+    ref->push_back(NoiseFrame(1280, 720, &rng));
+    dist->push_back(NoiseFrame(1280, 720, &rng));
+  }
+}
+
+struct ReadResult {
+  std::vector<std::vector<double>> scores;
+  unsigned n_eagain = 0;
+};
+
+// Scores the frames under the configuration. A read which returns -EAGAIN is
+// retried with the same pictures once the frames in flight have had time to
+// drain.
+ReadResult ReadWithRetries(const std::vector<Frame>& ref,
+                           const std::vector<Frame>& dist,
+                           VmafConfiguration config) {
+  ReadResult result;
+  VmafContext* vmaf;
+  EXPECT_EQ(vmaf_init(&vmaf, config), 0);
+  for (const std::string& name : kExtractors)
+    EXPECT_EQ(vmaf_use_feature(vmaf, name.c_str(), nullptr), 0);
+
+  for (unsigned i = 0; i < ref.size(); i++) {
+    VmafPicture pic[2];
+    EXPECT_EQ(vmaf_test::ToPicture(ref[i], &pic[0]), 0);
+    EXPECT_EQ(vmaf_test::ToPicture(dist[i], &pic[1]), 0);
+    int err;
+    while ((err = vmaf_read_pictures(vmaf, &pic[0], &pic[1], i)) == -EAGAIN) {
+      result.n_eagain++;
+      // The pictures are still the caller's.
+      EXPECT_NE(pic[0].ref, nullptr);
+      EXPECT_NE(pic[1].ref, nullptr);
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(err, 0) << "frame " << i;
+  }
+  EXPECT_EQ(vmaf_read_pictures(vmaf, nullptr, nullptr, 0), 0);
+
+  result.scores = vmaf_test::ReadFeatures(vmaf, ref.size(), kFeatures);
+  vmaf_close(vmaf);
+  return result;
+}
+
+TEST(LibvmafTest, NonblockingReadReturnsEagainAtTheLimit) {
+  std::vector<Frame> ref, dist;
+  MakeFrames(&ref, &dist);
+  const VmafConfiguration config = {
+      .log_level = VMAF_LOG_LEVEL_NONE,
+      .n_threads = 1,
+      .max_inflight_frames = 1,
+      .nonblocking = true,
+  };
+  VmafContext* vmaf;
+  ASSERT_EQ(vmaf_init(&vmaf, config), 0);
+  for (const std::string& name : kExtractors)
+    ASSERT_EQ(vmaf_use_feature(vmaf, name.c_str(), nullptr), 0);
+
+  VmafPicture pic[4];
+  for (unsigned k = 0; k < 4; k++)
+    ASSERT_EQ(vmaf_test::ToPicture(ref[k / 2], &pic[k]), 0);
+  ASSERT_EQ(vmaf_read_pictures(vmaf, &pic[0], &pic[1], 0), 0);
+  // Frame 0 holds the only slot.
+  EXPECT_EQ(vmaf_read_pictures(vmaf, &pic[2], &pic[3], 1), -EAGAIN);
+
+  // Once it drains the same pictures are accepted.
+  int err;
+  while ((err = vmaf_read_pictures(vmaf, &pic[2], &pic[3], 1)) == -EAGAIN)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  EXPECT_EQ(err, 0);
+  EXPECT_EQ(vmaf_read_pictures(vmaf, nullptr, nullptr, 0), 0);
+  vmaf_close(vmaf);
+}
+
+TEST(LibvmafTest, InflightLimitKeepsTheScores) {
+  std::vector<Frame> ref, dist;
+  MakeFrames(&ref, &dist);
+  const VmafConfiguration serial = {
+      .log_level = VMAF_LOG_LEVEL_NONE,
+  };
+  const auto expected = ReadWithRetries(ref, dist, serial).scores;
+  ASSERT_EQ(expected.size(), ref.size());
+  for (const auto& frame_scores : expected)
+    ASSERT_THAT(frame_scores, testing::Each(testing::Ge(0.0)));
+
+  for (unsigned limit : {0u, 1u, 2u}) {
+    VmafConfiguration config = {
+        .log_level = VMAF_LOG_LEVEL_NONE,
+        .n_threads = 2,
+        .max_inflight_frames = limit,
+    };
+    // Bit-exact, not approximately equal.
+    const ReadResult blocking = ReadWithRetries(ref, dist, config);
+    EXPECT_EQ(blocking.n_eagain, 0u);
+    EXPECT_EQ(blocking.scores, expected) << "blocking, limit " << limit;
+
+    config.nonblocking = true;
+    const ReadResult nonblocking = ReadWithRetries(ref, dist, config);
+    if (limit) EXPECT_GT(nonblocking.n_eagain, 0u);
+    EXPECT_EQ(nonblocking.scores, expected) << "nonblocking, limit " << limit;
+  }
+}
+
+}  // namespace
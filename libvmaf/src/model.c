@@ -1,4 +1,5 @@
 #include <errno.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -6,6 +7,7 @@
 
 #include "model_interface.h"
 
+#include "binary_model.h"
 #include "feature_extractor.h"
 #include "log.h"
 #include "model.h"
@@ -130,10 +132,18 @@ char *vmaf_model_generate_name(VmafModelConfig *cfg)
     return name;
 }
 
+unsigned long vmaf_model_generate_id(void)
+{
+    static atomic_ulong next_id = 1;
+    return atomic_fetch_add(&next_id, 1);
+}
+
 int vmaf_model_load_from_path(VmafModel **model, VmafModelConfig *cfg,
                               const char *path)
 {
-    int err = vmaf_read_json_model_from_path(model, cfg, path);
+    int err = vmaf_is_binary_model_path(path) ?
+        vmaf_read_binary_model_from_path(model, cfg, path) :
+        vmaf_read_json_model_from_path(model, cfg, path);
     if (err) {
         vmaf_log(VMAF_LOG_LEVEL_ERROR,
                  "could not read model from path: \"%s\"\n", path);
@@ -149,6 +159,8 @@ int vmaf_model_load_from_path(VmafModel **model, VmafModelConfig *cfg,
 
 int vmaf_model_load_from_buffer(VmafModel **model, VmafModelConfig *cfg,
                                 const char *data, const int data_len) {
+    if (data_len > 0 && vmaf_is_binary_model(data, data_len))
+        return vmaf_read_binary_model_from_buffer(model, cfg, data, data_len);
     return vmaf_read_json_model_from_buffer(model, cfg, data, data_len);
 }
 
@@ -283,7 +295,9 @@ int vmaf_model_collection_load_from_path(VmafModel **model,
                                          VmafModelConfig *cfg,
                                          const char *path)
 {
-    int err =
+    int err = vmaf_is_binary_model_path(path) ?
+        vmaf_read_binary_model_collection_from_path(model, model_collection,
+                                                    cfg, path) :
         vmaf_read_json_model_collection_from_path(model, model_collection,
                                                   cfg, path);
     if (err) {
@@ -306,6 +320,12 @@ int vmaf_model_collection_load_from_buffer(VmafModel **model,
                                       const char *data,
                                       const int data_len)
 {
+    if (data_len > 0 && vmaf_is_binary_model(data, data_len)) {
+        return vmaf_read_binary_model_collection_from_buffer(model,
+                                                             model_collection,
+                                                             cfg, data,
+                                                             data_len);
+    }
     return vmaf_read_json_model_collection_from_buffer(model, model_collection,
                                                        cfg, data, data_len);
 }
@@ -49,6 +49,7 @@ typedef struct {
 } VmafPoint;
 
 typedef struct VmafModel {
+    unsigned long id;
     char *path;
     char *name;
     enum VmafModelType type;
@@ -85,6 +86,10 @@ typedef struct VmafModelCollection {
 
 char *vmaf_model_generate_name(VmafModelConfig *cfg);
 
+/* Unique for every loaded model, so that state compiled against a model is
+ * never mistaken for state of a later one allocated at the same address. */
+unsigned long vmaf_model_generate_id(void);
+
 int vmaf_model_collection_append(VmafModelCollection **model_collection,
                                  VmafModel *model);
 
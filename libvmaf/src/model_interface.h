@@ -96,6 +96,43 @@ int vmaf_model_collection_feature_overload(VmafModel *model,
 
 void vmaf_model_collection_destroy(VmafModelCollection *model_collection);
 
+/*
+ * Process-wide registry of models, keyed by a hash of the model data and the
+ * config. Acquiring data that is already loaded hands out the loaded model and
+ * takes a reference on it instead of parsing it again, so contexts on any
+ * thread share one copy. Acquired models are read-only: a model to pass to
+ * vmaf_model_feature_overload() must be loaded on its own.
+ *
+ * Every handle acquired, the model and the model collection alike, is released
+ * on its own. A model is destroyed with the last release of its handles,
+ * unless it is pinned.
+ */
+int vmaf_model_acquire_from_buffer(VmafModel **model, VmafModelConfig *cfg,
+                                  const char *data, const int data_len);
+
+int vmaf_model_collection_acquire_from_buffer(VmafModel **model,
+                                             VmafModelCollection **model_collection,
+                                             VmafModelConfig *cfg,
+                                             const char *data,
+                                             const int data_len);
+
+/* Models and collections which were not acquired are destroyed. */
+void vmaf_model_release(VmafModel *model);
+
+void vmaf_model_collection_release(VmafModelCollection *model_collection);
+
+/*
+ * Keeps an acquired model, and the collection acquired with it, loaded after
+ * its last release, so that later acquires of the same data skip parsing it.
+ * Pinned models stay loaded until vmaf_model_registry_purge(), so only pin
+ * models from a bounded set of buffers.
+ */
+int vmaf_model_pin(VmafModel *model);
+
+/* Destroys the registered models nobody holds a reference to and unpins the
+ * rest, which go with their last release. */
+void vmaf_model_registry_purge(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,296 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "model_interface.h"
+
+#include "model.h"
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+typedef struct ModelRegistryEntry {
+    uint64_t hash;
+    char *data;
+    size_t data_len;
+    uint64_t flags;
+    char *name;
+    VmafModel *model;
+    VmafModelCollection *model_collection;
+    unsigned ref_cnt;
+    bool pinned;
+    struct ModelRegistryEntry *next;
+} ModelRegistryEntry;
+
+static struct {
+    ModelRegistryEntry *head;
+    pthread_mutex_t lock;
+} registry = {
+    .head = NULL,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+static uint64_t hash_data(const char *data, size_t data_len)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (size_t i = 0; i < data_len; i++) {
+        hash ^= (uint8_t) data[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static bool same_name(const char *a, const char *b)
+{
+    if (!a || !b) return a == b;
+    return !strcmp(a, b);
+}
+
+/* The config is part of the key, since its name and flags are applied to the
+ * model as it is loaded. The hash only picks the candidates; the data itself
+ * decides. Must be called with registry.lock held. */
+static ModelRegistryEntry *find_entry(uint64_t hash, const char *data,
+                                      size_t data_len,
+                                      const VmafModelConfig *cfg)
+{
+    for (ModelRegistryEntry *e = registry.head; e; e = e->next) {
+        if (e->hash == hash && e->data_len == data_len &&
+            e->flags == cfg->flags && same_name(e->name, cfg->name) &&
+            !memcmp(e->data, data, data_len))
+        {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+static void destroy_entry(ModelRegistryEntry *e)
+{
+    vmaf_model_collection_destroy(e->model_collection);
+    vmaf_model_destroy(e->model);
+    free(e->data);
+    free(e->name);
+    free(e);
+}
+
+static int add_entry(uint64_t hash, const char *data, size_t data_len,
+                     const VmafModelConfig *cfg, VmafModel *model,
+                     VmafModelCollection *model_collection, unsigned ref_cnt)
+{
+    ModelRegistryEntry *e = malloc(sizeof(*e));
+    if (!e) return -ENOMEM;
+    memset(e, 0, sizeof(*e));
+    e->data = malloc(data_len);
+    if (!e->data) goto fail;
+    memcpy(e->data, data, data_len);
+    if (cfg->name) {
+        e->name = strdup(cfg->name);
+        if (!e->name) goto fail;
+    }
+    e->hash = hash;
+    e->data_len = data_len;
+    e->flags = cfg->flags;
+    e->model = model;
+    e->model_collection = model_collection;
+    e->ref_cnt = ref_cnt;
+    e->next = registry.head;
+    registry.head = e;
+    return 0;
+
+fail:
+    free(e->data);
+    free(e);
+    return -ENOMEM;
+}
+
+int vmaf_model_acquire_from_buffer(VmafModel **model, VmafModelConfig *cfg,
+                                   const char *data, const int data_len)
+{
+    if (!model) return -EINVAL;
+    if (!cfg) return -EINVAL;
+    if (!data) return -EINVAL;
+    if (data_len <= 0) return -EINVAL;
+
+    const uint64_t hash = hash_data(data, data_len);
+    int err = 0;
+
+    pthread_mutex_lock(&registry.lock);
+
+    ModelRegistryEntry *e = find_entry(hash, data, data_len, cfg);
+    if (e) {
+        // The data is known to hold a collection, which can't be read as a
+        // model; fail without parsing it again.
+        if (e->model_collection) {
+            err = -EINVAL;
+            goto unlock;
+        }
+        e->ref_cnt++;
+        *model = e->model;
+        goto unlock;
+    }
+
+    VmafModel *m;
+    err = vmaf_model_load_from_buffer(&m, cfg, data, data_len);
+    if (err) goto unlock;
+    err = add_entry(hash, data, data_len, cfg, m, NULL, 1);
+    if (err) {
+        vmaf_model_destroy(m);
+        goto unlock;
+    }
+    *model = m;
+
+unlock:
+    pthread_mutex_unlock(&registry.lock);
+    return err;
+}
+
+int vmaf_model_collection_acquire_from_buffer(VmafModel **model,
+                                       VmafModelCollection **model_collection,
+                                       VmafModelConfig *cfg,
+                                       const char *data, const int data_len)
+{
+    if (!model) return -EINVAL;
+    if (!model_collection) return -EINVAL;
+    if (!cfg) return -EINVAL;
+    if (!data) return -EINVAL;
+    if (data_len <= 0) return -EINVAL;
+
+    const uint64_t hash = hash_data(data, data_len);
+    int err = 0;
+
+    pthread_mutex_lock(&registry.lock);
+
+    ModelRegistryEntry *e = find_entry(hash, data, data_len, cfg);
+    if (e) {
+        if (!e->model_collection) {
+            err = -EINVAL;
+            goto unlock;
+        }
+        // One reference for each of the two handles.
+        e->ref_cnt += 2;
+        *model = e->model;
+        *model_collection = e->model_collection;
+        goto unlock;
+    }
+
+    VmafModel *m;
+    VmafModelCollection *mc;
+    err = vmaf_model_collection_load_from_buffer(&m, &mc, cfg, data,
+                                                 data_len);
+    if (err) goto unlock;
+    err = add_entry(hash, data, data_len, cfg, m, mc, 2);
+    if (err) {
+        vmaf_model_collection_destroy(mc);
+        vmaf_model_destroy(m);
+        goto unlock;
+    }
+    *model = m;
+    *model_collection = mc;
+
+unlock:
+    pthread_mutex_unlock(&registry.lock);
+    return err;
+}
+
+/* Drops a reference on the entry holding the model or the collection and
+ * destroys the entry with its last one, unless it is pinned. Returns false if
+ * neither is registered. */
+static bool release_entry(const VmafModel *model,
+                          const VmafModelCollection *model_collection)
+{
+    pthread_mutex_lock(&registry.lock);
+    ModelRegistryEntry **next = &registry.head;
+    while (*next) {
+        ModelRegistryEntry *e = *next;
+        if ((model && e->model == model) ||
+            (model_collection && e->model_collection == model_collection))
+        {
+            break;
+        }
+        next = &e->next;
+    }
+
+    ModelRegistryEntry *e = *next;
+    if (!e) {
+        pthread_mutex_unlock(&registry.lock);
+        return false;
+    }
+    if (e->ref_cnt) e->ref_cnt--;
+    if (e->ref_cnt || e->pinned) {
+        pthread_mutex_unlock(&registry.lock);
+        return true;
+    }
+    *next = e->next;
+    pthread_mutex_unlock(&registry.lock);
+
+    destroy_entry(e);
+    return true;
+}
+
+void vmaf_model_release(VmafModel *model)
+{
+    if (!model) return;
+    if (!release_entry(model, NULL))
+        vmaf_model_destroy(model);
+}
+
+void vmaf_model_collection_release(VmafModelCollection *model_collection)
+{
+    if (!model_collection) return;
+    if (!release_entry(NULL, model_collection))
+        vmaf_model_collection_destroy(model_collection);
+}
+
+int vmaf_model_pin(VmafModel *model)
+{
+    if (!model) return -EINVAL;
+
+    int err = -EINVAL;
+    pthread_mutex_lock(&registry.lock);
+    for (ModelRegistryEntry *e = registry.head; e; e = e->next) {
+        if (e->model != model) continue;
+        e->pinned = true;
+        err = 0;
+        break;
+    }
+    pthread_mutex_unlock(&registry.lock);
+    return err;
+}
+
+void vmaf_model_registry_purge(void)
+{
+    pthread_mutex_lock(&registry.lock);
+    ModelRegistryEntry **next = &registry.head;
+    while (*next) {
+        ModelRegistryEntry *e = *next;
+        if (e->ref_cnt) {
+            e->pinned = false;
+            next = &e->next;
+            continue;
+        }
+        *next = e->next;
+        destroy_entry(e);
+    }
+    pthread_mutex_unlock(&registry.lock);
+}
@@ -28,8 +28,8 @@
 
 #define DATA_ALIGN 32
 
-int vmaf_picture_alloc(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
-                       unsigned bpc, unsigned w, unsigned h)
+static int picture_set_params(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
+                              unsigned bpc, unsigned w, unsigned h)
 {
     if (!pic) return -EINVAL;
     if (!pix_fmt) return -EINVAL;
@@ -47,6 +47,15 @@ int vmaf_picture_alloc(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
     if (pic->pix_fmt == VMAF_PIX_FMT_YUV400P)
         pic->w[1] = pic->w[2] = pic->h[1] = pic->h[2] = 0;
 
+    return 0;
+}
+
+int vmaf_picture_alloc(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
+                       unsigned bpc, unsigned w, unsigned h)
+{
+    int err = picture_set_params(pic, pix_fmt, bpc, w, h);
+    if (err) return err;
+
     const int aligned_y = (pic->w[0] + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1);
     const int aligned_c = (pic->w[1] + DATA_ALIGN - 1) & ~(DATA_ALIGN - 1);
     const int hbd = pic->bpc > 8;
@@ -65,7 +74,7 @@ int vmaf_picture_alloc(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
     if (pic->pix_fmt == VMAF_PIX_FMT_YUV400P)
         pic->data[1] = pic->data[2] = NULL;
 
-    int err = vmaf_ref_init(&pic->ref);
+    err = vmaf_ref_init(&pic->ref);
     if (err) goto free_data;
 
     return 0;
@@ -76,6 +85,49 @@ fail:
     return -ENOMEM;
 }
 
+int vmaf_picture_wrap(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
+                      unsigned bpc, unsigned w, unsigned h, void *data[3],
+                      const ptrdiff_t stride[3],
+                      void (*release)(void *cookie), void *cookie)
+{
+    if (!pic) return -EINVAL;
+    if (!data) return -EINVAL;
+    if (!stride) return -EINVAL;
+
+    // Every plane is checked against the parameters before any of them is
+    // written, so that *pic is left untouched on error.
+    VmafPicture params;
+    int err = picture_set_params(&params, pix_fmt, bpc, w, h);
+    if (err) return err;
+
+    const int hbd = params.bpc > 8;
+    const unsigned n_planes = params.pix_fmt == VMAF_PIX_FMT_YUV400P ? 1 : 3;
+    for (unsigned i = 0; i < n_planes; i++) {
+        if (!data[i]) return -EINVAL;
+        if (stride[i] < ((ptrdiff_t)params.w[i] << hbd)) return -EINVAL;
+        params.data[i] = data[i];
+        params.stride[i] = stride[i];
+    }
+    *pic = params;
+
+    VmafPicturePrivate *priv = pic->priv = malloc(sizeof(*priv));
+    if (!priv) goto fail;
+    priv->release = release;
+    priv->cookie = cookie;
+    priv->pooled = false;
+
+    err = vmaf_ref_init(&pic->ref);
+    if (err) goto free_priv;
+
+    return 0;
+
+free_priv:
+    free(priv);
+fail:
+    memset(pic, 0, sizeof(*pic));
+    return -ENOMEM;
+}
+
 int vmaf_picture_ref(VmafPicture *dst, VmafPicture *src) {
     if (!dst || !src) return -EINVAL;
 
@@ -88,10 +140,19 @@ int vmaf_picture_unref(VmafPicture *pic) {
     if (!pic) return -EINVAL;
     if (!pic->ref) return -EINVAL;
 
-    vmaf_ref_fetch_decrement(pic->ref);
-    if (vmaf_ref_load(pic->ref) == 0) {
-        aligned_free(pic->data[0]);
-        vmaf_ref_close(pic->ref);
+    if (vmaf_ref_fetch_decrement(pic->ref) == 1) {
+        VmafPicturePrivate *priv = pic->priv;
+        if (priv && priv->pooled) {
+            priv->release(priv->cookie);
+        } else {
+            if (!priv) {
+                aligned_free(pic->data[0]);
+            } else {
+                if (priv->release) priv->release(priv->cookie);
+                free(priv);
+            }
+            vmaf_ref_close(pic->ref);
+        }
     }
     memset(pic, 0, sizeof(*pic));
     return 0;
@@ -19,8 +19,16 @@
 #ifndef __VMAF_SRC_PICTURE_H__
 #define __VMAF_SRC_PICTURE_H__
 
+#include <stdbool.h>
+
 #include "picture_interface.h"
 
-int vmaf_picture_ref(VmafPicture *dst, VmafPicture *src);
+typedef struct VmafPicturePrivate {
+    void (*release)(void *cookie);
+    void *cookie;
+    // Buffer, ref and this struct belong to whoever `release` hands the
+    // picture back to, e.g. a VmafPicturePool, and are not freed on unref.
+    bool pooled;
+} VmafPicturePrivate;
 
 #endif /* __VMAF_SRC_PICTURE_H__ */
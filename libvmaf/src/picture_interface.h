@@ -42,11 +42,61 @@ typedef struct {
     ptrdiff_t stride[3];
     void *data[3];
     VmafRef *ref;
+    void *priv;
 } VmafPicture;
 
 int vmaf_picture_alloc(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
                        unsigned bpc, unsigned w, unsigned h);
 
+/**
+ * Wrap externally owned planes in a `VmafPicture` without copying them.
+ * The picture is reference counted like one from `vmaf_picture_alloc()`.
+ * When the last reference is dropped, `release` is called with `cookie`
+ * instead of freeing the planes, e.g. to unref the decoder's frame buffer.
+ * `release` may be called from a libvmaf worker thread.
+ *
+ * @param pic     Picture to initialize.
+ *
+ * @param pix_fmt Pixel format of the planes.
+ *
+ * @param bpc     Bits per component. Samples are 16-bit words if `bpc > 8`.
+ *
+ * @param w       Luma width.
+ *
+ * @param h       Luma height.
+ *
+ * @param data    Plane pointers. Chroma planes are ignored for
+ *                `VMAF_PIX_FMT_YUV400P`.
+ *
+ * @param stride  Plane strides in bytes. Each must be at least the width
+ *                of its plane in bytes.
+ *
+ * @param release Called once the picture is no longer used. May be NULL.
+ *
+ * @param cookie  Opaque pointer passed to `release`.
+ *
+ *
+ * @return 0 on success, or < 0 (a negative errno code) on error.
+ */
+int vmaf_picture_wrap(VmafPicture *pic, enum VmafPixelFormat pix_fmt,
+                      unsigned bpc, unsigned w, unsigned h, void *data[3],
+                      const ptrdiff_t stride[3],
+                      void (*release)(void *cookie), void *cookie);
+
+/**
+ * Take another reference to a picture. `dst` becomes a copy of `src` that
+ * shares its planes, and each of them must be unreferenced with
+ * `vmaf_picture_unref()`.
+ *
+ * @param dst Picture to initialize.
+ *
+ * @param src Referenced picture.
+ *
+ *
+ * @return 0 on success, or < 0 (a negative errno code) on error.
+ */
+int vmaf_picture_ref(VmafPicture *dst, VmafPicture *src);
+
 int vmaf_picture_unref(VmafPicture *pic);
 
 #ifdef __cplusplus
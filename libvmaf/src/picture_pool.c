@@ -0,0 +1,229 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mem.h"
+#include "picture.h"
+#include "picture_pool.h"
+#include "ref.h"
+
+// Idle pictures kept per (pix_fmt, bpc, w, h). Pictures returned beyond this
+// are freed, so a burst of fetches doesn't pin its memory for good.
+#define PICTURE_POOL_MAX_IDLE_PER_KEY 32
+
+struct VmafPicturePoolKey;
+
+typedef struct VmafPicturePoolEntry {
+    VmafPicture pic;
+    VmafPicturePrivate priv;
+    VmafPicturePool *pool;
+    struct VmafPicturePoolKey *key;
+    struct VmafPicturePoolEntry *next;
+} VmafPicturePoolEntry;
+
+typedef struct VmafPicturePoolKey {
+    enum VmafPixelFormat pix_fmt;
+    unsigned bpc, w, h;
+    VmafPicturePoolEntry *free_list;
+    unsigned n_idle;
+    struct VmafPicturePoolKey *next;
+} VmafPicturePoolKey;
+
+typedef struct VmafPicturePool {
+    pthread_mutex_t lock;
+    VmafPicturePoolKey *key;
+    unsigned n_outstanding;
+    bool closed;
+} VmafPicturePool;
+
+static void picture_pool_destroy(VmafPicturePool *pool)
+{
+    VmafPicturePoolKey *key = pool->key;
+    while (key) {
+        VmafPicturePoolKey *next = key->next;
+        free(key);
+        key = next;
+    }
+    pthread_mutex_destroy(&(pool->lock));
+    free(pool);
+}
+
+static void picture_pool_entry_destroy(VmafPicturePoolEntry *entry)
+{
+    aligned_free(entry->pic.data[0]);
+    vmaf_ref_close(entry->pic.ref);
+    free(entry);
+}
+
+static void picture_pool_entry_return(void *cookie)
+{
+    VmafPicturePoolEntry *entry = cookie;
+    VmafPicturePool *pool = entry->pool;
+    VmafPicturePoolKey *key = entry->key;
+
+    pthread_mutex_lock(&(pool->lock));
+    const bool closed = pool->closed;
+    const bool last = --(pool->n_outstanding) == 0;
+    const bool keep = !closed && key->n_idle < PICTURE_POOL_MAX_IDLE_PER_KEY;
+    if (keep) {
+        entry->next = key->free_list;
+        key->free_list = entry;
+        key->n_idle++;
+    }
+    pthread_mutex_unlock(&(pool->lock));
+
+    if (!keep) picture_pool_entry_destroy(entry);
+    if (closed && last) picture_pool_destroy(pool);
+}
+
+/* Must be called with pool->lock held. */
+static VmafPicturePoolKey *picture_pool_key(VmafPicturePool *pool,
+                                            enum VmafPixelFormat pix_fmt,
+                                            unsigned bpc, unsigned w,
+                                            unsigned h)
+{
+    for (VmafPicturePoolKey *key = pool->key; key; key = key->next) {
+        if (key->pix_fmt == pix_fmt && key->bpc == bpc && key->w == w &&
+            key->h == h)
+        {
+            return key;
+        }
+    }
+
+    VmafPicturePoolKey *const key = malloc(sizeof(*key));
+    if (!key) return NULL;
+    memset(key, 0, sizeof(*key));
+    key->pix_fmt = pix_fmt;
+    key->bpc = bpc;
+    key->w = w;
+    key->h = h;
+    key->next = pool->key;
+    pool->key = key;
+    return key;
+}
+
+static int picture_pool_entry_create(VmafPicturePool *pool,
+                                     VmafPicturePoolKey *key,
+                                     VmafPicturePoolEntry **entry)
+{
+    VmafPicturePoolEntry *const e = *entry = malloc(sizeof(*e));
+    if (!e) return -ENOMEM;
+    memset(e, 0, sizeof(*e));
+
+    int err = vmaf_picture_alloc(&e->pic, key->pix_fmt, key->bpc, key->w,
+                                 key->h);
+    if (err) {
+        free(e);
+        return err;
+    }
+
+    e->pool = pool;
+    e->key = key;
+    e->priv.release = picture_pool_entry_return;
+    e->priv.cookie = e;
+    e->priv.pooled = true;
+    e->pic.priv = &e->priv;
+    return 0;
+}
+
+int vmaf_picture_pool_init(VmafPicturePool **pool)
+{
+    if (!pool) return -EINVAL;
+
+    VmafPicturePool *const p = *pool = malloc(sizeof(*p));
+    if (!p) return -ENOMEM;
+    memset(p, 0, sizeof(*p));
+    pthread_mutex_init(&(p->lock), NULL);
+    return 0;
+}
+
+int vmaf_picture_pool_fetch(VmafPicturePool *pool, VmafPicture *pic,
+                            enum VmafPixelFormat pix_fmt, unsigned bpc,
+                            unsigned w, unsigned h)
+{
+    if (!pool) return -EINVAL;
+    if (!pic) return -EINVAL;
+
+    // Every geometry keeps its own idle pictures, so inputs of different
+    // formats or sizes sharing the pool don't evict each other's.
+    pthread_mutex_lock(&(pool->lock));
+    VmafPicturePoolKey *key = picture_pool_key(pool, pix_fmt, bpc, w, h);
+    if (!key) {
+        pthread_mutex_unlock(&(pool->lock));
+        return -ENOMEM;
+    }
+    VmafPicturePoolEntry *entry = key->free_list;
+    if (entry) {
+        key->free_list = entry->next;
+        key->n_idle--;
+    }
+    pool->n_outstanding++;
+    pthread_mutex_unlock(&(pool->lock));
+
+    if (entry) {
+        vmaf_ref_fetch_increment(entry->pic.ref);
+    } else {
+        int err = picture_pool_entry_create(pool, key, &entry);
+        if (err) {
+            pthread_mutex_lock(&(pool->lock));
+            pool->n_outstanding--;
+            pthread_mutex_unlock(&(pool->lock));
+            return err;
+        }
+    }
+
+    entry->next = NULL;
+    memcpy(pic, &entry->pic, sizeof(*pic));
+    return 0;
+}
+
+int vmaf_picture_pool_close(VmafPicturePool *pool)
+{
+    if (!pool) return -EINVAL;
+
+    pthread_mutex_lock(&(pool->lock));
+    pool->closed = true;
+    VmafPicturePoolEntry *idle_entries = NULL;
+    for (VmafPicturePoolKey *key = pool->key; key; key = key->next) {
+        while (key->free_list) {
+            VmafPicturePoolEntry *entry = key->free_list;
+            key->free_list = entry->next;
+            entry->next = idle_entries;
+            idle_entries = entry;
+        }
+        key->n_idle = 0;
+    }
+    const bool idle = pool->n_outstanding == 0;
+    pthread_mutex_unlock(&(pool->lock));
+
+    while (idle_entries) {
+        VmafPicturePoolEntry *next = idle_entries->next;
+        picture_pool_entry_destroy(idle_entries);
+        idle_entries = next;
+    }
+
+    // Pictures still referenced elsewhere free themselves, and the last one
+    // frees the pool, when they are unreferenced.
+    if (idle) picture_pool_destroy(pool);
+    return 0;
+}
@@ -0,0 +1,76 @@
+#include <set>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "picture_interface.h"
+#include "picture_pool.h"
+}
+
+namespace {
+
+struct Geometry {
+  enum VmafPixelFormat pix_fmt;
+  unsigned bpc, w, h;
+};
+
+// The luma-only path fetches a YUV400P picture for one input and the full
+// format for the other; both stay in the pool between frames.
+constexpr Geometry kGeometries[] = {
+    {VMAF_PIX_FMT_YUV400P, 8, 1920, 1080},
+    {VMAF_PIX_FMT_YUV420P, 10, 1280, 720},
+};
+
+constexpr unsigned kFrames = 16;
+constexpr unsigned kInFlight = 3;
+
+TEST(PicturePoolTest, AlternatingGeometriesReuseBuffers) {
+  VmafPicturePool* pool;
+  ASSERT_EQ(vmaf_picture_pool_init(&pool), 0);
+
+  std::set<void*> buffers[2];
+  std::vector<VmafPicture> in_flight;
+  for (unsigned i = 0; i < kFrames; i++) {
+    for (unsigned k = 0; k < 2; k++) {
+      const Geometry& g = kGeometries[k];
+      VmafPicture pic;
+      ASSERT_EQ(vmaf_picture_pool_fetch(pool, &pic, g.pix_fmt, g.bpc, g.w,
+                                        g.h),
+                0);
+      EXPECT_EQ(pic.pix_fmt, g.pix_fmt);
+      EXPECT_EQ(pic.w[0], g.w);
+      EXPECT_EQ(pic.h[0], g.h);
+      buffers[k].insert(pic.data[0]);
+      in_flight.push_back(pic);
+    }
+    // Return the oldest pair once kInFlight pairs are out, like the per-frame
+    // loop does.
+    if (in_flight.size() > 2 * kInFlight) {
+      for (unsigned k = 0; k < 2; k++) {
+        EXPECT_EQ(vmaf_picture_unref(&in_flight.front()), 0);
+        in_flight.erase(in_flight.begin());
+      }
+    }
+  }
+
+  // Only the pictures in flight at once were ever allocated.
+  for (unsigned k = 0; k < 2; k++)
+    EXPECT_LE(buffers[k].size(), kInFlight + 1) << "geometry " << k;
+
+  for (VmafPicture& pic : in_flight) EXPECT_EQ(vmaf_picture_unref(&pic), 0);
+  EXPECT_EQ(vmaf_picture_pool_close(pool), 0);
+}
+
+TEST(PicturePoolTest, OutlivesCloseWhilePicturesAreOut) {
+  VmafPicturePool* pool;
+  ASSERT_EQ(vmaf_picture_pool_init(&pool), 0);
+  VmafPicture pic;
+  ASSERT_EQ(vmaf_picture_pool_fetch(pool, &pic, VMAF_PIX_FMT_YUV420P, 8, 64,
+                                    48),
+            0);
+  EXPECT_EQ(vmaf_picture_pool_close(pool), 0);
+  EXPECT_EQ(vmaf_picture_unref(&pic), 0);
+}
+
+}  // namespace
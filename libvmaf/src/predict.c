@@ -88,7 +88,7 @@ static int find_linear_function_parameters(VmafPoint p1, VmafPoint p2, double *a
 
 static int piecewise_linear_mapping(double x, VmafPoint *knots, unsigned n_knots, double *y) {
 
-    double slope, offset;
+    double slope = 1.0, offset = 0.0;
 
     if (n_knots <= 1)
         return EINVAL;
@@ -122,8 +122,10 @@ static int piecewise_linear_mapping(double x, VmafPoint *knots, unsigned n_knots
                     *y = knots[idx].y;
             }
         } else {
-            find_linear_function_parameters(knots[idx], knots[idx + 1],
-                                            &slope, &offset);
+            int err = find_linear_function_parameters(knots[idx],
+                                                      knots[idx + 1],
+                                                      &slope, &offset);
+            if (err) return err;
 
             if (cond0 && cond1){
                 *y = slope * x + offset;
@@ -223,109 +225,304 @@ static int clip(const VmafModel *model, double *prediction,
     return 0;
 }
 
-int vmaf_predict_score_at_index(VmafModel *model,
-                                VmafFeatureCollector *feature_collector,
-                                unsigned index, double *vmaf_score,
-                                bool write_prediction,
-                                enum VmafModelFlags flags)
+/* Generates the name the model's feature i is written to the collector under,
+ * which depends on the options the model sets for it. */
+static int model_feature_name(const VmafModel *model, unsigned i,
+                              char **feature_name)
 {
+    VmafFeatureExtractor *fex =
+        vmaf_get_feature_extractor_by_feature_name(model->feature[i].name);
+
+    if (!fex) {
+        vmaf_log(VMAF_LOG_LEVEL_ERROR,
+                 "vmaf_predictor_create(): no feature extractor "
+                 "providing feature '%s'\n", model->feature[i].name);
+        return -EINVAL;
+    }
+
+    VmafDictionary *opts_dict = NULL;
+    if (model->feature[i].opts_dict) {
+        int err = vmaf_dictionary_copy(&model->feature[i].opts_dict, &opts_dict);
+        if (err) return err;
+    }
+
+    VmafFeatureExtractorContext *fex_ctx;
+    int err = vmaf_feature_extractor_context_create(&fex_ctx, fex, opts_dict);
+    if (err) {
+        vmaf_log(VMAF_LOG_LEVEL_ERROR,
+                 "vmaf_predictor_create(): could not generate "
+                 "feature extractor context\n");
+        vmaf_dictionary_free(&opts_dict);
+        return err;
+    }
+
+    *feature_name =
+        vmaf_feature_name_from_options(model->feature[i].name,
+                fex_ctx->fex->options, fex_ctx->fex->priv);
+
+    vmaf_feature_extractor_context_destroy(fex_ctx);
+
+    if (!*feature_name) {
+        vmaf_log(VMAF_LOG_LEVEL_ERROR,
+                 "vmaf_predictor_create(): could not generate "
+                 "feature name\n");
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
+int vmaf_predictor_create(VmafPredictor **predictor, VmafModel *model,
+                          VmafFeatureCollector *feature_collector)
+{
+    if (!predictor) return -EINVAL;
     if (!model) return -EINVAL;
     if (!feature_collector) return -EINVAL;
-    if (!vmaf_score) return -EINVAL;
-
-    int err = 0;
 
-    struct svm_node *node = malloc(sizeof(*node) * (model->n_features + 1));
-    if (!node) return -ENOMEM;
+    VmafPredictor *const p = *predictor = malloc(sizeof(*p));
+    if (!p) return -ENOMEM;
+    memset(p, 0, sizeof(*p));
+    p->model = model;
+    p->model_id = model->id;
+    p->feature_collector = feature_collector;
+    int err = -ENOMEM;
+
+    const size_t feature_sz = sizeof(*p->feature) * model->n_features;
+    p->feature = malloc(feature_sz);
+    if (!p->feature && feature_sz) goto fail;
+    memset(p->feature, 0, feature_sz);
+    p->n_features = model->n_features;
+
+    p->node = malloc(sizeof(*p->node) * (model->n_features + 1));
+    if (!p->node) goto fail;
+    p->x = malloc(sizeof(*p->x) * DENSE_SVM_BATCH * (model->n_features + 1));
+    if (!p->x) goto fail;
 
     for (unsigned i = 0; i < model->n_features; i++) {
-        VmafFeatureExtractor *fex =
-            vmaf_get_feature_extractor_by_feature_name(model->feature[i].name);
+        err = model_feature_name(model, i, &p->feature[i].name);
+        if (err) goto fail;
+        p->node[i].index = i + 1;
+    }
+    p->node[model->n_features].index = -1;
 
-        if (!fex) {
-            vmaf_log(VMAF_LOG_LEVEL_ERROR,
-                     "vmaf_predict_score_at_index(): no feature extractor "
-                     "providing feature '%s'\n", model->feature[i].name);
-            err = -EINVAL;
-            goto free_node;
-        }
+    // Models the dense SVM does not cover are left to svm_predict().
+    err = vmaf_dense_svm_init(&p->dense_svm, model->svm, model->n_features);
+    if (err == -ENOMEM) goto fail;
+    if (err) p->dense_svm = NULL;
 
-        VmafDictionary *opts_dict = NULL;
-        if (model->feature[i].opts_dict) {
-            err = vmaf_dictionary_copy(&model->feature[i].opts_dict, &opts_dict);
-            if (err) return err;
-        }
+    return 0;
 
-        VmafFeatureExtractorContext *fex_ctx;
-        err = vmaf_feature_extractor_context_create(&fex_ctx, fex, opts_dict);
-        if (err) {
-            vmaf_log(VMAF_LOG_LEVEL_ERROR,
-                     "vmaf_predict_score_at_index(): could not generate "
-                     "feature extractor context\n");
-            vmaf_dictionary_free(&opts_dict);
-            return err;
-        }
+fail:
+    vmaf_predictor_destroy(p);
+    *predictor = NULL;
+    return err;
+}
 
-        char *feature_name =
-            vmaf_feature_name_from_options(model->feature[i].name,
-                    fex_ctx->fex->options, fex_ctx->fex->priv);
+void vmaf_predictor_destroy(VmafPredictor *predictor)
+{
+    if (!predictor) return;
+
+    for (unsigned i = 0; i < predictor->n_features; i++)
+        free(predictor->feature[i].name);
+    free(predictor->feature);
+    free(predictor->node);
+    free(predictor->x);
+    vmaf_dense_svm_destroy(predictor->dense_svm);
+    free(predictor);
+}
 
-        vmaf_feature_extractor_context_destroy(fex_ctx);
+/* Ids are looked up by name until the collector holds the feature, which it
+ * does from the first score written for it on. */
+static int get_score(VmafFeatureCollector *feature_collector,
+                     const char *feature_name, unsigned *id, bool *resolved,
+                     double *score, unsigned index)
+{
+    if (!*resolved) {
+        int err = vmaf_feature_collector_get_id(feature_collector,
+                                                feature_name, id);
+        if (err) return err;
+        *resolved = true;
+    }
 
-        if (!feature_name) {
-            vmaf_log(VMAF_LOG_LEVEL_ERROR,
-                     "vmaf_predict_score_at_index(): could not generate "
-                     "feature name\n");
-            err = -ENOMEM;
-            goto free_node;
-        }
+    return vmaf_feature_collector_get_score_by_id(feature_collector, *id,
+                                                  score, index);
+}
 
-        double feature_score;
-        err = vmaf_feature_collector_get_score(feature_collector,
-                                               feature_name, &feature_score,
-                                               index);
-        free(feature_name);
+int vmaf_predictor_get_prediction(VmafPredictor *predictor, unsigned index,
+                                  double *vmaf_score)
+{
+    if (!predictor) return -EINVAL;
+    if (!vmaf_score) return -EINVAL;
 
+    return get_score(predictor->feature_collector, predictor->model->name,
+                     &predictor->prediction.id, &predictor->prediction.resolved,
+                     vmaf_score, index);
+}
+
+static int append_prediction(VmafPredictor *predictor, double prediction,
+                             unsigned index)
+{
+    VmafFeatureCollector *feature_collector = predictor->feature_collector;
+
+    if (predictor->prediction.resolved) {
+        return vmaf_feature_collector_append_by_id(feature_collector,
+                                                   predictor->prediction.id,
+                                                   prediction, index);
+    }
+
+    int err = vmaf_feature_collector_append(feature_collector,
+                                            predictor->model->name,
+                                            prediction, index);
+    if (err) return err;
+
+    err = vmaf_feature_collector_get_id(feature_collector,
+                                        predictor->model->name,
+                                        &predictor->prediction.id);
+    if (!err) predictor->prediction.resolved = true;
+    return 0;
+}
+
+/* Reads and normalizes the features of the frame at index into x, and into
+ * node for svm_predict(). */
+static int read_features(VmafPredictor *predictor, unsigned index, double *x)
+{
+    const VmafModel *model = predictor->model;
+
+    for (unsigned i = 0; i < model->n_features; i++) {
+        double feature_score;
+        int err = get_score(predictor->feature_collector,
+                            predictor->feature[i].name,
+                            &predictor->feature[i].id,
+                            &predictor->feature[i].resolved, &feature_score,
+                            index);
         if (err) {
             vmaf_log(VMAF_LOG_LEVEL_ERROR,
-                     "vmaf_predict_score_at_index(): no feature '%s' "
-                     "at index %d\n", feature_name, index);
-            goto free_node;
+                     "vmaf_predictor_predict(): no feature '%s' "
+                     "at index %d\n", predictor->feature[i].name, index);
+            return err;
         }
 
         err = normalize(model, model->feature[i].slope,
                         model->feature[i].intercept, &feature_score);
-        if (err) goto free_node;
+        if (err) return err;
 
-        node[i].index = i + 1;
-        node[i].value = feature_score;
+        predictor->node[i].value = x[i] = feature_score;
     }
-    node[model->n_features].index = -1;
 
-    double prediction = svm_predict(model->svm, node);
+    return 0;
+}
+
+/* Turns the output of the svm into the score of the frame at index. */
+static int finish_prediction(VmafPredictor *predictor, double prediction,
+                             unsigned index, double *vmaf_score,
+                             bool write_prediction, enum VmafModelFlags flags)
+{
+    const VmafModel *model = predictor->model;
 
-    err = denormalize(model, &prediction);
-    if (err) goto free_node;
+    int err = denormalize(model, &prediction);
+    if (err) return err;
 
     err = transform(model, &prediction, flags);
-    if (err) goto free_node;
+    if (err) return err;
 
     err = clip(model, &prediction, flags);
-    if (err) goto free_node;
+    if (err) return err;
 
     if (write_prediction) {
-        err = vmaf_feature_collector_append(feature_collector, model->name,
-                                            prediction, index);
-        if (err) goto free_node;
+        err = append_prediction(predictor, prediction, index);
+        if (err) return err;
     }
 
     *vmaf_score = prediction;
+    return 0;
+}
 
-free_node:
-    free(node);
-    return err;
+int vmaf_predictor_predict(VmafPredictor *predictor, unsigned index,
+                           double *vmaf_score, bool write_prediction,
+                           enum VmafModelFlags flags)
+{
+    if (!predictor) return -EINVAL;
+    if (!vmaf_score) return -EINVAL;
+
+    int err = read_features(predictor, index, predictor->x);
+    if (err) return err;
+
+    double prediction = predictor->dense_svm ?
+        vmaf_dense_svm_predict(predictor->dense_svm, predictor->x) :
+        svm_predict(predictor->model->svm, predictor->node);
+
+    return finish_prediction(predictor, prediction, index, vmaf_score,
+                             write_prediction, flags);
+}
+
+/* Predicts and writes the frames whose features were read into x. */
+static int predict_batch(VmafPredictor *predictor, const unsigned *index,
+                         unsigned n, unsigned index_low, double *scores)
+{
+    double prediction[DENSE_SVM_BATCH];
+    vmaf_dense_svm_predict_batch(predictor->dense_svm, predictor->x, n,
+                                 prediction);
+
+    for (unsigned j = 0; j < n; j++) {
+        double score;
+        int err = finish_prediction(predictor, prediction[j], index[j],
+                                    &score, true, 0);
+        if (err) return err;
+        if (scores) scores[index[j] - index_low] = score;
+    }
+
+    return 0;
 }
 
+int vmaf_predictor_predict_range(VmafPredictor *predictor, unsigned index_low,
+                                 unsigned index_high, unsigned n_subsample,
+                                 double *scores)
+{
+    if (!predictor) return -EINVAL;
+    if (index_low > index_high) return -EINVAL;
+
+    const unsigned n_features = predictor->n_features;
+    unsigned index[DENSE_SVM_BATCH];
+    unsigned n = 0;
+    int err = 0;
+
+    for (unsigned i = index_low; i <= index_high; i++) {
+        if ((n_subsample > 1) && (i % n_subsample))
+            continue;
+
+        double score;
+        if (!vmaf_predictor_get_prediction(predictor, i, &score)) {
+            if (scores) scores[i - index_low] = score;
+            continue;
+        }
+
+        if (!predictor->dense_svm) {
+            err = vmaf_predictor_predict(predictor, i, &score, true, 0);
+            if (err) return err;
+            if (scores) scores[i - index_low] = score;
+            continue;
+        }
+
+        err = read_features(predictor, i, predictor->x + n * n_features);
+        if (err) break;
+        index[n++] = i;
+
+        if (n == DENSE_SVM_BATCH) {
+            err = predict_batch(predictor, index, n, index_low, scores);
+            if (err) return err;
+            n = 0;
+        }
+    }
+
+    /* The frames read before a missing feature are still predicted. */
+    if (n) {
+        const int batch_err = predict_batch(predictor, index, n, index_low,
+                                            scores);
+        if (!err) err = batch_err;
+    }
+
+    return err;
+}
 
 static int score_compare(const void *a, const void *b)
 {
@@ -348,10 +545,11 @@ static double percentile(double *scores, unsigned n_scores, double perc)
 
 static int vmaf_bootstrap_predict_score_at_index(
                                         VmafModelCollection *model_collection,
-                                        VmafFeatureCollector *feature_collector,
+                                        VmafPredictor **predictor,
                                         unsigned index,
                                         VmafModelCollectionScore *score)
 {
+    VmafFeatureCollector *feature_collector = predictor[0]->feature_collector;
     int err = 0;
     double scores[model_collection->cnt];
 
@@ -361,18 +559,14 @@ static int vmaf_bootstrap_predict_score_at_index(
         // but do not write them to the feature collector
         const unsigned flags =
             VMAF_MODEL_FLAG_DISABLE_CLIP | VMAF_MODEL_FLAG_DISABLE_TRANSFORM;
-        err = vmaf_predict_score_at_index(model_collection->model[i],
-                                          feature_collector, index,
-                                          &scores[i], false,
-                                          flags);
+        err = vmaf_predictor_predict(predictor[i], index, &scores[i], false,
+                                     flags);
         if (err) return err;
 
         // do not override the model's transform/clip behavior
         // write the scores to the feature collector
         double score;
-        err = vmaf_predict_score_at_index(model_collection->model[i],
-                                          feature_collector, index,
-                                          &score, true, 0);
+        err = vmaf_predictor_predict(predictor[i], index, &score, true, 0);
         if (err) return err;
     }
 
@@ -443,16 +637,17 @@ static int vmaf_bootstrap_predict_score_at_index(
 
 int vmaf_predict_score_at_index_model_collection(
                                 VmafModelCollection *model_collection,
-                                VmafFeatureCollector *feature_collector,
+                                VmafPredictor **predictor,
                                 unsigned index,
                                 VmafModelCollectionScore *score)
 {
+    if (!model_collection->cnt) return -EINVAL;
+
     switch (model_collection->type) {
     case VMAF_MODEL_BOOTSTRAP_SVM_NUSVR:
     case VMAF_MODEL_RESIDUE_BOOTSTRAP_SVM_NUSVR:
         return vmaf_bootstrap_predict_score_at_index(model_collection,
-                                                     feature_collector,
-                                                     index, score);
+                                                     predictor, index, score);
     default:
         return -EINVAL;
     }
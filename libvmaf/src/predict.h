@@ -19,18 +19,62 @@
 #ifndef __VMAF_PREDICT_H__
 #define __VMAF_PREDICT_H__
 
+#include "dense_svm.h"
 #include "feature_collector.h"
 #include "model.h"
 
-int vmaf_predict_score_at_index(VmafModel *model,
-                                VmafFeatureCollector *feature_collector,
-                                unsigned index, double *vmaf_score,
-                                bool write_prediction,
-                                enum VmafModelFlags flags);
+struct svm_node;
 
+/* A model bound to a feature collector. The names of the model's features are
+ * generated once, and resolved to collector ids the first time they are
+ * found, so that predicting a frame allocates nothing and compares no
+ * strings. RBF SVR models, i.e. all VMAF models, are evaluated with a
+ * VmafDenseSvm. Not thread-safe. */
+typedef struct VmafPredictor {
+    VmafModel *model;
+    unsigned long model_id;
+    VmafFeatureCollector *feature_collector;
+    struct {
+        char *name;
+        unsigned id;
+        bool resolved;
+    } *feature;
+    unsigned n_features;
+    struct {
+        unsigned id;
+        bool resolved;
+    } prediction;
+    struct svm_node *node;
+    VmafDenseSvm *dense_svm;
+    double *x;
+} VmafPredictor;
+
+int vmaf_predictor_create(VmafPredictor **predictor, VmafModel *model,
+                          VmafFeatureCollector *feature_collector);
+
+int vmaf_predictor_predict(VmafPredictor *predictor, unsigned index,
+                           double *vmaf_score, bool write_prediction,
+                           enum VmafModelFlags flags);
+
+/* Predicts and writes the frames from index_low to index_high inclusive which
+ * have no prediction yet, skipping those not a multiple of n_subsample if it
+ * is above 1. The frames are read into rows of x and evaluated
+ * DENSE_SVM_BATCH at a time. scores[i - index_low], if given, receives the
+ * score of frame i. */
+int vmaf_predictor_predict_range(VmafPredictor *predictor, unsigned index_low,
+                                 unsigned index_high, unsigned n_subsample,
+                                 double *scores);
+
+/* Reads a prediction written earlier for the frame at index. */
+int vmaf_predictor_get_prediction(VmafPredictor *predictor, unsigned index,
+                                  double *vmaf_score);
+
+void vmaf_predictor_destroy(VmafPredictor *predictor);
+
+/* Takes one predictor per model of the collection, in the same order. */
 int vmaf_predict_score_at_index_model_collection(
                                 VmafModelCollection *model_collection,
-                                VmafFeatureCollector *feature_collector,
+                                VmafPredictor **predictor,
                                 unsigned index,
                                 VmafModelCollectionScore *score);
 
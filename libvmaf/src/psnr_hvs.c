@@ -405,4 +405,5 @@ VmafFeatureExtractor vmaf_fex_psnr_hvs = {
     .init = init,
     .extract = extract,
     .provided_features = provided_features,
+    .flags = VMAF_FEATURE_EXTRACTOR_CHROMA,
 };
@@ -428,6 +428,7 @@ static int vmaf_read_json_model(VmafModel **model, VmafModelConfig *cfg,
     VmafModel *const m = *model = malloc(sizeof(*m));
     if (!m) return -ENOMEM;
     memset(m, 0, sizeof(*m));
+    m->id = vmaf_model_generate_id();
 
     const size_t model_sz = sizeof(*m->feature) * MAX_FEATURE_COUNT;
     m->feature = malloc(model_sz);
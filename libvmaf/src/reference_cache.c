@@ -0,0 +1,271 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "picture.h"
+#include "reference_cache.h"
+
+#define REFERENCE_CACHE_MAGIC 0x31304352464d4156ULL /* "VMAFRC01" */
+#define REFERENCE_CACHE_SLOT_VALID 0x544f4c53U /* "SLOT" */
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+#define REFERENCE_CACHE_HASH_LANES 4
+
+typedef struct ReferenceCacheHeader {
+    uint64_t magic;
+    uint64_t key;
+    uint64_t record_size;
+} ReferenceCacheHeader;
+
+typedef struct ReferenceCacheSlotHeader {
+    uint64_t content_hash;
+    uint32_t valid;
+    uint32_t reserved;
+} ReferenceCacheSlotHeader;
+
+typedef struct VmafReferenceCache {
+    int fd;
+    size_t record_size, slot_size;
+    uint8_t *map;
+    size_t map_size;
+} VmafReferenceCache;
+
+static off_t slot_offset(VmafReferenceCache *cache, unsigned index)
+{
+    return sizeof(ReferenceCacheHeader) + (off_t) index * cache->slot_size;
+}
+
+static int write_header(VmafReferenceCache *cache, uint64_t key)
+{
+    const ReferenceCacheHeader header = {
+        .magic = REFERENCE_CACHE_MAGIC,
+        .key = key,
+        .record_size = cache->record_size,
+    };
+
+    if (ftruncate(cache->fd, 0)) return -errno;
+    if (pwrite(cache->fd, &header, sizeof(header), 0) != sizeof(header))
+        return -EIO;
+    return 0;
+}
+
+int vmaf_reference_cache_open(VmafReferenceCache **cache, const char *path,
+                              uint64_t key, size_t record_size)
+{
+    if (!cache) return -EINVAL;
+    if (!path) return -EINVAL;
+    if (!record_size) return -EINVAL;
+
+    int err = 0;
+    VmafReferenceCache *const c = *cache = malloc(sizeof(*c));
+    if (!c) return -ENOMEM;
+    memset(c, 0, sizeof(*c));
+    c->record_size = record_size;
+    c->slot_size = sizeof(ReferenceCacheSlotHeader) + record_size;
+
+    /* Each key gets a file of its own, so runs with other options never
+     * start over on a file another run has mapped. */
+    const size_t key_path_size = strlen(path) + sizeof(".") + 16;
+    char *key_path = malloc(key_path_size);
+    if (!key_path) {
+        err = -ENOMEM;
+        goto free_cache;
+    }
+    snprintf(key_path, key_path_size, "%s.%016" PRIx64, path, key);
+    c->fd = open(key_path, O_RDWR | O_CREAT, 0644);
+    free(key_path);
+    if (c->fd < 0) {
+        err = -errno;
+        goto free_cache;
+    }
+
+    /* Another run may be creating the same file, or starting over on a
+     * damaged one; check and map the header while holding it alone. */
+    if (flock(c->fd, LOCK_EX)) {
+        err = -errno;
+        goto close_fd;
+    }
+
+    ReferenceCacheHeader header;
+    const ssize_t n = pread(c->fd, &header, sizeof(header), 0);
+    if (n != sizeof(header) || header.magic != REFERENCE_CACHE_MAGIC ||
+        header.key != key || header.record_size != record_size)
+    {
+        /* Missing or damaged: start over. */
+        err = write_header(c, key);
+        if (err) goto close_fd;
+        goto unlock;
+    }
+
+    struct stat st;
+    if (fstat(c->fd, &st)) {
+        err = -errno;
+        goto close_fd;
+    }
+    if ((size_t) st.st_size > sizeof(header)) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, c->fd, 0);
+        if (map != MAP_FAILED) {
+            c->map = map;
+            c->map_size = st.st_size;
+        }
+    }
+
+unlock:
+    flock(c->fd, LOCK_UN);
+    return 0;
+
+close_fd:
+    close(c->fd);
+free_cache:
+    free(c);
+    *cache = NULL;
+    return err;
+}
+
+uint64_t vmaf_reference_cache_hash_string(uint64_t hash, const char *str)
+{
+    if (!hash) hash = FNV_OFFSET_BASIS;
+    if (!str) return hash;
+
+    for (; *str; str++) {
+        hash ^= (uint8_t) *str;
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+uint64_t vmaf_reference_cache_hash_combine(uint64_t hash, uint64_t other)
+{
+    hash = (hash ^ other) * FNV_PRIME;
+    return hash ^ (hash >> 29);
+}
+
+uint64_t vmaf_reference_cache_hash_luma(VmafPicture *pic)
+{
+    uint64_t hash = FNV_OFFSET_BASIS;
+    hash = (hash ^ pic->w[0]) * FNV_PRIME;
+    hash = (hash ^ pic->h[0]) * FNV_PRIME;
+    hash = (hash ^ pic->bpc) * FNV_PRIME;
+
+    /* Word at a time rather than byte at a time, and in independent lanes
+     * so that the multiplies overlap instead of waiting on each other, to
+     * keep hashing cheap compared to the work the cache saves. */
+    uint64_t lane[REFERENCE_CACHE_HASH_LANES];
+    for (unsigned k = 0; k < REFERENCE_CACHE_HASH_LANES; k++)
+        lane[k] = vmaf_reference_cache_hash_combine(hash, k);
+
+    const size_t row_size = pic->w[0] * (pic->bpc > 8 ? 2 : 1);
+    const size_t block_size = REFERENCE_CACHE_HASH_LANES * sizeof(uint64_t);
+    const uint8_t *row = pic->data[0];
+    for (unsigned i = 0; i < pic->h[0]; i++) {
+        size_t j = 0;
+        for (; j + block_size <= row_size; j += block_size) {
+            for (unsigned k = 0; k < REFERENCE_CACHE_HASH_LANES; k++) {
+                uint64_t word;
+                memcpy(&word, row + j + k * sizeof(word), sizeof(word));
+                lane[k] = vmaf_reference_cache_hash_combine(lane[k], word);
+            }
+        }
+        for (; j < row_size; j++)
+            lane[0] = (lane[0] ^ row[j]) * FNV_PRIME;
+        row += pic->stride[0];
+    }
+
+    hash = lane[0];
+    for (unsigned k = 1; k < REFERENCE_CACHE_HASH_LANES; k++)
+        hash = vmaf_reference_cache_hash_combine(hash, lane[k]);
+    return hash;
+}
+
+const void *vmaf_reference_cache_find(VmafReferenceCache *cache,
+                                      unsigned index, uint64_t content_hash)
+{
+    if (!cache) return NULL;
+
+    const off_t offset = slot_offset(cache, index);
+    if (!cache->map || offset + cache->slot_size > cache->map_size)
+        return NULL;
+
+    ReferenceCacheSlotHeader slot_header;
+    memcpy(&slot_header, cache->map + offset, sizeof(slot_header));
+    if (slot_header.valid != REFERENCE_CACHE_SLOT_VALID ||
+        slot_header.content_hash != content_hash)
+    {
+        return NULL;
+    }
+
+    return cache->map + offset + sizeof(slot_header);
+}
+
+int vmaf_reference_cache_lookup(VmafReferenceCache *cache, unsigned index,
+                                uint64_t content_hash, void *record)
+{
+    if (!cache) return -EINVAL;
+    if (!record) return -EINVAL;
+
+    const void *found = vmaf_reference_cache_find(cache, index, content_hash);
+    if (!found) return 0;
+
+    memcpy(record, found, cache->record_size);
+    return 1;
+}
+
+int vmaf_reference_cache_store(VmafReferenceCache *cache, unsigned index,
+                               uint64_t content_hash, const void *record)
+{
+    if (!cache) return -EINVAL;
+    if (!record) return -EINVAL;
+
+    const ReferenceCacheSlotHeader slot_header = {
+        .content_hash = content_hash,
+        .valid = REFERENCE_CACHE_SLOT_VALID,
+    };
+    const struct iovec iov[2] = {
+        { .iov_base = (void *) &slot_header, .iov_len = sizeof(slot_header) },
+        { .iov_base = (void *) record, .iov_len = cache->record_size },
+    };
+
+    /* Header and record go out in one write so that a slot is never
+     * marked valid before its record is in place. */
+    const ssize_t n = pwritev(cache->fd, iov, 2, slot_offset(cache, index));
+    return n == (ssize_t) cache->slot_size ? 0 : -EIO;
+}
+
+int vmaf_reference_cache_close(VmafReferenceCache *cache)
+{
+    if (!cache) return -EINVAL;
+
+    int err = 0;
+    if (cache->map) err |= munmap(cache->map, cache->map_size);
+    err |= close(cache->fd);
+    free(cache);
+    return err ? -EIO : 0;
+}
@@ -0,0 +1,71 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#ifndef __VMAF_SRC_REFERENCE_CACHE_H__
+#define __VMAF_SRC_REFERENCE_CACHE_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "picture.h"
+
+/**
+ * Sidecar file of per-frame intermediates which a feature extractor computes
+ * from the reference picture alone. They are identical for every encode of
+ * the same source, so a later run against a new encode can read them back
+ * instead of recomputing them.
+ *
+ * The file is a header followed by one fixed-size slot per picture index,
+ * in host byte order, so that it can be mapped and indexed directly. A key
+ * derived from the extractor and its options is appended to the path, so
+ * every set of options has a file of its own, and is checked against the
+ * header; a damaged file is started over. Each slot holds the content hash of
+ * the reference picture it was computed from, so a record is only used for
+ * the same source picture.
+ */
+typedef struct VmafReferenceCache VmafReferenceCache;
+
+int vmaf_reference_cache_open(VmafReferenceCache **cache, const char *path,
+                              uint64_t key, size_t record_size);
+
+/* Hash of the luma plane, for keying records by reference content. */
+uint64_t vmaf_reference_cache_hash_luma(VmafPicture *pic);
+
+/* Hash of a string, for deriving a key from extractor options. */
+uint64_t vmaf_reference_cache_hash_string(uint64_t hash, const char *str);
+
+/* Mixes two hashes, for records which depend on several pictures. */
+uint64_t vmaf_reference_cache_hash_combine(uint64_t hash, uint64_t other);
+
+/*
+ * Returns the record in the file as it was when the cache was opened on a
+ * hit, NULL on a miss. The record stays valid until the cache is closed.
+ */
+const void *vmaf_reference_cache_find(VmafReferenceCache *cache,
+                                      unsigned index, uint64_t content_hash);
+
+/* Returns 1 and copies the record out on a hit, 0 on a miss. */
+int vmaf_reference_cache_lookup(VmafReferenceCache *cache, unsigned index,
+                                uint64_t content_hash, void *record);
+
+int vmaf_reference_cache_store(VmafReferenceCache *cache, unsigned index,
+                               uint64_t content_hash, const void *record);
+
+int vmaf_reference_cache_close(VmafReferenceCache *cache);
+
+#endif /* __VMAF_SRC_REFERENCE_CACHE_H__ */
@@ -0,0 +1,256 @@
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cinttypes>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "reference_cache.h"
+}
+
+#include "feature_test_util.h"
+
+namespace {
+
+using vmaf_test::Frame;
+
+constexpr uint64_t kKey = 0x1234;
+
+// The magic, the key and the record size.
+constexpr off_t kHeaderSize = 24;
+
+struct Record {
+  uint64_t a, b;
+};
+
+// The file the cache at path keeps the records for key in.
+std::string KeyPath(const std::string& path, uint64_t key) {
+  char suffix[32];
+  snprintf(suffix, sizeof(suffix), ".%016" PRIx64, key);
+  return path + suffix;
+}
+
+class ReferenceCacheTest : public testing::Test {
+ protected:
+  void SetUp() override {
+    path_ = testing::TempDir() + "reference_cache_test_" +
+            testing::UnitTest::GetInstance()->current_test_info()->name();
+    unlink(KeyPath(path_, kKey).c_str());
+  }
+
+  // Stores record {i, 2 * i} for content hash 100 + i at indices 0 to n - 1.
+  void Store(unsigned n) {
+    VmafReferenceCache* cache;
+    ASSERT_EQ(vmaf_reference_cache_open(&cache, path_.c_str(), kKey,
+                                        sizeof(Record)),
+              0);
+    for (unsigned i = 0; i < n; i++) {
+      const Record record = {i, 2 * i};
+      EXPECT_EQ(vmaf_reference_cache_store(cache, i, 100 + i, &record), 0);
+    }
+    EXPECT_EQ(vmaf_reference_cache_close(cache), 0);
+  }
+
+  // Returns which of indices 0 to n - 1 hit, checking the records of hits.
+  std::vector<bool> Lookup(unsigned n, uint64_t key = kKey) {
+    std::vector<bool> hits;
+    VmafReferenceCache* cache;
+    EXPECT_EQ(vmaf_reference_cache_open(&cache, path_.c_str(), key,
+                                        sizeof(Record)),
+              0);
+    if (!cache) return hits;
+    for (unsigned i = 0; i < n; i++) {
+      Record record = {0, 0};
+      const int hit = vmaf_reference_cache_lookup(cache, i, 100 + i, &record);
+      if (hit) {
+        EXPECT_EQ(record.a, i);
+        EXPECT_EQ(record.b, 2 * i);
+      }
+      hits.push_back(hit == 1);
+    }
+    EXPECT_EQ(vmaf_reference_cache_close(cache), 0);
+    return hits;
+  }
+
+  std::string path_;
+};
+
+TEST_F(ReferenceCacheTest, ColdThenWarm) {
+  EXPECT_THAT(Lookup(4), testing::Each(false));
+  Store(4);
+  EXPECT_THAT(Lookup(4), testing::Each(true));
+}
+
+TEST_F(ReferenceCacheTest, ContentHashMismatchMisses) {
+  Store(1);
+  VmafReferenceCache* cache;
+  ASSERT_EQ(vmaf_reference_cache_open(&cache, path_.c_str(), kKey,
+                                      sizeof(Record)),
+            0);
+  Record record;
+  EXPECT_EQ(vmaf_reference_cache_lookup(cache, 0, 99, &record), 0);
+  EXPECT_EQ(vmaf_reference_cache_close(cache), 0);
+}
+
+TEST_F(ReferenceCacheTest, KeyMismatchKeepsTheOtherFile) {
+  Store(4);
+  unlink(KeyPath(path_, kKey + 1).c_str());
+  EXPECT_THAT(Lookup(4, kKey + 1), testing::Each(false));
+  // Opening with another key must not have discarded the records.
+  EXPECT_THAT(Lookup(4), testing::Each(true));
+}
+
+TEST_F(ReferenceCacheTest, TruncatedFileMissesTheCutRecords) {
+  Store(4);
+  struct stat st;
+  ASSERT_EQ(stat(KeyPath(path_, kKey).c_str(), &st), 0);
+  const off_t slot_size = (st.st_size - kHeaderSize) / 4;
+
+  // Cut through the third record.
+  ASSERT_EQ(truncate(KeyPath(path_, kKey).c_str(),
+                     kHeaderSize + 2 * slot_size + 8),
+            0);
+  EXPECT_THAT(Lookup(4), testing::ElementsAre(true, true, false, false));
+
+  // Cut through the header, which starts the file over.
+  ASSERT_EQ(truncate(KeyPath(path_, kKey).c_str(), kHeaderSize / 2), 0);
+  EXPECT_THAT(Lookup(4), testing::Each(false));
+  Store(4);
+  EXPECT_THAT(Lookup(4), testing::Each(true));
+}
+
+const std::vector<std::string> kMotionFeatures = {
+    "VMAF_integer_feature_motion_score",
+    "VMAF_integer_feature_motion2_score",
+};
+
+const std::vector<std::string> kVifFeatures = {
+    "VMAF_integer_feature_vif_scale0_score",
+    "VMAF_integer_feature_vif_scale1_score",
+    "VMAF_integer_feature_vif_scale2_score",
+    "VMAF_integer_feature_vif_scale3_score",
+    "integer_vif_num",
+    "integer_vif_den",
+};
+
+const std::vector<std::string> kAdmFeatures = {
+    "VMAF_integer_feature_adm2_score",
+    "integer_adm_num",
+    "integer_adm_den",
+};
+
+Frame NoiseFrame(unsigned w, unsigned h, unsigned bpc, std::mt19937* rng) {
+  Frame f = {w, h, bpc, std::vector<uint16_t>(w * h)};
+  std::uniform_int_distribution<int> sample(0, (1 << bpc) - 1);
+  for (uint16_t& v : f.luma) v = sample(*rng);
+  return f;
+}
+
+// Creates dir, or removes the files of an earlier run from it.
+void EmptyDir(const std::string& dir) {
+  mkdir(dir.c_str(), 0755);
+  DIR* d = opendir(dir.c_str());
+  ASSERT_NE(d, nullptr);
+  while (const struct dirent* entry = readdir(d)) {
+    const std::string name = entry->d_name;
+    if (name != "." && name != "..") unlink((dir + "/" + name).c_str());
+  }
+  closedir(d);
+}
+
+// Scores a source against two encodes with the cache of the extractor, and
+// another source, expecting the scores of runs without the cache each time.
+void ExpectScoresMatchWithoutTheCache(const std::string& path,
+                                      const std::string& extractor,
+                                      const std::vector<std::string>& features,
+                                      unsigned bpc, uint64_t cpumask) {
+  std::mt19937 rng(11);
+  std::vector<Frame> ref, dist, other_dist;
+  for (unsigned i = 0; i < 6; i++) {
+    ref.push_back(NoiseFrame(101, 57, bpc, &rng));
+    dist.push_back(NoiseFrame(101, 57, bpc, &rng));
+    other_dist.push_back(NoiseFrame(101, 57, bpc, &rng));
+  }
+  // Half the distorted samples follow the reference, so that every branch
+  // of the statistics is taken.
+  for (unsigned i = 0; i < ref.size(); i++) {
+    for (unsigned k = 0; k < ref[i].luma.size(); k += 2) {
+      dist[i].luma[k] = ref[i].luma[k];
+      other_dist[i].luma[k] = ref[i].luma[k];
+    }
+  }
+  const auto uncached =
+      vmaf_test::ScoreFeatures(ref, dist, {extractor}, features, cpumask);
+  ASSERT_EQ(uncached.size(), ref.size());
+  const auto other_dist_uncached = vmaf_test::ScoreFeatures(
+      ref, other_dist, {extractor}, features, cpumask);
+
+  // The file name depends on the key the extractor derives, so start from
+  // an empty directory rather than a known file.
+  const std::string dir = path + ".d";
+  EmptyDir(dir);
+  const std::map<std::string, std::string> options = {
+      {"reference_cache", dir + "/ref"},
+  };
+  const auto cold = vmaf_test::ScoreFeatures(ref, dist, {extractor}, features,
+                                             cpumask, options);
+  EXPECT_EQ(cold, uncached);
+
+  // A new encode of the same source reads the reference-side work back.
+  const auto warm = vmaf_test::ScoreFeatures(ref, other_dist, {extractor},
+                                             features, cpumask, options);
+  EXPECT_EQ(warm, other_dist_uncached);
+
+  // Another source misses and is scored from scratch.
+  std::vector<Frame> other_ref = ref;
+  other_ref[3] = NoiseFrame(101, 57, bpc, &rng);
+  const auto other_uncached = vmaf_test::ScoreFeatures(
+      other_ref, dist, {extractor}, features, cpumask);
+  const auto other_cached = vmaf_test::ScoreFeatures(
+      other_ref, dist, {extractor}, features, cpumask, options);
+  EXPECT_EQ(other_cached, other_uncached);
+  EXPECT_NE(other_cached, uncached);
+}
+
+TEST_F(ReferenceCacheTest, MotionScoresMatchWithoutTheCache) {
+  ExpectScoresMatchWithoutTheCache(path_, "motion", kMotionFeatures, 8, 0);
+}
+
+TEST_F(ReferenceCacheTest, VifScoresMatchWithoutTheCache) {
+  ExpectScoresMatchWithoutTheCache(path_, "vif", kVifFeatures, 8, 0);
+}
+
+TEST_F(ReferenceCacheTest, VifScoresMatchWithoutTheCacheAt10Bit) {
+  ExpectScoresMatchWithoutTheCache(path_, "vif", kVifFeatures, 10, 0);
+}
+
+TEST_F(ReferenceCacheTest, VifScoresMatchWithoutTheCacheInC) {
+  ExpectScoresMatchWithoutTheCache(path_, "vif", kVifFeatures, 8,
+                                   ~UINT64_C(0));
+  ExpectScoresMatchWithoutTheCache(path_ + "_10", "vif", kVifFeatures, 10,
+                                   ~UINT64_C(0));
+}
+
+TEST_F(ReferenceCacheTest, AdmScoresMatchWithoutTheCache) {
+  ExpectScoresMatchWithoutTheCache(path_, "adm", kAdmFeatures, 8, 0);
+}
+
+TEST_F(ReferenceCacheTest, AdmScoresMatchWithoutTheCacheAt10Bit) {
+  ExpectScoresMatchWithoutTheCache(path_, "adm", kAdmFeatures, 10, 0);
+}
+
+TEST_F(ReferenceCacheTest, AdmScoresMatchWithoutTheCacheInC) {
+  ExpectScoresMatchWithoutTheCache(path_, "adm", kAdmFeatures, 8,
+                                   ~UINT64_C(0));
+  ExpectScoresMatchWithoutTheCache(path_ + "_10", "adm", kAdmFeatures, 10,
+                                   ~UINT64_C(0));
+}
+
+}  // namespace
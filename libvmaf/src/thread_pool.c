@@ -18,80 +18,274 @@
 
 #include <errno.h>
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "thread_pool.h"
+
+/* Payloads up to this size are copied into the job itself, which covers the
+ * per-extractor jobs libvmaf enqueues. Larger payloads get a heap copy. */
+#define JOB_PAYLOAD_SIZE 320
+
+/* Preallocated jobs per worker. Once they are all in use, further jobs are
+ * heap allocated until slots are returned. */
+#define RING_JOBS_PER_THREAD 64
+
+#define DEQUE_INITIAL_CAPACITY 64
+
 typedef struct VmafThreadPoolJob {
     void (*func)(void *data);
     void *data;
-    struct VmafThreadPoolJob *next;
+    atomic_bool in_use;
+    bool in_ring;
+    union {
+        max_align_t align;
+        unsigned char bytes[JOB_PAYLOAD_SIZE];
+    } payload;
 } VmafThreadPoolJob;
 
-typedef struct VmafTreadPool {
+/*
+ * The state of a vmaf_thread_pool_parallel_for() call. The pool keeps one
+ * per thread and one for the caller, so that calls allocate nothing. Helper
+ * jobs may only get to run once their call has returned and the slot has
+ * been taken by another call, so they claim indices through a ticket which
+ * holds the generation of the call next to the number of indices left.
+ */
+typedef struct ParallelFor {
+    atomic_bool in_use;
+    atomic_uint_least64_t ticket;
+    void (*func)(void *data, unsigned i);
+    void *data;
+    unsigned n;
+    atomic_uint done;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} ParallelFor;
+
+typedef struct VmafThreadPoolWorker {
+    struct VmafThreadPool *pool;
+    pthread_t thread;
+    unsigned id;
     struct {
         pthread_mutex_t lock;
-        pthread_cond_t empty;
-        VmafThreadPoolJob *head, *tail;
-    } queue;
-    pthread_cond_t working;
+        VmafThreadPoolJob **job;
+        unsigned head, capacity;
+        atomic_uint cnt;
+    } deque;
+} VmafThreadPoolWorker;
+
+typedef struct VmafThreadPool {
+    VmafThreadPoolWorker *worker;
     unsigned n_threads;
-    unsigned n_working;
-    bool stop;
+    atomic_uint next_worker;
+    struct {
+        VmafThreadPoolJob *job;
+        unsigned cnt;
+        atomic_uint next;
+    } ring;
+    /* Never less than the number of jobs sitting in deques, so a worker which
+     * sees zero may go to sleep. */
+    atomic_uint n_queued;
+    /* Enqueued and not yet finished, for vmaf_thread_pool_wait(). */
+    atomic_uint n_unfinished;
+    atomic_bool stop;
+    struct {
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        atomic_uint n_sleeping;
+    } wake;
+    struct {
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+    } idle;
+    struct {
+        ParallelFor *slot;
+        unsigned cnt;
+    } parallel_for;
 } VmafThreadPool;
 
-static VmafThreadPoolJob *vmaf_thread_pool_fetch_job(VmafThreadPool *pool)
+static VmafThreadPoolJob *job_alloc(VmafThreadPool *pool, size_t data_sz)
 {
-    if (!pool) return NULL;
-    if (!pool->queue.head) return NULL;
+    VmafThreadPoolJob *job = NULL;
 
-    VmafThreadPoolJob *job = pool->queue.head;
-    if (!job->next) {
-        pool->queue.head = NULL;
-        pool->queue.tail = NULL;
-    } else {
-        pool->queue.head = job->next;
+    for (unsigned i = 0; i < pool->ring.cnt; i++) {
+        const unsigned idx =
+            atomic_fetch_add_explicit(&pool->ring.next, 1,
+                                      memory_order_relaxed) % pool->ring.cnt;
+        VmafThreadPoolJob *const slot = &pool->ring.job[idx];
+        bool expected = false;
+        if (atomic_load_explicit(&slot->in_use, memory_order_relaxed))
+            continue;
+        if (atomic_compare_exchange_strong_explicit(&slot->in_use, &expected,
+                true, memory_order_acquire, memory_order_relaxed))
+        {
+            job = slot;
+            break;
+        }
+    }
+
+    if (!job) {
+        job = malloc(sizeof(*job));
+        if (!job) return NULL;
+        job->in_ring = false;
+    }
+
+    job->data = job->payload.bytes;
+    if (data_sz > sizeof(job->payload)) {
+        job->data = malloc(data_sz);
+        if (!job->data) goto free_job;
     }
     return job;
+
+free_job:
+    if (job->in_ring)
+        atomic_store_explicit(&job->in_use, false, memory_order_release);
+    else
+        free(job);
+    return NULL;
 }
 
-static void vmaf_thread_pool_job_destroy(VmafThreadPoolJob *job)
+static void job_free(VmafThreadPoolJob *job)
 {
-    if (!job) return;
-    if (job->data) free(job->data);
-    free(job);
+    if (job->data && job->data != job->payload.bytes) free(job->data);
+    if (job->in_ring)
+        atomic_store_explicit(&job->in_use, false, memory_order_release);
+    else
+        free(job);
+}
+
+static int deque_push(VmafThreadPoolWorker *w, VmafThreadPoolJob *job)
+{
+    pthread_mutex_lock(&(w->deque.lock));
+
+    const unsigned cnt = atomic_load_explicit(&w->deque.cnt,
+                                              memory_order_relaxed);
+    if (cnt == w->deque.capacity) {
+        const unsigned capacity = w->deque.capacity * 2;
+        VmafThreadPoolJob **job_arr = malloc(sizeof(*job_arr) * capacity);
+        if (!job_arr) {
+            pthread_mutex_unlock(&(w->deque.lock));
+            return -ENOMEM;
+        }
+        for (unsigned i = 0; i < cnt; i++)
+            job_arr[i] = w->deque.job[(w->deque.head + i) % w->deque.capacity];
+        free(w->deque.job);
+        w->deque.job = job_arr;
+        w->deque.head = 0;
+        w->deque.capacity = capacity;
+    }
+
+    w->deque.job[(w->deque.head + cnt) % w->deque.capacity] = job;
+    atomic_store_explicit(&w->deque.cnt, cnt + 1, memory_order_relaxed);
+    pthread_mutex_unlock(&(w->deque.lock));
+    return 0;
+}
+
+/* The owning worker runs its jobs oldest first, which keeps frames moving
+ * through in order. Thieves take from the other end. */
+static VmafThreadPoolJob *deque_pop(VmafThreadPoolWorker *w, bool steal)
+{
+    if (!atomic_load_explicit(&w->deque.cnt, memory_order_relaxed))
+        return NULL;
+
+    VmafThreadPoolJob *job = NULL;
+    pthread_mutex_lock(&(w->deque.lock));
+    const unsigned cnt = atomic_load_explicit(&w->deque.cnt,
+                                              memory_order_relaxed);
+    if (cnt) {
+        if (steal) {
+            job = w->deque.job[(w->deque.head + cnt - 1) % w->deque.capacity];
+        } else {
+            job = w->deque.job[w->deque.head];
+            w->deque.head = (w->deque.head + 1) % w->deque.capacity;
+        }
+        atomic_store_explicit(&w->deque.cnt, cnt - 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&(w->deque.lock));
+    return job;
+}
+
+static VmafThreadPoolJob *fetch_job(VmafThreadPool *pool, unsigned id)
+{
+    VmafThreadPoolJob *job = deque_pop(&pool->worker[id], false);
+    for (unsigned i = 1; !job && i < pool->n_threads; i++)
+        job = deque_pop(&pool->worker[(id + i) % pool->n_threads], true);
+    if (job) atomic_fetch_sub(&pool->n_queued, 1);
+    return job;
+}
+
+static void finish_jobs(VmafThreadPool *pool, unsigned n)
+{
+    if (atomic_fetch_sub(&pool->n_unfinished, n) != n) return;
+    pthread_mutex_lock(&(pool->idle.lock));
+    pthread_cond_broadcast(&(pool->idle.cond));
+    pthread_mutex_unlock(&(pool->idle.lock));
 }
 
 static void *vmaf_thread_pool_runner(void *p)
 {
-    VmafThreadPool *pool = p;
+    VmafThreadPoolWorker *w = p;
+    VmafThreadPool *pool = w->pool;
 
-    for (;;) {
-        pthread_mutex_lock(&(pool->queue.lock));
-        if (!pool->queue.head && !pool->stop)
-            pthread_cond_wait(&(pool->queue.empty), &(pool->queue.lock));
-        if (pool->stop) break;
-        VmafThreadPoolJob *job = vmaf_thread_pool_fetch_job(pool);
-        pool->n_working++;
-        pthread_mutex_unlock(&(pool->queue.lock));
+    while (!atomic_load(&pool->stop)) {
+        VmafThreadPoolJob *job = fetch_job(pool, w->id);
         if (job) {
             job->func(job->data);
-            vmaf_thread_pool_job_destroy(job);
+            job_free(job);
+            finish_jobs(pool, 1);
+            continue;
         }
-        pthread_mutex_lock(&(pool->queue.lock));
-        pool->n_working--;
-        if (!pool->stop && pool->n_working == 0 && !pool->queue.head)
-            pthread_cond_signal(&(pool->working));
-        pthread_mutex_unlock(&(pool->queue.lock));
-    }
 
-    if (--(pool->n_threads) == 0)
-        pthread_cond_signal(&(pool->working));
+        pthread_mutex_lock(&(pool->wake.lock));
+        atomic_fetch_add(&pool->wake.n_sleeping, 1);
+        if (!atomic_load(&pool->stop) && !atomic_load(&pool->n_queued))
+            pthread_cond_wait(&(pool->wake.cond), &(pool->wake.lock));
+        atomic_fetch_sub(&pool->wake.n_sleeping, 1);
+        pthread_mutex_unlock(&(pool->wake.lock));
+    }
 
-    pthread_mutex_unlock(&(pool->queue.lock));
     return NULL;
 }
 
+static void stop_workers(VmafThreadPool *pool, unsigned n_started)
+{
+    pthread_mutex_lock(&(pool->wake.lock));
+    atomic_store(&pool->stop, true);
+    pthread_cond_broadcast(&(pool->wake.cond));
+    pthread_mutex_unlock(&(pool->wake.lock));
+
+    for (unsigned i = 0; i < n_started; i++)
+        pthread_join(pool->worker[i].thread, NULL);
+}
+
+static void free_pool(VmafThreadPool *pool)
+{
+    for (unsigned i = 0; i < pool->n_threads; i++) {
+        VmafThreadPoolWorker *w = &pool->worker[i];
+        VmafThreadPoolJob *job;
+        while ((job = deque_pop(w, false)))
+            job_free(job);
+        pthread_mutex_destroy(&(w->deque.lock));
+        free(w->deque.job);
+    }
+    for (unsigned i = 0; i < pool->parallel_for.cnt; i++) {
+        pthread_mutex_destroy(&(pool->parallel_for.slot[i].lock));
+        pthread_cond_destroy(&(pool->parallel_for.slot[i].cond));
+    }
+    pthread_mutex_destroy(&(pool->wake.lock));
+    pthread_cond_destroy(&(pool->wake.cond));
+    pthread_mutex_destroy(&(pool->idle.lock));
+    pthread_cond_destroy(&(pool->idle.cond));
+    free(pool->parallel_for.slot);
+    free(pool->ring.job);
+    free(pool->worker);
+    free(pool);
+}
+
 int vmaf_thread_pool_create(VmafThreadPool **pool, unsigned n_threads)
 {
     if (!pool) return -EINVAL;
@@ -101,18 +295,78 @@ int vmaf_thread_pool_create(VmafThreadPool **pool, unsigned n_threads)
     if (!p) return -ENOMEM;
     memset(p, 0, sizeof(*p));
     p->n_threads = n_threads;
+    atomic_init(&p->next_worker, 0);
+    atomic_init(&p->ring.next, 0);
+    atomic_init(&p->n_queued, 0);
+    atomic_init(&p->n_unfinished, 0);
+    atomic_init(&p->stop, false);
+    atomic_init(&p->wake.n_sleeping, 0);
+    pthread_mutex_init(&(p->wake.lock), NULL);
+    pthread_cond_init(&(p->wake.cond), NULL);
+    pthread_mutex_init(&(p->idle.lock), NULL);
+    pthread_cond_init(&(p->idle.cond), NULL);
 
-    pthread_mutex_init(&(p->queue.lock), NULL);
-    pthread_cond_init(&(p->queue.empty), NULL);
-    pthread_cond_init(&(p->working), NULL);
+    p->worker = calloc(n_threads, sizeof(*p->worker));
+    p->ring.cnt = n_threads * RING_JOBS_PER_THREAD;
+    p->ring.job = malloc(sizeof(*p->ring.job) * p->ring.cnt);
+    if (!p->worker || !p->ring.job) goto free_p;
+
+    for (unsigned i = 0; i < p->ring.cnt; i++) {
+        atomic_init(&p->ring.job[i].in_use, false);
+        p->ring.job[i].in_ring = true;
+    }
+
+    for (unsigned i = 0; i < n_threads; i++) {
+        VmafThreadPoolWorker *w = &p->worker[i];
+        w->pool = p;
+        w->id = i;
+        pthread_mutex_init(&(w->deque.lock), NULL);
+        atomic_init(&w->deque.cnt, 0);
+        w->deque.capacity = DEQUE_INITIAL_CAPACITY;
+    }
 
     for (unsigned i = 0; i < n_threads; i++) {
-        pthread_t thread;
-        pthread_create(&thread, NULL, vmaf_thread_pool_runner, p);
-        pthread_detach(thread);
+        VmafThreadPoolWorker *w = &p->worker[i];
+        w->deque.job = malloc(sizeof(*w->deque.job) * w->deque.capacity);
+        if (!w->deque.job) goto free_p;
+    }
+
+    p->parallel_for.slot = malloc(sizeof(*p->parallel_for.slot) * (n_threads + 1));
+    if (!p->parallel_for.slot) goto free_p;
+    for (unsigned i = 0; i < n_threads + 1; i++) {
+        ParallelFor *pf = &p->parallel_for.slot[i];
+        atomic_init(&pf->in_use, false);
+        atomic_init(&pf->ticket, 0);
+        atomic_init(&pf->done, 0);
+        pthread_mutex_init(&(pf->lock), NULL);
+        pthread_cond_init(&(pf->cond), NULL);
+        p->parallel_for.cnt++;
+    }
+
+    for (unsigned i = 0; i < n_threads; i++) {
+        if (pthread_create(&p->worker[i].thread, NULL,
+                           vmaf_thread_pool_runner, &p->worker[i]))
+        {
+            stop_workers(p, i);
+            goto free_p;
+        }
     }
 
     return 0;
+
+free_p:
+    if (p->worker) {
+        free_pool(p);
+    } else {
+        pthread_mutex_destroy(&(p->wake.lock));
+        pthread_cond_destroy(&(p->wake.cond));
+        pthread_mutex_destroy(&(p->idle.lock));
+        pthread_cond_destroy(&(p->idle.cond));
+        free(p->ring.job);
+        free(p);
+    }
+    *pool = NULL;
+    return -ENOMEM;
 }
 
 int vmaf_thread_pool_enqueue(VmafThreadPool *pool, void (*func)(void *data),
@@ -121,67 +375,153 @@ int vmaf_thread_pool_enqueue(VmafThreadPool *pool, void (*func)(void *data),
     if (!pool) return -EINVAL;
     if (!func) return -EINVAL;
 
-    VmafThreadPoolJob *job = malloc(sizeof(*job));
+    VmafThreadPoolJob *job = job_alloc(pool, data ? data_sz : 0);
     if (!job) return -ENOMEM;
-    memset(job, 0, sizeof(*job));
     job->func = func;
-    if (data) {
-        job->data = malloc(data_sz);
-        if (!job->data) goto free_job;
+    if (data)
         memcpy(job->data, data, data_sz);
-    }
+    else
+        job->data = NULL;
 
-    pthread_mutex_lock(&(pool->queue.lock));
+    atomic_fetch_add(&pool->n_unfinished, 1);
+    atomic_fetch_add(&pool->n_queued, 1);
 
-    if (!pool->queue.head) {
-        pool->queue.head = job;
-        pool->queue.tail = pool->queue.head;
-    } else {
-        pool->queue.tail->next = job;
-        pool->queue.tail = job;
+    const unsigned id = atomic_fetch_add_explicit(&pool->next_worker, 1,
+                            memory_order_relaxed) % pool->n_threads;
+    int err = deque_push(&pool->worker[id], job);
+    if (err) {
+        atomic_fetch_sub(&pool->n_queued, 1);
+        job_free(job);
+        finish_jobs(pool, 1);
+        return err;
     }
 
-    pthread_cond_broadcast(&(pool->queue.empty));
-    pthread_mutex_unlock(&(pool->queue.lock));
+    /* Wake a single worker, and only when one is asleep. Any other idle
+     * worker will find the job itself or steal it. */
+    if (atomic_load(&pool->wake.n_sleeping)) {
+        pthread_mutex_lock(&(pool->wake.lock));
+        pthread_cond_signal(&(pool->wake.cond));
+        pthread_mutex_unlock(&(pool->wake.lock));
+    }
 
     return 0;
-
-free_job:
-    free(job);
-    return -ENOMEM;
 }
 
 int vmaf_thread_pool_wait(VmafThreadPool *pool)
 {
     if (!pool) return -EINVAL;
 
-    pthread_mutex_lock(&(pool->queue.lock));
-    while((!pool->stop && (pool->n_working || pool->queue.head)) ||
-          (pool->stop && pool->n_threads))
-        pthread_cond_wait(&(pool->working), &(pool->queue.lock));
-    pthread_mutex_unlock(&(pool->queue.lock));
+    /* Workers only take this lock when the last outstanding job finishes. */
+    if (!atomic_load(&pool->n_unfinished)) return 0;
+
+    pthread_mutex_lock(&(pool->idle.lock));
+    while (atomic_load(&pool->n_unfinished))
+        pthread_cond_wait(&(pool->idle.cond), &(pool->idle.lock));
+    pthread_mutex_unlock(&(pool->idle.lock));
     return 0;
 }
-int vmaf_thread_pool_destroy(VmafThreadPool *pool)
+
+unsigned vmaf_thread_pool_n_threads(VmafThreadPool *pool)
 {
-    if (!pool) return -EINVAL;
-    pthread_mutex_lock(&(pool->queue.lock));
+    return pool ? pool->n_threads : 0;
+}
+
+typedef struct ParallelForHelper {
+    ParallelFor *pf;
+    uint32_t gen;
+} ParallelForHelper;
 
-    VmafThreadPoolJob *job = pool->queue.head;
-    while (job) {
-        VmafThreadPoolJob *next_job = job->next;
-        vmaf_thread_pool_job_destroy(job);
-        job = next_job;
+/* Claims the next index of call gen of the slot, if it has any left. */
+static bool parallel_for_claim(ParallelFor *pf, uint32_t gen, unsigned *i)
+{
+    uint_least64_t ticket = atomic_load(&pf->ticket);
+    do {
+        if ((uint32_t)(ticket >> 32) != gen || !(uint32_t)ticket)
+            return false;
+    } while (!atomic_compare_exchange_weak(&pf->ticket, &ticket, ticket - 1));
+
+    /* The call can't end before this index is done, so n is still its. */
+    *i = pf->n - (uint32_t)ticket;
+    return true;
+}
+
+static void parallel_for_run(ParallelFor *pf, uint32_t gen)
+{
+    unsigned i;
+    while (parallel_for_claim(pf, gen, &i)) {
+        /* The last index done ends the call, after which the slot may be
+         * taken by the next one. */
+        const unsigned n = pf->n;
+        pf->func(pf->data, i);
+        if (atomic_fetch_add(&pf->done, 1) + 1 != n) continue;
+        pthread_mutex_lock(&(pf->lock));
+        pthread_cond_signal(&(pf->cond));
+        pthread_mutex_unlock(&(pf->lock));
     }
+}
 
-    pool->stop = true;
-    pthread_cond_broadcast(&(pool->queue.empty));
-    pthread_mutex_unlock(&(pool->queue.lock));
-    vmaf_thread_pool_wait(pool);
-    pthread_mutex_destroy(&(pool->queue.lock));
-    pthread_cond_destroy(&(pool->queue.empty));
-    pthread_cond_destroy(&(pool->working));
+static void parallel_for_helper(void *data)
+{
+    const ParallelForHelper *helper = data;
+    parallel_for_run(helper->pf, helper->gen);
+}
 
-    free(pool);
+static ParallelFor *parallel_for_acquire(VmafThreadPool *pool)
+{
+    for (unsigned i = 0; i < pool->parallel_for.cnt; i++) {
+        ParallelFor *pf = &pool->parallel_for.slot[i];
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&pf->in_use, &expected, true))
+            return pf;
+    }
+    return NULL;
+}
+
+int vmaf_thread_pool_parallel_for(VmafThreadPool *pool,
+                                  void (*func)(void *data, unsigned i),
+                                  void *data, unsigned n)
+{
+    if (!func) return -EINVAL;
+
+    /* Calls nested deeper than there are slots run serially. */
+    ParallelFor *pf = NULL;
+    if (pool && n > 1) pf = parallel_for_acquire(pool);
+    if (!pf) {
+        for (unsigned i = 0; i < n; i++)
+            func(data, i);
+        return 0;
+    }
+
+    pf->func = func;
+    pf->data = data;
+    pf->n = n;
+    atomic_store(&pf->done, 0);
+    const uint32_t gen = (uint32_t)(atomic_load(&pf->ticket) >> 32) + 1;
+    atomic_store(&pf->ticket, (uint_least64_t)gen << 32 | n);
+
+    ParallelForHelper helper = { .pf = pf, .gen = gen };
+    const unsigned n_helpers = n - 1 < pool->n_threads ? n - 1 : pool->n_threads;
+    for (unsigned i = 0; i < n_helpers; i++)
+        vmaf_thread_pool_enqueue(pool, parallel_for_helper, &helper, sizeof(helper));
+
+    /* Whatever the helpers have not claimed runs here. Then only calls which
+     * are already running on other threads remain. */
+    parallel_for_run(pf, gen);
+    pthread_mutex_lock(&(pf->lock));
+    while (atomic_load(&pf->done) != n)
+        pthread_cond_wait(&(pf->cond), &(pf->lock));
+    pthread_mutex_unlock(&(pf->lock));
+
+    atomic_store(&pf->in_use, false);
+    return 0;
+}
+
+int vmaf_thread_pool_destroy(VmafThreadPool *pool)
+{
+    if (!pool) return -EINVAL;
+
+    /* As before, jobs which have not started yet are discarded. */
+    stop_workers(pool, pool->n_threads);
+    free_pool(pool);
     return 0;
 }
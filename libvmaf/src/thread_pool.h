@@ -30,6 +30,19 @@ int vmaf_thread_pool_enqueue(VmafThreadPool *pool, void (*func)(void *data),
 
 int vmaf_thread_pool_wait(VmafThreadPool *pool);
 
+unsigned vmaf_thread_pool_n_threads(VmafThreadPool *pool);
+
+/**
+ * Calls func(data, i) for every i in [0, n) and returns once all calls have
+ * completed. The calling thread takes part, so this may be called from within
+ * a job running on the same pool. Allocates nothing. Runs serially when pool
+ * is NULL, or when as many calls as the pool has threads, plus one, are
+ * already running on it.
+ */
+int vmaf_thread_pool_parallel_for(VmafThreadPool *pool,
+                                  void (*func)(void *data, unsigned i),
+                                  void *data, unsigned n);
+
 int vmaf_thread_pool_destroy(VmafThreadPool *tpool);
 
 #endif /* __VMAF_THREAD_POOL_H__ */
@@ -0,0 +1,113 @@
+#include <atomic>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "thread_pool.h"
+}
+
+#include "feature_test_util.h"
+
+namespace {
+
+using vmaf_test::Frame;
+
+struct Counts {
+  std::vector<std::atomic<unsigned>> calls;
+  explicit Counts(unsigned n) : calls(n) {}
+};
+
+void CountCall(void* data, unsigned i) {
+  static_cast<Counts*>(data)->calls[i]++;
+}
+
+TEST(ThreadPoolTest, ParallelForCallsEveryIndexOnce) {
+  VmafThreadPool* pool;
+  ASSERT_EQ(vmaf_thread_pool_create(&pool, 4), 0);
+  // Far more calls than the pool has slots for them, each reusing one.
+  for (unsigned n : {0u, 1u, 2u, 3u, 5u, 17u, 64u}) {
+    for (unsigned round = 0; round < 200; round++) {
+      Counts counts(n);
+      ASSERT_EQ(vmaf_thread_pool_parallel_for(pool, CountCall, &counts, n),
+                0);
+      for (unsigned i = 0; i < n; i++)
+        ASSERT_EQ(counts.calls[i], 1u) << "index " << i << " of " << n;
+    }
+  }
+  EXPECT_EQ(vmaf_thread_pool_destroy(pool), 0);
+}
+
+struct NestedJob {
+  VmafThreadPool* pool;
+  Counts* counts;
+};
+
+void RunNested(void* data) {
+  const NestedJob* job = static_cast<NestedJob*>(data);
+  vmaf_thread_pool_parallel_for(job->pool, CountCall, job->counts,
+                                job->counts->calls.size());
+}
+
+TEST(ThreadPoolTest, ParallelForFromJobsOnTheSamePool) {
+  VmafThreadPool* pool;
+  ASSERT_EQ(vmaf_thread_pool_create(&pool, 3), 0);
+  // More jobs than slots, so some calls run serially.
+  std::vector<Counts> counts;
+  for (unsigned k = 0; k < 16; k++) counts.emplace_back(9 + k);
+  for (unsigned k = 0; k < counts.size(); k++) {
+    NestedJob job = {pool, &counts[k]};
+    ASSERT_EQ(vmaf_thread_pool_enqueue(pool, RunNested, &job, sizeof(job)), 0);
+  }
+  ASSERT_EQ(vmaf_thread_pool_wait(pool), 0);
+  for (const Counts& c : counts) {
+    for (const auto& calls : c.calls) EXPECT_EQ(calls, 1u);
+  }
+  EXPECT_EQ(vmaf_thread_pool_destroy(pool), 0);
+}
+
+Frame NoiseFrame(unsigned w, unsigned h, unsigned bpc, std::mt19937* rng) {
+  Frame f = {w, h, bpc, std::vector<uint16_t>(w * h)};
+  std::uniform_int_distribution<int> sample(0, (1 << bpc) - 1);
+  for (uint16_t& v : f.luma) v = sample(*rng);
+  return f;
+}
+
+TEST(ThreadPoolTest, ThreadedScoresMatchSerialScores) {
+  const std::vector<std::string> extractors = {"vif", "adm", "motion"};
+  const std::vector<std::string> features = {
+      "integer_vif_num",
+      "integer_vif_den",
+      "VMAF_integer_feature_vif_scale0_score",
+      "integer_adm_num",
+      "integer_adm_den",
+      "VMAF_integer_feature_adm2_score",
+      "VMAF_integer_feature_motion_score",
+      "VMAF_integer_feature_motion2_score",
+  };
+
+  std::mt19937 rng(7);
+  for (unsigned bpc : {8u, 10u}) {
+    // Tall enough for every extractor to split its scales into bands.
+    std::vector<Frame> ref, dist;
+    for (unsigned i = 0; i < 4; i++) {
+      ref.push_back(NoiseFrame(641, 361, bpc, &rng));
+      dist.push_back(NoiseFrame(641, 361, bpc, &rng));
+    }
+    const auto serial =
+        vmaf_test::ScoreFeatures(ref, dist, extractors, features, 0, {}, 0);
+    ASSERT_EQ(serial.size(), ref.size());
+    for (unsigned n_threads : {1u, 3u, 4u}) {
+      // Bit-exact, not approximately equal.
+      EXPECT_EQ(vmaf_test::ScoreFeatures(ref, dist, extractors, features, 0,
+                                         {}, n_threads),
+                serial)
+          << n_threads << " threads, " << bpc << " bit";
+    }
+  }
+}
+
+}  // namespace
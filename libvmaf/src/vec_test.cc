@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+extern "C" {
+#include "cpu.h"
+#include "libvmaf.h"
+}
+
+#include "feature_test_util.h"
+
+namespace {
+
+// Features written with debug enabled by the extractors which have portable
+// vector kernels.
+const std::vector<std::string> kFeatures = {
+    "VMAF_integer_feature_vif_scale0_score",
+    "VMAF_integer_feature_vif_scale1_score",
+    "VMAF_integer_feature_vif_scale2_score",
+    "VMAF_integer_feature_vif_scale3_score",
+    "integer_vif_num_scale0",
+    "integer_vif_den_scale0",
+    "integer_vif_num_scale1",
+    "integer_vif_den_scale1",
+    "integer_vif_num_scale2",
+    "integer_vif_den_scale2",
+    "integer_vif_num_scale3",
+    "integer_vif_den_scale3",
+    "VMAF_integer_feature_motion_score",
+    "VMAF_integer_feature_motion2_score",
+};
+
+using vmaf_test::Frame;
+
+// Smooth content with noise on top, so that VIF sees both flat and textured
+// areas and motion sees a moving pattern.
+Frame MakeFrame(unsigned w, unsigned h, unsigned bpc, unsigned t,
+                std::mt19937* rng) {
+  Frame f = {w, h, bpc, std::vector<uint16_t>(w * h)};
+  const int max = (1 << bpc) - 1;
+  std::normal_distribution<double> noise(0.0, max / 32.0);
+  for (unsigned y = 0; y < h; y++) {
+    for (unsigned x = 0; x < w; x++) {
+      const int v = ((x + 3 * t) * 7 + y * 5) % (max + 1) / 2 + max / 4 +
+                    static_cast<int>(noise(*rng));
+      f.luma[y * w + x] = v < 0 ? 0 : v > max ? max : v;
+    }
+  }
+  return f;
+}
+
+class VecTest : public testing::Test {
+ protected:
+  void SetUp() override {
+#if !ARCH_X86
+    GTEST_SKIP() << "cpumask can only select the C kernels on x86";
+#endif
+  }
+
+  void ExpectVecMatchesC(unsigned w, unsigned h, unsigned bpc) {
+#if ARCH_X86
+    std::vector<Frame> ref, dist;
+    for (unsigned t = 0; t < 4; t++) {
+      ref.push_back(MakeFrame(w, h, bpc, t, &rng_));
+      dist.push_back(MakeFrame(w, h, bpc, t, &rng_));
+    }
+    // Masking AVX2 masks every tier above it too and leaves the vector
+    // kernels as the highest one.
+    vmaf_test::ExpectMatchesC(ref, dist, {"vif", "motion"}, kFeatures,
+                              VMAF_X86_CPU_FLAG_AVX2);
+#endif
+  }
+
+  std::mt19937 rng_{7};
+};
+
+TEST_F(VecTest, MatchesCAt8Bit) {
+  for (const auto& size : vmaf_test::kEdgeSizes)
+    ExpectVecMatchesC(size[0], size[1], 8);
+}
+
+TEST_F(VecTest, MatchesCAt10Bit) {
+  for (const auto& size : vmaf_test::kEdgeSizes)
+    ExpectVecMatchesC(size[0], size[1], 10);
+}
+
+}  // namespace
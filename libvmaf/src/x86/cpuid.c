@@ -0,0 +1,39 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+/* C equivalent of cpuid.asm for builds without nasm, e.g. Bazel. */
+
+#include <cpuid.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t eax, ebx, ecx, edx;
+} CpuidRegisters;
+
+void vmaf_cpu_cpuid(CpuidRegisters *regs, unsigned leaf, unsigned subleaf)
+{
+    __cpuid_count(leaf, subleaf, regs->eax, regs->ebx, regs->ecx, regs->edx);
+}
+
+uint64_t vmaf_cpu_xgetbv(unsigned xcr)
+{
+    uint32_t eax, edx;
+    /* Encoded as bytes so that no -mxsave is needed. */
+    __asm__ volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(eax), "=d"(edx) : "c"(xcr));
+    return ((uint64_t) edx << 32) | eax;
+}
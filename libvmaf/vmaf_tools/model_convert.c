@@ -0,0 +1,75 @@
+/**
+ *
+ *  Copyright 2016-2020 Netflix, Inc.
+ *
+ *     Licensed under the BSD+Patent License (the "License");
+ *     you may not use this file except in compliance with the License.
+ *     You may obtain a copy of the License at
+ *
+ *         https://opensource.org/licenses/BSDplusPatent
+ *
+ *     Unless required by applicable law or agreed to in writing, software
+ *     distributed under the License is distributed on an "AS IS" BASIS,
+ *     WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *     See the License for the specific language governing permissions and
+ *     limitations under the License.
+ *
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "libvmaf/src/binary_model.h"
+#include "libvmaf/src/model.h"
+#include "libvmaf/src/read_json_model.h"
+
+static void usage(void)
+{
+    puts("usage: model_convert in.json out\n"
+         "Converts a JSON model or model collection to the binary format,\n"
+         "which vmaf_model_load_from_path() and\n"
+         "vmaf_model_load_from_buffer() recognize by its magic.");
+}
+
+int main(int argc, const char **argv)
+{
+    if (argc != 3) {
+        usage();
+        return 1;
+    }
+
+    VmafModelConfig cfg = { .flags = VMAF_MODEL_FLAGS_DEFAULT };
+    VmafModel *model = NULL;
+    VmafModelCollection *model_collection = NULL;
+
+    int err = vmaf_read_json_model_collection_from_path(&model,
+                                                        &model_collection,
+                                                        &cfg, argv[1]);
+    if (err) {
+        vmaf_model_destroy(model);
+        model = NULL;
+        model_collection = NULL;
+        err = vmaf_read_json_model_from_path(&model, &cfg, argv[1]);
+    }
+    if (err) {
+        fprintf(stderr, "could not read model from path: \"%s\"\n", argv[1]);
+        return 1;
+    }
+
+    FILE *out = fopen(argv[2], "wb");
+    if (!out) {
+        fprintf(stderr, "could not open \"%s\"\n", argv[2]);
+        err = 1;
+        goto destroy;
+    }
+    err = vmaf_write_binary_model(out, model, model_collection);
+    if (fclose(out) && !err)
+        err = 1;
+    if (err)
+        fprintf(stderr, "could not write \"%s\": %d\n", argv[2], err);
+
+destroy:
+    vmaf_model_collection_destroy(model_collection);
+    vmaf_model_destroy(model);
+    return err ? 1 : 0;
+}
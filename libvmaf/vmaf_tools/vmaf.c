@@ -65,7 +65,7 @@ static int validate_videos(video_input *vid1, video_input *vid2)
     return err_cnt;
 }
 
-static int fetch_picture(video_input *vid, VmafPicture *pic)
+static int fetch_picture(VmafContext *vmaf, video_input *vid, VmafPicture *pic)
 {
     int ret;
     video_input_ycbcr ycbcr;
@@ -75,8 +75,8 @@ static int fetch_picture(video_input *vid, VmafPicture *pic)
     if (ret < 1) return !ret;
 
     video_input_get_info(vid, &info);
-    ret = vmaf_picture_alloc(pic, pix_fmt_map(info.pixel_fmt), info.depth,
-                             info.pic_w, info.pic_h);
+    ret = vmaf_fetch_picture(vmaf, pic, pix_fmt_map(info.pixel_fmt),
+                             info.depth, info.pic_w, info.pic_h);
     if (ret) {
         fprintf(stderr, "problem allocating picture.\n");
         return -1;
@@ -308,11 +308,15 @@ int main(int argc, char *argv[])
 
     VmafPicture pic_ref, pic_dist;
 
-    for (unsigned i = 0; i < c.frame_skip_ref; i++)
-        fetch_picture(&vid_ref, &pic_ref);
+    for (unsigned i = 0; i < c.frame_skip_ref; i++) {
+        if (!fetch_picture(vmaf, &vid_ref, &pic_ref))
+            vmaf_picture_unref(&pic_ref);
+    }
 
-    for (unsigned i = 0; i < c.frame_skip_dist; i++)
-        fetch_picture(&vid_dist, &pic_dist);
+    for (unsigned i = 0; i < c.frame_skip_dist; i++) {
+        if (!fetch_picture(vmaf, &vid_dist, &pic_dist))
+            vmaf_picture_unref(&pic_dist);
+    }
 
     float fps = 0.;
     const time_t t0 = clock();
@@ -323,8 +327,8 @@ int main(int argc, char *argv[])
             break;
 
         VmafPicture pic_ref, pic_dist;
-        int ret1 = fetch_picture(&vid_ref, &pic_ref);
-        int ret2 = fetch_picture(&vid_dist, &pic_dist);
+        int ret1 = fetch_picture(vmaf, &vid_ref, &pic_ref);
+        int ret2 = fetch_picture(vmaf, &vid_dist, &pic_dist);
 
         if (ret1 && ret2) {
             break;